@@ -0,0 +1,128 @@
+// Compare the open list policies of AStarFinder on generated maps, and
+// report the expansions per second of each one per map type.
+#define BOOST_CHRONO_HEADER_ONLY
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "boost/chrono.hpp"
+#include "finders/astarfinder.hpp"
+#include "test/random.hpp"
+
+typedef AStarFinder::grid_t grid_t;
+typedef std::size_t size_type;
+
+struct Query {
+    size_type start_x, start_y, end_x, end_y;
+};
+
+class Random {
+public:
+    explicit Random(unsigned seed) : state_(seed) {}
+    size_type Next(size_type bound) {
+        return size_type((NextRandom(state_) >> 8) % bound);
+    }
+private:
+    unsigned state_;
+};
+
+// all cells walkable
+void MakeOpen(grid_t &, Random &) {}
+
+// a quarter of the cells blocked at random
+void MakeRandom(grid_t &grid, Random &random) {
+    size_type w = grid.width(), h = grid.height();
+    for (size_type i = 0, n = w * h / 4; i < n; ++i) {
+        grid.SetWalkableAt(random.Next(w), random.Next(h), false);
+    }
+}
+
+// 16x16 rooms with one door in each wall
+void MakeRooms(grid_t &grid, Random &random) {
+    const size_type room = 16;
+    size_type w = grid.width(), h = grid.height();
+    for (size_type y = 0; y < h; ++y) {
+        for (size_type x = 0; x < w; ++x) {
+            if (x % room == 0 || y % room == 0) {
+                grid.SetWalkableAt(x, y, false);
+            }
+        }
+    }
+    for (size_type y = 0; y < h; y += room) {
+        for (size_type x = 0; x < w; x += room) {
+            size_type door = 1 + random.Next(room - 1);
+            if (x + door < w) grid.SetWalkableAt(x + door, y, true);
+            if (y + door < h) grid.SetWalkableAt(x, y + door, true);
+        }
+    }
+}
+
+template <class OpenList>
+void Run(const char *name, const AStarFinder &finder, const grid_t &grid,
+         const std::vector<Query> &queries) {
+    typedef boost::chrono::steady_clock clock_t;
+    BasicSearchContext<OpenList> context;
+    double seconds = 0;
+    std::size_t expanded = 0, found = 0;
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        const Query &q = queries[i];
+        clock_t::time_point begin = clock_t::now();
+        AStarFinder::pnode_vector_t path = finder.FindPath(
+            q.start_x, q.start_y, q.end_x, q.end_y, grid, context);
+        seconds += boost::chrono::duration<double>(
+            clock_t::now() - begin).count();
+        if (path) {
+            ++found;
+        }
+        // count outside of the timing, the closed nodes were expanded
+        for (size_type index = 0; index < grid.size(); ++index) {
+            if (context.IsClosed(index)) {
+                ++expanded;
+            }
+        }
+    }
+    std::printf("  %-12s %10.0f expansions/s %8.3f ms/query"
+                " (%lu expanded, %lu/%lu found)\n",
+                name, expanded / seconds, seconds * 1000 / queries.size(),
+                (unsigned long)expanded, (unsigned long)found,
+                (unsigned long)queries.size());
+}
+
+int main() {
+    const size_type size = 512;
+    const std::size_t query_count = 50;
+    struct MapType {
+        const char *name;
+        void (*make)(grid_t &, Random &);
+    } map_types[] = {
+        {"open", MakeOpen},
+        {"random", MakeRandom},
+        {"rooms", MakeRooms},
+    };
+
+    AStarFinder finder;
+    finder.Option().allow_diagonal = true;
+    finder.Option().heuristic = heuristic::Chebyshev();
+
+    for (std::size_t t = 0; t < sizeof(map_types) / sizeof(map_types[0]); ++t) {
+        Random random(42);
+        grid_t grid(size, size);
+        map_types[t].make(grid, random);
+        std::vector<Query> queries;
+        while (queries.size() < query_count) {
+            Query q = {random.Next(size), random.Next(size),
+                       random.Next(size), random.Next(size)};
+            if (grid.IsWalkableAt(q.start_x, q.start_y) &&
+                    grid.IsWalkableAt(q.end_x, q.end_y)) {
+                queries.push_back(q);
+            }
+        }
+        std::printf("%s %lux%lu:\n", map_types[t].name,
+                    (unsigned long)size, (unsigned long)size);
+        Run<PairingHeapOpenList>("pairing", finder, grid, queries);
+        Run<DAryHeapOpenList<2> >("binary", finder, grid, queries);
+        Run<DAryHeapOpenList<4> >("4-ary", finder, grid, queries);
+        Run<BucketOpenList>("bucket", finder, grid, queries);
+    }
+    return 0;
+}
@@ -0,0 +1,585 @@
+// Replay the MovingAI scenarios against the finders: check the length of
+// every path against the optimal length of its query, and report the time
+// and the expansions per query of each finder, per map and per bucket, as
+// text and optionally as JSON.
+//
+//   bench_scenarios [--json FILE] [--repeat N] [--finder NAME]...
+//                   MAP_DIR SCEN...
+//
+// e.g. from output/bench_scenarios/:
+//   bench_scenarios ../../../PathFinding.js-master/benchmark/map
+//       ../../../PathFinding.js-master/benchmark/scen/*.scen
+//
+// The map of a query is looked up by its file name in MAP_DIR. The optimal
+// lengths count sqrt(2) for a diagonal step and cut no corners, so the
+// finders move by kDiagonalOnlyWhenNoObstacles. With --repeat the queries
+// are replayed N times in a row and the fastest time of each one is kept.
+// The exit status is 1 if a path is missing, does not go from the start
+// to the goal of its query by legal moves, or is shorter than the optimal
+// one, or longer with an exact finder.
+//
+// The losttemple scenario of PathFinding.js, a "version 1.0" one, does not
+// fit the map next to it: every finder gets about a third of its queries
+// wrong, shorter or longer, while they agree with one another.
+#define BOOST_CHRONO_HEADER_ONLY
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "boost/chrono.hpp"
+#include "boost/shared_ptr.hpp"
+#include "core/mapfile.hpp"
+#include "finders/astarfinder.hpp"
+#include "finders/biastarfinder.hpp"
+#include "finders/dstarlitefinder.hpp"
+#include "finders/fringefinder.hpp"
+#include "finders/hpastarfinder.hpp"
+#include "finders/jpsplusfinder.hpp"
+#include "finders/jumppointfinder.hpp"
+#include "finders/landmarks.hpp"
+
+typedef AStarFinder::grid_t grid_t;
+typedef AStarFinder::pnode_vector_t pnode_vector_t;
+typedef std::size_t size_type;
+typedef DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> diagonal_t;
+
+// A finder set up on one grid.
+class Runner {
+public:
+    virtual ~Runner() {}
+    virtual pnode_vector_t Find(const ScenarioQuery &q) = 0;
+    // The cells expanded by the last query, or -1 if the finder keeps no
+    // count of them.
+    virtual long Expanded() const = 0;
+};
+
+template <class OpenList>
+long CountExpanded(const BasicSearchContext<OpenList> &context,
+                   const grid_t &grid) {
+    long expanded = 0;
+    for (size_type index = 0; index < grid.size(); ++index) {
+        if (context.IsClosed(index)) {
+            ++expanded;
+        }
+    }
+    return expanded;
+}
+
+// counted by the search itself
+template <class OpenList>
+long CountExpanded(
+        const BasicSearchContext<OpenList, CountingSearchStats> &context,
+        const grid_t &) {
+    return long(context.stats().Get().expanded);
+}
+
+template <class OpenList>
+long CountExpanded(const BasicBiSearchContext<OpenList> &context,
+                   const grid_t &grid) {
+    return CountExpanded(context.side(0), grid) +
+           CountExpanded(context.side(1), grid);
+}
+
+// the fringe and the two levels of HPA* keep no closed set to count
+template <class Context>
+long CountExpanded(const Context &, const grid_t &) {
+    return -1;
+}
+
+template <class Context>
+Context *NewContext(Context *, const grid_t &) {
+    return new Context;
+}
+
+// room for every cell, a fuller context gives up the query
+FringeContext *NewContext(FringeContext *, const grid_t &grid) {
+    return new FringeContext(grid.size());
+}
+
+// A finder searching with a context of its own. `keep` holds what the
+// finder reads, e.g. its jump table.
+template <class Finder>
+class ContextRunner : public Runner {
+public:
+    typedef typename Finder::context_t context_t;
+
+    ContextRunner(const Finder &finder, const grid_t &grid,
+                  boost::shared_ptr<void> keep)
+        : finder_(finder), grid_(grid), keep_(keep),
+          context_(NewContext(static_cast<context_t *>(0), grid)) {}
+
+    pnode_vector_t Find(const ScenarioQuery &q) {
+        return finder_.FindPath(q.start_x, q.start_y, q.goal_x, q.goal_y,
+                                grid_, *context_);
+    }
+    long Expanded() const { return CountExpanded(*context_, grid_); }
+
+private:
+    Finder finder_;
+    const grid_t &grid_;
+    boost::shared_ptr<void> keep_;
+    boost::scoped_ptr<context_t> context_;
+};
+
+template <class Finder>
+Runner *NewRunner(const Finder &finder, const grid_t &grid,
+                  boost::shared_ptr<void> keep = boost::shared_ptr<void>()) {
+    return new ContextRunner<Finder>(finder, grid, keep);
+}
+
+class DStarLiteRunner : public Runner {
+public:
+    explicit DStarLiteRunner(grid_t &grid) : finder_(grid) {}
+    pnode_vector_t Find(const ScenarioQuery &q) {
+        return finder_.FindPath(q.start_x, q.start_y, q.goal_x, q.goal_y);
+    }
+    long Expanded() const { return long(finder_.expanded()); }
+
+private:
+    BasicDStarLiteFinder<heuristic::Octile, diagonal_t> finder_;
+};
+
+template <class Heuristic>
+Runner *MakeAStar(grid_t &grid) {
+    return NewRunner(BasicAStarFinder<Heuristic, diagonal_t, DefaultOpenList,
+                                      CountingSearchStats>(), grid);
+}
+
+Runner *MakeALT(grid_t &grid) {
+    boost::shared_ptr<LandmarkTable> table(new LandmarkTable);
+    table->Build(grid, diagonal_t::movement, 16);
+    AStarFinder::poption_t option(new FinderOption);
+    option->allow_diagonal = true;
+    option->dont_cross_corners = true;
+    option->heuristic = GoalHeuristic(new LandmarkHeuristic(table));
+    option->weight = 1;
+    return NewRunner(AStarFinder(option), grid);
+}
+
+Runner *MakeBiAStar(grid_t &grid) {
+    return NewRunner(BasicBiAStarFinder<heuristic::Octile, diagonal_t>(),
+                     grid);
+}
+
+Runner *MakeJPS(grid_t &grid) {
+    return NewRunner(BasicJumpPointFinder<heuristic::Octile, diagonal_t>(),
+                     grid);
+}
+
+Runner *MakeJPSPlus(grid_t &grid) {
+    typedef BasicJPSPlusFinder<heuristic::Octile, diagonal_t> finder_t;
+    boost::shared_ptr<finder_t::table_t> table(new finder_t::table_t(grid));
+    return NewRunner(finder_t(*table), grid, table);
+}
+
+Runner *MakeFringe(grid_t &grid) {
+    return NewRunner(BasicFringeFinder<heuristic::Octile, diagonal_t>(),
+                     grid);
+}
+
+Runner *MakeHPAStar(grid_t &grid) {
+    typedef BasicHPAStarFinder<heuristic::Octile, diagonal_t> finder_t;
+    boost::shared_ptr<finder_t::graph_t> graph(new finder_t::graph_t(grid));
+    return NewRunner(finder_t(*graph), grid, graph);
+}
+
+Runner *MakeDStarLite(grid_t &grid) {
+    return new DStarLiteRunner(grid);
+}
+
+// IDA* is left out: it takes seconds per query on these maps.
+const struct FinderType {
+    const char *name;
+    Runner *(*make)(grid_t &);
+    // whether its paths are shortest ones
+    bool exact;
+} kFinderTypes[] = {
+    {"astar-octile", MakeAStar<heuristic::Octile>, true},
+    {"astar-chebyshev", MakeAStar<heuristic::Chebyshev>, true},
+    {"astar-euclidean", MakeAStar<heuristic::Euclidean>, true},
+    {"astar-manhattan", MakeAStar<heuristic::Manhattan>, false},
+    {"astar-alt", MakeALT, true},
+    {"bi-astar", MakeBiAStar, true},
+    {"jps", MakeJPS, true},
+    {"jps+", MakeJPSPlus, true},
+    {"fringe", MakeFringe, true},
+    {"hpa*", MakeHPAStar, false},
+    {"d*lite", MakeDStarLite, true},
+};
+const std::size_t kFinderTypeCount =
+    sizeof(kFinderTypes) / sizeof(kFinderTypes[0]);
+
+enum Verdict { kOptimal, kSuboptimal, kWrong };
+
+struct Sample {
+    unsigned bucket;
+    double ns;
+    long expanded;
+    // the length of the path over the optimal one, 1 without a path
+    double excess;
+    Verdict verdict;
+};
+
+// Whether the step from `a` to `b` is one move to a walkable cell, and
+// cuts no corner.
+bool IsLegalStep(const grid_t &grid, const grid_t::node_t &a,
+                 const grid_t::node_t &b) {
+    long dx = long(b.x) - long(a.x), dy = long(b.y) - long(a.y);
+    if ((dx == 0 && dy == 0) || std::labs(dx) > 1 || std::labs(dy) > 1 ||
+            !grid.IsWalkableAt(b.x, b.y)) {
+        return false;
+    }
+    return dx == 0 || dy == 0 ||
+           (grid.IsWalkableAt(b.x, a.y) && grid.IsWalkableAt(a.x, b.y));
+}
+
+// Check that `path` goes from the start of `q` to its goal by legal steps,
+// and compare its length, sqrt(2) a diagonal step, with the optimal one.
+// The finders cost the steps 10 and 14, so a shortest path by them may be
+// longer by up to sqrt(2) - 1.4 per diagonal step.
+Verdict Check(const grid_t &grid, const ScenarioQuery &q,
+              const pnode_vector_t &path, double &excess) {
+    excess = 1;
+    if (!path || path->empty() ||
+            path->front()->x != q.start_x || path->front()->y != q.start_y ||
+            path->back()->x != q.goal_x || path->back()->y != q.goal_y ||
+            !grid.IsWalkableAt(q.start_x, q.start_y)) {
+        return kWrong;
+    }
+    double length = 0, slack = 1e-3;
+    for (std::size_t i = 1; i < path->size(); ++i) {
+        const grid_t::node_t &a = *(*path)[i - 1], &b = *(*path)[i];
+        if (!IsLegalStep(grid, a, b)) {
+            return kWrong;
+        }
+        bool diagonal = a.x != b.x && a.y != b.y;
+        length += diagonal ? std::sqrt(2.0) : 1;
+        slack += diagonal * (std::sqrt(2.0) - 1.4);
+    }
+    double optimal = q.optimal_length;
+    excess = optimal > 0 ? length / optimal - 1 : length;
+    if (length < optimal - 1e-3) {
+        return kWrong;
+    }
+    return length <= optimal + slack ? kOptimal : kSuboptimal;
+}
+
+struct Summary {
+    std::size_t queries;
+    double ns_per_query;
+    double p50_ns;
+    double p99_ns;
+    double max_ns;
+    // -1 if unknown
+    double expanded_per_query;
+    std::size_t optimal;
+    std::size_t suboptimal;
+    std::size_t wrong;
+    double max_excess;
+};
+
+// The nearest rank percentile of sorted values.
+double Percentile(const std::vector<double> &sorted, double p) {
+    std::size_t rank = std::size_t(std::ceil(p * sorted.size()));
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Summarize the samples of `bucket`, or all of them if it is negative.
+Summary Summarize(const std::vector<Sample> &samples, long bucket) {
+    Summary s = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    std::vector<double> ns;
+    double total = 0, expanded = 0;
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const Sample &sample = samples[i];
+        if (bucket >= 0 && sample.bucket != unsigned(bucket)) {
+            continue;
+        }
+        ns.push_back(sample.ns);
+        total += sample.ns;
+        if (expanded >= 0 && sample.expanded >= 0) {
+            expanded += sample.expanded;
+        } else {
+            expanded = -1;
+        }
+        s.optimal += sample.verdict == kOptimal;
+        s.suboptimal += sample.verdict == kSuboptimal;
+        s.wrong += sample.verdict == kWrong;
+        s.max_excess = std::max(s.max_excess, sample.excess);
+    }
+    s.queries = ns.size();
+    if (s.queries == 0) {
+        return s;
+    }
+    std::sort(ns.begin(), ns.end());
+    s.ns_per_query = total / s.queries;
+    s.p50_ns = Percentile(ns, 0.50);
+    s.p99_ns = Percentile(ns, 0.99);
+    s.max_ns = ns.back();
+    s.expanded_per_query = expanded >= 0 ? expanded / s.queries : -1;
+    return s;
+}
+
+void PrintSummary(std::FILE *out, const char *name, double setup_ms,
+                  const Summary &s) {
+    char expanded[32] = "-";
+    if (s.expanded_per_query >= 0) {
+        std::sprintf(expanded, "%.1f", s.expanded_per_query);
+    }
+    std::fprintf(out, "  %-16s %9.2f %10.0f %10.0f %10.0f %10.0f %10s"
+                 " %7lu %7lu %9.4f\n",
+                 name, setup_ms, s.ns_per_query, s.p50_ns, s.p99_ns,
+                 s.max_ns, expanded, (unsigned long)s.suboptimal,
+                 (unsigned long)s.wrong, s.max_excess);
+}
+
+// Write `s` as a JSON string, escaping its quotes, backslashes and
+// control characters.
+void WriteString(std::FILE *out, const std::string &s) {
+    std::fputc('"', out);
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c == '"' || c == '\\') {
+            std::fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            std::fprintf(out, "\\u%04x", c);
+        } else {
+            std::fputc(c, out);
+        }
+    }
+    std::fputc('"', out);
+}
+
+void WriteSummary(std::FILE *out, const Summary &s) {
+    std::fprintf(out, "\"queries\": %lu, \"ns_per_query\": %.1f, "
+                 "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f, ",
+                 (unsigned long)s.queries, s.ns_per_query, s.p50_ns,
+                 s.p99_ns, s.max_ns);
+    if (s.expanded_per_query >= 0) {
+        std::fprintf(out, "\"expanded_per_query\": %.2f, ",
+                     s.expanded_per_query);
+    } else {
+        std::fprintf(out, "\"expanded_per_query\": null, ");
+    }
+    std::fprintf(out, "\"optimal\": %lu, \"suboptimal\": %lu, "
+                 "\"wrong\": %lu, \"max_excess\": %.6f",
+                 (unsigned long)s.optimal, (unsigned long)s.suboptimal,
+                 (unsigned long)s.wrong, s.max_excess);
+}
+
+// Replay `queries` with a finder of type `type`, and get the setup time.
+std::vector<Sample> Replay(const FinderType &type, grid_t &grid,
+                           const std::vector<ScenarioQuery> &queries,
+                           unsigned repeat, double &setup_ms) {
+    typedef boost::chrono::steady_clock clock_t;
+    clock_t::time_point begin = clock_t::now();
+    boost::scoped_ptr<Runner> runner(type.make(grid));
+    setup_ms = boost::chrono::duration<double, boost::milli>(
+        clock_t::now() - begin).count();
+
+    std::vector<Sample> samples(queries.size());
+    for (unsigned round = 0; round < repeat; ++round) {
+        for (std::size_t i = 0; i < queries.size(); ++i) {
+            begin = clock_t::now();
+            pnode_vector_t path = runner->Find(queries[i]);
+            double ns = boost::chrono::duration<double, boost::nano>(
+                clock_t::now() - begin).count();
+            Sample &sample = samples[i];
+            if (round > 0) {
+                sample.ns = std::min(sample.ns, ns);
+                continue;
+            }
+            // checked and counted outside of the timing
+            sample.bucket = queries[i].bucket;
+            sample.ns = ns;
+            sample.expanded = runner->Expanded();
+            sample.verdict = Check(grid, queries[i], path, sample.excess);
+        }
+    }
+    return samples;
+}
+
+std::string BaseName(const std::string &path) {
+    std::string::size_type slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+int Usage(const char *program) {
+    std::fprintf(stderr, "usage: %s [--json FILE] [--repeat N] "
+                 "[--finder NAME]... MAP_DIR SCEN...\nfinders:", program);
+    for (std::size_t t = 0; t < kFinderTypeCount; ++t) {
+        std::fprintf(stderr, " %s", kFinderTypes[t].name);
+    }
+    std::fprintf(stderr, "\n");
+    return 2;
+}
+
+int main(int argc, char *argv[]) {
+    const char *json_path = 0;
+    unsigned repeat = 1;
+    std::vector<std::string> only;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+        if (arg + 1 >= argc) {
+            return Usage(argv[0]);
+        } else if (std::strcmp(argv[arg], "--json") == 0) {
+            json_path = argv[++arg];
+        } else if (std::strcmp(argv[arg], "--repeat") == 0) {
+            repeat = unsigned(std::max(1, std::atoi(argv[++arg])));
+        } else if (std::strcmp(argv[arg], "--finder") == 0) {
+            only.push_back(argv[++arg]);
+        } else {
+            return Usage(argv[0]);
+        }
+    }
+    if (argc - arg < 2) {
+        return Usage(argv[0]);
+    }
+    std::string map_dir = argv[arg++];
+
+    // the text goes to stderr if the JSON goes to stdout
+    std::FILE *json = 0, *text = stdout;
+    if (json_path) {
+        json = std::strcmp(json_path, "-") == 0
+            ? stdout : std::fopen(json_path, "w");
+        if (!json) {
+            std::fprintf(stderr, "cannot write %s\n", json_path);
+            return 2;
+        }
+        if (json == stdout) {
+            text = stderr;
+        }
+        std::fprintf(json, "{\"repeat\": %u, \"maps\": [", repeat);
+    }
+
+    bool failed = false, first_map = true;
+    try {
+        for (; arg < argc; ++arg) {
+            std::vector<ScenarioQuery> all;
+            std::ifstream scen(argv[arg]);
+            if (!scen) {
+                throw std::runtime_error(
+                    std::string("cannot read ") + argv[arg]);
+            }
+            ReadMovingAIScenario(scen, all);
+
+            // a scenario may span several maps, replayed one at a time
+            std::vector<std::string> maps;
+            for (std::size_t i = 0; i < all.size(); ++i) {
+                if (std::find(maps.begin(), maps.end(), all[i].map) ==
+                        maps.end()) {
+                    maps.push_back(all[i].map);
+                }
+            }
+            for (std::size_t m = 0; m < maps.size(); ++m) {
+                std::vector<ScenarioQuery> queries;
+                std::vector<unsigned> buckets;
+                for (std::size_t i = 0; i < all.size(); ++i) {
+                    if (all[i].map == maps[m]) {
+                        queries.push_back(all[i]);
+                        if (buckets.empty() ||
+                                buckets.back() != all[i].bucket) {
+                            buckets.push_back(all[i].bucket);
+                        }
+                    }
+                }
+                std::sort(buckets.begin(), buckets.end());
+                buckets.erase(std::unique(buckets.begin(), buckets.end()),
+                              buckets.end());
+
+                std::string name = BaseName(maps[m]);
+                std::string path = map_dir + "/" + name;
+                std::ifstream in(path.c_str());
+                if (!in) {
+                    throw std::runtime_error("cannot read " + path);
+                }
+                WalkableBitmap bitmap;
+                ReadMovingAIMap(in, bitmap);
+                if (bitmap.width() != queries[0].map_width ||
+                        bitmap.height() != queries[0].map_height) {
+                    throw std::runtime_error(
+                        "the scenario does not fit " + path);
+                }
+                grid_t grid(bitmap);
+
+                std::fprintf(text, "%s %lux%lu, %lu queries in %lu buckets:\n",
+                             name.c_str(), (unsigned long)grid.width(),
+                             (unsigned long)grid.height(),
+                             (unsigned long)queries.size(),
+                             (unsigned long)buckets.size());
+                std::fprintf(text, "  %-16s %9s %10s %10s %10s %10s %10s"
+                             " %7s %7s %9s\n",
+                             "finder", "setup ms", "ns/query", "p50 ns",
+                             "p99 ns", "max ns", "expanded", "subopt",
+                             "wrong", "excess");
+                if (json) {
+                    std::fprintf(json, "%s\n {\"map\": ",
+                                 first_map ? "" : ",");
+                    WriteString(json, name);
+                    std::fprintf(json, ", \"width\": %lu, \"height\": %lu, "
+                                 "\"finders\": [",
+                                 (unsigned long)grid.width(),
+                                 (unsigned long)grid.height());
+                    first_map = false;
+                }
+
+                bool first_finder = true;
+                for (std::size_t t = 0; t < kFinderTypeCount; ++t) {
+                    const FinderType &type = kFinderTypes[t];
+                    if (!only.empty() && std::find(only.begin(), only.end(),
+                            std::string(type.name)) == only.end()) {
+                        continue;
+                    }
+                    double setup_ms = 0;
+                    std::vector<Sample> samples =
+                        Replay(type, grid, queries, repeat, setup_ms);
+                    Summary total = Summarize(samples, -1);
+                    PrintSummary(text, type.name, setup_ms, total);
+                    if (total.wrong > 0 ||
+                            (type.exact && total.suboptimal > 0)) {
+                        failed = true;
+                    }
+                    if (!json) {
+                        continue;
+                    }
+                    std::fprintf(json, "%s\n  {\"finder\": ",
+                                 first_finder ? "" : ",");
+                    WriteString(json, type.name);
+                    std::fprintf(json, ", \"exact\": %s, \"setup_ms\": %.3f, "
+                                 "\"total\": {",
+                                 type.exact ? "true" : "false", setup_ms);
+                    first_finder = false;
+                    WriteSummary(json, total);
+                    std::fprintf(json, "}, \"buckets\": [");
+                    for (std::size_t b = 0; b < buckets.size(); ++b) {
+                        std::fprintf(json, "%s\n   {\"bucket\": %u, ",
+                                     b ? "," : "", buckets[b]);
+                        WriteSummary(json,
+                                     Summarize(samples, long(buckets[b])));
+                        std::fprintf(json, "}");
+                    }
+                    std::fprintf(json, "]}");
+                }
+                if (json) {
+                    std::fprintf(json, "]}");
+                }
+            }
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    if (json) {
+        std::fprintf(json, "\n]}\n");
+        if (json != stdout) {
+            std::fclose(json);
+        }
+    }
+    return failed ? 1 : 0;
+}
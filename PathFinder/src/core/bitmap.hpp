@@ -0,0 +1,234 @@
+#ifndef CORE_BITMAP_HPP_
+#define CORE_BITMAP_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/shared_ptr.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit, `bits` must not be 0.
+inline unsigned LowestBit(unsigned bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return unsigned(index);
+#else
+    return unsigned(__builtin_ctz(bits));
+#endif
+}
+
+// Index of the lowest set bit of a word, `bits` must not be 0.
+inline unsigned LowestBit64(boost::uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(bits))) {
+        return unsigned(index);
+    }
+    _BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+    return unsigned(index) + 32;
+#else
+    return unsigned(__builtin_ctzll(bits));
+#endif
+}
+
+// Index of the highest set bit of a word, `bits` must not be 0.
+inline unsigned HighestBit64(boost::uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    if (_BitScanReverse(&index, static_cast<unsigned long>(bits >> 32))) {
+        return unsigned(index) + 32;
+    }
+    _BitScanReverse(&index, static_cast<unsigned long>(bits));
+    return unsigned(index);
+#else
+    return 63 - unsigned(__builtin_clzll(bits));
+#endif
+}
+
+/**
+ * Packed walkability layer, 1 bit per cell (set = walkable).
+ *
+ * Every row is padded with a blocked cell on both sides and the map is
+ * surrounded by a blocked row above and below, so the 3x3 neighborhood of
+ * any inside cell can be read without bounds checks. Each row also keeps
+ * one spare word at its end, so that 3 bits crossing a word boundary are
+ * read by two plain word loads.
+ *
+ * The words are the bitmap's own, or borrowed in this very layout, e.g.
+ * from a mapped file (see core/mapfile.hpp), and then copied on the first
+ * Set() only.
+ */
+class WalkableBitmap {
+public:
+    typedef std::size_t size_type;
+    typedef boost::uint64_t word_t;
+
+    WalkableBitmap() : width_(0), height_(0), stride_(0), data_(0) {}
+    WalkableBitmap(size_type width, size_type height, bool walkable = true)
+            : data_(0) {
+        Reset(width, height, walkable);
+    }
+    WalkableBitmap(const WalkableBitmap &other) { *this = other; }
+    WalkableBitmap &operator=(const WalkableBitmap &other);
+
+    void Reset(size_type width, size_type height, bool walkable = true);
+    // Read the (height + 2) * Stride(width) padded words at `words`,
+    // which `owner` keeps alive, instead of words of its own.
+    void Borrow(size_type width, size_type height, const word_t *words,
+                const boost::shared_ptr<const void> &owner);
+    // Whether the words are borrowed, see Borrow().
+    bool borrowed() const { return bool(owner_); }
+
+    bool Get(size_type x, size_type y) const {
+        BOOST_ASSERT(x < width_ && y < height_);
+        size_type bit = x + 1;
+        return (Row(y)[bit >> 6] >> (bit & 63)) & 1;
+    }
+    void Set(size_type x, size_type y, bool walkable) {
+        BOOST_ASSERT(x < width_ && y < height_);
+        if (owner_) {
+            Own();
+        }
+        size_type bit = x + 1;
+        word_t &word = words_[(y + 1) * stride_ + (bit >> 6)];
+        word_t mask = word_t(1) << (bit & 63);
+        word = walkable ? (word | mask) : (word & ~mask);
+    }
+
+    /**
+     * Get the 3x3 neighborhood of (x, y), one bit per cell, the center
+     * included, read row by row from the top-left corner:
+     *
+     *  +---+---+---+
+     *  | 0 | 1 | 2 |
+     *  +---+---+---+
+     *  | 3 | 4 | 5 |
+     *  +---+---+---+
+     *  | 6 | 7 | 8 |
+     *  +---+---+---+
+     */
+    unsigned Neighborhood(size_type x, size_type y) const {
+        // (x, y) is at padded column x + 1, so its row starts at bit x.
+        const word_t *top = Row(y) - stride_;
+        return Bits3(top, x) |
+               (Bits3(top + stride_, x) << 3) |
+               (Bits3(top + 2 * stride_, x) << 6);
+    }
+
+    // The padded words of row y, bit `x + 1` holds the cell (x, y).
+    const word_t *Row(size_type y) const {
+        return data_ + (y + 1) * stride_;
+    }
+
+    /**
+     * Get the 64 bits of a padded row from the bit `bit` on, so that 62
+     * cells and the two around them are tested by one word operation.
+     * `bit` may be down to -63, the bits before the row then read as
+     * blocked. It must not be past the padded column of width().
+     */
+    static word_t Word(const word_t *row, std::ptrdiff_t bit) {
+        if (bit < 0) {
+            return Word(row, 0) << -bit;
+        }
+        size_type i = size_type(bit) >> 6;
+        unsigned shift = unsigned(bit & 63);
+        return (row[i] >> shift) | ((row[i + 1] << 1) << (63 - shift));
+    }
+
+    size_type width() const { return width_; }
+    size_type height() const { return height_; }
+    // The number of words per padded row.
+    size_type stride() const { return stride_; }
+    // All the padded words, row after row.
+    const word_t *data() const { return data_; }
+    size_type word_count() const { return (height_ + 2) * stride_; }
+    // The number of words per padded row of a bitmap `width` wide.
+    static size_type Stride(size_type width) {
+        return (width + 2 + 63) / 64 + 1;
+    }
+
+private:
+    // Copy the borrowed words into words of its own.
+    void Own();
+
+    static unsigned Bits3(const word_t *row, size_type bit) {
+        size_type i = bit >> 6;
+        unsigned shift = unsigned(bit & 63);
+        // The second shift pair yields 0 instead of overflowing when shift is 0.
+        word_t v = (row[i] >> shift) | ((row[i + 1] << 1) << (63 - shift));
+        return unsigned(v & 7);
+    }
+
+    size_type width_;
+    size_type height_;
+    size_type stride_;
+    std::vector<word_t> words_;
+    // the words read, words_ or borrowed ones
+    const word_t *data_;
+    boost::shared_ptr<const void> owner_;
+};
+
+inline WalkableBitmap &WalkableBitmap::operator=(const WalkableBitmap &other) {
+    if (this == &other) {
+        return *this;
+    }
+    width_ = other.width_;
+    height_ = other.height_;
+    stride_ = other.stride_;
+    words_ = other.words_;
+    owner_ = other.owner_;
+    // a borrowed bitmap is shared by its copies until they are Set()
+    data_ = owner_ ? other.data_ : (words_.empty() ? 0 : &words_[0]);
+    return *this;
+}
+
+inline void WalkableBitmap::Reset(size_type width, size_type height,
+                                  bool walkable) {
+    width_ = width;
+    height_ = height;
+    stride_ = Stride(width);
+    words_.assign((height + 2) * stride_, 0);
+    data_ = &words_[0];
+    owner_.reset();
+    if (!walkable) {
+        return;
+    }
+    // Fill the inside bits of every row, the padding stays blocked.
+    for (size_type y = 0; y < height; ++y) {
+        word_t *row = &words_[(y + 1) * stride_];
+        size_type first = 1, last = width;  // inclusive bit range
+        for (size_type bit = first; bit <= last; ) {
+            size_type i = bit >> 6, lo = bit & 63;
+            size_type hi = std::min<size_type>(63, lo + (last - bit));
+            word_t mask = (hi == 63 ? ~word_t(0) : ((word_t(1) << (hi + 1)) - 1)) &
+                          ~((word_t(1) << lo) - 1);
+            row[i] |= mask;
+            bit += hi - lo + 1;
+        }
+    }
+}
+
+inline void WalkableBitmap::Borrow(size_type width, size_type height,
+        const word_t *words, const boost::shared_ptr<const void> &owner) {
+    BOOST_ASSERT_MSG(owner, "Oops, Borrow() without an owner.");
+    width_ = width;
+    height_ = height;
+    stride_ = Stride(width);
+    std::vector<word_t>().swap(words_);
+    data_ = words;
+    owner_ = owner;
+}
+
+inline void WalkableBitmap::Own() {
+    words_.assign(data_, data_ + word_count());
+    data_ = &words_[0];
+    owner_.reset();
+}
+
+#endif // CORE_BITMAP_HPP_
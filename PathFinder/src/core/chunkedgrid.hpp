@@ -0,0 +1,425 @@
+#ifndef CORE_CHUNKEDGRID_HPP_
+#define CORE_CHUNKEDGRID_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/unordered_map.hpp"
+#include "bitmap.hpp"
+#include "grid.hpp"
+#include "movement.hpp"
+#include "node.hpp"
+
+/**
+ * A grid of tiles of 64x64 cells for worlds too large for Grid, whose
+ * memory goes with the detail of the map rather than its area.
+ *
+ * A tile is 64 words, the bit x of the word y holding the cell (x, y) of
+ * the tile, set if walkable. The tiles all open or all blocked share one
+ * array of words each, and cost a pointer; the other ones have words of
+ * their own, or borrowed, e.g. from a mapped file (see core/mapfile.hpp)
+ * whose pages are read from the disk once a search first reads them. A
+ * tile is given words of its own, or copied, on the first
+ * SetWalkableAt() that changes it, and shares the uniform words again
+ * once it is all open or all blocked again; its words are then reused
+ * by the next tile given some.
+ *
+ * The cells are read as Grid reads them, by the same indexes and moves,
+ * so the finders that take the grid type as a parameter search it with a
+ * SparseSearchContext (see finders/searchcontext.hpp). There is no index
+ * of the connected components: IsReachable() only tells a blocked goal,
+ * and a goal walled off is found out by the search.
+ *
+ * The nodes are made on demand for the paths, and kept until
+ * ReleaseNodes(). Making them, the one write of the queries, is not safe
+ * from concurrent threads.
+ */
+class ChunkedGrid {
+public:
+    typedef std::size_t size_type;
+    typedef boost::uint64_t word_t;
+    typedef BaseNode<size_type> node_t;
+    typedef node_t *pnode_t;
+    typedef std::vector<pnode_t> node_vector_t;
+    typedef boost::shared_ptr<node_vector_t> pnode_vector_t;
+
+    enum { kTileShift = 6, kTileSize = 1 << kTileShift };
+    enum TileKind {
+        kOpenTile,
+        kBlockedTile,
+        // words of its own
+        kDetailedTile,
+        // words borrowed, copied on the first change
+        kBorrowedTile
+    };
+
+    ChunkedGrid() { Reset(0, 0); }
+    ChunkedGrid(size_type width, size_type height, bool walkable = true) {
+        Reset(width, height, walkable);
+    }
+    // The cells of `bitmap`, the uniform tiles being shared.
+    explicit ChunkedGrid(const WalkableBitmap &bitmap);
+    // The copy shares the borrowed tiles, and makes no node.
+    ChunkedGrid(const ChunkedGrid &other);
+    ChunkedGrid &operator=(const ChunkedGrid &other) {
+        ChunkedGrid copy(other);
+        Swap(copy);
+        return *this;
+    }
+    void Swap(ChunkedGrid &other);
+
+    // Make every cell open, or blocked, forgetting the tiles and the nodes.
+    void Reset(size_type width, size_type height, bool walkable = true);
+
+    size_type IndexAt(size_type x, size_type y) const { return y * width_ + x; }
+    void CoordsOf(size_type index, size_type &x, size_type &y) const {
+        x = index % width_;
+        y = index / width_;
+    }
+    bool IsInside(size_type x, size_type y) const {
+        return x < width_ && y < height_;
+    }
+    bool IsWalkableAt(size_type x, size_type y) const {
+        return IsInside(x, y) && Bit(x, y);
+    }
+    void SetWalkableAt(size_type x, size_type y, bool walkable);
+    // Whether the goal is not blocked, see the class comment.
+    bool IsReachable(size_type start_x, size_type start_y,
+                     size_type end_x, size_type end_y,
+                     DiagonalMovement movement) const;
+
+    // See Grid::NeighborMask().
+    unsigned NeighborMask(size_type x, size_type y,
+                          DiagonalMovement movement) const {
+        return NeighborTable::Instance().Lookup(movement,
+            NeighborTable::Compact(Neighborhood(x, y)));
+    }
+    // See Grid::GetNeighbors().
+    unsigned GetNeighbors(size_type x, size_type y,
+                          DiagonalMovement movement,
+                          NeighborBuffer &buffer) const;
+    std::ptrdiff_t IndexOffset(unsigned dir) const {
+        return index_offsets_[dir];
+    }
+
+    // The node of the cell, made on its first call.
+    pnode_t GetNodeAt(size_type x, size_type y) const {
+        return GetNodeAt(IndexAt(x, y));
+    }
+    pnode_t GetNodeAt(size_type index) const;
+    // Forget the nodes, and so the paths made of them.
+    void ReleaseNodes() {
+        node_of_.clear();
+        nodes_.clear();
+    }
+
+    size_type width() const { return width_; }
+    size_type height() const { return height_; }
+    size_type size() const { return width_ * height_; }
+
+    // The tiles, tile_x() across and tile_y() down.
+    size_type tile_x() const { return tile_x_; }
+    size_type tile_y() const { return tile_y_; }
+    TileKind tile_kind(size_type tx, size_type ty) const {
+        return TileKind(kinds_[ty * tile_x_ + tx]);
+    }
+    // The 64 words of the tile.
+    const word_t *tile_words(size_type tx, size_type ty) const {
+        return tiles_[ty * tile_x_ + tx];
+    }
+    // Make the tile all open, or all blocked.
+    void SetTile(size_type tx, size_type ty, bool walkable);
+    // Make the tile read the 64 words at `words`, which `owner` keeps
+    // alive, until it is changed.
+    void BorrowTile(size_type tx, size_type ty, const word_t *words,
+                    const boost::shared_ptr<const void> &owner);
+    // The tiles with words of their own or borrowed.
+    size_type detailed_tiles() const { return detailed_; }
+
+private:
+    // The words of a tile of its own, at a fixed address.
+    struct TileWords {
+        word_t words[kTileSize];
+    };
+
+    static const TileWords &OpenWords();
+    static const TileWords &BlockedWords();
+
+    bool Bit(size_type x, size_type y) const {
+        const word_t *words =
+            tiles_[(y >> kTileShift) * tile_x_ + (x >> kTileShift)];
+        return (words[y & (kTileSize - 1)] >> (x & (kTileSize - 1))) & 1;
+    }
+    // The cells x - 1 to x + 1 of the row y, as the bits 0 to 2, the ones
+    // outside blocked.
+    unsigned Bits3(size_type x, std::ptrdiff_t y) const;
+    // See WalkableBitmap::Neighborhood().
+    unsigned Neighborhood(size_type x, size_type y) const {
+        return Bits3(x, std::ptrdiff_t(y) - 1) |
+               (Bits3(x, std::ptrdiff_t(y)) << 3) |
+               (Bits3(x, std::ptrdiff_t(y) + 1) << 6);
+    }
+    // Give the tile words of its own, and return them.
+    word_t *Own(size_type tile);
+    // Make the tile of its own share the uniform words if it is uniform.
+    void Fold(size_type tile);
+    void SetKind(size_type tile, TileKind kind, const word_t *words);
+
+    size_type width_;
+    size_type height_;
+    size_type tile_x_;
+    size_type tile_y_;
+    std::vector<const word_t *> tiles_;
+    std::vector<unsigned char> kinds_;
+    size_type detailed_;
+    // the words of the detailed tiles, the ones no tile has, and the
+    // owners of the borrowed tiles
+    std::deque<TileWords> owned_;
+    std::vector<word_t *> free_;
+    std::vector<boost::shared_ptr<const void> > owners_;
+    std::ptrdiff_t index_offsets_[8];
+    mutable std::deque<node_t> nodes_;
+    mutable boost::unordered_map<size_type, pnode_t> node_of_;
+};
+
+inline ChunkedGrid::ChunkedGrid(const WalkableBitmap &bitmap) {
+    Reset(bitmap.width(), bitmap.height());
+    for (size_type ty = 0; ty < tile_y_; ++ty) {
+        for (size_type tx = 0; tx < tile_x_; ++tx) {
+            TileWords tile = {{0}};
+            // the tile is uniform if the cells inside the grid are, the
+            // ones past the edges being never read
+            bool open = true, blocked = true;
+            for (size_type y = 0; y < kTileSize; ++y) {
+                size_type cy = (ty << kTileShift) + y;
+                for (size_type x = 0; x < kTileSize; ++x) {
+                    size_type cx = (tx << kTileShift) + x;
+                    if (cx >= width_ || cy >= height_) {
+                        break;
+                    }
+                    bool walkable = bitmap.Get(cx, cy);
+                    tile.words[y] |= word_t(walkable) << x;
+                    open = open && walkable;
+                    blocked = blocked && !walkable;
+                }
+            }
+            if (blocked) {
+                SetTile(tx, ty, false);
+            } else if (!open) {
+                std::copy(tile.words, tile.words + kTileSize,
+                          Own(ty * tile_x_ + tx));
+            }
+        }
+    }
+}
+
+inline ChunkedGrid::ChunkedGrid(const ChunkedGrid &other)
+        : width_(other.width_), height_(other.height_),
+          tile_x_(other.tile_x_), tile_y_(other.tile_y_),
+          tiles_(other.tiles_), kinds_(other.kinds_),
+          detailed_(other.detailed_), owners_(other.owners_) {
+    std::copy(other.index_offsets_, other.index_offsets_ + 8,
+              index_offsets_);
+    // the tiles of its own point into owned_, and are copied
+    for (size_type tile = 0; tile < tiles_.size(); ++tile) {
+        if (kinds_[tile] == kDetailedTile) {
+            owned_.push_back(TileWords());
+            std::copy(other.tiles_[tile], other.tiles_[tile] + kTileSize,
+                      owned_.back().words);
+            tiles_[tile] = owned_.back().words;
+        }
+    }
+}
+
+inline void ChunkedGrid::Swap(ChunkedGrid &other) {
+    // the words of a deque stay where they are
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    std::swap(tile_x_, other.tile_x_);
+    std::swap(tile_y_, other.tile_y_);
+    tiles_.swap(other.tiles_);
+    kinds_.swap(other.kinds_);
+    std::swap(detailed_, other.detailed_);
+    owned_.swap(other.owned_);
+    free_.swap(other.free_);
+    owners_.swap(other.owners_);
+    std::swap_ranges(index_offsets_, index_offsets_ + 8,
+                     other.index_offsets_);
+    nodes_.swap(other.nodes_);
+    node_of_.swap(other.node_of_);
+}
+
+inline void ChunkedGrid::Reset(size_type width, size_type height,
+                               bool walkable) {
+    width_ = width;
+    height_ = height;
+    tile_x_ = (width + kTileSize - 1) >> kTileShift;
+    tile_y_ = (height + kTileSize - 1) >> kTileShift;
+    const word_t *words = walkable ? OpenWords().words
+                                   : BlockedWords().words;
+    tiles_.assign(tile_x_ * tile_y_, words);
+    kinds_.assign(tile_x_ * tile_y_, walkable ? kOpenTile : kBlockedTile);
+    detailed_ = 0;
+    owned_.clear();
+    free_.clear();
+    owners_.clear();
+    ReleaseNodes();
+    for (unsigned dir = 0; dir < 8; ++dir) {
+        const DirectionOffset &o = OffsetOf(dir);
+        index_offsets_[dir] =
+            std::ptrdiff_t(o.dy) * std::ptrdiff_t(width_) + o.dx;
+    }
+}
+
+inline void ChunkedGrid::SetWalkableAt(size_type x, size_type y,
+                                       bool walkable) {
+    BOOST_ASSERT_MSG(IsInside(x, y), "Oops, SetWalkableAt() outside.");
+    if (Bit(x, y) == walkable) {
+        return;
+    }
+    size_type tile = (y >> kTileShift) * tile_x_ + (x >> kTileShift);
+    word_t *words = Own(tile);
+    word_t &word = words[y & (kTileSize - 1)];
+    word_t mask = word_t(1) << (x & (kTileSize - 1));
+    word = walkable ? (word | mask) : (word & ~mask);
+    Fold(tile);
+    boost::unordered_map<size_type, pnode_t>::iterator it =
+        node_of_.find(IndexAt(x, y));
+    if (it != node_of_.end()) {
+        it->second->walkable = walkable;
+    }
+}
+
+inline bool ChunkedGrid::IsReachable(size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y, DiagonalMovement) const {
+    return (start_x == end_x && start_y == end_y) ||
+           IsWalkableAt(end_x, end_y);
+}
+
+inline unsigned ChunkedGrid::GetNeighbors(size_type x, size_type y,
+        DiagonalMovement movement, NeighborBuffer &buffer) const {
+    size_type index = IndexAt(x, y);
+    unsigned dirs = NeighborMask(x, y, movement);
+    unsigned n = 0;
+    while (dirs) {
+        unsigned dir = LowestBit(dirs);
+        dirs &= dirs - 1;
+        buffer.index[n] = index + index_offsets_[dir];
+        buffer.dir[n] = static_cast<unsigned char>(dir);
+        ++n;
+    }
+    buffer.size = n;
+    return n;
+}
+
+inline ChunkedGrid::pnode_t ChunkedGrid::GetNodeAt(size_type index) const {
+    BOOST_ASSERT_MSG(index < size(), "Oops, GetNodeAt() with incorrect index.");
+    pnode_t &node = node_of_[index];
+    if (!node) {
+        size_type x = 0, y = 0;
+        CoordsOf(index, x, y);
+        nodes_.push_back(node_t(x, y, Bit(x, y)));
+        node = &nodes_.back();
+    }
+    return node;
+}
+
+inline void ChunkedGrid::SetTile(size_type tx, size_type ty, bool walkable) {
+    SetKind(ty * tile_x_ + tx, walkable ? kOpenTile : kBlockedTile,
+            walkable ? OpenWords().words : BlockedWords().words);
+}
+
+inline void ChunkedGrid::BorrowTile(size_type tx, size_type ty,
+        const word_t *words, const boost::shared_ptr<const void> &owner) {
+    BOOST_ASSERT_MSG(owner, "Oops, BorrowTile() without an owner.");
+    if (owners_.empty() || owners_.back() != owner) {
+        owners_.push_back(owner);
+    }
+    SetKind(ty * tile_x_ + tx, kBorrowedTile, words);
+}
+
+inline const ChunkedGrid::TileWords &ChunkedGrid::OpenWords() {
+    struct Open : TileWords {
+        Open() { std::fill(words, words + kTileSize, ~word_t(0)); }
+    };
+    static const Open open;
+    return open;
+}
+
+inline const ChunkedGrid::TileWords &ChunkedGrid::BlockedWords() {
+    static const TileWords blocked = {{0}};
+    return blocked;
+}
+
+inline unsigned ChunkedGrid::Bits3(size_type x, std::ptrdiff_t y) const {
+    if (y < 0 || size_type(y) >= height_) {
+        return 0;
+    }
+    size_type bit = x & (kTileSize - 1);
+    if (bit > 0 && bit < kTileSize - 1 && x + 1 < width_) {
+        // the three cells in one word
+        const word_t *words = tiles_[(size_type(y) >> kTileShift) * tile_x_ +
+                                     (x >> kTileShift)];
+        return unsigned(words[y & (kTileSize - 1)] >> (bit - 1)) & 7;
+    }
+    return (x > 0 && Bit(x - 1, y) ? 1 : 0) |
+           (Bit(x, y) ? 2 : 0) |
+           (x + 1 < width_ && Bit(x + 1, y) ? 4 : 0);
+}
+
+inline ChunkedGrid::word_t *ChunkedGrid::Own(size_type tile) {
+    if (kinds_[tile] == kDetailedTile) {
+        return const_cast<word_t *>(tiles_[tile]);
+    }
+    word_t *words = 0;
+    if (free_.empty()) {
+        owned_.push_back(TileWords());
+        words = owned_.back().words;
+    } else {
+        words = free_.back();
+        free_.pop_back();
+    }
+    std::copy(tiles_[tile], tiles_[tile] + kTileSize, words);
+    SetKind(tile, kDetailedTile, words);
+    return words;
+}
+
+inline void ChunkedGrid::Fold(size_type tile) {
+    // the cells past the edges of the grid are never read
+    size_type tx = tile % tile_x_, ty = tile / tile_x_;
+    size_type columns = std::min<size_type>(kTileSize,
+                                            width_ - (tx << kTileShift)),
+              rows = std::min<size_type>(kTileSize,
+                                         height_ - (ty << kTileShift));
+    word_t mask = columns == kTileSize ? ~word_t(0)
+                                       : (word_t(1) << columns) - 1;
+    const word_t *words = tiles_[tile];
+    word_t any = 0, all = mask;
+    for (size_type y = 0; y < rows; ++y) {
+        any |= words[y] & mask;
+        all &= words[y];
+    }
+    if (!any) {
+        SetTile(tx, ty, false);
+    } else if (all == mask) {
+        SetTile(tx, ty, true);
+    }
+}
+
+inline void ChunkedGrid::SetKind(size_type tile, TileKind kind,
+                                 const word_t *words) {
+    bool was = kinds_[tile] == kDetailedTile || kinds_[tile] == kBorrowedTile,
+         is = kind == kDetailedTile || kind == kBorrowedTile;
+    if (kinds_[tile] == kDetailedTile && tiles_[tile] != words) {
+        free_.push_back(const_cast<word_t *>(tiles_[tile]));
+    }
+    detailed_ += size_type(is) - size_type(was);
+    kinds_[tile] = static_cast<unsigned char>(kind);
+    tiles_[tile] = words;
+}
+
+#endif // CORE_CHUNKEDGRID_HPP_
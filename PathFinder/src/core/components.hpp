@@ -0,0 +1,382 @@
+#ifndef CORE_COMPONENTS_HPP_
+#define CORE_COMPONENTS_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "bitmap.hpp"
+#include "movement.hpp"
+
+/**
+ * The connected components of the walkable cells of a bitmap, so that a
+ * goal out of the component of the start is told unreachable without a
+ * search.
+ *
+ * The labels are built by one scanline pass over a union-find, joining
+ * the runs of walkable cells of each row, found by words, with the runs
+ * they touch in the row above; they are kept
+ * up to date as the cells flip: a cell opening joins the components
+ * around it; a cell closing may split its component, which is first
+ * ruled out from its 8 neighbors alone, and else settled by flooding the
+ * pieces it may leave by turns, until all but the largest one are over
+ * and relabeled.
+ *
+ * The cells are 4-connected, as with the moves of every DiagonalMovement
+ * but kDiagonalAlways, whose diagonal moves pass by a free straight
+ * neighbor, or 8-connected.
+ */
+class ComponentIndex {
+public:
+    typedef std::size_t size_type;
+    typedef boost::uint32_t label_t;
+    // The component of a blocked cell.
+    static const label_t kNoComponent = 0;
+
+    explicit ComponentIndex(bool diagonal = false)
+        : diagonal_(diagonal), width_(0), stamp_(0) {}
+
+    // Label every walkable cell of `bitmap`.
+    void Build(const WalkableBitmap &bitmap);
+    // Relabel after the cell (x, y) of `bitmap` flipped to `walkable`.
+    void Update(const WalkableBitmap &bitmap, size_type x, size_type y,
+                bool walkable);
+
+    // The component of the cell `index`, kNoComponent if it is blocked.
+    // It only reads, so it may be called from several threads.
+    label_t Component(size_type index) const {
+        label_t label = labels_[index];
+        while (parent_[label] != label) {
+            label = parent_[label];
+        }
+        return label;
+    }
+    bool diagonal() const { return diagonal_; }
+
+private:
+    // The free cells around a cell, as bits of NeighborTable::Compact().
+    unsigned Ring(const WalkableBitmap &bitmap, size_type index) const {
+        return NeighborTable::Compact(bitmap.Neighborhood(
+            index % width_, index / width_));
+    }
+    // The positions of a ring connected to its center.
+    unsigned Neighbors() const { return diagonal_ ? 0xFFu : 0x5Au; }
+    // The cells [begin, end) of a row, labeled `label`.
+    struct Run {
+        size_type begin;
+        size_type end;
+        label_t label;
+    };
+    // The first padded bit of `row` from `bit` on that is `value`, or
+    // `end` if it is not before.
+    static size_type FindBit(const WalkableBitmap::word_t *row,
+                             size_type bit, bool value, size_type end);
+    label_t NewLabel();
+    label_t Root(label_t label);
+    // Join the component of `label` with the one of the cell labeled
+    // `other`, if it is walkable.
+    void Join(label_t &label, label_t other);
+    // Relabel the pieces the closed cell `index` may have split its
+    // component into, each reached from the ring position of `seeds`.
+    void Split(const WalkableBitmap &bitmap, size_type index,
+               const unsigned char *seeds, unsigned count);
+
+    /**
+     * For each ring of the 8 neighbors of a cell, one position per group
+     * of its neighbors that are connected within the ring, i.e. without
+     * the cell. A single group means the cell cannot split anything.
+     */
+    struct RingGroups {
+        unsigned char count;
+        unsigned char seeds[4];
+    };
+    static const RingGroups &Groups(bool diagonal, unsigned ring);
+
+    bool diagonal_;
+    size_type width_;
+    std::ptrdiff_t offsets_[8];
+    std::vector<label_t> labels_;
+    std::vector<label_t> parent_;
+    std::vector<boost::uint8_t> rank_;
+    // Split() scratch: the piece of a cell, from `stamp_` on, and the
+    // cells of each piece in the order they are flooded.
+    std::vector<boost::uint32_t> mark_;
+    boost::uint32_t stamp_;
+    std::vector<size_type> pieces_[4];
+};
+
+inline void ComponentIndex::Build(const WalkableBitmap &bitmap) {
+    width_ = bitmap.width();
+    size_type height = bitmap.height();
+    for (unsigned p = 0, bit = 0; bit < 9; ++bit) {
+        if (bit != 4) {
+            offsets_[p++] = (std::ptrdiff_t(bit / 3) - 1) *
+                std::ptrdiff_t(width_) + std::ptrdiff_t(bit % 3) - 1;
+        }
+    }
+    labels_.assign(width_ * height, label_t(kNoComponent));
+    parent_.assign(1, label_t(kNoComponent));
+    rank_.assign(1, 0);
+    mark_.clear();
+    stamp_ = 0;
+
+    // join each run with the runs of the row above it touches, the ones
+    // next to it by a corner too if diagonal
+    std::vector<Run> runs;
+    // the first run of each row, and past the last row
+    std::vector<size_type> rows(height + 1, 0);
+    size_type reach = diagonal_ ? 1 : 0;
+    for (size_type y = 0; y < height; ++y) {
+        const WalkableBitmap::word_t *row = bitmap.Row(y);
+        size_type row_begin = runs.size(), next = y > 0 ? rows[y - 1] : 0;
+        rows[y] = row_begin;
+        for (size_type bit = 1; ; ) {
+            size_type begin = FindBit(row, bit, true, width_ + 1);
+            if (begin > width_) {
+                break;
+            }
+            size_type end = FindBit(row, begin, false, width_ + 1);
+            bit = end;
+            // the cells of the padded bits [begin, end)
+            Run run = {begin - 1, end - 1, kNoComponent};
+            while (next < row_begin &&
+                    runs[next].end + reach <= run.begin) {
+                ++next;
+            }
+            for (size_type i = next;
+                    i < row_begin && runs[i].begin < run.end + reach; ++i) {
+                Join(run.label, runs[i].label);
+            }
+            if (run.label == kNoComponent) {
+                run.label = NewLabel();
+            }
+            runs.push_back(run);
+        }
+    }
+    rows[height] = runs.size();
+
+    // then number the components from 1, each one label
+    std::vector<label_t> numbers(parent_.size(), label_t(kNoComponent));
+    label_t count = 0;
+    for (size_type y = 0; y < height; ++y) {
+        for (size_type i = rows[y]; i < rows[y + 1]; ++i) {
+            label_t &number = numbers[Root(runs[i].label)];
+            if (number == kNoComponent) {
+                number = ++count;
+            }
+            std::fill(labels_.begin() + y * width_ + runs[i].begin,
+                      labels_.begin() + y * width_ + runs[i].end, number);
+        }
+    }
+    parent_.resize(count + 1);
+    for (label_t label = 0; label <= count; ++label) {
+        parent_[label] = label;
+    }
+    rank_.assign(count + 1, 0);
+}
+
+inline void ComponentIndex::Update(const WalkableBitmap &bitmap,
+        size_type x, size_type y, bool walkable) {
+    size_type index = y * width_ + x;
+    unsigned ring = Ring(bitmap, index);
+    if (walkable) {
+        label_t label = kNoComponent;
+        for (unsigned bits = ring & Neighbors(); bits; bits &= bits - 1) {
+            Join(label, labels_[index + offsets_[LowestBit(bits)]]);
+        }
+        labels_[index] = label != kNoComponent ? label : NewLabel();
+    } else {
+        labels_[index] = kNoComponent;
+        const RingGroups &groups = Groups(diagonal_, ring);
+        if (groups.count > 1) {
+            Split(bitmap, index, groups.seeds, groups.count);
+        }
+    }
+    // the labels of the components gone are never reused, renumber them
+    // once they outnumber the cells
+    if (parent_.size() > 2 * labels_.size() + 64) {
+        Build(bitmap);
+    }
+}
+
+inline ComponentIndex::size_type ComponentIndex::FindBit(
+        const WalkableBitmap::word_t *row, size_type bit, bool value,
+        size_type end) {
+    typedef WalkableBitmap::word_t word_t;
+    size_type i = bit >> 6, last = end >> 6;
+    word_t word = (value ? row[i] : ~row[i]) & (~word_t(0) << (bit & 63));
+    while (word == 0) {
+        if (++i > last) {
+            return end;
+        }
+        word = value ? row[i] : ~row[i];
+    }
+    return std::min(end, (i << 6) + LowestBit64(word));
+}
+
+inline ComponentIndex::label_t ComponentIndex::NewLabel() {
+    label_t label = label_t(parent_.size());
+    parent_.push_back(label);
+    rank_.push_back(0);
+    return label;
+}
+
+inline ComponentIndex::label_t ComponentIndex::Root(label_t label) {
+    while (parent_[label] != label) {
+        parent_[label] = parent_[parent_[label]];
+        label = parent_[label];
+    }
+    return label;
+}
+
+inline void ComponentIndex::Join(label_t &label, label_t other) {
+    if (other == kNoComponent) {
+        return;
+    }
+    other = Root(other);
+    if (label == kNoComponent) {
+        label = other;
+        return;
+    }
+    label = Root(label);
+    if (label == other) {
+        return;
+    }
+    if (rank_[label] < rank_[other]) {
+        std::swap(label, other);
+    } else if (rank_[label] == rank_[other]) {
+        ++rank_[label];
+    }
+    parent_[other] = label;
+}
+
+inline void ComponentIndex::Split(const WalkableBitmap &bitmap,
+        size_type index, const unsigned char *seeds, unsigned count) {
+    if (mark_.size() != labels_.size() || stamp_ > 0xFFFFFFF0u) {
+        mark_.assign(labels_.size(), 0);
+        stamp_ = 0;
+    }
+    // the marks from stamp_ to stamp_ + 3 are the pieces of this split
+    stamp_ += 4;
+
+    // each piece floods one cell per turn; two pieces that meet are one,
+    // and a piece whose flood is over is cut off from the others
+    unsigned owner[4];
+    size_type head[4];
+    for (unsigned i = 0; i < count; ++i) {
+        size_type seed = index + offsets_[seeds[i]];
+        owner[i] = i;
+        head[i] = 0;
+        pieces_[i].clear();
+        pieces_[i].push_back(seed);
+        mark_[seed] = stamp_ + i;
+    }
+    unsigned active = count;
+    while (active > 1) {
+        for (unsigned i = 0; i < count && active > 1; ++i) {
+            if (head[i] == pieces_[i].size()) {
+                continue;
+            }
+            size_type cell = pieces_[i][head[i]++];
+            for (unsigned bits = Ring(bitmap, cell) & Neighbors(); bits;
+                    bits &= bits - 1) {
+                size_type next = cell + offsets_[LowestBit(bits)];
+                if (mark_[next] < stamp_) {
+                    mark_[next] = stamp_ + i;
+                    pieces_[i].push_back(next);
+                    continue;
+                }
+                unsigned a = mark_[next] - stamp_, b = i;
+                while (owner[a] != a) a = owner[a];
+                while (owner[b] != b) b = owner[b];
+                if (a != b) {
+                    owner[a] = b;
+                    --active;
+                }
+            }
+
+            unsigned root = i;
+            while (owner[root] != root) root = owner[root];
+            bool over = true;
+            for (unsigned j = 0; j < count && over; ++j) {
+                unsigned r = j;
+                while (owner[r] != r) r = owner[r];
+                over = r != root || head[j] == pieces_[j].size();
+            }
+            if (over) {
+                label_t label = NewLabel();
+                for (unsigned j = 0; j < count; ++j) {
+                    unsigned r = j;
+                    while (owner[r] != r) r = owner[r];
+                    if (r != root) {
+                        continue;
+                    }
+                    for (size_type k = 0; k < pieces_[j].size(); ++k) {
+                        labels_[pieces_[j][k]] = label;
+                    }
+                }
+                --active;
+            }
+        }
+    }
+}
+
+inline const ComponentIndex::RingGroups &
+ComponentIndex::Groups(bool diagonal, unsigned ring) {
+    struct Table {
+        RingGroups groups[2][256];
+        Table() {
+            // the (dx, dy) of each ring position
+            static const int dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+            static const int dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+            for (unsigned d = 0; d < 2; ++d) {
+                unsigned neighbors = d ? 0xFFu : 0x5Au;
+                for (unsigned mask = 0; mask < 256; ++mask) {
+                    // union the free positions adjacent within the ring
+                    unsigned group[8];
+                    for (unsigned p = 0; p < 8; ++p) {
+                        group[p] = p;
+                    }
+                    for (unsigned p = 0; p < 8; ++p) {
+                        for (unsigned q = p + 1; q < 8; ++q) {
+                            int ax = dx[p] - dx[q], ay = dy[p] - dy[q];
+                            ax = ax < 0 ? -ax : ax;
+                            ay = ay < 0 ? -ay : ay;
+                            bool adjacent = d ? (ax <= 1 && ay <= 1)
+                                              : (ax + ay == 1);
+                            if (!adjacent || !((mask >> p) & 1) ||
+                                    !((mask >> q) & 1)) {
+                                continue;
+                            }
+                            unsigned a = p, b = q;
+                            while (group[a] != a) a = group[a];
+                            while (group[b] != b) b = group[b];
+                            group[b] = a;
+                        }
+                    }
+                    RingGroups &entry = groups[d][mask];
+                    entry.count = 0;
+                    bool seen[8] = {false};
+                    for (unsigned p = 0; p < 8; ++p) {
+                        if (!((mask & neighbors) >> p & 1)) {
+                            continue;
+                        }
+                        unsigned a = p;
+                        while (group[a] != a) a = group[a];
+                        if (!seen[a]) {
+                            seen[a] = true;
+                            BOOST_ASSERT(entry.count < 4);
+                            entry.seeds[entry.count++] =
+                                static_cast<unsigned char>(p);
+                        }
+                    }
+                }
+            }
+        }
+    };
+    static const Table table;
+    return table.groups[diagonal ? 1 : 0][ring];
+}
+
+#endif // CORE_COMPONENTS_HPP_
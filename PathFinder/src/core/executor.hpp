@@ -0,0 +1,131 @@
+#ifndef CORE_EXECUTOR_HPP_
+#define CORE_EXECUTOR_HPP_
+
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/bind.hpp"
+#include "boost/circular_buffer.hpp"
+#include "boost/function.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+
+/**
+ * A fixed set of worker threads running the tasks of a queue of bounded
+ * capacity, in the order they came.
+ *
+ * A full queue pushes back on the callers: Submit() waits for room, and
+ * TrySubmit() turns the task down, so the tasks are never queued faster
+ * than they are run. A task submitting another one from a worker must
+ * use TrySubmit(), or it may wait for itself.
+ */
+class BoundedExecutor : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    // task(worker), it must not throw
+    typedef boost::function<void (unsigned)> task_t;
+
+    // `workers` 0 is one per hardware thread.
+    explicit BoundedExecutor(unsigned workers = 0, size_type capacity = 1024);
+    // Run the tasks queued, then stop the workers.
+    ~BoundedExecutor();
+
+    unsigned workers() const { return unsigned(threads_.size()); }
+    size_type capacity() const { return queue_.capacity(); }
+    // The tasks queued and not started yet.
+    size_type queued() const {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    // Queue `task`, waiting for room if the queue is full.
+    void Submit(const task_t &task);
+    // Queue `task`, or return false if the queue is full.
+    bool TrySubmit(const task_t &task);
+
+private:
+    void Loop(unsigned worker);
+
+    boost::circular_buffer<task_t> queue_;
+    std::vector<boost::shared_ptr<boost::thread> > threads_;
+    mutable boost::mutex mutex_;
+    boost::condition_variable not_empty_;
+    boost::condition_variable not_full_;
+    bool stopping_;
+};
+
+inline BoundedExecutor::BoundedExecutor(unsigned workers, size_type capacity)
+        : queue_(capacity), stopping_(false) {
+    BOOST_ASSERT(capacity > 0);
+    if (workers == 0) {
+        workers = boost::thread::hardware_concurrency();
+    }
+    if (workers == 0) {
+        workers = 1;
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+        threads_.push_back(boost::shared_ptr<boost::thread>(
+            new boost::thread(boost::bind(&BoundedExecutor::Loop, this, i))));
+    }
+}
+
+inline BoundedExecutor::~BoundedExecutor() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    not_empty_.notify_all();
+    for (std::size_t i = 0; i < threads_.size(); ++i) {
+        threads_[i]->join();
+    }
+}
+
+inline void BoundedExecutor::Submit(const task_t &task) {
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        BOOST_ASSERT_MSG(!stopping_, "Oops, Submit() while stopping.");
+        while (queue_.full()) {
+            not_full_.wait(lock);
+        }
+        queue_.push_back(task);
+    }
+    not_empty_.notify_one();
+}
+
+inline bool BoundedExecutor::TrySubmit(const task_t &task) {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        BOOST_ASSERT_MSG(!stopping_, "Oops, TrySubmit() while stopping.");
+        if (queue_.full()) {
+            return false;
+        }
+        queue_.push_back(task);
+    }
+    not_empty_.notify_one();
+    return true;
+}
+
+inline void BoundedExecutor::Loop(unsigned worker) {
+    for (;;) {
+        task_t task;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (!stopping_ && queue_.empty()) {
+                not_empty_.wait(lock);
+            }
+            if (queue_.empty()) {
+                return;
+            }
+            task.swap(queue_.front());
+            queue_.pop_front();
+        }
+        not_full_.notify_one();
+        task(worker);
+    }
+}
+
+#endif // CORE_EXECUTOR_HPP_
@@ -1,10 +1,15 @@
 #ifndef CORE_GRID_H_
 #define CORE_GRID_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <stdexcept>
 #include <vector>
 #include "boost/assert.hpp"
 #include "boost/shared_ptr.hpp"
+#include "bitmap.hpp"
+#include "components.hpp"
+#include "movement.hpp"
 #include "node.hpp"
 
 struct BaseMatrix {
@@ -28,25 +33,78 @@ struct RandomAccessMatrix : public BaseMatrix {
     Data *data;
 };
 
+// Fixed-capacity inline storage for the neighbors of one cell, filled by
+// Grid::GetNeighbors() without any allocation.
+struct NeighborBuffer {
+    typedef std::size_t size_type;
+    enum { kCapacity = 8 };
+    unsigned size;
+    // cell index and Direction of each neighbor
+    size_type index[kCapacity];
+    unsigned char dir[kCapacity];
+};
+
+/**
+ * Interface of the structures derived from a grid, e.g. a jump table,
+ * that repair themselves when the grid changes.
+ *
+ * An observer is added to the grid by Grid::AddObserver() and must be
+ * removed before it is destroyed.
+ */
+class GridObserver {
+public:
+    typedef std::size_t size_type;
+    virtual ~GridObserver() {}
+    // Called by Grid::SetWalkableAt() after the cell (x, y) flipped.
+    virtual void OnWalkableChanged(size_type x, size_type y,
+                                   bool walkable) = 0;
+};
+
 template <class Node = BaseNode<std::size_t> >
 class Grid {
 public:
     typedef std::size_t size_type;
     typedef Node node_t;
-    typedef boost::shared_ptr<node_t> pnode_t;
+    // Nodes live in one contiguous row-major array, so a node is addressed
+    // either by a raw pointer into it or by its cell index `y * width + x`.
+    typedef node_t *pnode_t;
     typedef std::vector<pnode_t> node_vector_t;
-    typedef std::vector<node_vector_t> node_grid_t;
+    typedef std::vector<node_t> node_grid_t;
     typedef boost::shared_ptr<node_vector_t> pnode_vector_t;
     typedef boost::shared_ptr<node_grid_t> pnode_grid_t;
 
     Grid(size_type width, size_type height);
     template <class Matrix>
     Grid(size_type width, size_type height, Matrix *matrix);
+    // A grid of the cells of `bitmap`, whose words are kept as they are,
+    // e.g. the borrowed words of a mapped file, until a cell is set. The
+    // nodes, the transposed bitmap and the components are still built
+    // from every cell, in O(width * height).
+    explicit Grid(const WalkableBitmap &bitmap);
 
     pnode_t GetNodeAt(size_type x, size_type y) const;
+    pnode_t GetNodeAt(size_type index) const;
+    size_type IndexAt(size_type x, size_type y) const { return y * width_ + x; }
+    size_type IndexOf(const node_t *node) const { return node - &(*nodes_)[0]; }
     bool IsWalkableAt(size_type x, size_type y) const;
     bool IsInside(size_type x, size_type y) const;
+    // Set the walkability of the cell (x, y), and notify the observers
+    // if it changed.
     void SetWalkableAt(size_type x, size_type y, bool walkable);
+    /**
+     * Whether a path from (start_x, start_y) to (end_x, end_y) exists with
+     * `movement`, told by the connected components of the grid without a
+     * search. A blocked start may still leave to its free neighbors.
+     */
+    bool IsReachable(size_type start_x, size_type start_y,
+                     size_type end_x, size_type end_y,
+                     DiagonalMovement movement) const;
+    // The connected components the moves of `movement` stay in.
+    const ComponentIndex &components(DiagonalMovement movement) const {
+        return components_[movement == kDiagonalAlways ? 1 : 0];
+    }
+    void AddObserver(GridObserver *observer);
+    void RemoveObserver(GridObserver *observer);
     /**
      * Get the neighbors of the given node.
      *
@@ -69,44 +127,120 @@ public:
     pnode_vector_t GetNeighbors(pnode_t node,
             bool allow_diagonal,
             bool dont_cross_corners) const;
+    pnode_vector_t GetNeighbors(pnode_t node,
+            DiagonalMovement movement) const;
+    // Get the neighbors of the cell (x, y) into `buffer`, and return
+    // their number. Nothing is allocated.
+    unsigned GetNeighbors(size_type x, size_type y,
+            DiagonalMovement movement, NeighborBuffer &buffer) const;
+    // Call `visitor(index, dir)` for each neighbor of the cell (x, y).
+    template <class Visitor>
+    void ForEachNeighbor(size_type x, size_type y,
+            DiagonalMovement movement, Visitor &visitor) const;
+    /**
+     * Get the directions (see Direction) the cell (x, y) may move to, as a
+     * bit set. It is looked up from the 3x3 neighborhood in the bitmap,
+     * so there is no branch per neighbor.
+     */
+    unsigned NeighborMask(size_type x, size_type y,
+            DiagonalMovement movement) const {
+        return NeighborTable::Instance().Lookup(movement,
+            NeighborTable::Compact(bitmap_.Neighborhood(x, y)));
+    }
+    // The offset of the neighbor in Direction `dir` in cell indexes.
+    std::ptrdiff_t IndexOffset(unsigned dir) const {
+        return index_offsets_[dir];
+    }
+    void CoordsOf(size_type index, size_type &x, size_type &y) const {
+        x = index % width_;
+        y = index / width_;
+    }
 
     size_type width() const { return width_; }
     size_type height() const { return height_; }
+    // The number of cells, i.e. width() * height().
+    size_type size() const { return width_ * height_; }
     pnode_grid_t nodes() const { return nodes_; }
+    const WalkableBitmap &bitmap() const { return bitmap_; }
+    // The bitmap of the transposed grid, its row x is the column x, so
+    // that columns are scanned by words as well.
+    const WalkableBitmap &transposed_bitmap() const { return transposed_; }
 
 private:
     template <class Matrix>
     node_grid_t *BuildNodes(size_type width, size_type height,
             Matrix *matrix);
+    void InitIndexOffsets();
+    void InitComponents();
 
     size_type width_;
     size_type height_;
     pnode_grid_t nodes_;
+    // Kept in sync with node_t::walkable, and read by every walkable query.
+    WalkableBitmap bitmap_;
+    WalkableBitmap transposed_;
+    // 4-connected, and 8-connected for kDiagonalAlways
+    ComponentIndex components_[2];
+    std::ptrdiff_t index_offsets_[8];
+    std::vector<GridObserver *> observers_;
 };
 
 template <class Node>
 Grid<Node>::Grid(size_type width, size_type height)
-        : width_(width), height_(height) {
+        : width_(width), height_(height), bitmap_(width, height),
+          transposed_(height, width) {
     this->nodes_.reset(BuildNodes(width, height, (BaseMatrix *)0));
+    InitIndexOffsets();
+    InitComponents();
 }
 
 template <class Node>
 template <class Matrix>
 Grid<Node>::Grid(size_type width, size_type height, Matrix *matrix)
-        : width_(width), height_(height) {
+        : width_(width), height_(height), bitmap_(width, height),
+          transposed_(height, width) {
     this->nodes_.reset(BuildNodes(width, height, matrix));
+    InitIndexOffsets();
+    InitComponents();
+}
+
+template <class Node>
+Grid<Node>::Grid(const WalkableBitmap &bitmap)
+        : width_(bitmap.width()), height_(bitmap.height()), bitmap_(bitmap),
+          transposed_(bitmap.height(), bitmap.width()) {
+    node_grid_t *nodes = new node_grid_t;
+    nodes->reserve(width_ * height_);
+    for (size_type y = 0; y < height_; ++y) {
+        for (size_type x = 0; x < width_; ++x) {
+            bool walkable = bitmap.Get(x, y);
+            nodes->push_back(node_t(x, y, walkable));
+            if (!walkable) {
+                this->transposed_.Set(y, x, false);
+            }
+        }
+    }
+    this->nodes_.reset(nodes);
+    InitIndexOffsets();
+    InitComponents();
 }
 
 template <class Node>
 typename Grid<Node>::pnode_t
 Grid<Node>::GetNodeAt(size_type x, size_type y) const {
     BOOST_ASSERT_MSG(IsInside(x, y), "Oops, GetNodeAt() with incorrect position.");
-    return (*(this->nodes_))[y][x];
+    return &(*(this->nodes_))[y * this->width_ + x];
+}
+
+template <class Node>
+typename Grid<Node>::pnode_t
+Grid<Node>::GetNodeAt(size_type index) const {
+    BOOST_ASSERT_MSG(index < size(), "Oops, GetNodeAt() with incorrect index.");
+    return &(*(this->nodes_))[index];
 }
 
 template <class Node>
 bool Grid<Node>::IsWalkableAt(size_type x, size_type y) const {
-    return this->IsInside(x, y) && (*(this->nodes_))[y][x]->walkable;
+    return this->IsInside(x, y) && this->bitmap_.Get(x, y);
 }
 
 template <class Node>
@@ -117,7 +251,56 @@ bool Grid<Node>::IsInside(size_type x, size_type y) const {
 
 template <class Node>
 void Grid<Node>::SetWalkableAt(size_type x, size_type y, bool walkable) {
-    (*(this->nodes_))[y][x]->walkable = walkable;
+    (*(this->nodes_))[y * this->width_ + x].walkable = walkable;
+    if (this->bitmap_.Get(x, y) == walkable) {
+        return;
+    }
+    this->bitmap_.Set(x, y, walkable);
+    this->transposed_.Set(y, x, walkable);
+    this->components_[0].Update(this->bitmap_, x, y, walkable);
+    this->components_[1].Update(this->bitmap_, x, y, walkable);
+    for (std::size_t i = 0; i < this->observers_.size(); ++i) {
+        this->observers_[i]->OnWalkableChanged(x, y, walkable);
+    }
+}
+
+template <class Node>
+bool Grid<Node>::IsReachable(size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y, DiagonalMovement movement) const {
+    if (start_x == end_x && start_y == end_y) {
+        return true;
+    }
+    if (!IsWalkableAt(end_x, end_y)) {
+        return false;
+    }
+    const ComponentIndex &index = components(movement);
+    ComponentIndex::label_t goal = index.Component(IndexAt(end_x, end_y));
+    size_type start = IndexAt(start_x, start_y);
+    if (this->bitmap_.Get(start_x, start_y)) {
+        return index.Component(start) == goal;
+    }
+    unsigned dirs = NeighborMask(start_x, start_y, movement);
+    while (dirs) {
+        unsigned dir = LowestBit(dirs);
+        dirs &= dirs - 1;
+        if (index.Component(start + index_offsets_[dir]) == goal) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class Node>
+void Grid<Node>::AddObserver(GridObserver *observer) {
+    this->observers_.push_back(observer);
+}
+
+template <class Node>
+void Grid<Node>::RemoveObserver(GridObserver *observer) {
+    this->observers_.erase(
+        std::remove(this->observers_.begin(), this->observers_.end(),
+                    observer),
+        this->observers_.end());
 }
 
 template <class Node>
@@ -125,71 +308,69 @@ typename Grid<Node>::pnode_vector_t
 Grid<Node>::GetNeighbors(pnode_t node,
         bool allow_diagonal,
         bool dont_cross_corners) const {
-    size_type x = node->x,
-              y = node->y;
-    bool s0 = false, d0 = false,
-         s1 = false, d1 = false,
-         s2 = false, d2 = false,
-         s3 = false, d3 = false;
-    pnode_vector_t neighbors(new node_vector_t);
-    node_grid_t &nodes = *(this->nodes_);
+    return GetNeighbors(node,
+        ToDiagonalMovement(allow_diagonal, dont_cross_corners));
+}
 
-    // Attention: -1 will be a large number when size_type is unsigned.
-    // ↑
-    if (IsWalkableAt(x, y - 1)) {
-        neighbors->push_back(nodes[y - 1][x]);
-        s0 = true;
-    }
-    // →
-    if (IsWalkableAt(x + 1, y)) {
-        neighbors->push_back(nodes[y][x + 1]);
-        s1 = true;
-    }
-    // ↓
-    if (IsWalkableAt(x, y + 1)) {
-        neighbors->push_back(nodes[y + 1][x]);
-        s2 = true;
-    }
-    // ←
-    if (IsWalkableAt(x - 1, y)) {
-        neighbors->push_back(nodes[y][x - 1]);
-        s3 = true;
+template <class Node>
+typename Grid<Node>::pnode_vector_t
+Grid<Node>::GetNeighbors(pnode_t node,
+        DiagonalMovement movement) const {
+    NeighborBuffer buffer;
+    unsigned n = GetNeighbors(node->x, node->y, movement, buffer);
+    pnode_vector_t neighbors(new node_vector_t);
+    neighbors->reserve(n);
+    for (unsigned i = 0; i < n; ++i) {
+        neighbors->push_back(node + IndexOffset(buffer.dir[i]));
     }
+    return neighbors;
+}
 
-    if (!allow_diagonal) {
-        return neighbors;
+template <class Node>
+unsigned Grid<Node>::GetNeighbors(size_type x, size_type y,
+        DiagonalMovement movement, NeighborBuffer &buffer) const {
+    size_type index = IndexAt(x, y);
+    unsigned dirs = NeighborMask(x, y, movement);
+    unsigned n = 0;
+    while (dirs) {
+        unsigned dir = LowestBit(dirs);
+        dirs &= dirs - 1;
+        buffer.index[n] = index + index_offsets_[dir];
+        buffer.dir[n] = static_cast<unsigned char>(dir);
+        ++n;
     }
+    buffer.size = n;
+    return n;
+}
 
-    if (dont_cross_corners) {
-        d0 = s3 && s0;
-        d1 = s0 && s1;
-        d2 = s1 && s2;
-        d3 = s2 && s3;
-    } else {
-        d0 = s3 || s0;
-        d1 = s0 || s1;
-        d2 = s1 || s2;
-        d3 = s2 || s3;
+template <class Node>
+template <class Visitor>
+void Grid<Node>::ForEachNeighbor(size_type x, size_type y,
+        DiagonalMovement movement, Visitor &visitor) const {
+    size_type index = IndexAt(x, y);
+    unsigned dirs = NeighborMask(x, y, movement);
+    while (dirs) {
+        unsigned dir = LowestBit(dirs);
+        dirs &= dirs - 1;
+        visitor(index + index_offsets_[dir], dir);
     }
+}
 
-    // ↖
-    if (d0 && IsWalkableAt(x - 1, y - 1)) {
-        neighbors->push_back(nodes[y - 1][x - 1]);
-    }
-    // ↗
-    if (d1 && IsWalkableAt(x + 1, y - 1)) {
-        neighbors->push_back(nodes[y - 1][x + 1]);
-    }
-    // ↘
-    if (d2 && IsWalkableAt(x + 1, y + 1)) {
-        neighbors->push_back(nodes[y + 1][x + 1]);
-    }
-    // ↙
-    if (d3 && IsWalkableAt(x - 1, y + 1)) {
-        neighbors->push_back(nodes[y + 1][x - 1]);
+template <class Node>
+void Grid<Node>::InitIndexOffsets() {
+    for (unsigned dir = 0; dir < 8; ++dir) {
+        const DirectionOffset &o = OffsetOf(dir);
+        index_offsets_[dir] =
+            std::ptrdiff_t(o.dy) * std::ptrdiff_t(width_) + o.dx;
     }
+}
 
-    return neighbors;
+template <class Node>
+void Grid<Node>::InitComponents() {
+    components_[0] = ComponentIndex(false);
+    components_[1] = ComponentIndex(true);
+    components_[0].Build(bitmap_);
+    components_[1].Build(bitmap_);
 }
 
 template <class Node>
@@ -199,12 +380,12 @@ Grid<Node>::BuildNodes(size_type width,
         size_type height, Matrix *matrix) {
     size_type i, j;
 
+    // One allocation for the whole grid instead of one per node.
     node_grid_t *nodes = new node_grid_t;
-    nodes->resize(height);
+    nodes->reserve(width * height);
     for (i = 0; i < height; ++i) {
-        (*nodes)[i].resize(width);
         for (j = 0; j < width; ++j) {
-            (*nodes)[i][j].reset(new node_t(j, i, true));
+            nodes->push_back(node_t(j, i, true));
         }
     }
 
@@ -213,13 +394,17 @@ Grid<Node>::BuildNodes(size_type width,
     }
 
     if (width != matrix->Width() || height != matrix->Height()) {
+        delete nodes;
         throw std::runtime_error("Matrix size does not fit");
     }
 
+    typename node_grid_t::iterator node = nodes->begin();
     for (i = 0; i < height; ++i) {
-        for (j = 0; j < width; ++j) {
+        for (j = 0; j < width; ++j, ++node) {
             if (!matrix->IsWalkableAt(j, i)) {
-                (*nodes)[i][j]->walkable = false;
+                node->walkable = false;
+                this->bitmap_.Set(j, i, false);
+                this->transposed_.Set(i, j, false);
             }
         }
     }
@@ -1,34 +1,64 @@
 #ifndef CORE_HEURISTIC_HPP_
 #define CORE_HEURISTIC_HPP_
 
-#include <math.h>
-#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include "boost/cstdint.hpp"
 
 namespace heuristic {
 
 // diff_t: Negative is allowed.
 
+// floor(sqrt(n)), digit by digit from the highest bit of n.
+inline int ISqrt(boost::uint64_t n) {
+    boost::uint64_t root = 0, bit = boost::uint64_t(1) << 62;
+    while (bit > n) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return int(root);
+}
+
 // Manhattan distance.
 struct Manhattan {
-    int operator()(int dx, int dy) {
+    int operator()(int dx, int dy) const {
         return std::abs(dx) + std::abs(dy);
     }
 };
 
-// Euclidean distance.
+// Euclidean distance, rounded down.
 struct Euclidean {
-    int operator()(int dx, int dy) {
-        return int(sqrt(double(dx*dx + dy*dy)));
+    int operator()(int dx, int dy) const {
+        boost::int64_t x = dx, y = dy;
+        return ISqrt(boost::uint64_t(x * x + y * y));
     }
 };
 
 // Chebyshev distance.
 struct Chebyshev {
-    int operator()(int dx, int dy) {
+    int operator()(int dx, int dy) const {
         return std::max(std::abs(dx), std::abs(dy));
     }
 };
 
+// Octile distance, the exact cost on an empty map when a straight step
+// costs 10 and a diagonal one 14, as the finders count them. The
+// differences are given in tenths of a cell.
+struct Octile {
+    int operator()(int dx, int dy) const {
+        int ax = std::abs(dx), ay = std::abs(dy);
+        return std::max(ax, ay) + std::min(ax, ay) * 2 / 5;
+    }
+};
+
 }  // heuristic
 
 #endif // CORE_HEURISTIC_HPP_
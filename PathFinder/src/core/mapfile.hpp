@@ -0,0 +1,492 @@
+#ifndef CORE_MAPFILE_HPP_
+#define CORE_MAPFILE_HPP_
+
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "boost/cstdint.hpp"
+#include "boost/interprocess/file_mapping.hpp"
+#include "boost/interprocess/mapped_region.hpp"
+#include "boost/shared_ptr.hpp"
+#include "bitmap.hpp"
+#include "chunkedgrid.hpp"
+
+/*
+ * Grids on disk: the maps and scenarios of the MovingAI benchmarks, e.g.
+ * the ones of PathFinding.js-master/benchmark, and a packed format that
+ * holds the padded words of a WalkableBitmap as they are, so that a
+ * mapped file is read in place (see Grid(const WalkableBitmap &)), and
+ * one that holds the tiles of a ChunkedGrid, its uniform tiles as one
+ * flag each.
+ */
+
+// The characters of the walkable cells of a MovingAI map: the plain
+// ground and the swamp, as the optimal lengths of the scenarios take them.
+// The port in PathFinding.js only takes ".G".
+const char *const kMovingAIWalkable = ".GS";
+
+// One query of a MovingAI scenario.
+struct ScenarioQuery {
+    typedef std::size_t size_type;
+    unsigned bucket;
+    std::string map;
+    size_type map_width;
+    size_type map_height;
+    size_type start_x;
+    size_type start_y;
+    size_type goal_x;
+    size_type goal_y;
+    // The cost of a shortest path, a straight step costing 1 and a
+    // diagonal one sqrt(2), without cutting corners.
+    double optimal_length;
+};
+
+// Read a MovingAI map into `bitmap`, a cell being walkable if its
+// character is one of `walkable`. Throw std::runtime_error if it is not
+// a map.
+void ReadMovingAIMap(std::istream &in, WalkableBitmap &bitmap,
+                     const char *walkable = kMovingAIWalkable);
+// Read the queries of a MovingAI scenario into `queries`.
+void ReadMovingAIScenario(std::istream &in,
+                          std::vector<ScenarioQuery> &queries);
+
+// Write `bitmap` in the packed format, or read it back into a bitmap of
+// its own.
+void WritePackedGrid(std::ostream &out, const WalkableBitmap &bitmap);
+void ReadPackedGrid(std::istream &in, WalkableBitmap &bitmap);
+// Map the packed file `path` into memory and make `bitmap` read it in
+// place: no word is read but the header, each page being read from the
+// disk the first time a cell of it is. The padding is trusted to be
+// blocked, as WritePackedGrid() writes it; ReadPackedGrid() checks it.
+// A Grid of the bitmap still reads every cell once, see
+// Grid(const WalkableBitmap &).
+void MapPackedGrid(const std::string &path, WalkableBitmap &bitmap);
+
+// Write `grid` in the chunked format, or read it back into tiles of its
+// own.
+void WriteChunkedGrid(std::ostream &out, const ChunkedGrid &grid);
+void ReadChunkedGrid(std::istream &in, ChunkedGrid &grid);
+// Map the chunked file `path` into memory and make the detailed tiles of
+// `grid` read it in place, each page being read from the disk the first
+// time a search reads one of its tiles.
+void MapChunkedGrid(const std::string &path, ChunkedGrid &grid);
+
+inline void ReadMovingAIMap(std::istream &in, WalkableBitmap &bitmap,
+                            const char *walkable) {
+    bool table[256] = {false};
+    for (const char *c = walkable; *c; ++c) {
+        table[static_cast<unsigned char>(*c)] = true;
+    }
+
+    // the header lines up to "map", in any order
+    std::string key;
+    std::size_t width = 0, height = 0;
+    while (in >> key && key != "map") {
+        if (key == "height") {
+            in >> height;
+        } else if (key == "width") {
+            in >> width;
+        } else if (key == "type") {
+            in >> key;
+        } else {
+            throw std::runtime_error("Not a MovingAI map");
+        }
+    }
+    if (!in || width == 0 || height == 0) {
+        throw std::runtime_error("Not a MovingAI map");
+    }
+
+    bitmap.Reset(width, height, false);
+    std::string line;
+    std::getline(in, line);  // the end of the "map" line
+    for (std::size_t y = 0; y < height; ++y) {
+        if (!std::getline(in, line) || line.size() < width) {
+            throw std::runtime_error("MovingAI map is truncated");
+        }
+        for (std::size_t x = 0; x < width; ++x) {
+            if (table[static_cast<unsigned char>(line[x])]) {
+                bitmap.Set(x, y, true);
+            }
+        }
+    }
+}
+
+inline void ReadMovingAIScenario(std::istream &in,
+                                 std::vector<ScenarioQuery> &queries) {
+    queries.clear();
+    std::string version;
+    // the first line is "version 1" but in the oldest files
+    if (in >> version && version == "version") {
+        in >> version;
+    } else {
+        in.clear();
+        in.seekg(0);
+    }
+    ScenarioQuery query;
+    while (in >> query.bucket >> query.map >> query.map_width
+               >> query.map_height >> query.start_x >> query.start_y
+               >> query.goal_x >> query.goal_y >> query.optimal_length) {
+        queries.push_back(query);
+    }
+    if (!in.eof()) {
+        throw std::runtime_error("Not a MovingAI scenario");
+    }
+}
+
+namespace mapfile_detail {
+
+const boost::uint32_t kMagic = 0x42474650;  // "PFGB"
+const boost::uint32_t kChunkedMagic = 0x47434650;  // "PFCG"
+const boost::uint32_t kVersion = 1;
+// The header takes one cache line, and the words after it stay aligned.
+const std::size_t kHeaderBytes = 64;
+
+inline bool IsLittleEndian() {
+    boost::uint16_t probe = 1;
+    return *reinterpret_cast<const unsigned char *>(&probe) == 1;
+}
+
+// The header words, little-endian as the rest of the file.
+struct Header {
+    boost::uint32_t magic;
+    boost::uint32_t version;
+    boost::uint32_t width;
+    boost::uint32_t height;
+    boost::uint32_t stride;
+};
+
+inline void Put(unsigned char *bytes, boost::uint64_t word, unsigned count) {
+    for (unsigned i = 0; i < count; ++i) {
+        bytes[i] = static_cast<unsigned char>((word >> (8 * i)) & 0xFF);
+    }
+}
+
+inline boost::uint64_t Get(const unsigned char *bytes, unsigned count) {
+    boost::uint64_t word = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        word |= boost::uint64_t(bytes[i]) << (8 * i);
+    }
+    return word;
+}
+
+inline Header ParseHeader(const unsigned char *bytes) {
+    Header header = {
+        boost::uint32_t(Get(bytes, 4)), boost::uint32_t(Get(bytes + 4, 4)),
+        boost::uint32_t(Get(bytes + 8, 4)), boost::uint32_t(Get(bytes + 12, 4)),
+        boost::uint32_t(Get(bytes + 16, 4))};
+    if (header.magic != kMagic || header.version != kVersion) {
+        throw std::runtime_error("Not a packed grid file");
+    }
+    if (header.stride != WalkableBitmap::Stride(header.width)) {
+        throw std::runtime_error("Packed grid file is corrupt");
+    }
+    return header;
+}
+
+// Whether the padding around the cells is blocked, as the neighborhoods
+// read it without bounds checks.
+inline bool IsPaddingBlocked(const WalkableBitmap &bitmap) {
+    typedef WalkableBitmap::word_t word_t;
+    std::size_t stride = bitmap.stride(), width = bitmap.width(),
+                height = bitmap.height();
+    const word_t *words = bitmap.data();
+    for (std::size_t i = 0; i < stride; ++i) {
+        if (words[i] || words[(height + 1) * stride + i]) {
+            return false;
+        }
+    }
+    // the bits from width + 1 on, up to the end of the row
+    std::size_t last = (width + 1) >> 6;
+    word_t tail = ~((word_t(1) << ((width + 1) & 63)) - 1);
+    for (std::size_t y = 0; y < height; ++y) {
+        const word_t *row = bitmap.Row(y);
+        if ((row[0] & 1) || (row[last] & tail)) {
+            return false;
+        }
+        for (std::size_t i = last + 1; i < stride; ++i) {
+            if (row[i]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The header words of a chunked file.
+struct ChunkedHeader {
+    boost::uint32_t magic;
+    boost::uint32_t version;
+    boost::uint32_t width;
+    boost::uint32_t height;
+    boost::uint32_t tile_shift;
+    boost::uint32_t tile_x;
+    boost::uint32_t tile_y;
+    boost::uint32_t detailed;
+};
+
+// The directory of a chunked file: an entry a tile.
+enum {
+    kOpenEntry,
+    kBlockedEntry,
+    // the detailed tile k is the entry kDetailedEntry + k
+    kDetailedEntry
+};
+
+// The bytes of the directory, up to the next cache line.
+inline std::size_t DirectoryBytes(std::size_t tiles) {
+    return (tiles * 4 + kHeaderBytes - 1) / kHeaderBytes * kHeaderBytes;
+}
+
+inline ChunkedHeader ParseChunkedHeader(const unsigned char *bytes) {
+    ChunkedHeader header = {
+        boost::uint32_t(Get(bytes, 4)), boost::uint32_t(Get(bytes + 4, 4)),
+        boost::uint32_t(Get(bytes + 8, 4)), boost::uint32_t(Get(bytes + 12, 4)),
+        boost::uint32_t(Get(bytes + 16, 4)),
+        boost::uint32_t(Get(bytes + 20, 4)),
+        boost::uint32_t(Get(bytes + 24, 4)),
+        boost::uint32_t(Get(bytes + 28, 4))};
+    if (header.magic != kChunkedMagic || header.version != kVersion) {
+        throw std::runtime_error("Not a chunked grid file");
+    }
+    const std::size_t size = ChunkedGrid::kTileSize;
+    if (header.tile_shift != ChunkedGrid::kTileShift ||
+            header.tile_x != (header.width + size - 1) / size ||
+            header.tile_y != (header.height + size - 1) / size ||
+            header.detailed > std::size_t(header.tile_x) * header.tile_y) {
+        throw std::runtime_error("Chunked grid file is corrupt");
+    }
+    return header;
+}
+
+// Make the tiles of `grid` the ones of the directory, the detailed ones
+// reading the words at `words`, which `owner` keeps alive.
+inline void SetTiles(const ChunkedHeader &header,
+                     const unsigned char *directory,
+                     const ChunkedGrid::word_t *words,
+                     const boost::shared_ptr<const void> &owner,
+                     ChunkedGrid &grid) {
+    ChunkedGrid read(header.width, header.height);
+    for (std::size_t ty = 0, i = 0; ty < header.tile_y; ++ty) {
+        for (std::size_t tx = 0; tx < header.tile_x; ++tx, ++i) {
+            boost::uint32_t entry = boost::uint32_t(Get(directory + 4 * i, 4));
+            if (entry == kBlockedEntry) {
+                read.SetTile(tx, ty, false);
+            } else if (entry != kOpenEntry) {
+                std::size_t k = entry - kDetailedEntry;
+                if (k >= header.detailed) {
+                    throw std::runtime_error("Chunked grid file is corrupt");
+                }
+                read.BorrowTile(tx, ty, words + k * ChunkedGrid::kTileSize,
+                                owner);
+            }
+        }
+    }
+    grid.Swap(read);
+}
+
+}  // mapfile_detail
+
+/*
+ * The file is a header of 64 bytes: magic, version, width, height and
+ * stride, 4 bytes each, and zeros; then the (height + 2) * stride padded
+ * words of the bitmap, 8 bytes each, all little-endian.
+ */
+inline void WritePackedGrid(std::ostream &out, const WalkableBitmap &bitmap) {
+    using namespace mapfile_detail;
+    unsigned char header[kHeaderBytes] = {0};
+    Put(header, kMagic, 4);
+    Put(header + 4, kVersion, 4);
+    Put(header + 8, bitmap.width(), 4);
+    Put(header + 12, bitmap.height(), 4);
+    Put(header + 16, bitmap.stride(), 4);
+    out.write(reinterpret_cast<const char *>(header), kHeaderBytes);
+    const WalkableBitmap::word_t *words = bitmap.data();
+    unsigned char bytes[8];
+    for (std::size_t i = 0; i < bitmap.word_count(); ++i) {
+        Put(bytes, words[i], 8);
+        out.write(reinterpret_cast<const char *>(bytes), 8);
+    }
+    if (!out) {
+        throw std::runtime_error("Fail to write the packed grid file");
+    }
+}
+
+inline void ReadPackedGrid(std::istream &in, WalkableBitmap &bitmap) {
+    using namespace mapfile_detail;
+    unsigned char bytes[kHeaderBytes];
+    if (!in.read(reinterpret_cast<char *>(bytes), kHeaderBytes)) {
+        throw std::runtime_error("Packed grid file is truncated");
+    }
+    Header header = ParseHeader(bytes);
+    std::size_t count = (std::size_t(header.height) + 2) * header.stride;
+    boost::shared_ptr<std::vector<WalkableBitmap::word_t> > words(
+        new std::vector<WalkableBitmap::word_t>(count));
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!in.read(reinterpret_cast<char *>(bytes), 8)) {
+            throw std::runtime_error("Packed grid file is truncated");
+        }
+        (*words)[i] = Get(bytes, 8);
+    }
+    WalkableBitmap read;
+    read.Borrow(header.width, header.height, count ? &(*words)[0] : 0, words);
+    if (!IsPaddingBlocked(read)) {
+        throw std::runtime_error("Packed grid file is corrupt");
+    }
+    bitmap = read;
+}
+
+inline void MapPackedGrid(const std::string &path, WalkableBitmap &bitmap) {
+    using namespace mapfile_detail;
+    namespace ip = boost::interprocess;
+    if (!IsLittleEndian()) {
+        // the words are swapped on the way in
+        std::ifstream in(path.c_str(), std::ios::binary);
+        ReadPackedGrid(in, bitmap);
+        return;
+    }
+    boost::shared_ptr<ip::mapped_region> region;
+    try {
+        ip::file_mapping file(path.c_str(), ip::read_only);
+        region.reset(new ip::mapped_region(file, ip::read_only));
+    } catch (const ip::interprocess_exception &e) {
+        throw std::runtime_error(std::string("Fail to map the packed grid "
+                                             "file: ") + e.what());
+    }
+    const unsigned char *bytes =
+        static_cast<const unsigned char *>(region->get_address());
+    if (region->get_size() < kHeaderBytes) {
+        throw std::runtime_error("Packed grid file is truncated");
+    }
+    Header header = ParseHeader(bytes);
+    std::size_t count = (std::size_t(header.height) + 2) * header.stride;
+    if ((region->get_size() - kHeaderBytes) / 8 < count) {
+        throw std::runtime_error("Packed grid file is truncated");
+    }
+    bitmap.Borrow(header.width, header.height,
+        reinterpret_cast<const WalkableBitmap::word_t *>(bytes + kHeaderBytes),
+        region);
+}
+
+/*
+ * The chunked file is a header of 64 bytes: magic, version, width,
+ * height, the shift of the tile size, the tiles across and down and the
+ * number of detailed tiles, 4 bytes each, and zeros; then the directory,
+ * one entry of 4 bytes a tile, row by row, padded with zeros up to 64
+ * bytes; then the 64 words of each detailed tile, 8 bytes each, all
+ * little-endian.
+ */
+inline void WriteChunkedGrid(std::ostream &out, const ChunkedGrid &grid) {
+    using namespace mapfile_detail;
+    typedef ChunkedGrid::size_type size_type;
+    std::size_t tiles = grid.tile_x() * grid.tile_y();
+    std::vector<unsigned char> directory(DirectoryBytes(tiles));
+    std::vector<const ChunkedGrid::word_t *> detailed;
+    for (size_type ty = 0, i = 0; ty < grid.tile_y(); ++ty) {
+        for (size_type tx = 0; tx < grid.tile_x(); ++tx, ++i) {
+            ChunkedGrid::TileKind kind = grid.tile_kind(tx, ty);
+            boost::uint32_t entry = 0;
+            if (kind == ChunkedGrid::kOpenTile) {
+                entry = kOpenEntry;
+            } else if (kind == ChunkedGrid::kBlockedTile) {
+                entry = kBlockedEntry;
+            } else {
+                entry = boost::uint32_t(kDetailedEntry + detailed.size());
+                detailed.push_back(grid.tile_words(tx, ty));
+            }
+            Put(&directory[4 * i], entry, 4);
+        }
+    }
+    unsigned char header[kHeaderBytes] = {0};
+    Put(header, kChunkedMagic, 4);
+    Put(header + 4, kVersion, 4);
+    Put(header + 8, grid.width(), 4);
+    Put(header + 12, grid.height(), 4);
+    Put(header + 16, ChunkedGrid::kTileShift, 4);
+    Put(header + 20, grid.tile_x(), 4);
+    Put(header + 24, grid.tile_y(), 4);
+    Put(header + 28, detailed.size(), 4);
+    out.write(reinterpret_cast<const char *>(header), kHeaderBytes);
+    if (!directory.empty()) {
+        out.write(reinterpret_cast<const char *>(&directory[0]),
+                  directory.size());
+    }
+    unsigned char bytes[8];
+    for (std::size_t k = 0; k < detailed.size(); ++k) {
+        for (std::size_t i = 0; i < ChunkedGrid::kTileSize; ++i) {
+            Put(bytes, detailed[k][i], 8);
+            out.write(reinterpret_cast<const char *>(bytes), 8);
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("Fail to write the chunked grid file");
+    }
+}
+
+inline void ReadChunkedGrid(std::istream &in, ChunkedGrid &grid) {
+    using namespace mapfile_detail;
+    unsigned char bytes[kHeaderBytes];
+    if (!in.read(reinterpret_cast<char *>(bytes), kHeaderBytes)) {
+        throw std::runtime_error("Chunked grid file is truncated");
+    }
+    ChunkedHeader header = ParseChunkedHeader(bytes);
+    std::vector<unsigned char> directory(
+        DirectoryBytes(std::size_t(header.tile_x) * header.tile_y));
+    if (!directory.empty() &&
+            !in.read(reinterpret_cast<char *>(&directory[0]),
+                     directory.size())) {
+        throw std::runtime_error("Chunked grid file is truncated");
+    }
+    std::size_t count = std::size_t(header.detailed) * ChunkedGrid::kTileSize;
+    boost::shared_ptr<std::vector<ChunkedGrid::word_t> > words(
+        new std::vector<ChunkedGrid::word_t>(count));
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!in.read(reinterpret_cast<char *>(bytes), 8)) {
+            throw std::runtime_error("Chunked grid file is truncated");
+        }
+        (*words)[i] = Get(bytes, 8);
+    }
+    SetTiles(header, directory.empty() ? 0 : &directory[0],
+             count ? &(*words)[0] : 0, words, grid);
+}
+
+inline void MapChunkedGrid(const std::string &path, ChunkedGrid &grid) {
+    using namespace mapfile_detail;
+    namespace ip = boost::interprocess;
+    if (!IsLittleEndian()) {
+        // the words are swapped on the way in
+        std::ifstream in(path.c_str(), std::ios::binary);
+        ReadChunkedGrid(in, grid);
+        return;
+    }
+    boost::shared_ptr<ip::mapped_region> region;
+    try {
+        ip::file_mapping file(path.c_str(), ip::read_only);
+        region.reset(new ip::mapped_region(file, ip::read_only));
+    } catch (const ip::interprocess_exception &e) {
+        throw std::runtime_error(std::string("Fail to map the chunked grid "
+                                             "file: ") + e.what());
+    }
+    const unsigned char *bytes =
+        static_cast<const unsigned char *>(region->get_address());
+    if (region->get_size() < kHeaderBytes) {
+        throw std::runtime_error("Chunked grid file is truncated");
+    }
+    ChunkedHeader header = ParseChunkedHeader(bytes);
+    std::size_t directory =
+        DirectoryBytes(std::size_t(header.tile_x) * header.tile_y);
+    std::size_t count = std::size_t(header.detailed) * ChunkedGrid::kTileSize;
+    if (region->get_size() < kHeaderBytes + directory ||
+            (region->get_size() - kHeaderBytes - directory) / 8 < count) {
+        throw std::runtime_error("Chunked grid file is truncated");
+    }
+    SetTiles(header, bytes + kHeaderBytes,
+        reinterpret_cast<const ChunkedGrid::word_t *>(
+            bytes + kHeaderBytes + directory),
+        region, grid);
+}
+
+#endif // CORE_MAPFILE_HPP_
@@ -0,0 +1,134 @@
+#ifndef CORE_MOVEMENT_HPP_
+#define CORE_MOVEMENT_HPP_
+
+#include "boost/cstdint.hpp"
+
+// Same modes as PathFinding.js DiagonalMovement.
+enum DiagonalMovement {
+    kDiagonalAlways = 0,
+    kDiagonalNever,
+    // Diagonal move is allowed if at most one of the two cells it passes
+    // by is blocked.
+    kDiagonalIfAtMostOneObstacle,
+    // Diagonal move is allowed only if both cells it passes by are free,
+    // i.e. it never crosses a block corner.
+    kDiagonalOnlyWhenNoObstacles
+};
+
+enum { kDiagonalMovementCount = 4 };
+
+// A DiagonalMovement as a type, so that a finder can be specialized for it
+// at compile time.
+template <DiagonalMovement kMovement>
+struct DiagonalPolicy {
+    static const DiagonalMovement movement = kMovement;
+};
+
+// Map the FinderOption flags to the movement mode.
+inline DiagonalMovement ToDiagonalMovement(bool allow_diagonal,
+                                           bool dont_cross_corners) {
+    if (!allow_diagonal) {
+        return kDiagonalNever;
+    }
+    return dont_cross_corners ? kDiagonalOnlyWhenNoObstacles
+                              : kDiagonalIfAtMostOneObstacle;
+}
+
+/**
+ * Directions, in the order Grid::GetNeighbors() emits the neighbors.
+ *
+ *  +---+---+---+
+ *  | 4 | 0 | 5 |
+ *  +---+---+---+
+ *  | 3 |   | 1 |
+ *  +---+---+---+
+ *  | 7 | 2 | 6 |
+ *  +---+---+---+
+ */
+enum Direction {
+    kDirUp = 0,
+    kDirRight,
+    kDirDown,
+    kDirLeft,
+    kDirUpLeft,
+    kDirUpRight,
+    kDirDownRight,
+    kDirDownLeft
+};
+
+struct DirectionOffset {
+    int dx;
+    int dy;
+};
+
+inline const DirectionOffset &OffsetOf(unsigned dir) {
+    static const DirectionOffset offsets[8] = {
+        { 0, -1}, { 1,  0}, { 0,  1}, {-1,  0},
+        {-1, -1}, { 1, -1}, { 1,  1}, {-1,  1}
+    };
+    return offsets[dir];
+}
+
+/**
+ * Lookup table from the 8-bit neighborhood of a cell to the set of
+ * directions it may move to, one table per DiagonalMovement.
+ *
+ * The neighborhood bits are read row by row from the top-left corner,
+ * skipping the center (see WalkableBitmap::Neighborhood()):
+ *
+ *  +---+---+---+
+ *  | 0 | 1 | 2 |
+ *  +---+---+---+
+ *  | 3 |   | 4 |
+ *  +---+---+---+
+ *  | 5 | 6 | 7 |
+ *  +---+---+---+
+ *
+ * The result has bit `d` set if moving to Direction `d` is allowed.
+ */
+class NeighborTable {
+public:
+    static const NeighborTable &Instance() {
+        static const NeighborTable table;
+        return table;
+    }
+
+    // Drop the center bit of a 9-bit 3x3 neighborhood.
+    static unsigned Compact(unsigned neighborhood) {
+        return (neighborhood & 0x0F) | ((neighborhood >> 1) & 0xF0);
+    }
+
+    unsigned Lookup(DiagonalMovement movement, unsigned mask) const {
+        return moves_[movement][mask];
+    }
+
+private:
+    NeighborTable() {
+        for (unsigned mask = 0; mask < 256; ++mask) {
+            unsigned s0 = (mask >> 1) & 1,  // ↑
+                     s1 = (mask >> 4) & 1,  // →
+                     s2 = (mask >> 6) & 1,  // ↓
+                     s3 = (mask >> 3) & 1;  // ←
+            unsigned straight = s0 | (s1 << 1) | (s2 << 2) | (s3 << 3);
+            unsigned diagonal = ((mask >> 0) & 1) << 4 |  // ↖
+                                ((mask >> 2) & 1) << 5 |  // ↗
+                                ((mask >> 7) & 1) << 6 |  // ↘
+                                ((mask >> 5) & 1) << 7;   // ↙
+            unsigned at_most_one = ((s3 | s0) << 4) | ((s0 | s1) << 5) |
+                                   ((s1 | s2) << 6) | ((s2 | s3) << 7);
+            unsigned no_obstacle = ((s3 & s0) << 4) | ((s0 & s1) << 5) |
+                                   ((s1 & s2) << 6) | ((s2 & s3) << 7);
+            moves_[kDiagonalAlways][mask] =
+                boost::uint8_t(straight | diagonal);
+            moves_[kDiagonalNever][mask] = boost::uint8_t(straight);
+            moves_[kDiagonalIfAtMostOneObstacle][mask] =
+                boost::uint8_t(straight | (diagonal & at_most_one));
+            moves_[kDiagonalOnlyWhenNoObstacles][mask] =
+                boost::uint8_t(straight | (diagonal & no_obstacle));
+        }
+    }
+
+    boost::uint8_t moves_[kDiagonalMovementCount][256];
+};
+
+#endif // CORE_MOVEMENT_HPP_
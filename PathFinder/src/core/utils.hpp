@@ -1,18 +1,71 @@
 #ifndef CORE_UTILS_HPP_
 #define CORE_UTILS_HPP_
 
-template <typename grid_t>
+#include <algorithm>
+#include <cstddef>
+#include "boost/cstdint.hpp"
+
+// Backtrace according to the parent records of the search context and
+// return the path, including both start and end nodes.
+template <typename grid_t, typename context_t>
 typename grid_t::pnode_vector_t
-Backtrace(typename grid_t::pnode_t pnode) {
+Backtrace(const grid_t &grid, const context_t &context,
+          typename grid_t::size_type index) {
     typedef typename grid_t::node_vector_t node_vector_t;
     typedef typename grid_t::pnode_vector_t pnode_vector_t;
     pnode_vector_t pnode_path(new node_vector_t);
-    pnode_path->insert(pnode_path->begin(), pnode);
-    while (pnode->parent) {
-        pnode = pnode->parent;
-        pnode_path->insert(pnode_path->begin(), pnode);
+    pnode_path->push_back(grid.GetNodeAt(index));
+    while ((index = context.Parent(index)) != context_t::kNoParent) {
+        pnode_path->push_back(grid.GetNodeAt(index));
     }
+    std::reverse(pnode_path->begin(), pnode_path->end());
     return pnode_path;
 }
 
+// Expand a path whose consecutive nodes lie on one straight or diagonal
+// line, e.g. the jump points of JumpPointFinder, into the path of every
+// cell passed, including both start and end nodes.
+template <typename grid_t>
+typename grid_t::pnode_vector_t
+ExpandPath(const grid_t &grid,
+           const typename grid_t::pnode_vector_t &pnode_path) {
+    typedef typename grid_t::size_type size_type;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    pnode_vector_t expanded(new node_vector_t);
+    if (pnode_path->empty()) {
+        return expanded;
+    }
+    expanded->push_back(pnode_path->front());
+    for (std::size_t i = 1, sz = pnode_path->size(); i < sz; ++i) {
+        size_type x = (*pnode_path)[i - 1]->x, y = (*pnode_path)[i - 1]->y,
+                  end_x = (*pnode_path)[i]->x, end_y = (*pnode_path)[i]->y;
+        while (x != end_x || y != end_y) {
+            x = x < end_x ? x + 1 : (x > end_x ? x - 1 : x);
+            y = y < end_y ? y + 1 : (y > end_y ? y - 1 : y);
+            expanded->push_back(grid.GetNodeAt(x, y));
+        }
+    }
+    return expanded;
+}
+
+// Compute the cost of the path, 10 per straight step and 14 per diagonal
+// step, as the finders count it.
+template <typename pnode_vector_t>
+int PathCost(const pnode_vector_t &pnode_path) {
+    int cost = 0;
+    for (std::size_t i = 1, sz = pnode_path->size(); i < sz; ++i) {
+        bool straight = (*pnode_path)[i - 1]->x == (*pnode_path)[i]->x ||
+                        (*pnode_path)[i - 1]->y == (*pnode_path)[i]->y;
+        cost += straight ? 10 : 14;
+    }
+    return cost;
+}
+
+// Hash a cell index into `bits` bits (1 to 63), by Fibonacci hashing.
+inline std::size_t HashIndex(std::size_t index, unsigned bits) {
+    return std::size_t((boost::uint64_t(index) *
+                        UINT64_C(0x9E3779B97F4A7C15)) >> (64 - bits));
+}
+
 #endif // CORE_UTILS_HPP_
@@ -0,0 +1,184 @@
+#ifndef CORE_WORKPOOL_HPP_
+#define CORE_WORKPOOL_HPP_
+
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/bind.hpp"
+#include "boost/function.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/condition_variable.hpp"
+#include "boost/thread/locks.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/thread.hpp"
+
+/**
+ * A fixed set of worker threads running the items [0, count) of a task,
+ * the calling thread being worker 0.
+ *
+ * The items are dealt out as one range per worker. A worker takes the
+ * items of its range from the front, and once it is empty steals the back
+ * half of the range of another worker, so the workers stay busy to the
+ * end even if the items take very different times, and rarely touch the
+ * same range.
+ */
+class WorkStealingPool : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    // task(worker, item), it must not throw
+    typedef boost::function<void (unsigned, size_type)> task_t;
+
+    // `workers` 0 is one per hardware thread.
+    explicit WorkStealingPool(unsigned workers = 0);
+    ~WorkStealingPool();
+
+    unsigned workers() const { return unsigned(ranges_.size()); }
+    // Run `task` for every item in [0, count), and return once all are
+    // done. One Run() at a time.
+    void Run(size_type count, const task_t &task);
+
+private:
+    // The items left to a worker, on a cache line of its own.
+    struct Range {
+        Range() : begin(0), end(0) {}
+        boost::mutex mutex;
+        size_type begin;
+        size_type end;
+        char padding[64];
+    };
+
+    void Loop(unsigned worker);
+    void Work(unsigned worker);
+    bool Take(unsigned worker, size_type &item);
+    bool Steal(unsigned worker, size_type &item);
+
+    std::vector<boost::shared_ptr<Range> > ranges_;
+    std::vector<boost::shared_ptr<boost::thread> > threads_;
+    boost::mutex mutex_;
+    boost::condition_variable started_;
+    boost::condition_variable finished_;
+    const task_t *task_;
+    // bumped by every Run(), so that a thread runs each one once
+    unsigned long round_;
+    unsigned running_;
+    bool stopping_;
+};
+
+inline WorkStealingPool::WorkStealingPool(unsigned workers)
+        : task_(0), round_(0), running_(0), stopping_(false) {
+    if (workers == 0) {
+        workers = boost::thread::hardware_concurrency();
+    }
+    if (workers == 0) {
+        workers = 1;
+    }
+    for (unsigned i = 0; i < workers; ++i) {
+        ranges_.push_back(boost::shared_ptr<Range>(new Range));
+    }
+    for (unsigned i = 1; i < workers; ++i) {
+        threads_.push_back(boost::shared_ptr<boost::thread>(
+            new boost::thread(boost::bind(&WorkStealingPool::Loop, this, i))));
+    }
+}
+
+inline WorkStealingPool::~WorkStealingPool() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    started_.notify_all();
+    for (std::size_t i = 0; i < threads_.size(); ++i) {
+        threads_[i]->join();
+    }
+}
+
+inline void WorkStealingPool::Run(size_type count, const task_t &task) {
+    unsigned n = workers();
+    for (unsigned i = 0; i < n; ++i) {
+        boost::lock_guard<boost::mutex> lock(ranges_[i]->mutex);
+        ranges_[i]->begin = count * i / n;
+        ranges_[i]->end = count * (i + 1) / n;
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        BOOST_ASSERT_MSG(running_ == 0, "Oops, Run() while running.");
+        task_ = &task;
+        running_ = n - 1;
+        ++round_;
+    }
+    started_.notify_all();
+    Work(0);
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (running_ > 0) {
+        finished_.wait(lock);
+    }
+    task_ = 0;
+}
+
+inline void WorkStealingPool::Loop(unsigned worker) {
+    unsigned long round = 0;
+    for (;;) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (!stopping_ && round_ == round) {
+                started_.wait(lock);
+            }
+            if (stopping_) {
+                return;
+            }
+            round = round_;
+        }
+        Work(worker);
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        if (--running_ == 0) {
+            finished_.notify_one();
+        }
+    }
+}
+
+inline void WorkStealingPool::Work(unsigned worker) {
+    size_type item = 0;
+    while (Take(worker, item) || Steal(worker, item)) {
+        (*task_)(worker, item);
+    }
+}
+
+inline bool WorkStealingPool::Take(unsigned worker, size_type &item) {
+    Range &range = *ranges_[worker];
+    boost::lock_guard<boost::mutex> lock(range.mutex);
+    if (range.begin == range.end) {
+        return false;
+    }
+    item = range.begin++;
+    return true;
+}
+
+inline bool WorkStealingPool::Steal(unsigned worker, size_type &item) {
+    unsigned n = workers();
+    for (unsigned i = 1; i < n; ++i) {
+        size_type begin = 0, end = 0;
+        {
+            Range &victim = *ranges_[(worker + i) % n];
+            boost::lock_guard<boost::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            // the back half, rounded up so that a last item is taken too
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+        // the victim's lock is released first, two thieves never wait on
+        // each other's range
+        Range &range = *ranges_[worker];
+        boost::lock_guard<boost::mutex> lock(range.mutex);
+        item = begin;
+        range.begin = begin + 1;
+        range.end = end;
+        return true;
+    }
+    return false;
+}
+
+#endif // CORE_WORKPOOL_HPP_
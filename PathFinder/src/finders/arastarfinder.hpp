@@ -0,0 +1,327 @@
+#ifndef FINDERS_ARASTARFINDER_HPP_
+#define FINDERS_ARASTARFINDER_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/chrono.hpp"
+#include "boost/noncopyable.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "deadline.hpp"
+#include "searchcontext.hpp"
+
+/**
+ * ARA*: an anytime search that finds a path by weighted A* first, then
+ * better ones as the weight goes down to 1, each time reusing the search
+ * so far, until the path is a shortest one or the budget of the caller
+ * runs out.
+ *
+ * The cells are keyed g + w * h. A cell lowered after it was expanded
+ * with the current weight is set aside, and queued again with the open
+ * cells, under the next weight, once the search with this one has reached
+ * the goal. Each path comes with a bound: it costs at most that many times
+ * a shortest one, which is the lesser of the weight and the cost over the
+ * lowest g + h of the cells queued or set aside.
+ *
+ * The search of one query goes on over the calls of Improve(), each one
+ * within a number of expansions or a deadline, e.g. the budget of a tick.
+ * The grid must not change between Start() and the last Improve().
+ *
+ * @tparam Heuristic      consistent functor int(int dx, int dy), e.g.
+ *                        heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ * @tparam OpenList       open list policy, see openlist.hpp
+ */
+template <class Heuristic = heuristic::Octile,
+          class Diagonal = DiagonalPolicy<kDiagonalNever>,
+          class OpenList = DefaultOpenList>
+class BasicARAStarFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef BasicSearchContext<OpenList> context_t;
+    typedef boost::chrono::steady_clock clock_t;
+
+    // The best path found so far for the query.
+    struct Result {
+        // empty if none yet, or if there is none
+        pnode_vector_t path;
+        int cost;
+        // the path costs at most `bound` times a shortest one
+        double bound;
+        // the weight of the search that found it
+        double weight;
+        // whether the search is over: the path is a shortest one, or
+        // there is none
+        bool done;
+    };
+
+    // The weights go from `initial_weight` down to 1 by `weight_step`.
+    explicit BasicARAStarFinder(double initial_weight = 3,
+                                double weight_step = 0.5,
+                                const Heuristic &heuristic = Heuristic());
+
+    // Start the query, with nothing searched yet.
+    void Start(size_type start_x, size_type start_y,
+               size_type end_x, size_type end_y, const grid_t &grid);
+    // Search on until done, or `max_expansions` more cells were expanded,
+    // or the deadline passed, which is read every 64 expansions.
+    const Result &Improve(size_type max_expansions = size_type(-1)) {
+        return ImproveUntil(max_expansions, NoDeadline());
+    }
+    const Result &Improve(size_type max_expansions,
+                          clock_t::time_point deadline) {
+        return ImproveUntil(max_expansions, SteadyDeadline(deadline));
+    }
+    // Start() and Improve() at once.
+    const Result &FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y, const grid_t &grid,
+        size_type max_expansions = size_type(-1)) {
+        Start(start_x, start_y, end_x, end_y, grid);
+        return Improve(max_expansions);
+    }
+    const Result &FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y, const grid_t &grid,
+        size_type max_expansions, clock_t::time_point deadline) {
+        Start(start_x, start_y, end_x, end_y, grid);
+        return Improve(max_expansions, deadline);
+    }
+
+    const Result &result() const { return result_; }
+    // The cells expanded by the query so far, counted again when they are
+    // expanded again under a lower weight.
+    size_type expanded() const { return expanded_; }
+
+private:
+    typedef typename context_t::State state_t;
+
+    // The weights are in 1/kWeightScale, applied to h.
+    enum { kWeightScale = 16 };
+
+    int KeyOf(const state_t &state) const {
+        return state.g + state.h * weight_ / kWeightScale;
+    }
+    int GoalG() const {
+        const state_t *goal = context_.Find(end_);
+        return goal ? goal->g : INT_MAX;
+    }
+    // See Improve(), a Deadline being NoDeadline or SteadyDeadline.
+    template <class Deadline>
+    const Result &ImproveUntil(size_type max_expansions,
+                               const Deadline &deadline);
+    // Set aside the open cells and the lowered closed ones, publish the
+    // path found with the current weight, and queue them again under the
+    // next weight unless the path is a shortest one.
+    void FinishWeight();
+
+    Heuristic heuristic_;
+    int initial_weight_;
+    int weight_step_;
+    const grid_t *grid_;
+    size_type end_x_;
+    size_type end_y_;
+    size_type end_;
+    int weight_;
+    context_t context_;
+    // the cells closed under the current weight, the ones of them lowered
+    // since, and the cells to queue under the next weight
+    std::vector<size_type> closed_;
+    std::vector<size_type> lowered_;
+    std::vector<size_type> pending_;
+    size_type expanded_;
+    Result result_;
+};
+
+template <class Heuristic, class Diagonal, class OpenList>
+BasicARAStarFinder<Heuristic, Diagonal, OpenList>::BasicARAStarFinder(
+        double initial_weight, double weight_step, const Heuristic &heuristic)
+        : heuristic_(heuristic),
+          initial_weight_(std::max(int(kWeightScale),
+                                   int(initial_weight * kWeightScale + 0.5))),
+          weight_step_(std::max(1, int(weight_step * kWeightScale + 0.5))),
+          grid_(0), end_x_(0), end_y_(0), end_(0), weight_(kWeightScale),
+          expanded_(0) {
+    result_.cost = 0;
+    result_.bound = 1;
+    result_.weight = 1;
+    result_.done = true;
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+void BasicARAStarFinder<Heuristic, Diagonal, OpenList>::Start(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y, const grid_t &grid) {
+    grid_ = &grid;
+    end_x_ = end_x;
+    end_y_ = end_y;
+    end_ = grid.IndexAt(end_x, end_y);
+    weight_ = initial_weight_;
+    expanded_ = 0;
+    closed_.clear();
+    lowered_.clear();
+    result_.path = pnode_vector_t();
+    result_.cost = 0;
+    result_.bound = double(weight_) / kWeightScale;
+    result_.weight = result_.bound;
+    result_.done = false;
+
+    context_.Prepare(grid.size());
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y,
+                          Diagonal::movement)) {
+        result_.done = true;
+        return;
+    }
+    size_type start = grid.IndexAt(start_x, start_y);
+    state_t &state = context_.Touch(start);
+    state.h = heuristic_(10 * (int(start_x) - int(end_x)),
+                         10 * (int(start_y) - int(end_y)));
+    state.f = KeyOf(state);
+    state.opened = true;
+    context_.open_list().Push(start, state.f, state.handle);
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+template <class Deadline>
+const typename BasicARAStarFinder<Heuristic, Diagonal, OpenList>::Result &
+BasicARAStarFinder<Heuristic, Diagonal, OpenList>::ImproveUntil(
+        size_type max_expansions, const Deadline &deadline) {
+    if (result_.done) {
+        return result_;
+    }
+    const grid_t &grid = *grid_;
+    OpenList &open_list = context_.open_list();
+    NeighborBuffer neighbors;
+    size_type x = 0, y = 0;
+    size_type count = 0;
+    while (!result_.done) {
+        if (open_list.Empty()) {
+            FinishWeight();
+            continue;
+        }
+        size_type index = open_list.Pop();
+        state_t &state = context_.Touch(index);
+        // the weight is done when no queued key is below the goal's g
+        if (state.f >= GoalG()) {
+            open_list.Push(index, state.f, state.handle);
+            FinishWeight();
+            continue;
+        }
+        if (count >= max_expansions ||
+                (count % 64 == 0 && deadline.Passed())) {
+            open_list.Push(index, state.f, state.handle);
+            break;
+        }
+        ++count;
+        ++expanded_;
+        state.opened = false;
+        state.closed = true;
+        closed_.push_back(index);
+
+        grid.CoordsOf(index, x, y);
+        grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            size_type neighbor_index = neighbors.index[i];
+            unsigned dir = neighbors.dir[i];
+            int ng = state.g + (dir < 4 ? 10 : 14);
+            const state_t *seen = context_.Find(neighbor_index);
+            if (seen && ng >= seen->g) {
+                continue;
+            }
+            state_t &neighbor_state = context_.Touch(neighbor_index);
+            if (!seen) {
+                const DirectionOffset &o = OffsetOf(dir);
+                neighbor_state.h = heuristic_(
+                    10 * (int(x) + o.dx - int(end_x_)),
+                    10 * (int(y) + o.dy - int(end_y_)));
+            }
+            neighbor_state.g = ng;
+            neighbor_state.parent = index;
+            if (neighbor_state.closed) {
+                // queued again under the next weight
+                lowered_.push_back(neighbor_index);
+                continue;
+            }
+            neighbor_state.f = KeyOf(neighbor_state);
+            if (neighbor_state.opened) {
+                open_list.Update(neighbor_state.handle, neighbor_index,
+                                 neighbor_state.f);
+            } else {
+                neighbor_state.opened = true;
+                open_list.Push(neighbor_index, neighbor_state.f,
+                               neighbor_state.handle);
+            }
+        }
+    }
+    return result_;
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+void BasicARAStarFinder<Heuristic, Diagonal, OpenList>::FinishWeight() {
+    OpenList &open_list = context_.open_list();
+    int goal_g = GoalG();
+    if (goal_g == INT_MAX) {
+        // the open list ran out without reaching the goal
+        result_.done = true;
+        return;
+    }
+
+    // the cells to queue under the next weight, marked opened
+    pending_.clear();
+    while (!open_list.Empty()) {
+        pending_.push_back(open_list.Pop());
+    }
+    for (std::size_t i = 0; i < closed_.size(); ++i) {
+        context_.Touch(closed_[i]).closed = false;
+    }
+    for (std::size_t i = 0; i < lowered_.size(); ++i) {
+        state_t &state = context_.Touch(lowered_[i]);
+        if (!state.opened) {
+            state.opened = true;
+            pending_.push_back(lowered_[i]);
+        }
+    }
+    closed_.clear();
+    lowered_.clear();
+    // no path is shorter than the lowest g + h of them
+    int lowest = INT_MAX;
+    for (std::size_t i = 0; i < pending_.size(); ++i) {
+        const state_t &state = context_.Touch(pending_[i]);
+        lowest = std::min(lowest, state.g + state.h);
+    }
+
+    // the path may cost less than the goal's g, if cells on it were
+    // lowered after their successors
+    result_.path = Backtrace(*grid_, context_, end_);
+    result_.cost = PathCost(result_.path);
+    result_.weight = double(weight_) / kWeightScale;
+    result_.bound = lowest >= result_.cost
+        ? 1 : std::min(result_.weight, double(result_.cost) / lowest);
+    if (weight_ == kWeightScale || result_.bound <= 1) {
+        result_.bound = 1;
+        result_.done = true;
+        return;
+    }
+
+    weight_ = std::max(int(kWeightScale), weight_ - weight_step_);
+    for (std::size_t i = 0; i < pending_.size(); ++i) {
+        state_t &state = context_.Touch(pending_[i]);
+        state.f = KeyOf(state);
+        open_list.Push(pending_[i], state.f, state.handle);
+    }
+}
+
+typedef BasicARAStarFinder<> ARAStarFinder;
+
+#endif // FINDERS_ARASTARFINDER_HPP_
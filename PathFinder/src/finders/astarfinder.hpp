@@ -4,158 +4,537 @@
 #define _USE_MATH_DEFINES
 
 #include <math.h>
-#include <boost/heap/pairing_heap.hpp>
-#include "boost/foreach.hpp"
+#include "boost/chrono.hpp"
 #include "boost/shared_ptr.hpp"
 #include "core/grid.hpp"
 #include "core/heuristic.hpp"
+#include "core/movement.hpp"
 #include "core/utils.hpp"
+#include "deadline.hpp"
 #include "option.hpp"
+#include "searchcontext.hpp"
 
-template <typename subscript_t>
-struct AStarNode : public BaseNode<subscript_t> {
-    typedef boost::shared_ptr<AStarNode> pnode_t;
-    struct FCmp {
-        bool operator()(const pnode_t &lhs,
-                        const pnode_t &rhs) const {
-            return lhs->f > rhs->f;
-        }
-    };
-    typedef boost::heap::pairing_heap<pnode_t,
-        boost::heap::compare<FCmp> > heap_t;
-    AStarNode(subscript_t x, subscript_t y, bool walkable)
-        : BaseNode<subscript_t>(x, y, walkable) { Reset(); }
-    void Reset() {
-        f = 0; g = 0; h = 0;
-        opened = false; closed = false;
-        parent.reset();
-    }
-    int f;
-    int g;
-    int h;
-    bool opened;
-    bool closed;
-    pnode_t parent;
-    typename heap_t::handle_type handle;
-};
+template <class Heuristic, class Diagonal, class OpenList, class Stats,
+          class GridT = Grid<BaseNode<std::size_t> >,
+          class Context = BasicSearchContext<OpenList, Stats> >
+class BasicAStarSearch;
 
-class AStarFinder {
+/**
+ * A* specialized at compile time: the heuristic functor is inlined, and
+ * neighbor generation is compiled for one movement mode.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ * @tparam OpenList       open list policy, see openlist.hpp
+ * @tparam Stats          statistics policy, see searchstats.hpp
+ */
+template <class Heuristic,
+          class Diagonal = DiagonalPolicy<kDiagonalNever>,
+          class OpenList = DefaultOpenList,
+          class Stats = NoSearchStats>
+class BasicAStarFinder {
 public:
     typedef std::size_t size_type;
-    typedef AStarNode<size_type> node_t;
+    typedef BaseNode<size_type> node_t;
     typedef Grid<node_t> grid_t;
-    typedef grid_t::pnode_t pnode_t;
-    typedef grid_t::node_vector_t node_vector_t;
-    typedef grid_t::pnode_vector_t pnode_vector_t;
-    typedef grid_t::pnode_grid_t pnode_grid_t;
-    typedef boost::shared_ptr<FinderOption> poption_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef BasicSearchContext<OpenList, Stats> context_t;
+    typedef BasicAStarSearch<Heuristic, Diagonal, OpenList, Stats> search_t;
+    typedef boost::shared_ptr<search_t> psearch_t;
 
-    AStarFinder(poption_t op = poption_t()) : op_(op) {
-        if (!op_) {
-            FinderOption temp = {false, false, heuristic::Manhattan(), 1};
-            op_ = poption_t(new FinderOption(temp));  // copy constructor
-        }
-    }
-    inline FinderOption &Option() {
-        return *op_;
-    }
+    explicit BasicAStarFinder(int weight = 1,
+                              const Heuristic &heuristic = Heuristic())
+        : weight_(weight), heuristic_(heuristic) {}
 
-    // It will change the node's additional attributes.
-    // You should ResetGrid(), while you FindPath() again.
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
     pnode_vector_t
     FindPath(size_type start_x, size_type start_y,
              size_type end_x, size_type end_y,
-             const grid_t &grid) const;
-    // Reset all nodes' additional attributes.
-    void ResetGrid(const grid_t &grid) const;
+             const grid_t &grid, context_t &context) const;
+    // The same on any grid read as Grid is, e.g. a ChunkedGrid with a
+    // SparseSearchContext<OpenList, Stats>.
+    template <class AnyGrid, class AnyContext>
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const AnyGrid &grid, AnyContext &context) const {
+        BasicAStarSearch<Heuristic, Diagonal, OpenList, Stats,
+                         AnyGrid, AnyContext>
+            search(*this, start_x, start_y, end_x, end_y, grid, context);
+        search.Step(size_type(-1));
+        return search.path();
+    }
+    // Start the query, to be searched a slice at a time, see
+    // BasicAStarSearch.
+    psearch_t
+    StartSearch(size_type start_x, size_type start_y,
+                size_type end_x, size_type end_y,
+                const grid_t &grid, context_t &context) const {
+        return psearch_t(new search_t(*this, start_x, start_y, end_x, end_y,
+                                      grid, context));
+    }
+
+    int weight() const { return weight_; }
+    const Heuristic &heuristic() const { return heuristic_; }
 
 private:
-    poption_t op_;
+    int weight_;
+    Heuristic heuristic_;
+};
+
+// How far a search advanced a slice at a time has gone.
+enum SearchStatus {
+    kSearchInProgress,
+    kSearchFound,
+    kSearchFailed
+};
+
+/**
+ * One query of a BasicAStarFinder, searched a slice at a time, e.g. one
+ * per frame: each Step() expands a number of cells, or for a while, and
+ * the open list stays in the context for the next one.
+ *
+ * The search reads the grid and keeps its state in the context until it
+ * is over; neither may be changed or used by another query in between.
+ * A search is dropped at any time by no longer stepping it.
+ *
+ * The grid and the context are Grid and BasicSearchContext unless
+ * given, e.g. a ChunkedGrid and a SparseSearchContext.
+ */
+template <class Heuristic, class Diagonal, class OpenList, class Stats,
+          class GridT, class Context>
+class BasicAStarSearch {
+public:
+    typedef BasicAStarFinder<Heuristic, Diagonal, OpenList, Stats> finder_t;
+    typedef typename finder_t::size_type size_type;
+    typedef GridT grid_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef Context context_t;
+    typedef boost::chrono::steady_clock clock_t;
+
+    // Start the query, with only the start cell queued.
+    BasicAStarSearch(const finder_t &finder,
+                     size_type start_x, size_type start_y,
+                     size_type end_x, size_type end_y,
+                     const grid_t &grid, context_t &context);
+
+    // Search on until the goal is reached or the open list runs out, or
+    // `max_expansions` more cells were expanded, or the deadline passed,
+    // which is read every 64 expansions.
+    SearchStatus Step(size_type max_expansions) {
+        return StepUntil(max_expansions, NoDeadline());
+    }
+    SearchStatus Step(size_type max_expansions,
+                      clock_t::time_point deadline) {
+        return StepUntil(max_expansions, SteadyDeadline(deadline));
+    }
+    // Search on for about `budget`.
+    SearchStatus StepFor(boost::chrono::microseconds budget) {
+        return Step(size_type(-1), clock_t::now() + budget);
+    }
+
+    SearchStatus status() const { return status_; }
+    // The path once found, else empty.
+    const pnode_vector_t &path() const { return path_; }
+
+private:
+    // See Step(), a Deadline being NoDeadline or SteadyDeadline.
+    template <class Deadline>
+    SearchStatus StepUntil(size_type max_expansions,
+                           const Deadline &deadline);
+
+    int weight_;
+    Heuristic heuristic_;
+    const grid_t *grid_;
+    context_t *context_;
+    size_type end_x_;
+    size_type end_y_;
+    size_type end_;
+    SearchStatus status_;
+    pnode_vector_t path_;
 };
 
-AStarFinder::pnode_vector_t
-AStarFinder::FindPath(
+template <class Heuristic, class Diagonal, class OpenList, class Stats,
+          class GridT, class Context>
+BasicAStarSearch<Heuristic, Diagonal, OpenList, Stats, GridT, Context>::
+BasicAStarSearch(
+        const finder_t &finder,
         size_type start_x, size_type start_y,
         size_type end_x, size_type end_y,
-        const grid_t &grid) const {
-    pnode_t pstart_node = grid.GetNodeAt(start_x, start_y),
-            pend_node = grid.GetNodeAt(end_x, end_y);
-    bool allow_diagonal = op_->allow_diagonal,
-         dont_cross_corners = op_->dont_cross_corners;
+        const grid_t &grid, context_t &context)
+        : weight_(finder.weight()), heuristic_(finder.heuristic()),
+          grid_(&grid), context_(&context), end_x_(end_x), end_y_(end_y),
+          end_(grid.IndexAt(end_x, end_y)), status_(kSearchInProgress) {
+    typedef typename Stats::Scope scope_t;
+    size_type start = grid.IndexAt(start_x, start_y);
 
-    node_t::heap_t open_list;
+    context.Prepare(grid.size());
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        status_ = kSearchFailed;
+        return;
+    }
+    Stats &stats = context.stats();
 
     // push the start node into the open list
-    pstart_node->opened = true;
-    pstart_node->handle = open_list.push(pstart_node);
+    typename context_t::State &start_state = context.Touch(start);
+    start_state.opened = true;
+    {
+        scope_t scope(stats, kHeapPhase);
+        context.open_list().Push(start, 0, start_state.handle);
+    }
+    stats.Push();
+}
+
+template <class Heuristic, class Diagonal, class OpenList, class Stats,
+          class GridT, class Context>
+template <class Deadline>
+SearchStatus BasicAStarSearch<Heuristic, Diagonal, OpenList, Stats, GridT,
+                              Context>::StepUntil(
+        size_type max_expansions, const Deadline &deadline) {
+    typedef typename context_t::State state_t;
+    typedef typename Stats::Scope scope_t;
+    if (status_ != kSearchInProgress) {
+        return status_;
+    }
+    const grid_t &grid = *grid_;
+    context_t &context = *context_;
+    OpenList &open_list = context.open_list();
+    Stats &stats = context.stats();
 
-    pnode_t pnode;
+    NeighborBuffer neighbors;
     size_type x = 0, y = 0;
     int ng = 0;
     // while the open list is not empty
-    while (!open_list.empty()) {
+    for (size_type count = 0; !open_list.Empty(); ++count) {
+        if (count >= max_expansions ||
+                (count % 64 == 0 && deadline.Passed())) {
+            return status_;
+        }
         // pop the position of node which has the minimum `f` value.
-        pnode = open_list.top();
-        open_list.pop();
-        pnode->closed = true;
+        size_type index = 0;
+        {
+            scope_t scope(stats, kHeapPhase);
+            index = open_list.Pop();
+        }
+        state_t &state = context.Touch(index);
+        state.closed = true;
+        stats.Expand();
 
         // if reached the end position, construct the path and return it
-        if (pnode == pend_node) {
-            return Backtrace<grid_t>(pend_node);
+        if (index == end_) {
+            scope_t scope(stats, kBacktracePhase);
+            path_ = Backtrace(grid, context, end_);
+            status_ = kSearchFound;
+            return status_;
         }
 
         // get neigbours of the current node
-        pnode_vector_t neighbors = grid.GetNeighbors(
-            pnode, allow_diagonal, dont_cross_corners);
-        BOOST_FOREACH(pnode_t &neighbor, *neighbors) {
-            if (neighbor->closed) {
+        grid.CoordsOf(index, x, y);
+        {
+            scope_t scope(stats, kNeighborPhase);
+            grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+        }
+        stats.Generate(neighbors.size);
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            size_type neighbor_index = neighbors.index[i];
+            unsigned dir = neighbors.dir[i];
+            state_t &neighbor_state = context.Touch(neighbor_index);
+            if (neighbor_state.closed) {
+                stats.RejectClosed();
                 continue;
             }
 
-            x = neighbor->x;
-            y = neighbor->y;
-
             // get the distance between current node and the neighbor
             // and calculate the next g score
-            ng = pnode->g + ((x - pnode->x == 0 || y - pnode->y == 0) ? 10 : 14);
+            ng = state.g + (dir < 4 ? 10 : 14);
 
             // check if the neighbor has not been inspected yet, or
             // can be reached with smaller cost from the current node
-            if (!neighbor->opened || ng < neighbor->g) {
-                neighbor->g = ng;
-                if (neighbor->h == 0) {
-                    neighbor->h = op_->weight * op_->heuristic(10 * (x - end_x),
-                                                               10 * (y - end_y));
+            if (!neighbor_state.opened || ng < neighbor_state.g) {
+                neighbor_state.g = ng;
+                if (!neighbor_state.opened) {
+                    const DirectionOffset &o = OffsetOf(dir);
+                    int dx = int(x) + o.dx - int(end_x_),
+                        dy = int(y) + o.dy - int(end_y_);
+                    neighbor_state.h = weight_ *
+                        heuristic_(10 * dx, 10 * dy);
                 }
-                neighbor->f = neighbor->g + neighbor->h;
-                neighbor->parent = pnode;
+                neighbor_state.f = neighbor_state.g + neighbor_state.h;
+                neighbor_state.parent = index;
 
-                if (!neighbor->opened) {
-                    neighbor->opened = true;
-                    neighbor->handle = open_list.push(neighbor);
+                scope_t scope(stats, kHeapPhase);
+                if (!neighbor_state.opened) {
+                    neighbor_state.opened = true;
+                    open_list.Push(neighbor_index, neighbor_state.f,
+                                   neighbor_state.handle);
+                    stats.Push();
                 } else {
                     // the neighbor can be reached with smaller cost.
                     // Since its f value has been updated, we have to
                     // update its position in the open list
-                    open_list.update(neighbor->handle);
+                    open_list.Update(neighbor_state.handle, neighbor_index,
+                                     neighbor_state.f);
+                    stats.Update();
                 }
             }  // end for each neighbor
         }  // end while not open list empty
     }
 
     // fail to find the path
-    return pnode_vector_t();
+    status_ = kSearchFailed;
+    return status_;
 }
 
-void AStarFinder::ResetGrid(const grid_t &grid) const {
-    const pnode_grid_t &nodes = grid.nodes();
-    size_type w = grid.width(), h = grid.height();
-    for (size_type i = 0; i < h; ++i) {
-        for (size_type j = 0; j < w; ++j) {
-            (*nodes)[i][j]->Reset();
-        }
+template <class Heuristic, class Diagonal, class OpenList, class Stats>
+typename BasicAStarFinder<Heuristic, Diagonal, OpenList, Stats>::pnode_vector_t
+BasicAStarFinder<Heuristic, Diagonal, OpenList, Stats>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    search_t search(*this, start_x, start_y, end_x, end_y, grid, context);
+    search.Step(size_type(-1));
+    return search.path();
+}
+
+/**
+ * A search of AStarFinder, whatever BasicAStarSearch it runs, see
+ * AStarFinder::StartSearch().
+ */
+class AStarSearch {
+public:
+    typedef std::size_t size_type;
+    typedef Grid<BaseNode<size_type> >::pnode_vector_t pnode_vector_t;
+    typedef boost::chrono::steady_clock clock_t;
+
+    virtual ~AStarSearch() {}
+
+    // See BasicAStarSearch::Step().
+    virtual SearchStatus Step(size_type max_expansions) = 0;
+    virtual SearchStatus Step(size_type max_expansions,
+                              clock_t::time_point deadline) = 0;
+    SearchStatus StepFor(boost::chrono::microseconds budget) {
+        return Step(size_type(-1), clock_t::now() + budget);
     }
+    virtual SearchStatus status() const = 0;
+    virtual const pnode_vector_t &path() const = 0;
+};
+
+/**
+ * A* configured at runtime by FinderOption.
+ *
+ * Each query is dispatched to the BasicAStarFinder specialized for the
+ * movement mode and, if it is one of core/heuristic.hpp, the heuristic
+ * of the option; any other heuristic is called through the
+ * boost::function.
+ */
+class AStarFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef grid_t::pnode_t pnode_t;
+    typedef grid_t::node_vector_t node_vector_t;
+    typedef grid_t::pnode_vector_t pnode_vector_t;
+    typedef SearchContext context_t;
+    typedef boost::shared_ptr<FinderOption> poption_t;
+    typedef boost::shared_ptr<AStarSearch> psearch_t;
+
+    AStarFinder(poption_t op = poption_t())
+        : op_(op ? op : DefaultOption()) {}
+    inline FinderOption &Option() {
+        return *op_;
+    }
+    const FinderOption &Option() const {
+        return *op_;
+    }
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    // The open list and statistics policies are the ones of the context
+    // type.
+    template <class OpenList, class Stats>
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid,
+             BasicSearchContext<OpenList, Stats> &context) const {
+        FindVisitor<BasicSearchContext<OpenList, Stats> > visitor(
+            start_x, start_y, end_x, end_y, grid, context);
+        return Dispatch(op_->heuristic, visitor);
+    }
+    // Search with the finder's own context, which keeps the state of the
+    // last query until the next one (see Context()).
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid) const {
+        return FindPath(start_x, start_y, end_x, end_y, grid, context_);
+    }
+
+    // Start the query, to be searched a slice at a time by the caller,
+    // e.g. once per frame, see BasicAStarSearch. The search keeps the
+    // option as it is now; the grid and the context are its own until it
+    // is over.
+    template <class OpenList, class Stats>
+    psearch_t
+    StartSearch(size_type start_x, size_type start_y,
+                size_type end_x, size_type end_y,
+                const grid_t &grid,
+                BasicSearchContext<OpenList, Stats> &context) const {
+        StartVisitor<BasicSearchContext<OpenList, Stats> > visitor(
+            start_x, start_y, end_x, end_y, grid, context);
+        // a copy, as the heuristics bound to it are only pointers
+        visitor.heuristic.reset(new FinderOption::heuristic_t(op_->heuristic));
+        return Dispatch(*visitor.heuristic, visitor);
+    }
+    // Search with the finder's own context (see Context()).
+    psearch_t
+    StartSearch(size_type start_x, size_type start_y,
+                size_type end_x, size_type end_y,
+                const grid_t &grid) const {
+        return StartSearch(start_x, start_y, end_x, end_y, grid, context_);
+    }
+
+    // The finder's own context, e.g. to show the opened and closed nodes.
+    const context_t &Context() const { return context_; }
+    // Forget the state of the last query.
+    // It is no longer required between queries.
+    void ResetGrid(const grid_t &grid) const {
+        context_.Prepare(grid.size());
+    }
+
+private:
+    // An AStarSearch running `Search`, which keeps `keep` alive.
+    template <class Search>
+    class SearchOf : public AStarSearch {
+    public:
+        SearchOf(const Search &search, boost::shared_ptr<const void> keep)
+            : search_(search), keep_(keep) {}
+        SearchStatus Step(size_type max_expansions) {
+            return search_.Step(max_expansions);
+        }
+        SearchStatus Step(size_type max_expansions,
+                          clock_t::time_point deadline) {
+            return search_.Step(max_expansions, deadline);
+        }
+        SearchStatus status() const { return search_.status(); }
+        const pnode_vector_t &path() const { return search_.path(); }
+
+    private:
+        Search search_;
+        boost::shared_ptr<const void> keep_;
+    };
+
+    // A query, and what to do with the BasicAStarFinder that Dispatch()
+    // picks for it.
+    template <class Context>
+    struct Query {
+        typedef Context context_t;
+        Query(size_type start_x, size_type start_y,
+              size_type end_x, size_type end_y,
+              const grid_t &grid, Context &context)
+            : start_x(start_x), start_y(start_y), end_x(end_x), end_y(end_y),
+              grid(&grid), context(&context) {}
+        size_type start_x, start_y, end_x, end_y;
+        const grid_t *grid;
+        Context *context;
+    };
+    template <class Context>
+    struct FindVisitor : Query<Context> {
+        typedef pnode_vector_t result_type;
+        FindVisitor(size_type start_x, size_type start_y,
+                    size_type end_x, size_type end_y,
+                    const grid_t &grid, Context &context)
+            : Query<Context>(start_x, start_y, end_x, end_y, grid, context) {}
+        template <class Finder>
+        result_type operator()(const Finder &finder) const {
+            return finder.FindPath(this->start_x, this->start_y,
+                                   this->end_x, this->end_y,
+                                   *this->grid, *this->context);
+        }
+    };
+    template <class Context>
+    struct StartVisitor : Query<Context> {
+        typedef psearch_t result_type;
+        StartVisitor(size_type start_x, size_type start_y,
+                     size_type end_x, size_type end_y,
+                     const grid_t &grid, Context &context)
+            : Query<Context>(start_x, start_y, end_x, end_y, grid, context) {}
+        template <class Finder>
+        result_type operator()(const Finder &finder) const {
+            typedef typename Finder::search_t search_t;
+            return psearch_t(new SearchOf<search_t>(
+                search_t(finder, this->start_x, this->start_y,
+                         this->end_x, this->end_y,
+                         *this->grid, *this->context),
+                heuristic));
+        }
+        boost::shared_ptr<const FinderOption::heuristic_t> heuristic;
+    };
+
+    // What to do with the heuristic DispatchHeuristic() picks.
+    template <class Visitor>
+    struct HeuristicVisitor {
+        typedef typename Visitor::result_type result_type;
+        HeuristicVisitor(const AStarFinder &finder, const Visitor &visitor)
+            : finder(&finder), visitor(&visitor) {}
+        template <class Heuristic>
+        result_type operator()(const Heuristic &heuristic) const {
+            return finder->DispatchWith(heuristic, *visitor);
+        }
+        const AStarFinder *finder;
+        const Visitor *visitor;
+    };
+
+    // Call `visitor` with the BasicAStarFinder of the option, with
+    // `heuristic` in place of the option's.
+    template <class Visitor>
+    typename Visitor::result_type
+    Dispatch(const FinderOption::heuristic_t &heuristic,
+             const Visitor &visitor) const;
+    template <class Heuristic, class Visitor>
+    typename Visitor::result_type
+    DispatchWith(const Heuristic &heuristic, const Visitor &visitor) const;
+
+    poption_t op_;
+    mutable context_t context_;
+};
+
+template <class Visitor>
+typename Visitor::result_type
+AStarFinder::Dispatch(const FinderOption::heuristic_t &h,
+                      const Visitor &visitor) const {
+    const grid_t &grid = *visitor.grid;
+    return DispatchHeuristic(h, visitor.end_x, visitor.end_y,
+        grid.width(), grid.height(),
+        ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners),
+        HeuristicVisitor<Visitor>(*this, visitor));
 }
 
+template <class Heuristic, class Visitor>
+typename Visitor::result_type
+AStarFinder::DispatchWith(const Heuristic &heuristic,
+                          const Visitor &visitor) const {
+    typedef typename Visitor::context_t::open_list_t OpenList;
+    typedef typename Visitor::context_t::stats_t Stats;
+    switch (ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners)) {
+    case kDiagonalIfAtMostOneObstacle:
+        return visitor(BasicAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalIfAtMostOneObstacle>,
+                OpenList, Stats>(op_->weight, heuristic));
+    case kDiagonalOnlyWhenNoObstacles:
+        return visitor(BasicAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalOnlyWhenNoObstacles>,
+                OpenList, Stats>(op_->weight, heuristic));
+    default:
+        return visitor(BasicAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalNever>, OpenList, Stats>(
+            op_->weight, heuristic));
+    }
+}
 
 #endif // FINDERS_ASTARFINDER_HPP_
@@ -0,0 +1,245 @@
+#ifndef FINDERS_ASYNCFINDER_HPP_
+#define FINDERS_ASYNCFINDER_HPP_
+
+#include <cstddef>
+#include <vector>
+#include "boost/atomic.hpp"
+#include "boost/bind.hpp"
+#include "boost/function.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/future.hpp"
+#include "core/executor.hpp"
+#include "astarfinder.hpp"
+#include "batchfinder.hpp"
+
+/**
+ * The cancellation of a query, shared by the copies of the token: the
+ * caller keeps one and cancels it, e.g. once the goal of the agent has
+ * changed, and the search of the query reads another.
+ */
+class CancellationToken {
+public:
+    CancellationToken() : cancelled_(new boost::atomic<bool>(false)) {}
+
+    void Cancel() const {
+        cancelled_->store(true, boost::memory_order_relaxed);
+    }
+    bool IsCancelled() const {
+        return cancelled_->load(boost::memory_order_relaxed);
+    }
+
+private:
+    boost::shared_ptr<boost::atomic<bool> > cancelled_;
+};
+
+enum PathStatus {
+    kPathFound,
+    kPathNotFound,
+    kPathCancelled
+};
+
+// The expansions between two reads of the token by the stepped searches.
+const std::size_t kCancelCheckExpansions = 256;
+
+/*
+ * Find the path of `query` into `path` unless `token` is cancelled.
+ *
+ * A finder that can be stepped, the A* ones, reads the token every
+ * kCancelCheckExpansions expansions and drops its search once it is
+ * cancelled; any other one only reads it before it starts.
+ */
+template <class Finder>
+PathStatus FindPathUnlessCancelled(
+        const Finder &finder, const PathQuery &query,
+        const typename Finder::grid_t &grid,
+        typename Finder::context_t &context, const CancellationToken &token,
+        typename Finder::pnode_vector_t &path) {
+    if (token.IsCancelled()) {
+        return kPathCancelled;
+    }
+    path = finder.FindPath(query.start_x, query.start_y,
+                           query.end_x, query.end_y, grid, context);
+    return path ? kPathFound : kPathNotFound;
+}
+
+namespace asyncfinder_detail {
+
+template <class PSearch, class PNodeVector>
+PathStatus StepUntilCancelled(const PSearch &search,
+                              const CancellationToken &token,
+                              PNodeVector &path) {
+    SearchStatus status = search->status();
+    while (status == kSearchInProgress) {
+        if (token.IsCancelled()) {
+            return kPathCancelled;
+        }
+        status = search->Step(kCancelCheckExpansions);
+    }
+    path = search->path();
+    return status == kSearchFound ? kPathFound : kPathNotFound;
+}
+
+}  // asyncfinder_detail
+
+template <class Heuristic, class Diagonal, class OpenList, class Stats>
+PathStatus FindPathUnlessCancelled(
+        const BasicAStarFinder<Heuristic, Diagonal, OpenList, Stats> &finder,
+        const PathQuery &query,
+        const typename BasicAStarFinder<Heuristic, Diagonal, OpenList,
+                                        Stats>::grid_t &grid,
+        BasicSearchContext<OpenList, Stats> &context,
+        const CancellationToken &token,
+        typename BasicAStarFinder<Heuristic, Diagonal, OpenList,
+                                  Stats>::pnode_vector_t &path) {
+    if (token.IsCancelled()) {
+        return kPathCancelled;
+    }
+    return asyncfinder_detail::StepUntilCancelled(
+        finder.StartSearch(query.start_x, query.start_y,
+                           query.end_x, query.end_y, grid, context),
+        token, path);
+}
+
+inline PathStatus FindPathUnlessCancelled(
+        const AStarFinder &finder, const PathQuery &query,
+        const AStarFinder::grid_t &grid, AStarFinder::context_t &context,
+        const CancellationToken &token, AStarFinder::pnode_vector_t &path) {
+    if (token.IsCancelled()) {
+        return kPathCancelled;
+    }
+    return asyncfinder_detail::StepUntilCancelled(
+        finder.StartSearch(query.start_x, query.start_y,
+                           query.end_x, query.end_y, grid, context),
+        token, path);
+}
+
+/**
+ * Run queries without blocking the caller, on a BoundedExecutor: each
+ * query comes back through a future or a callback, and is dropped as
+ * soon as its token is cancelled (see FindPathUnlessCancelled()).
+ *
+ * Each worker searches with a context of its own. The grid of a query
+ * is only read, and must not change until the query is over.
+ *
+ * @tparam Finder     any finder with FindPath(..., grid, context) const,
+ *                    e.g. AStarFinder or BasicJumpPointFinder<...>
+ */
+template <class Finder>
+class AsyncFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef typename Finder::grid_t grid_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef typename Finder::context_t context_t;
+
+    struct Result {
+        PathStatus status;
+        // empty unless found
+        pnode_vector_t path;
+    };
+    // shared, so that it is copied, e.g. into a std::vector
+    typedef boost::shared_future<Result> future_t;
+    // callback(result), called on the worker, it must not throw
+    typedef boost::function<void (const Result &)> callback_t;
+
+    // `workers` 0 is one per hardware thread, and at most `capacity`
+    // queries wait for one.
+    explicit AsyncFinder(const Finder &finder = Finder(), unsigned workers = 0,
+                         size_type capacity = 1024);
+
+    // Queue the query, waiting for room if the queue is full.
+    future_t Submit(const PathQuery &query, const grid_t &grid,
+                    const CancellationToken &token = CancellationToken());
+    void Submit(const PathQuery &query, const grid_t &grid,
+                const CancellationToken &token, const callback_t &callback);
+    // Queue the query, or return false if the queue is full.
+    bool TrySubmit(const PathQuery &query, const grid_t &grid,
+                   const CancellationToken &token, future_t &future);
+    bool TrySubmit(const PathQuery &query, const grid_t &grid,
+                   const CancellationToken &token, const callback_t &callback);
+
+    unsigned workers() const { return executor_.workers(); }
+    size_type queued() const { return executor_.queued(); }
+
+private:
+    typedef boost::shared_ptr<boost::promise<Result> > ppromise_t;
+
+    static void Fulfill(const ppromise_t &promise, const Result &result) {
+        promise->set_value(result);
+    }
+    void FindOne(const PathQuery &query, const grid_t *grid,
+                 const CancellationToken &token, const callback_t &callback,
+                 unsigned worker);
+
+    Finder finder_;
+    std::vector<boost::shared_ptr<context_t> > contexts_;
+    // the last member: its workers stop before the rest goes
+    BoundedExecutor executor_;
+};
+
+template <class Finder>
+AsyncFinder<Finder>::AsyncFinder(const Finder &finder, unsigned workers,
+                                 size_type capacity)
+        : finder_(finder), executor_(workers, capacity) {
+    // the contexts of the workers are only read once a query is queued
+    for (unsigned i = 0; i < executor_.workers(); ++i) {
+        contexts_.push_back(boost::shared_ptr<context_t>(new context_t));
+    }
+}
+
+template <class Finder>
+typename AsyncFinder<Finder>::future_t
+AsyncFinder<Finder>::Submit(const PathQuery &query, const grid_t &grid,
+                            const CancellationToken &token) {
+    ppromise_t promise(new boost::promise<Result>);
+    // taken before a worker may fulfill the promise
+    future_t future = promise->get_future().share();
+    Submit(query, grid, token, boost::bind(&AsyncFinder::Fulfill, promise, _1));
+    return future;
+}
+
+template <class Finder>
+void AsyncFinder<Finder>::Submit(const PathQuery &query, const grid_t &grid,
+        const CancellationToken &token, const callback_t &callback) {
+    executor_.Submit(boost::bind(&AsyncFinder::FindOne, this,
+                                 query, &grid, token, callback, _1));
+}
+
+template <class Finder>
+bool AsyncFinder<Finder>::TrySubmit(const PathQuery &query,
+        const grid_t &grid, const CancellationToken &token,
+        future_t &future) {
+    ppromise_t promise(new boost::promise<Result>);
+    future_t taken = promise->get_future().share();
+    if (!TrySubmit(query, grid, token,
+                   boost::bind(&AsyncFinder::Fulfill, promise, _1))) {
+        return false;
+    }
+    future = taken;
+    return true;
+}
+
+template <class Finder>
+bool AsyncFinder<Finder>::TrySubmit(const PathQuery &query,
+        const grid_t &grid, const CancellationToken &token,
+        const callback_t &callback) {
+    return executor_.TrySubmit(boost::bind(&AsyncFinder::FindOne, this,
+                                           query, &grid, token, callback, _1));
+}
+
+template <class Finder>
+void AsyncFinder<Finder>::FindOne(const PathQuery &query, const grid_t *grid,
+        const CancellationToken &token, const callback_t &callback,
+        unsigned worker) {
+    Result result;
+    result.status = FindPathUnlessCancelled(finder_, query, *grid,
+                                            *contexts_[worker], token,
+                                            result.path);
+    if (result.status != kPathFound) {
+        result.path = pnode_vector_t();
+    }
+    callback(result);
+}
+
+#endif // FINDERS_ASYNCFINDER_HPP_
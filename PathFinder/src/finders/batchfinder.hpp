@@ -0,0 +1,208 @@
+#ifndef FINDERS_BATCHFINDER_HPP_
+#define FINDERS_BATCHFINDER_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/atomic.hpp"
+#include "boost/bind.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "core/workpool.hpp"
+
+// One query of a batch.
+struct PathQuery {
+    typedef std::size_t size_type;
+    size_type start_x;
+    size_type start_y;
+    size_type end_x;
+    size_type end_y;
+};
+
+/**
+ * The paths of a batch, one after the other in one buffer allocated ahead
+ * of the batch. Once the arena has grown to fit the paths of a batch, it
+ * stores the ones of the next batches without allocating.
+ *
+ * The workers store their paths concurrently, each one taking its slice
+ * of the buffer by one compare-and-swap.
+ */
+template <class Node>
+class PathArena : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef Node *pnode_t;
+    typedef const pnode_t *const_iterator;
+
+    explicit PathArena(size_type capacity = 0)
+        : nodes_(capacity), used_(0) {}
+
+    // Forget the paths, and make room for the ones of `count` queries.
+    void Reset(size_type count) {
+        Span none = {0, 0};
+        spans_.assign(count, none);
+        used_.store(0, boost::memory_order_relaxed);
+    }
+    // Grow the buffer to `capacity` nodes, keeping the paths.
+    // Not while paths are stored.
+    void Reserve(size_type capacity) {
+        if (nodes_.size() < capacity) {
+            nodes_.resize(capacity);
+        }
+    }
+    // Store the path of the query `i`, or return false if it does not
+    // fit, the arena being left as it was.
+    template <class NodeVector>
+    bool Store(size_type i, const NodeVector &path);
+
+    // The number of queries.
+    size_type size() const { return spans_.size(); }
+    // Whether a path was found for the query `i`.
+    bool Found(size_type i) const { return spans_[i].size > 0; }
+    // The nodes of the path of the query `i`, from its start.
+    const_iterator begin(size_type i) const {
+        return nodes_.empty() ? 0 : &nodes_[0] + spans_[i].offset;
+    }
+    const_iterator end(size_type i) const {
+        return begin(i) + spans_[i].size;
+    }
+    size_type PathSize(size_type i) const { return spans_[i].size; }
+    // The nodes the buffer holds, and the ones the paths take up.
+    size_type capacity() const { return nodes_.size(); }
+    size_type used() const { return used_.load(boost::memory_order_relaxed); }
+
+private:
+    struct Span {
+        size_type offset;
+        size_type size;
+    };
+
+    std::vector<pnode_t> nodes_;
+    std::vector<Span> spans_;
+    boost::atomic<size_type> used_;
+};
+
+template <class Node>
+template <class NodeVector>
+bool PathArena<Node>::Store(size_type i, const NodeVector &path) {
+    size_type size = path.size();
+    size_type offset = used_.load(boost::memory_order_relaxed);
+    do {
+        if (size > nodes_.size() - offset) {
+            return false;
+        }
+    } while (!used_.compare_exchange_weak(offset, offset + size,
+                                          boost::memory_order_relaxed));
+    std::copy(path.begin(), path.end(), nodes_.begin() + offset);
+    spans_[i].offset = offset;
+    spans_[i].size = size;
+    return true;
+}
+
+/**
+ * Run the queries of a batch on one grid over a WorkStealingPool. Each
+ * worker searches with a context of its own, and the grid is only read.
+ *
+ * The paths go to a PathArena. The ones that did not fit are kept aside
+ * by their worker, and stored once the arena has grown after the batch,
+ * so the arena passed in for every batch soon fits them all.
+ *
+ * @tparam Finder     any finder with FindPath(..., grid, context) const,
+ *                    e.g. AStarFinder or BasicJumpPointFinder<...>
+ */
+template <class Finder>
+class BatchFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef typename Finder::grid_t grid_t;
+    typedef typename grid_t::node_t node_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef typename Finder::context_t context_t;
+    typedef PathArena<node_t> arena_t;
+
+    // `workers` 0 is one per hardware thread.
+    explicit BatchFinder(const Finder &finder = Finder(), unsigned workers = 0);
+
+    // Find the path of every query of `batch` into `paths`.
+    void FindPaths(const std::vector<PathQuery> &batch, const grid_t &grid,
+                   arena_t &paths);
+    // The same into the finder's own arena, valid until the next batch.
+    const arena_t &FindPaths(const std::vector<PathQuery> &batch,
+                             const grid_t &grid) {
+        FindPaths(batch, grid, paths_);
+        return paths_;
+    }
+    unsigned workers() const { return pool_.workers(); }
+
+private:
+    typedef std::vector<std::pair<size_type, pnode_vector_t> > overflow_t;
+
+    void FindOne(unsigned worker, size_type i);
+
+    Finder finder_;
+    WorkStealingPool pool_;
+    std::vector<boost::shared_ptr<context_t> > contexts_;
+    std::vector<overflow_t> overflows_;
+    arena_t paths_;
+    // the batch being run
+    const std::vector<PathQuery> *batch_;
+    const grid_t *grid_;
+    arena_t *arena_;
+};
+
+template <class Finder>
+BatchFinder<Finder>::BatchFinder(const Finder &finder, unsigned workers)
+        : finder_(finder), pool_(workers), batch_(0), grid_(0), arena_(0) {
+    for (unsigned i = 0; i < pool_.workers(); ++i) {
+        contexts_.push_back(boost::shared_ptr<context_t>(new context_t));
+    }
+    overflows_.resize(pool_.workers());
+}
+
+template <class Finder>
+void BatchFinder<Finder>::FindPaths(const std::vector<PathQuery> &batch,
+        const grid_t &grid, arena_t &paths) {
+    batch_ = &batch;
+    grid_ = &grid;
+    arena_ = &paths;
+    paths.Reset(batch.size());
+    pool_.Run(batch.size(), boost::bind(&BatchFinder::FindOne, this, _1, _2));
+
+    // grow the arena for the paths left over, with room to spare for the
+    // next batches
+    size_type needed = paths.used();
+    for (std::size_t w = 0; w < overflows_.size(); ++w) {
+        for (std::size_t i = 0; i < overflows_[w].size(); ++i) {
+            needed += overflows_[w][i].second->size();
+        }
+    }
+    if (needed > paths.capacity()) {
+        paths.Reserve(std::max(needed, 2 * paths.capacity()));
+    }
+    for (std::size_t w = 0; w < overflows_.size(); ++w) {
+        for (std::size_t i = 0; i < overflows_[w].size(); ++i) {
+            bool stored = paths.Store(overflows_[w][i].first,
+                                      *overflows_[w][i].second);
+            BOOST_ASSERT(stored);
+            (void)stored;
+        }
+        overflows_[w].clear();
+    }
+    batch_ = 0;
+    grid_ = 0;
+    arena_ = 0;
+}
+
+template <class Finder>
+void BatchFinder<Finder>::FindOne(unsigned worker, size_type i) {
+    const PathQuery &query = (*batch_)[i];
+    pnode_vector_t path = finder_.FindPath(query.start_x, query.start_y,
+        query.end_x, query.end_y, *grid_, *contexts_[worker]);
+    if (path && !arena_->Store(i, *path)) {
+        overflows_[worker].push_back(std::make_pair(i, path));
+    }
+}
+
+#endif // FINDERS_BATCHFINDER_HPP_
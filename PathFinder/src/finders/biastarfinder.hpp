@@ -0,0 +1,487 @@
+#ifndef FINDERS_BIASTARFINDER_HPP_
+#define FINDERS_BIASTARFINDER_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include "boost/assert.hpp"
+#include "boost/atomic.hpp"
+#include "boost/bind.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/ref.hpp"
+#include "boost/scoped_array.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/thread/thread.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "option.hpp"
+#include "searchcontext.hpp"
+
+/**
+ * The search state of a bidirectional query: one BasicSearchContext per
+ * direction, and the g values each direction publishes for the other one
+ * when they run on two threads.
+ *
+ * A published value is stamped with the generation of the query, as the
+ * records of BasicSearchContext, so starting a query is O(1).
+ */
+template <class OpenList>
+class BasicBiSearchContext : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BasicSearchContext<OpenList> side_t;
+
+    enum Side { kForward = 0, kBackward = 1 };
+    static const int kUnreached = INT_MAX;
+
+    BasicBiSearchContext() : capacity_(0), generation_(0) {}
+
+    // Start a new query over a grid of `size` cells, `shared` if the two
+    // sides are going to run on two threads.
+    void Prepare(size_type size, bool shared);
+
+    side_t &side(int side) { return sides_[side]; }
+    const side_t &side(int side) const { return sides_[side]; }
+
+    // Make the g of the cell known to the other side.
+    //
+    // Both are sequentially consistent: a side publishes a cell, then
+    // reads what the other side published for it. With weaker orders
+    // both sides may read before the other's store shows, and miss the
+    // meeting.
+    void Publish(int side, size_type index, int g) {
+        published_[side][index].store(
+            boost::uint64_t(generation_) << 32 | boost::uint32_t(g));
+    }
+    // The g the side published for the cell, or kUnreached.
+    int Published(int side, size_type index) const {
+        boost::uint64_t value = published_[side][index].load();
+        return boost::uint32_t(value >> 32) == generation_
+            ? int(boost::uint32_t(value)) : kUnreached;
+    }
+
+private:
+    typedef boost::atomic<boost::uint64_t> published_t;
+
+    side_t sides_[2];
+    boost::scoped_array<published_t> published_[2];
+    size_type capacity_;
+    boost::uint32_t generation_;
+};
+
+typedef BasicBiSearchContext<DefaultOpenList> BiSearchContext;
+
+template <class OpenList>
+void BasicBiSearchContext<OpenList>::Prepare(size_type size, bool shared) {
+    sides_[kForward].Prepare(size);
+    sides_[kBackward].Prepare(size);
+    if (!shared) {
+        return;
+    }
+    if (capacity_ < size) {
+        for (int s = 0; s < 2; ++s) {
+            published_[s].reset(new published_t[size]);
+            for (size_type i = 0; i < size; ++i) {
+                published_[s][i].store(0, boost::memory_order_relaxed);
+            }
+        }
+        capacity_ = size;
+    }
+    if (++generation_ == 0) {
+        // wrapped around: values of the old queries may look current again
+        for (int s = 0; s < 2; ++s) {
+            for (size_type i = 0; i < capacity_; ++i) {
+                published_[s][i].store(0, boost::memory_order_relaxed);
+            }
+        }
+        generation_ = 1;
+    }
+}
+
+/**
+ * Bidirectional A*: one A* from the start towards the end and one from
+ * the end towards the start, the cost of a move being the same both ways.
+ *
+ * Every time a side reaches a cell the other side has reached, the sum of
+ * their g values is a path cost, and the lowest one is kept as the best
+ * meeting. A side stops when the f value it pops is not below it: with a
+ * consistent heuristic no cheaper path is left then, so the path of the
+ * best meeting is a shortest one (with weight 1).
+ *
+ * In parallel mode the backward side runs on a second thread. The sides
+ * publish their g values to each other through the context, and the best
+ * meeting is one lock-free word holding the cost and the cell.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ * @tparam OpenList       open list policy, see openlist.hpp
+ */
+template <class Heuristic,
+          class Diagonal = DiagonalPolicy<kDiagonalNever>,
+          class OpenList = DefaultOpenList>
+class BasicBiAStarFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef BasicBiSearchContext<OpenList> context_t;
+
+    explicit BasicBiAStarFinder(bool parallel = false, int weight = 1,
+                                const Heuristic &heuristic = Heuristic())
+        : parallel_(parallel), weight_(weight), heuristic_(heuristic),
+          backward_heuristic_(heuristic) {}
+    // The backward side with a heuristic of its own, for the ones bound
+    // to a goal (see GoalHeuristic): `heuristic` towards the end, and
+    // `backward_heuristic` towards the start.
+    BasicBiAStarFinder(bool parallel, int weight, const Heuristic &heuristic,
+                       const Heuristic &backward_heuristic)
+        : parallel_(parallel), weight_(weight), heuristic_(heuristic),
+          backward_heuristic_(backward_heuristic) {}
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+
+private:
+    typedef BasicSearchContext<OpenList> side_context_t;
+    typedef typename side_context_t::State state_t;
+    // the cost of the best meeting in the high half, its cell in the low
+    typedef boost::atomic<boost::uint64_t> meeting_t;
+
+    static const boost::uint64_t kNoMeeting = ~boost::uint64_t(0);
+
+    static boost::uint32_t MeetingCost(boost::uint64_t meeting) {
+        return boost::uint32_t(meeting >> 32);
+    }
+    static void Meet(meeting_t &best, int cost, size_type index) {
+        boost::uint64_t meeting =
+            boost::uint64_t(cost) << 32 | boost::uint32_t(index);
+        boost::uint64_t current = best.load(boost::memory_order_relaxed);
+        while (meeting < current &&
+               !best.compare_exchange_weak(current, meeting)) {
+        }
+    }
+
+    // Open the root of a side.
+    void Open(context_t &context, int side, size_type index,
+              bool shared) const;
+    // Expand one cell of a side. Return false when the side is done.
+    template <bool kShared>
+    bool Step(const grid_t &grid, context_t &context, int side,
+              size_type target_x, size_type target_y, meeting_t &best) const;
+    // Expand a side until it or the other one is done.
+    void RunSide(const grid_t *grid, context_t *context, int side,
+                 size_type target_x, size_type target_y,
+                 meeting_t *best, boost::atomic<bool> *done) const;
+
+    bool parallel_;
+    int weight_;
+    Heuristic heuristic_;
+    Heuristic backward_heuristic_;
+};
+
+template <class Heuristic, class Diagonal, class OpenList>
+typename BasicBiAStarFinder<Heuristic, Diagonal, OpenList>::pnode_vector_t
+BasicBiAStarFinder<Heuristic, Diagonal, OpenList>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    BOOST_ASSERT_MSG(grid.size() <= 0xFFFFFFFFu,
+                     "Oops, FindPath() on a grid too large to meet on.");
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y);
+
+    context.Prepare(grid.size(), parallel_);
+    Open(context, context_t::kForward, start, parallel_);
+    if (start == end) {
+        return Backtrace(grid, context.side(context_t::kForward), start);
+    }
+    // the backward side would leave a blocked end, A* never enters it
+    if (!grid.IsWalkableAt(end_x, end_y)) {
+        return pnode_vector_t();
+    }
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+    Open(context, context_t::kBackward, end, parallel_);
+
+    meeting_t best(kNoMeeting);
+    if (parallel_) {
+        // A side that runs out of cells has met the root of the other one,
+        // unless that is a blocked start it could not enter. So the start
+        // is expanded first, and its neighbors are published before the
+        // backward side runs.
+        Step<true>(grid, context, context_t::kForward, end_x, end_y, best);
+        boost::atomic<bool> done(false);
+        boost::thread backward(boost::bind(
+            &BasicBiAStarFinder::RunSide, this, &grid, &context,
+            int(context_t::kBackward), start_x, start_y, &best, &done));
+        RunSide(&grid, &context, context_t::kForward, end_x, end_y,
+                &best, &done);
+        backward.join();
+    } else {
+        // take turns, until either side is done
+        while (Step<false>(grid, context, context_t::kForward,
+                           end_x, end_y, best) &&
+               Step<false>(grid, context, context_t::kBackward,
+                           start_x, start_y, best)) {
+        }
+    }
+
+    boost::uint64_t meeting = best.load();
+    if (meeting == kNoMeeting) {
+        // fail to find the path
+        return pnode_vector_t();
+    }
+    // the forward path to the meeting cell, then the backward path from it
+    size_type index = size_type(boost::uint32_t(meeting));
+    pnode_vector_t path =
+        Backtrace(grid, context.side(context_t::kForward), index);
+    pnode_vector_t back =
+        Backtrace(grid, context.side(context_t::kBackward), index);
+    path->insert(path->end(), back->rbegin() + 1, back->rend());
+    return path;
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+void BasicBiAStarFinder<Heuristic, Diagonal, OpenList>::Open(
+        context_t &context, int side, size_type index, bool shared) const {
+    side_context_t &self = context.side(side);
+    state_t &state = self.Touch(index);
+    state.opened = true;
+    self.open_list().Push(index, 0, state.handle);
+    // published before the threads start, so each side always sees the
+    // root of the other one
+    if (shared) {
+        context.Publish(side, index, 0);
+    }
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+template <bool kShared>
+bool BasicBiAStarFinder<Heuristic, Diagonal, OpenList>::Step(
+        const grid_t &grid, context_t &context, int side,
+        size_type target_x, size_type target_y, meeting_t &best) const {
+    side_context_t &self = context.side(side),
+                   &other = context.side(1 - side);
+    OpenList &open_list = self.open_list();
+    const Heuristic &heuristic =
+        side == context_t::kForward ? heuristic_ : backward_heuristic_;
+    if (open_list.Empty()) {
+        return false;
+    }
+    // pop the position of node which has the minimum `f` value.
+    size_type index = open_list.Pop();
+    state_t &state = self.Touch(index);
+    state.closed = true;
+    // no path through the rest of the open list is cheaper
+    if (boost::uint32_t(state.f) >=
+            MeetingCost(best.load(boost::memory_order_relaxed))) {
+        return false;
+    }
+
+    NeighborBuffer neighbors;
+    size_type x = 0, y = 0;
+    grid.CoordsOf(index, x, y);
+    grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+    for (unsigned i = 0; i < neighbors.size; ++i) {
+        size_type neighbor_index = neighbors.index[i];
+        unsigned dir = neighbors.dir[i];
+        state_t &neighbor_state = self.Touch(neighbor_index);
+        if (neighbor_state.closed) {
+            continue;
+        }
+        int ng = state.g + (dir < 4 ? 10 : 14);
+        if (neighbor_state.opened && ng >= neighbor_state.g) {
+            continue;
+        }
+
+        neighbor_state.g = ng;
+        if (!neighbor_state.opened) {
+            const DirectionOffset &o = OffsetOf(dir);
+            int dx = int(x) + o.dx - int(target_x),
+                dy = int(y) + o.dy - int(target_y);
+            neighbor_state.h = weight_ * heuristic(10 * dx, 10 * dy);
+        }
+        neighbor_state.f = neighbor_state.g + neighbor_state.h;
+        neighbor_state.parent = index;
+        if (!neighbor_state.opened) {
+            neighbor_state.opened = true;
+            open_list.Push(neighbor_index, neighbor_state.f,
+                           neighbor_state.handle);
+        } else {
+            open_list.Update(neighbor_state.handle, neighbor_index,
+                             neighbor_state.f);
+        }
+
+        // meet the other side
+        int other_g = context_t::kUnreached;
+        if (kShared) {
+            context.Publish(side, neighbor_index, ng);
+            other_g = context.Published(1 - side, neighbor_index);
+        } else if (other.IsOpened(neighbor_index)) {
+            other_g = other.Find(neighbor_index)->g;
+        }
+        if (other_g != context_t::kUnreached) {
+            Meet(best, ng + other_g, neighbor_index);
+        }
+    }
+    return true;
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+void BasicBiAStarFinder<Heuristic, Diagonal, OpenList>::RunSide(
+        const grid_t *grid, context_t *context, int side,
+        size_type target_x, size_type target_y,
+        meeting_t *best, boost::atomic<bool> *done) const {
+    while (!done->load(boost::memory_order_relaxed) &&
+           Step<true>(*grid, *context, side, target_x, target_y, *best)) {
+    }
+    // Either side alone proves the best meeting is the shortest path
+    // once it is done.
+    done->store(true, boost::memory_order_relaxed);
+}
+
+/**
+ * Bidirectional A* configured at runtime by FinderOption, dispatched as
+ * AStarFinder does.
+ */
+class BiAStarFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef grid_t::pnode_t pnode_t;
+    typedef grid_t::node_vector_t node_vector_t;
+    typedef grid_t::pnode_vector_t pnode_vector_t;
+    typedef BiSearchContext context_t;
+    typedef boost::shared_ptr<FinderOption> poption_t;
+
+    // In `parallel` mode each query runs its backward side on a thread
+    // of its own.
+    BiAStarFinder(poption_t op = poption_t(), bool parallel = false)
+        : op_(op ? op : DefaultOption()), parallel_(parallel) {}
+    inline FinderOption &Option() {
+        return *op_;
+    }
+    bool parallel() const { return parallel_; }
+    void set_parallel(bool parallel) { parallel_ = parallel; }
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    template <class OpenList>
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, BasicBiSearchContext<OpenList> &context) const;
+    // Search with the finder's own context.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid) const {
+        return FindPath(start_x, start_y, end_x, end_y, grid, context_);
+    }
+
+private:
+    // A query, searched with the heuristic DispatchHeuristic() picks.
+    template <class OpenList>
+    struct FindVisitor {
+        typedef pnode_vector_t result_type;
+        FindVisitor(const BiAStarFinder &finder,
+                    size_type start_x, size_type start_y,
+                    size_type end_x, size_type end_y,
+                    const grid_t &grid,
+                    BasicBiSearchContext<OpenList> &context)
+            : finder(&finder), start_x(start_x), start_y(start_y),
+              end_x(end_x), end_y(end_y), grid(&grid), context(&context) {}
+        template <class Heuristic>
+        result_type operator()(const Heuristic &heuristic) const {
+            return finder->FindPathWith(heuristic, heuristic,
+                                        start_x, start_y, end_x, end_y,
+                                        *grid, *context);
+        }
+        // A GoalHeuristic bound to the end, bound to the start too for
+        // the backward side.
+        result_type operator()(const FinderOption::heuristic_t &bound) const {
+            const FinderOption &option = *finder->op_;
+            FinderOption::heuristic_t backward =
+                option.heuristic.target<GoalHeuristic>()->heuristic().Bind(
+                    start_x, start_y, grid->width(), grid->height(),
+                    ToDiagonalMovement(option.allow_diagonal,
+                                       option.dont_cross_corners));
+            return finder->FindPathWith(bound, backward,
+                                        start_x, start_y, end_x, end_y,
+                                        *grid, *context);
+        }
+        const BiAStarFinder *finder;
+        size_type start_x, start_y, end_x, end_y;
+        const grid_t *grid;
+        BasicBiSearchContext<OpenList> *context;
+    };
+
+    // Search with `heuristic` towards the end, and `backward_heuristic`
+    // towards the start.
+    template <class Heuristic, class OpenList>
+    pnode_vector_t
+    FindPathWith(const Heuristic &heuristic,
+                 const Heuristic &backward_heuristic,
+                 size_type start_x, size_type start_y,
+                 size_type end_x, size_type end_y,
+                 const grid_t &grid,
+                 BasicBiSearchContext<OpenList> &context) const;
+
+    poption_t op_;
+    bool parallel_;
+    mutable context_t context_;
+};
+
+template <class OpenList>
+BiAStarFinder::pnode_vector_t
+BiAStarFinder::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, BasicBiSearchContext<OpenList> &context) const {
+    return DispatchHeuristic(op_->heuristic, end_x, end_y,
+        grid.width(), grid.height(),
+        ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners),
+        FindVisitor<OpenList>(*this, start_x, start_y, end_x, end_y,
+                              grid, context));
+}
+
+template <class Heuristic, class OpenList>
+BiAStarFinder::pnode_vector_t
+BiAStarFinder::FindPathWith(const Heuristic &heuristic,
+        const Heuristic &backward_heuristic,
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, BasicBiSearchContext<OpenList> &context) const {
+    switch (ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners)) {
+    case kDiagonalIfAtMostOneObstacle:
+        return BasicBiAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalIfAtMostOneObstacle>, OpenList>(
+            parallel_, op_->weight, heuristic, backward_heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    case kDiagonalOnlyWhenNoObstacles:
+        return BasicBiAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalOnlyWhenNoObstacles>, OpenList>(
+            parallel_, op_->weight, heuristic, backward_heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    default:
+        return BasicBiAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalNever>, OpenList>(
+            parallel_, op_->weight, heuristic, backward_heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    }
+}
+
+#endif // FINDERS_BIASTARFINDER_HPP_
@@ -0,0 +1,416 @@
+#ifndef FINDERS_CLUSTERGRAPH_HPP_
+#define FINDERS_CLUSTERGRAPH_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/noncopyable.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "searchcontext.hpp"
+
+// An edge of a ClusterGraph, to the node of the cell `to`.
+struct ClusterEdge {
+    std::size_t to;
+    int cost;
+};
+
+/**
+ * The abstract graph of HPA*: the grid split into square clusters, with
+ * the entrances between neighboring clusters as nodes.
+ *
+ * Along each border, every run of cells walkable on both sides gets one
+ * transition in its middle, or one at each end if it is long. In the
+ * kDiagonalAlways mode a diagonal move that squeezes between two blocks
+ * is a transition of its own, as no straight moves can replace it. A
+ * node has an edge to the node across its transitions, and to the other
+ * nodes of its cluster at the cost of the shortest path in the cluster.
+ *
+ * The graph observes its grid. When a cell flips, only the clusters the
+ * 3x3 neighborhood of the cell overlaps are built again.
+ */
+template <class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class ClusterGraph : public GridObserver, private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    // the context of the searches within one cluster, by local index
+    typedef SearchContext local_context_t;
+
+    typedef ClusterEdge Edge;
+    // An entrance, addressed by its cell index.
+    struct Node {
+        size_type cell;
+        std::vector<Edge> edges;
+    };
+
+    static const size_type kNoCell = size_type(-1);
+    static const int kNoPath = -1;
+
+    // Build the graph of `grid` and observe it until destroyed.
+    ClusterGraph(grid_t &grid, size_type cluster_size = 16);
+    ~ClusterGraph() { grid_.RemoveObserver(this); }
+
+    const grid_t &grid() const { return grid_; }
+    size_type cluster_size() const { return cluster_size_; }
+    size_type clusters() const { return nodes_.size(); }
+    size_type ClusterOf(size_type cell) const {
+        size_type x = 0, y = 0;
+        grid_.CoordsOf(cell, x, y);
+        return y / cluster_size_ * clusters_x_ + x / cluster_size_;
+    }
+    const std::vector<Node> &Nodes(size_type cluster) const {
+        return nodes_[cluster];
+    }
+    // Get the node of the cell, or 0 if it is not an entrance.
+    const Node *FindNode(size_type cell) const;
+    // The number of clusters built since the graph was constructed.
+    size_type builds() const { return builds_; }
+
+    // Search the cluster of `source` from it, for `target` in the same
+    // cluster or, if kNoCell, for every cell of the cluster. Return the
+    // cost to the target, or kNoPath.
+    int SearchCluster(size_type source, size_type target,
+                      local_context_t &context) const;
+    // The cost to the cell found by the last SearchCluster() of
+    // `context`, or kNoPath.
+    int ClusterCost(size_type cell, const local_context_t &context) const;
+    // Append the path found by the last SearchCluster() of `context` to
+    // `path`, from the cell after the source up to `target`.
+    void AppendClusterPath(size_type target, const local_context_t &context,
+                           node_vector_t &path) const;
+
+    // Build the whole graph again.
+    void Rebuild();
+    virtual void OnWalkableChanged(size_type x, size_type y, bool walkable);
+
+private:
+    typedef std::ptrdiff_t coord_t;
+
+    struct Transition {
+        size_type from;
+        size_type to;
+        int cost;
+    };
+
+    // Runs of this length or longer get a transition at each end.
+    enum { kLongRun = 6 };
+
+    size_type LocalIndex(size_type cell) const;
+    void BuildCluster(size_type cluster);
+    // Append the transitions from cluster (cx, cy) to cluster
+    // (cx + dx, cy + dy), one of its eight neighbors.
+    void Transitions(coord_t cx, coord_t cy, int dx, int dy,
+                     std::vector<Transition> &out) const;
+    // Append the transitions across the border whose cells are
+    // (ax, ay) + i * (sx, sy) on one side and (bx, by) + i * (sx, sy) on
+    // the other, for i < length.
+    void BorderTransitions(coord_t ax, coord_t ay, coord_t bx, coord_t by,
+                           coord_t sx, coord_t sy, coord_t length,
+                           std::vector<Transition> &out) const;
+    // Append the diagonal move from (ax, ay) to (bx, by) if it is
+    // allowed while both straight ways around it are blocked.
+    void SqueezeTransition(coord_t ax, coord_t ay, coord_t bx, coord_t by,
+                           std::vector<Transition> &out) const;
+    void AddTransition(coord_t ax, coord_t ay, coord_t bx, coord_t by,
+                       int cost, std::vector<Transition> &out) const;
+
+    grid_t &grid_;
+    size_type cluster_size_;
+    size_type clusters_x_;
+    size_type clusters_y_;
+    std::vector<std::vector<Node> > nodes_;
+    size_type builds_;
+    local_context_t local_;
+};
+
+template <class Diagonal>
+ClusterGraph<Diagonal>::ClusterGraph(grid_t &grid, size_type cluster_size)
+    : grid_(grid), cluster_size_(cluster_size), clusters_x_(0),
+      clusters_y_(0), builds_(0) {
+    if (cluster_size < 2) {
+        throw std::invalid_argument("Cluster size must be at least 2");
+    }
+    Rebuild();
+    grid_.AddObserver(this);
+}
+
+template <class Diagonal>
+const typename ClusterGraph<Diagonal>::Node *
+ClusterGraph<Diagonal>::FindNode(size_type cell) const {
+    const std::vector<Node> &nodes = nodes_[ClusterOf(cell)];
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].cell == cell) {
+            return &nodes[i];
+        }
+    }
+    return 0;
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::Rebuild() {
+    clusters_x_ = (grid_.width() + cluster_size_ - 1) / cluster_size_;
+    clusters_y_ = (grid_.height() + cluster_size_ - 1) / cluster_size_;
+    nodes_.assign(clusters_x_ * clusters_y_, std::vector<Node>());
+    for (size_type cluster = 0; cluster < nodes_.size(); ++cluster) {
+        BuildCluster(cluster);
+    }
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::OnWalkableChanged(size_type x, size_type y,
+                                               bool /*walkable*/) {
+    // The transitions of a border depend on the cells next to it, so
+    // they change only for the clusters the neighborhood overlaps.
+    size_type first_x = x > 0 ? x - 1 : 0, first_y = y > 0 ? y - 1 : 0,
+              last_x = std::min(x + 1, grid_.width() - 1),
+              last_y = std::min(y + 1, grid_.height() - 1);
+    for (size_type cy = first_y / cluster_size_;
+            cy <= last_y / cluster_size_; ++cy) {
+        for (size_type cx = first_x / cluster_size_;
+                cx <= last_x / cluster_size_; ++cx) {
+            BuildCluster(cy * clusters_x_ + cx);
+        }
+    }
+}
+
+template <class Diagonal>
+typename ClusterGraph<Diagonal>::size_type
+ClusterGraph<Diagonal>::LocalIndex(size_type cell) const {
+    size_type x = 0, y = 0;
+    grid_.CoordsOf(cell, x, y);
+    return y % cluster_size_ * cluster_size_ + x % cluster_size_;
+}
+
+template <class Diagonal>
+int ClusterGraph<Diagonal>::SearchCluster(size_type source, size_type target,
+                                          local_context_t &context) const {
+    typedef local_context_t::State state_t;
+    size_type sx = 0, sy = 0, tx = 0, ty = 0;
+    grid_.CoordsOf(source, sx, sy);
+    if (target != kNoCell) {
+        grid_.CoordsOf(target, tx, ty);
+    }
+    size_type x0 = sx - sx % cluster_size_, y0 = sy - sy % cluster_size_,
+              x1 = std::min(x0 + cluster_size_, grid_.width()),
+              y1 = std::min(y0 + cluster_size_, grid_.height());
+    BOOST_ASSERT(target == kNoCell || (tx >= x0 && tx < x1 &&
+                                       ty >= y0 && ty < y1));
+
+    context.Prepare(cluster_size_ * cluster_size_);
+    DefaultOpenList &open_list = context.open_list();
+    size_type source_local = LocalIndex(source);
+    state_t &source_state = context.Touch(source_local);
+    source_state.opened = true;
+    open_list.Push(source_local, 0, source_state.handle);
+
+    heuristic::Octile octile;
+    NeighborBuffer neighbors;
+    while (!open_list.Empty()) {
+        size_type local = open_list.Pop();
+        state_t &state = context.Touch(local);
+        state.closed = true;
+        size_type x = x0 + local % cluster_size_,
+                  y = y0 + local / cluster_size_;
+        if (target != kNoCell && x == tx && y == ty) {
+            return state.g;
+        }
+
+        grid_.GetNeighbors(x, y, Diagonal::movement, neighbors);
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            const DirectionOffset &o = OffsetOf(neighbors.dir[i]);
+            size_type nx = x + o.dx, ny = y + o.dy;
+            if (nx < x0 || nx >= x1 || ny < y0 || ny >= y1) {
+                continue;
+            }
+            size_type neighbor_local = (ny - y0) * cluster_size_ + (nx - x0);
+            state_t &neighbor_state = context.Touch(neighbor_local);
+            if (neighbor_state.closed) {
+                continue;
+            }
+            int ng = state.g + (neighbors.dir[i] < 4 ? 10 : 14);
+            if (!neighbor_state.opened || ng < neighbor_state.g) {
+                neighbor_state.g = ng;
+                if (!neighbor_state.opened && target != kNoCell) {
+                    neighbor_state.h = octile(10 * (int(nx) - int(tx)),
+                                              10 * (int(ny) - int(ty)));
+                }
+                neighbor_state.f = neighbor_state.g + neighbor_state.h;
+                neighbor_state.parent = local;
+                if (!neighbor_state.opened) {
+                    neighbor_state.opened = true;
+                    open_list.Push(neighbor_local, neighbor_state.f,
+                                   neighbor_state.handle);
+                } else {
+                    open_list.Update(neighbor_state.handle, neighbor_local,
+                                     neighbor_state.f);
+                }
+            }
+        }
+    }
+    return kNoPath;
+}
+
+template <class Diagonal>
+int ClusterGraph<Diagonal>::ClusterCost(
+        size_type cell, const local_context_t &context) const {
+    const local_context_t::State *state = context.Find(LocalIndex(cell));
+    return state && state->closed ? state->g : int(kNoPath);
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::AppendClusterPath(
+        size_type target, const local_context_t &context,
+        node_vector_t &path) const {
+    size_type x = 0, y = 0;
+    grid_.CoordsOf(target, x, y);
+    size_type x0 = x - x % cluster_size_, y0 = y - y % cluster_size_;
+    std::size_t first = path.size();
+    for (size_type local = LocalIndex(target);
+            context.Parent(local) != local_context_t::kNoParent;
+            local = context.Parent(local)) {
+        path.push_back(grid_.GetNodeAt(x0 + local % cluster_size_,
+                                       y0 + local / cluster_size_));
+    }
+    std::reverse(path.begin() + first, path.end());
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::BuildCluster(size_type cluster) {
+    ++builds_;
+    std::vector<Node> &nodes = nodes_[cluster];
+    nodes.clear();
+    coord_t cx = coord_t(cluster % clusters_x_),
+            cy = coord_t(cluster / clusters_x_);
+
+    // the transitions to the neighbors
+    std::vector<Transition> transitions;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            if ((dx != 0 || dy != 0) &&
+                    cx + dx >= 0 && cx + dx < coord_t(clusters_x_) &&
+                    cy + dy >= 0 && cy + dy < coord_t(clusters_y_)) {
+                Transitions(cx, cy, dx, dy, transitions);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < transitions.size(); ++i) {
+        std::size_t n = 0;
+        while (n < nodes.size() && nodes[n].cell != transitions[i].from) {
+            ++n;
+        }
+        if (n == nodes.size()) {
+            nodes.push_back(Node());
+            nodes.back().cell = transitions[i].from;
+        }
+        Edge edge = {transitions[i].to, transitions[i].cost};
+        nodes[n].edges.push_back(edge);
+    }
+
+    // the paths within the cluster, the same both ways
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        SearchCluster(nodes[i].cell, kNoCell, local_);
+        for (std::size_t j = i + 1; j < nodes.size(); ++j) {
+            int cost = ClusterCost(nodes[j].cell, local_);
+            if (cost != kNoPath) {
+                Edge there = {nodes[j].cell, cost},
+                     back = {nodes[i].cell, cost};
+                nodes[i].edges.push_back(there);
+                nodes[j].edges.push_back(back);
+            }
+        }
+    }
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::Transitions(coord_t cx, coord_t cy,
+                                         int dx, int dy,
+                                         std::vector<Transition> &out) const {
+    // Found from the cluster above, or to the left on the same row, so
+    // that both clusters of a border agree on its transitions.
+    if (dy < 0 || (dy == 0 && dx < 0)) {
+        std::size_t first = out.size();
+        Transitions(cx + dx, cy + dy, -dx, -dy, out);
+        for (std::size_t i = first; i < out.size(); ++i) {
+            std::swap(out[i].from, out[i].to);
+        }
+        return;
+    }
+    coord_t s = coord_t(cluster_size_),
+            x0 = cx * s, y0 = cy * s,
+            x1 = std::min(x0 + s, coord_t(grid_.width())),
+            y1 = std::min(y0 + s, coord_t(grid_.height()));
+    if (dy == 0) {
+        // the right border
+        BorderTransitions(x1 - 1, y0, x1, y0, 0, 1, y1 - y0, out);
+    } else if (dx == 0) {
+        // the bottom border
+        BorderTransitions(x0, y1 - 1, x0, y1, 1, 0, x1 - x0, out);
+    } else if (dx > 0) {
+        SqueezeTransition(x1 - 1, y1 - 1, x1, y1, out);
+    } else {
+        SqueezeTransition(x0, y1 - 1, x0 - 1, y1, out);
+    }
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::BorderTransitions(
+        coord_t ax, coord_t ay, coord_t bx, coord_t by,
+        coord_t sx, coord_t sy, coord_t length,
+        std::vector<Transition> &out) const {
+    coord_t run = -1;
+    for (coord_t i = 0; i <= length; ++i) {
+        bool open = i < length &&
+                    grid_.IsWalkableAt(ax + i * sx, ay + i * sy) &&
+                    grid_.IsWalkableAt(bx + i * sx, by + i * sy);
+        if (open && run < 0) {
+            run = i;
+        } else if (!open && run >= 0) {
+            if (i - run < kLongRun) {
+                coord_t mid = (run + i - 1) / 2;
+                AddTransition(ax + mid * sx, ay + mid * sy,
+                              bx + mid * sx, by + mid * sy, 10, out);
+            } else {
+                AddTransition(ax + run * sx, ay + run * sy,
+                              bx + run * sx, by + run * sy, 10, out);
+                AddTransition(ax + (i - 1) * sx, ay + (i - 1) * sy,
+                              bx + (i - 1) * sx, by + (i - 1) * sy, 10, out);
+            }
+            run = -1;
+        }
+        if (i + 1 < length) {
+            SqueezeTransition(ax + i * sx, ay + i * sy,
+                              bx + (i + 1) * sx, by + (i + 1) * sy, out);
+            SqueezeTransition(ax + (i + 1) * sx, ay + (i + 1) * sy,
+                              bx + i * sx, by + i * sy, out);
+        }
+    }
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::SqueezeTransition(
+        coord_t ax, coord_t ay, coord_t bx, coord_t by,
+        std::vector<Transition> &out) const {
+    if (Diagonal::movement != kDiagonalAlways ||
+            !grid_.IsWalkableAt(ax, ay) || !grid_.IsWalkableAt(bx, by) ||
+            grid_.IsWalkableAt(ax, by) || grid_.IsWalkableAt(bx, ay)) {
+        return;
+    }
+    AddTransition(ax, ay, bx, by, 14, out);
+}
+
+template <class Diagonal>
+void ClusterGraph<Diagonal>::AddTransition(
+        coord_t ax, coord_t ay, coord_t bx, coord_t by, int cost,
+        std::vector<Transition> &out) const {
+    Transition transition = {grid_.IndexAt(ax, ay), grid_.IndexAt(bx, by),
+                             cost};
+    out.push_back(transition);
+}
+
+#endif // FINDERS_CLUSTERGRAPH_HPP_
@@ -0,0 +1,478 @@
+#ifndef FINDERS_COOPERATIVEFINDER_HPP_
+#define FINDERS_COOPERATIVEFINDER_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <deque>
+#include <utility>
+#include <vector>
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/unordered_map.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "batchfinder.hpp"
+#include "openlist.hpp"
+#include "reservationtable.hpp"
+#include "searchcontext.hpp"
+
+/**
+ * The distances to one goal, the other agents aside: the abstract
+ * heuristic of cooperative A*.
+ *
+ * It is a search from the goal towards the first cell asked, the origin;
+ * the moves being the same both ways, it finds the distance of each cell
+ * it closes. A cell asked that is not closed yet resumes the search
+ * until it is, so the cells around the ways of the agents to the goal are
+ * only searched once, however many ask. The cells searched are hashed,
+ * so that a goal takes memory for them only, not for the grid.
+ */
+template <class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class ReverseResumableDistance : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+
+    static const int kUnreachable = INT_MAX;
+
+    ReverseResumableDistance(const grid_t &grid,
+                             size_type goal_x, size_type goal_y,
+                             size_type origin_x, size_type origin_y);
+
+    // The cost of a shortest path from (x, y) to the goal, or kUnreachable.
+    int Distance(size_type x, size_type y);
+    // The cells closed so far.
+    size_type expanded() const { return expanded_; }
+
+private:
+    struct State {
+        size_type cell;
+        int g;
+        int f;
+        bool closed;
+        DefaultOpenList::handle_type handle;
+    };
+
+    // Queue `cell` at `g`, unless it is closed or queued at less.
+    void Visit(size_type cell, int g);
+
+    const grid_t *grid_;
+    size_type goal_x_;
+    size_type goal_y_;
+    size_type origin_x_;
+    size_type origin_y_;
+    // the states stay at their address for the handles of the open list
+    std::deque<State> states_;
+    boost::unordered_map<size_type, size_type> state_of_;
+    DefaultOpenList open_list_;
+    size_type expanded_;
+};
+
+template <class Diagonal>
+ReverseResumableDistance<Diagonal>::ReverseResumableDistance(
+        const grid_t &grid, size_type goal_x, size_type goal_y,
+        size_type origin_x, size_type origin_y)
+        : grid_(&grid), goal_x_(goal_x), goal_y_(goal_y),
+          origin_x_(origin_x), origin_y_(origin_y), expanded_(0) {
+    Visit(grid.IndexAt(goal_x, goal_y), 0);
+}
+
+template <class Diagonal>
+int ReverseResumableDistance<Diagonal>::Distance(size_type x, size_type y) {
+    const grid_t &grid = *grid_;
+    size_type target = grid.IndexAt(x, y);
+    boost::unordered_map<size_type, size_type>::const_iterator it =
+        state_of_.find(target);
+    if (it != state_of_.end() && states_[it->second].closed) {
+        return states_[it->second].g;
+    }
+    if (!grid.IsReachable(x, y, goal_x_, goal_y_, Diagonal::movement)) {
+        return kUnreachable;
+    }
+
+    // the heuristic to the origin is consistent, so a cell closed has its
+    // distance, whatever cell the search is resumed for
+    NeighborBuffer neighbors;
+    size_type cx = 0, cy = 0;
+    while (!open_list_.Empty()) {
+        State &state = states_[open_list_.Pop()];
+        state.closed = true;
+        ++expanded_;
+
+        grid.CoordsOf(state.cell, cx, cy);
+        grid.GetNeighbors(cx, cy, Diagonal::movement, neighbors);
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            Visit(neighbors.index[i],
+                  state.g + (neighbors.dir[i] < 4 ? 10 : 14));
+        }
+        if (state.cell == target) {
+            return state.g;
+        }
+    }
+    return kUnreachable;
+}
+
+template <class Diagonal>
+void ReverseResumableDistance<Diagonal>::Visit(size_type cell, int g) {
+    std::pair<boost::unordered_map<size_type, size_type>::iterator, bool>
+        inserted = state_of_.insert(std::make_pair(cell, states_.size()));
+    if (inserted.second) {
+        size_type x = 0, y = 0;
+        grid_->CoordsOf(cell, x, y);
+        int h = heuristic::Octile()(10 * (int(x) - int(origin_x_)),
+                                    10 * (int(y) - int(origin_y_)));
+        State state = {cell, g, g + h, false, 0};
+        states_.push_back(state);
+        open_list_.Push(states_.size() - 1, state.f, states_.back().handle);
+        return;
+    }
+    State &state = states_[inserted.first->second];
+    if (state.closed || g >= state.g) {
+        return;
+    }
+    state.f -= state.g - g;
+    state.g = g;
+    open_list_.Update(state.handle, inserted.first->second, state.f);
+}
+
+/**
+ * Windowed hierarchical cooperative A* (WHCA*): the agents sharing a grid
+ * are planned one after the other, each one in space and time around the
+ * cells the ones before it hold, so that no two of them are in one cell
+ * at once nor swap their cells.
+ *
+ * Each pass plans every agent of a batch over the next `window` steps,
+ * by A* on (cell, time) with the moves of GetNeighbors() and waiting,
+ * up to the end of the window, where the distance to the goal left is
+ * the one of a ReverseResumableDistance: the window keeps the search
+ * small, and the agents follow their plans for part of it before the
+ * next pass. The distances to a goal are kept from pass to pass while
+ * some agent heads to it. A step costs 10 or 14 and waiting 10, but at
+ * the goal where it is free.
+ *
+ * The agents on their way go first, in the order of the batch, then the
+ * ones at their goals, which step aside for them; it is up to the caller
+ * to change the order over the passes, e.g. to let a blocked agent
+ * through. An agent that cannot move within the window waits in its
+ * cell; if an agent planned before it runs through that cell, the cell
+ * is held for the whole window and the agents from the first one that
+ * ran through it on are planned again, the ones before keeping their
+ * plans, so that no two agents ever share a cell. stuck() tells the
+ * agents left waiting.
+ *
+ * @tparam Diagonal       DiagonalPolicy<...>
+ */
+template <class Diagonal = DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> >
+class BasicCooperativeFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef PathArena<node_t> arena_t;
+    typedef ReverseResumableDistance<Diagonal> distance_t;
+
+    explicit BasicCooperativeFinder(unsigned window = 16)
+        : window_(window), grid_(0), pass_(0), expanded_(0), searched_(0) {}
+
+    // Plan the agents of `agents`, by their start and goal, into `paths`:
+    // the cells of each one at the times 0 to window(), the first one
+    // being its start. The grid must not change between passes unless
+    // ResetGrid() is called.
+    void PlanWindow(const std::vector<PathQuery> &agents, const grid_t &grid,
+                    arena_t &paths);
+    // The same into the finder's own arena, valid until the next pass.
+    const arena_t &PlanWindow(const std::vector<PathQuery> &agents,
+                              const grid_t &grid) {
+        PlanWindow(agents, grid, paths_);
+        return paths_;
+    }
+    // Forget the distances to the goals, e.g. once the grid changed.
+    void ResetGrid() { distances_.clear(); }
+
+    unsigned window() const { return window_; }
+    // Whether the agent `agent` of the last pass found no plan, and waits.
+    bool stuck(size_type agent) const { return stuck_[agent]; }
+    // The cells held by the agents of the last pass.
+    const ReservationTable &reservations() const { return reservations_; }
+    // The (cell, time) states expanded by the last pass.
+    size_type expanded() const { return expanded_; }
+    // The agents searched by the last pass, the ones planned again
+    // counted each time.
+    size_type searched() const { return searched_; }
+
+private:
+    struct State {
+        size_type cell;
+        unsigned t;
+        int g;
+        int f;
+        size_type parent;
+        bool closed;
+        DefaultOpenList::handle_type handle;
+    };
+    struct Goal {
+        boost::shared_ptr<distance_t> distance;
+        // the last pass an agent headed to it
+        unsigned long pass;
+    };
+    static const size_type kNoParent = size_type(-1);
+
+    // Plan every agent into plans_, in order_.
+    void PlanAll(const std::vector<PathQuery> &agents);
+    distance_t &DistanceTo(const PathQuery &query);
+    // Plan `agent` into path_, or return false and leave it waiting.
+    bool PlanAgent(unsigned agent, const PathQuery &query);
+    void Visit(size_type parent, size_type cell, unsigned t, int g, int h);
+
+    unsigned window_;
+    const grid_t *grid_;
+    ReservationTable reservations_;
+    boost::unordered_map<size_type, Goal> distances_;
+    unsigned long pass_;
+    // the states of the search of one agent, which stay at their address
+    // for the handles of the open list
+    std::deque<State> states_;
+    boost::unordered_map<boost::uint64_t, size_type> state_of_;
+    DefaultOpenList open_list_;
+    std::vector<size_type> path_;
+    std::vector<pnode_t> nodes_;
+    // the agents in the order they are planned, and the place of each one
+    // in it
+    std::vector<unsigned> order_;
+    std::vector<size_type> place_;
+    // the cells of each agent at the times 0 to window_
+    std::vector<size_type> plans_;
+    // the agents waiting in their cells for the whole window
+    std::vector<bool> pinned_;
+    std::vector<bool> stuck_;
+    size_type expanded_;
+    size_type searched_;
+    arena_t paths_;
+};
+
+template <class Diagonal>
+void BasicCooperativeFinder<Diagonal>::PlanWindow(
+        const std::vector<PathQuery> &agents, const grid_t &grid,
+        arena_t &paths) {
+    if (grid_ != &grid) {
+        distances_.clear();
+        grid_ = &grid;
+    }
+    ++pass_;
+    expanded_ = 0;
+    searched_ = 0;
+    PlanAll(agents);
+
+    paths.Reset(agents.size());
+    paths.Reserve(agents.size() * (window_ + 1));
+    for (std::size_t i = 0; i < agents.size(); ++i) {
+        nodes_.clear();
+        for (unsigned t = 0; t <= window_; ++t) {
+            nodes_.push_back(grid.GetNodeAt(plans_[i * (window_ + 1) + t]));
+        }
+        bool stored = paths.Store(i, nodes_);
+        BOOST_ASSERT(stored);
+        (void)stored;
+    }
+
+    // forget the goals no agent heads to any more
+    typename boost::unordered_map<size_type, Goal>::iterator it =
+        distances_.begin();
+    while (it != distances_.end()) {
+        if (it->second.pass != pass_) {
+            it = distances_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+template <class Diagonal>
+void BasicCooperativeFinder<Diagonal>::PlanAll(
+        const std::vector<PathQuery> &agents) {
+    const grid_t &grid = *grid_;
+    const unsigned steps = window_ + 1;
+    reservations_.Reset(grid.size());
+    plans_.resize(agents.size() * steps);
+    pinned_.assign(agents.size(), false);
+    stuck_.assign(agents.size(), false);
+
+    // the agents on their way first, then the ones at their goals, which
+    // step aside for them
+    order_.clear();
+    place_.resize(agents.size());
+    for (int arrived = 0; arrived < 2; ++arrived) {
+        for (std::size_t i = 0; i < agents.size(); ++i) {
+            const PathQuery &agent = agents[i];
+            if ((agent.start_x == agent.end_x &&
+                 agent.start_y == agent.end_y) == bool(arrived)) {
+                place_[i] = order_.size();
+                order_.push_back(unsigned(i));
+            }
+        }
+    }
+    // every agent holds its start at time 0, so that no one swaps with it
+    for (std::size_t i = 0; i < agents.size(); ++i) {
+        reservations_.Reserve(
+            grid.IndexAt(agents[i].start_x, agents[i].start_y), 0,
+            unsigned(i));
+    }
+
+    size_type next = 0;
+    while (next < order_.size()) {
+        unsigned i = order_[next];
+        const PathQuery &agent = agents[i];
+        size_type start = grid.IndexAt(agent.start_x, agent.start_y);
+        if (pinned_[i]) {
+            path_.assign(steps, start);
+            stuck_[i] = true;
+        } else {
+            ++searched_;
+            if (!PlanAgent(i, agent)) {
+                stuck_[i] = true;
+                // the first agent planned that runs into it
+                size_type first = next;
+                for (unsigned t = 1; t <= window_; ++t) {
+                    unsigned holder = reservations_.At(start, t);
+                    if (holder != ReservationTable::kNoAgent) {
+                        first = std::min(first, place_[holder]);
+                    }
+                }
+                if (first < next) {
+                    // hold the cell for the whole window, and plan again
+                    // the agents from that one on
+                    for (size_type p = first; p < next; ++p) {
+                        unsigned other = order_[p];
+                        if (pinned_[other]) {
+                            continue;
+                        }
+                        for (unsigned t = 1; t <= window_; ++t) {
+                            reservations_.Release(
+                                plans_[other * steps + t], t, other);
+                        }
+                        stuck_[other] = false;
+                    }
+                    pinned_[i] = true;
+                    for (unsigned t = 1; t <= window_; ++t) {
+                        reservations_.Reserve(start, t, i);
+                    }
+                    next = first;
+                    continue;
+                }
+            }
+        }
+        for (unsigned t = 0; t <= window_; ++t) {
+            bool held = reservations_.Reserve(path_[t], t, i);
+            BOOST_ASSERT(held);
+            (void)held;
+            plans_[i * steps + t] = path_[t];
+        }
+        ++next;
+    }
+}
+
+template <class Diagonal>
+typename BasicCooperativeFinder<Diagonal>::distance_t &
+BasicCooperativeFinder<Diagonal>::DistanceTo(const PathQuery &query) {
+    Goal &goal = distances_[grid_->IndexAt(query.end_x, query.end_y)];
+    if (!goal.distance) {
+        goal.distance.reset(new distance_t(*grid_, query.end_x, query.end_y,
+                                           query.start_x, query.start_y));
+    }
+    goal.pass = pass_;
+    return *goal.distance;
+}
+
+template <class Diagonal>
+bool BasicCooperativeFinder<Diagonal>::PlanAgent(unsigned agent,
+                                                 const PathQuery &query) {
+    const grid_t &grid = *grid_;
+    size_type start = grid.IndexAt(query.start_x, query.start_y),
+              goal = grid.IndexAt(query.end_x, query.end_y);
+    path_.assign(window_ + 1, start);
+    if (!grid.IsReachable(query.start_x, query.start_y,
+                          query.end_x, query.end_y, Diagonal::movement)) {
+        return false;
+    }
+    distance_t &distance = DistanceTo(query);
+
+    states_.clear();
+    state_of_.clear();
+    open_list_.Clear();
+    Visit(kNoParent, start, 0, 0,
+          distance.Distance(query.start_x, query.start_y));
+
+    NeighborBuffer neighbors;
+    size_type x = 0, y = 0;
+    while (!open_list_.Empty()) {
+        size_type id = open_list_.Pop();
+        State &state = states_[id];
+        state.closed = true;
+        ++expanded_;
+        if (state.t == window_) {
+            for (size_type i = id; i != kNoParent; i = states_[i].parent) {
+                path_[states_[i].t] = states_[i].cell;
+            }
+            return true;
+        }
+
+        grid.CoordsOf(state.cell, x, y);
+        grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+        // waiting, then the moves
+        if (reservations_.CanMove(state.cell, state.cell, state.t, agent)) {
+            Visit(id, state.cell, state.t + 1,
+                  state.g + (state.cell == goal ? 0 : 10),
+                  distance.Distance(x, y));
+        }
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            size_type neighbor_index = neighbors.index[i];
+            unsigned dir = neighbors.dir[i];
+            if (!reservations_.CanMove(state.cell, neighbor_index, state.t,
+                                       agent)) {
+                continue;
+            }
+            const DirectionOffset &o = OffsetOf(dir);
+            Visit(id, neighbor_index, state.t + 1,
+                  state.g + (dir < 4 ? 10 : 14),
+                  distance.Distance(x + o.dx, y + o.dy));
+        }
+    }
+    // boxed in for the whole window
+    return false;
+}
+
+template <class Diagonal>
+void BasicCooperativeFinder<Diagonal>::Visit(size_type parent, size_type cell,
+                                             unsigned t, int g, int h) {
+    if (h == distance_t::kUnreachable) {
+        return;
+    }
+    boost::uint64_t key = boost::uint64_t(t) * grid_->size() + cell;
+    typename boost::unordered_map<boost::uint64_t, size_type>::iterator it =
+        state_of_.find(key);
+    if (it == state_of_.end()) {
+        State state = {cell, t, g, g + h, parent, false, 0};
+        states_.push_back(state);
+        size_type id = states_.size() - 1;
+        state_of_[key] = id;
+        open_list_.Push(id, state.f, states_.back().handle);
+        return;
+    }
+    State &state = states_[it->second];
+    if (state.closed || g >= state.g) {
+        return;
+    }
+    state.g = g;
+    state.f = g + h;
+    state.parent = parent;
+    open_list_.Update(state.handle, it->second, state.f);
+}
+
+typedef BasicCooperativeFinder<> CooperativeFinder;
+
+#endif // FINDERS_COOPERATIVEFINDER_HPP_
@@ -0,0 +1,25 @@
+#ifndef FINDERS_DEADLINE_HPP_
+#define FINDERS_DEADLINE_HPP_
+
+#include "boost/chrono.hpp"
+
+// The end of a slice of a search, e.g. of BasicAStarSearch::Step(): a
+// NoDeadline never passes, and the clock is not even linked; a
+// SteadyDeadline reads it unless it is the max.
+struct NoDeadline {
+    bool Passed() const { return false; }
+};
+
+class SteadyDeadline {
+public:
+    typedef boost::chrono::steady_clock clock_t;
+    explicit SteadyDeadline(clock_t::time_point at)
+        : at_(at), timed_(at != (clock_t::time_point::max)()) {}
+    bool Passed() const { return timed_ && clock_t::now() >= at_; }
+
+private:
+    clock_t::time_point at_;
+    bool timed_;
+};
+
+#endif // FINDERS_DEADLINE_HPP_
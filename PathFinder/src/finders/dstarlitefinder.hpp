@@ -0,0 +1,414 @@
+#ifndef FINDERS_DSTARLITEFINDER_HPP_
+#define FINDERS_DSTARLITEFINDER_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+
+/**
+ * D* Lite: a search from the goal kept between the queries on one grid,
+ * of which only the part the cells flipped since the last query touch is
+ * searched again, as is the part the start moved into.
+ *
+ * Each cell has its distance to the goal `g`, and `rhs`, the one its
+ * neighbors give it; the cells where they differ are queued by
+ * [min(g, rhs) + h(start, cell) + km, min(g, rhs)], `km` adding up how far
+ * the start moved so that the queued keys stay lower bounds. A flipped
+ * cell changes the moves of the cells of its 3x3 neighborhood only, whose
+ * `rhs` are computed again. The search stops as soon as the start is
+ * settled, and the path follows the lowest g from it.
+ *
+ * The finder observes the grid until destroyed. A new goal starts the
+ * search over.
+ *
+ * @tparam Heuristic      consistent functor int(int dx, int dy), e.g.
+ *                        heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ */
+template <class Heuristic = heuristic::Octile,
+          class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class BasicDStarLiteFinder : public GridObserver, private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+
+    static const int kInfinity = INT_MAX;
+
+    explicit BasicDStarLiteFinder(grid_t &grid,
+                                  const Heuristic &heuristic = Heuristic());
+    ~BasicDStarLiteFinder() { grid_.RemoveObserver(this); }
+
+    // The grid is the one of the finder, as it is now.
+    pnode_vector_t FindPath(size_type start_x, size_type start_y,
+                            size_type end_x, size_type end_y);
+
+    // The cells settled by the last FindPath(), and whether that search
+    // was from scratch.
+    size_type expanded() const { return expanded_; }
+    bool restarted() const { return restarted_; }
+    // The distance from the cell `index` to the goal, as far as the
+    // search went, or kInfinity.
+    int Distance(size_type index) const { return g_[index]; }
+
+    virtual void OnWalkableChanged(size_type x, size_type y, bool walkable);
+
+private:
+    // [k1, k2], compared in order.
+    struct Key {
+        int k1;
+        int k2;
+        bool operator<(const Key &other) const {
+            return k1 < other.k1 || (k1 == other.k1 && k2 < other.k2);
+        }
+        bool operator==(const Key &other) const {
+            return k1 == other.k1 && k2 == other.k2;
+        }
+    };
+    // A queued cell. The entries of a cell whose key has changed since,
+    // or which left the queue, are stale and skipped when popped.
+    struct Entry {
+        Key key;
+        size_type index;
+        bool operator>(const Entry &other) const { return other.key < key; }
+    };
+
+    void Restart(size_type goal);
+    Key KeyOf(size_type index) const;
+    // Compute `rhs` of the cell from its neighbors, and queue it or not.
+    void UpdateRhs(size_type index);
+    void UpdateVertex(size_type index);
+    void Push(size_type index, const Key &key);
+    // Drop the stale entries at the top, and tell if any entry is left.
+    bool SkipStale();
+    void ComputeShortestPath();
+    // The cells that move into the cell `index`.
+    unsigned Predecessors(size_type index) const;
+
+    grid_t &grid_;
+    Heuristic heuristic_;
+    size_type goal_;
+    size_type start_;
+    bool started_;
+    int km_;
+    std::vector<int> g_;
+    std::vector<int> rhs_;
+    // the key of each queued cell, and whether it is queued
+    std::vector<Key> keys_;
+    std::vector<boost::uint8_t> queued_;
+    std::vector<Entry> heap_;
+    size_type queued_count_;
+    // the cells flipped since the last query
+    std::vector<size_type> changed_;
+    size_type expanded_;
+    bool restarted_;
+};
+
+template <class Heuristic, class Diagonal>
+BasicDStarLiteFinder<Heuristic, Diagonal>::BasicDStarLiteFinder(
+        grid_t &grid, const Heuristic &heuristic)
+        : grid_(grid), heuristic_(heuristic), goal_(0), start_(0),
+          started_(false), km_(0), queued_count_(0), expanded_(0),
+          restarted_(false) {
+    grid_.AddObserver(this);
+}
+
+template <class Heuristic, class Diagonal>
+typename BasicDStarLiteFinder<Heuristic, Diagonal>::pnode_vector_t
+BasicDStarLiteFinder<Heuristic, Diagonal>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y) {
+    size_type start = grid_.IndexAt(start_x, start_y),
+              end = grid_.IndexAt(end_x, end_y);
+    expanded_ = 0;
+    restarted_ = false;
+    if (start == end) {
+        pnode_vector_t path(new node_vector_t);
+        path->push_back(grid_.GetNodeAt(start));
+        return path;
+    }
+    // a blocked goal is never entered, as by AStarFinder
+    if (!grid_.IsWalkableAt(end_x, end_y)) {
+        return pnode_vector_t();
+    }
+
+    // past a quarter of the grid flipped, a new search is cheaper
+    if (!started_ || end != goal_ || changed_.size() > grid_.size() / 4) {
+        start_ = start;
+        Restart(end);
+    } else {
+        // the keys queued so far are as much too high as the start moved
+        if (start != start_) {
+            size_type x = 0, y = 0;
+            grid_.CoordsOf(start_, x, y);
+            km_ += heuristic_(10 * (int(x) - int(start_x)),
+                              10 * (int(y) - int(start_y)));
+            size_type old_start = start_;
+            start_ = start;
+            // a blocked start has moves out only while it is the start
+            if (!grid_.IsWalkableAt(x, y)) {
+                UpdateRhs(old_start);
+            }
+        }
+        // the moves out of the 3x3 neighborhood of a flipped cell
+        for (std::size_t i = 0; i < changed_.size(); ++i) {
+            size_type x = 0, y = 0;
+            grid_.CoordsOf(changed_[i], x, y);
+            for (size_type ny = y > 0 ? y - 1 : 0;
+                    ny <= y + 1 && ny < grid_.height(); ++ny) {
+                for (size_type nx = x > 0 ? x - 1 : 0;
+                        nx <= x + 1 && nx < grid_.width(); ++nx) {
+                    UpdateRhs(grid_.IndexAt(nx, ny));
+                }
+            }
+        }
+    }
+    changed_.clear();
+    if (!grid_.IsWalkableAt(start_x, start_y)) {
+        UpdateRhs(start);
+    }
+
+    // a goal out of the component of the start fails without a search,
+    // which is left to the next query
+    if (!grid_.IsReachable(start_x, start_y, end_x, end_y,
+                           Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+    ComputeShortestPath();
+    if (rhs_[start] == kInfinity) {
+        return pnode_vector_t();
+    }
+
+    // down the distances to the goal
+    pnode_vector_t path(new node_vector_t);
+    path->push_back(grid_.GetNodeAt(start));
+    size_type index = start, x = start_x, y = start_y;
+    NeighborBuffer neighbors;
+    while (index != end) {
+        grid_.GetNeighbors(x, y, Diagonal::movement, neighbors);
+        int best = kInfinity;
+        size_type next = index;
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            int g = g_[neighbors.index[i]];
+            if (g == kInfinity) {
+                continue;
+            }
+            g += neighbors.dir[i] < 4 ? 10 : 14;
+            if (g < best) {
+                best = g;
+                next = neighbors.index[i];
+            }
+        }
+        BOOST_ASSERT_MSG(next != index, "Oops, D* Lite path is cut.");
+        if (next == index || path->size() > grid_.size()) {
+            return pnode_vector_t();
+        }
+        index = next;
+        grid_.CoordsOf(index, x, y);
+        path->push_back(grid_.GetNodeAt(index));
+    }
+    return path;
+}
+
+template <class Heuristic, class Diagonal>
+void BasicDStarLiteFinder<Heuristic, Diagonal>::OnWalkableChanged(
+        size_type x, size_type y, bool /*walkable*/) {
+    if (started_) {
+        changed_.push_back(grid_.IndexAt(x, y));
+    }
+}
+
+template <class Heuristic, class Diagonal>
+void BasicDStarLiteFinder<Heuristic, Diagonal>::Restart(size_type goal) {
+    goal_ = goal;
+    started_ = true;
+    restarted_ = true;
+    km_ = 0;
+    g_.assign(grid_.size(), int(kInfinity));
+    rhs_.assign(grid_.size(), int(kInfinity));
+    Key none = {0, 0};
+    keys_.assign(grid_.size(), none);
+    queued_.assign(grid_.size(), 0);
+    heap_.clear();
+    queued_count_ = 0;
+    rhs_[goal] = 0;
+    Push(goal, KeyOf(goal));
+}
+
+template <class Heuristic, class Diagonal>
+typename BasicDStarLiteFinder<Heuristic, Diagonal>::Key
+BasicDStarLiteFinder<Heuristic, Diagonal>::KeyOf(size_type index) const {
+    int g = std::min(g_[index], rhs_[index]);
+    if (g == kInfinity) {
+        Key key = {kInfinity, kInfinity};
+        return key;
+    }
+    size_type x = 0, y = 0, sx = 0, sy = 0;
+    grid_.CoordsOf(index, x, y);
+    grid_.CoordsOf(start_, sx, sy);
+    Key key = {g + heuristic_(10 * (int(sx) - int(x)),
+                              10 * (int(sy) - int(y))) + km_, g};
+    return key;
+}
+
+template <class Heuristic, class Diagonal>
+unsigned BasicDStarLiteFinder<Heuristic, Diagonal>::Predecessors(
+        size_type index) const {
+    // the moves between free cells go both ways, and none goes into a
+    // blocked cell
+    size_type x = 0, y = 0;
+    grid_.CoordsOf(index, x, y);
+    if (!grid_.IsWalkableAt(x, y)) {
+        return 0;
+    }
+    return grid_.NeighborMask(x, y, Diagonal::movement);
+}
+
+template <class Heuristic, class Diagonal>
+void BasicDStarLiteFinder<Heuristic, Diagonal>::UpdateRhs(size_type index) {
+    if (index == goal_) {
+        return;
+    }
+    int rhs = kInfinity;
+    // a blocked cell has no moves out, but for the start
+    size_type x = 0, y = 0;
+    grid_.CoordsOf(index, x, y);
+    if (index == start_ || grid_.IsWalkableAt(x, y)) {
+        unsigned dirs = grid_.NeighborMask(x, y, Diagonal::movement);
+        while (dirs) {
+            unsigned dir = LowestBit(dirs);
+            dirs &= dirs - 1;
+            int g = g_[index + grid_.IndexOffset(dir)];
+            if (g != kInfinity) {
+                rhs = std::min(rhs, g + (dir < 4 ? 10 : 14));
+            }
+        }
+    }
+    rhs_[index] = rhs;
+    UpdateVertex(index);
+}
+
+template <class Heuristic, class Diagonal>
+void BasicDStarLiteFinder<Heuristic, Diagonal>::UpdateVertex(
+        size_type index) {
+    if (g_[index] != rhs_[index]) {
+        Key key = KeyOf(index);
+        if (!queued_[index] || !(keys_[index] == key)) {
+            Push(index, key);
+        }
+    } else if (queued_[index]) {
+        // its entries are stale from now on
+        queued_[index] = 0;
+        --queued_count_;
+    }
+}
+
+template <class Heuristic, class Diagonal>
+void BasicDStarLiteFinder<Heuristic, Diagonal>::Push(size_type index,
+                                                     const Key &key) {
+    if (!queued_[index]) {
+        queued_[index] = 1;
+        ++queued_count_;
+    }
+    keys_[index] = key;
+    Entry entry = {key, index};
+    heap_.push_back(entry);
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+
+    // rebuild the heap of the live entries once stale ones outnumber them
+    if (heap_.size() > 4 * queued_count_ + 1024) {
+        std::size_t live = 0;
+        for (std::size_t i = 0; i < heap_.size(); ++i) {
+            const Entry &e = heap_[i];
+            if (queued_[e.index] && keys_[e.index] == e.key) {
+                heap_[live++] = e;
+            }
+        }
+        heap_.resize(live);
+        std::make_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+    }
+}
+
+template <class Heuristic, class Diagonal>
+bool BasicDStarLiteFinder<Heuristic, Diagonal>::SkipStale() {
+    while (!heap_.empty()) {
+        const Entry &top = heap_.front();
+        if (queued_[top.index] && keys_[top.index] == top.key) {
+            return true;
+        }
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+        heap_.pop_back();
+    }
+    return false;
+}
+
+template <class Heuristic, class Diagonal>
+void BasicDStarLiteFinder<Heuristic, Diagonal>::ComputeShortestPath() {
+    size_type sx = 0, sy = 0;
+    grid_.CoordsOf(start_, sx, sy);
+    bool blocked_start = !grid_.IsWalkableAt(sx, sy);
+    while (SkipStale()) {
+        Entry top = heap_.front();
+        size_type index = top.index;
+        if (!(top.key < KeyOf(start_)) && rhs_[start_] <= g_[start_]) {
+            break;
+        }
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+        heap_.pop_back();
+        queued_[index] = 0;
+        --queued_count_;
+
+        Key key = KeyOf(index);
+        if (top.key < key) {
+            // queued before the start moved
+            Push(index, key);
+            continue;
+        }
+        ++expanded_;
+        unsigned dirs = Predecessors(index);
+        if (g_[index] > rhs_[index]) {
+            // settled at a lower distance
+            g_[index] = rhs_[index];
+            while (dirs) {
+                unsigned dir = LowestBit(dirs);
+                dirs &= dirs - 1;
+                size_type pred = index + grid_.IndexOffset(dir);
+                int rhs = g_[index] + (dir < 4 ? 10 : 14);
+                if (pred != goal_ && rhs < rhs_[pred]) {
+                    rhs_[pred] = rhs;
+                    UpdateVertex(pred);
+                }
+            }
+        } else {
+            // farther than it was, and so may be its predecessors
+            g_[index] = kInfinity;
+            UpdateRhs(index);
+            while (dirs) {
+                unsigned dir = LowestBit(dirs);
+                dirs &= dirs - 1;
+                UpdateRhs(index + grid_.IndexOffset(dir));
+            }
+        }
+        // a blocked start is no neighbor of the cells it moves into
+        size_type x = 0, y = 0;
+        grid_.CoordsOf(index, x, y);
+        if (blocked_start && index != start_ &&
+                (x > sx ? x - sx : sx - x) <= 1 &&
+                (y > sy ? y - sy : sy - y) <= 1) {
+            UpdateRhs(start_);
+        }
+    }
+}
+
+#endif // FINDERS_DSTARLITEFINDER_HPP_
@@ -0,0 +1,193 @@
+#ifndef FINDERS_FLOWFIELD_HPP_
+#define FINDERS_FLOWFIELD_HPP_
+
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include "boost/cstdint.hpp"
+#include "core/grid.hpp"
+#include "core/movement.hpp"
+
+/**
+ * The distances of all the cells to one goal, and the direction of the
+ * first step of a shortest path from each of them, so that any number of
+ * agents heading to the goal find their next step by one lookup.
+ *
+ * The field is built by Dijkstra from the goal with the moves of
+ * GetNeighbors(), which are the same both ways between free cells. The
+ * costs 10 and 14 are small, so the open list is a ring of buckets, one
+ * per distance: the field is built in time linear in the cells.
+ *
+ * A blocked cell has no entry of its own, its step is looked up among its
+ * free neighbors as AStarFinder leaves a blocked start.
+ * The field is not kept up to date with the grid, Build() it again.
+ */
+template <class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class FlowField {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+
+    static const int kUnreachable = INT_MAX;
+    // The direction of the goal, and of the cells that cannot reach it.
+    enum { kNoDirection = 8 };
+
+    explicit FlowField(const grid_t &grid) : grid_(&grid), goal_(0) {}
+
+    // Compute the field towards the goal (goal_x, goal_y).
+    void Build(size_type goal_x, size_type goal_y);
+
+    // The cost of a shortest path from (x, y) to the goal, or kUnreachable.
+    int Distance(size_type x, size_type y) const;
+    // The Direction of the first step from (x, y) to the goal, or
+    // kNoDirection.
+    unsigned Direction(size_type x, size_type y) const;
+    // The shortest path from (x, y) to the goal, empty if there is none.
+    pnode_vector_t PathFrom(size_type x, size_type y) const;
+
+    const grid_t &grid() const { return *grid_; }
+    size_type goal() const { return goal_; }
+    // The distances by cell index, kUnreachable for the blocked cells but
+    // the goal.
+    const std::vector<int> &distances() const { return distances_; }
+
+private:
+    // The buckets of the ring are by distance / 2, the costs being even,
+    // and the queued distances span 8 of them.
+    enum { kBuckets = 8 };
+
+    // A queued cell, by its coordinates so that its neighbors are looked
+    // up without a division.
+    struct Cell {
+        boost::uint32_t x;
+        boost::uint32_t y;
+    };
+
+    // The best step from the blocked cell `index` into a free neighbor.
+    unsigned StepFromBlocked(size_type index, int &distance) const;
+
+    const grid_t *grid_;
+    size_type goal_;
+    std::vector<int> distances_;
+    std::vector<boost::uint8_t> directions_;
+    std::vector<Cell> buckets_[kBuckets];
+};
+
+template <class Diagonal>
+void FlowField<Diagonal>::Build(size_type goal_x, size_type goal_y) {
+    const grid_t &grid = *grid_;
+    goal_ = grid.IndexAt(goal_x, goal_y);
+    distances_.assign(grid.size(), int(kUnreachable));
+    directions_.assign(grid.size(), boost::uint8_t(kNoDirection));
+    distances_[goal_] = 0;
+    // a blocked goal is never entered, as by AStarFinder
+    if (!grid.IsWalkableAt(goal_x, goal_y)) {
+        return;
+    }
+
+    // every queued distance is within 14 of the current one, so no two of
+    // them share a bucket
+    for (int i = 0; i < kBuckets; ++i) {
+        buckets_[i].clear();
+    }
+    Cell root = {boost::uint32_t(goal_x), boost::uint32_t(goal_y)};
+    buckets_[0].push_back(root);
+    size_type queued = 1;
+    for (int distance = 0; queued > 0; distance += 2) {
+        std::vector<Cell> &bucket = buckets_[distance / 2 % kBuckets];
+        for (std::size_t i = 0; i < bucket.size(); ++i) {
+            Cell cell = bucket[i];
+            size_type index = grid.IndexAt(cell.x, cell.y);
+            --queued;
+            // reached later at a shorter distance already
+            if (distances_[index] != distance) {
+                continue;
+            }
+            unsigned dirs = grid.NeighborMask(cell.x, cell.y,
+                                              Diagonal::movement);
+            while (dirs) {
+                unsigned dir = LowestBit(dirs);
+                dirs &= dirs - 1;
+                size_type neighbor = index + grid.IndexOffset(dir);
+                int nd = distance + (dir < 4 ? 10 : 14);
+                if (nd < distances_[neighbor]) {
+                    distances_[neighbor] = nd;
+                    // the step back from the neighbor
+                    directions_[neighbor] =
+                        boost::uint8_t((dir & 4) | ((dir + 2) & 3));
+                    const DirectionOffset &o = OffsetOf(dir);
+                    Cell next = {cell.x + o.dx, cell.y + o.dy};
+                    buckets_[nd / 2 % kBuckets].push_back(next);
+                    ++queued;
+                }
+            }
+        }
+        bucket.clear();
+    }
+}
+
+template <class Diagonal>
+int FlowField<Diagonal>::Distance(size_type x, size_type y) const {
+    size_type index = grid_->IndexAt(x, y);
+    if (index == goal_ || grid_->IsWalkableAt(x, y)) {
+        return distances_[index];
+    }
+    int distance = kUnreachable;
+    StepFromBlocked(index, distance);
+    return distance;
+}
+
+template <class Diagonal>
+unsigned FlowField<Diagonal>::Direction(size_type x, size_type y) const {
+    size_type index = grid_->IndexAt(x, y);
+    if (index == goal_ || grid_->IsWalkableAt(x, y)) {
+        return directions_[index];
+    }
+    int distance = kUnreachable;
+    return StepFromBlocked(index, distance);
+}
+
+template <class Diagonal>
+typename FlowField<Diagonal>::pnode_vector_t
+FlowField<Diagonal>::PathFrom(size_type x, size_type y) const {
+    if (Distance(x, y) == kUnreachable) {
+        return pnode_vector_t();
+    }
+    pnode_vector_t path(new node_vector_t);
+    size_type index = grid_->IndexAt(x, y);
+    path->push_back(grid_->GetNodeAt(index));
+    for (unsigned dir = Direction(x, y); dir != kNoDirection;
+            dir = directions_[index]) {
+        index += grid_->IndexOffset(dir);
+        path->push_back(grid_->GetNodeAt(index));
+    }
+    return path;
+}
+
+template <class Diagonal>
+unsigned FlowField<Diagonal>::StepFromBlocked(size_type index,
+                                              int &distance) const {
+    size_type x = 0, y = 0;
+    grid_->CoordsOf(index, x, y);
+    NeighborBuffer neighbors;
+    grid_->GetNeighbors(x, y, Diagonal::movement, neighbors);
+    unsigned best = kNoDirection;
+    for (unsigned i = 0; i < neighbors.size; ++i) {
+        int d = distances_[neighbors.index[i]];
+        if (d == kUnreachable) {
+            continue;
+        }
+        d += neighbors.dir[i] < 4 ? 10 : 14;
+        if (d < distance) {
+            distance = d;
+            best = neighbors.dir[i];
+        }
+    }
+    return best;
+}
+
+#endif // FINDERS_FLOWFIELD_HPP_
@@ -0,0 +1,407 @@
+#ifndef FINDERS_FRINGEFINDER_HPP_
+#define FINDERS_FRINGEFINDER_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "option.hpp"
+
+/**
+ * The scratch memory of Fringe Search: the cells reached, with their
+ * cost and parent, in a hash table of a fixed capacity, and the fringe
+ * threaded through them as a doubly linked list.
+ *
+ * The memory does not depend on the size of the grid. A query that
+ * reaches more cells than the capacity gives up, see exhausted().
+ */
+class FringeContext : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef boost::uint32_t slot_t;
+    typedef boost::uint32_t generation_t;
+
+    struct Entry {
+        size_type index;
+        size_type parent;
+        int g;
+        int h;
+        // neighbors in the fringe
+        slot_t prev;
+        slot_t next;
+        generation_t generation;
+        bool listed;
+    };
+
+    static const size_type kNoParent = size_type(-1);
+    static const slot_t kNoSlot = slot_t(-1);
+    // 40 bytes per entry, two entries per cell
+    enum { kDefaultCapacity = 1 << 16 };
+
+    // Hold at most `capacity` cells.
+    explicit FringeContext(size_type capacity = kDefaultCapacity);
+
+    // Start a new query, in O(1).
+    void Prepare();
+
+    // Get the slot of the cell, or kNoSlot if this query has not reached it.
+    slot_t Find(size_type index) const;
+    // Add the cell, not reached yet, and get its slot, or kNoSlot if
+    // the context is full.
+    slot_t Insert(size_type index);
+    Entry &At(slot_t slot) { return entries_[slot]; }
+    size_type Parent(size_type index) const {
+        slot_t slot = Find(index);
+        if (slot == kNoSlot) {
+            return kNoParent;
+        }
+        return entries_[slot].parent;
+    }
+
+    // The fringe, from First() to Head().
+    slot_t Head() const { return head_; }
+    slot_t First() const { return entries_[head_].next; }
+    // Put the slot into the fringe after `where`.
+    void LinkAfter(slot_t where, slot_t slot);
+    void Unlink(slot_t slot);
+
+    size_type capacity() const { return capacity_; }
+    // The number of cells reached by the last query.
+    size_type size() const { return size_; }
+    // Whether the last query gave up for lack of capacity.
+    bool exhausted() const { return exhausted_; }
+    void set_exhausted() { exhausted_ = true; }
+
+private:
+    bool IsUsed(slot_t slot) const {
+        return entries_[slot].generation == generation_;
+    }
+
+    // the slots of the hash table, then the head of the fringe
+    std::vector<Entry> entries_;
+    unsigned bits_;
+    slot_t head_;
+    size_type capacity_;
+    size_type size_;
+    generation_t generation_;
+    bool exhausted_;
+};
+
+inline FringeContext::FringeContext(size_type capacity)
+    : bits_(1), capacity_(capacity), size_(0), generation_(0),
+      exhausted_(false) {
+    // at most half full, so that probes stay short
+    while ((size_type(1) << bits_) < 2 * capacity) {
+        ++bits_;
+    }
+    head_ = slot_t(size_type(1) << bits_);
+    Entry empty = {0, kNoParent, 0, 0, head_, head_, 0, false};
+    entries_.assign(head_ + 1, empty);
+}
+
+inline void FringeContext::Prepare() {
+    if (++generation_ == 0) {
+        for (std::vector<Entry>::iterator it = entries_.begin(),
+                end = entries_.end(); it != end; ++it) {
+            it->generation = 0;
+        }
+        generation_ = 1;
+    }
+    entries_[head_].prev = entries_[head_].next = head_;
+    size_ = 0;
+    exhausted_ = false;
+}
+
+inline FringeContext::slot_t FringeContext::Find(size_type index) const {
+    slot_t mask = head_ - 1;
+    for (slot_t slot = slot_t(HashIndex(index, bits_)); IsUsed(slot);
+            slot = (slot + 1) & mask) {
+        if (entries_[slot].index == index) {
+            return slot;
+        }
+    }
+    return kNoSlot;
+}
+
+inline FringeContext::slot_t FringeContext::Insert(size_type index) {
+    BOOST_ASSERT(Find(index) == kNoSlot);
+    if (size_ == capacity_) {
+        return kNoSlot;
+    }
+    slot_t mask = head_ - 1, slot = slot_t(HashIndex(index, bits_));
+    while (IsUsed(slot)) {
+        slot = (slot + 1) & mask;
+    }
+    ++size_;
+    Entry &entry = entries_[slot];
+    entry.index = index;
+    entry.parent = kNoParent;
+    entry.g = INT_MAX;
+    entry.h = 0;
+    entry.prev = entry.next = slot;
+    entry.generation = generation_;
+    entry.listed = false;
+    return slot;
+}
+
+inline void FringeContext::LinkAfter(slot_t where, slot_t slot) {
+    Entry &entry = entries_[slot];
+    BOOST_ASSERT(!entry.listed);
+    entry.prev = where;
+    entry.next = entries_[where].next;
+    entries_[entry.next].prev = slot;
+    entries_[where].next = slot;
+    entry.listed = true;
+}
+
+inline void FringeContext::Unlink(slot_t slot) {
+    Entry &entry = entries_[slot];
+    BOOST_ASSERT(entry.listed);
+    entries_[entry.prev].next = entry.next;
+    entries_[entry.next].prev = entry.prev;
+    entry.listed = false;
+}
+
+/**
+ * Fringe Search (Bjornsson et al., 2005): the iterations of IDA* without
+ * searching the cells within the threshold again. The fringe keeps the
+ * cells beyond the threshold for the next iteration, and the cells within
+ * it are expanded in list order, with no open list to keep sorted.
+ *
+ * It expands about as many cells as A*, in the memory of a FringeContext.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ */
+template <class Heuristic,
+          class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class BasicFringeFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef FringeContext context_t;
+
+    explicit BasicFringeFinder(int weight = 1,
+                               const Heuristic &heuristic = Heuristic())
+        : weight_(weight), heuristic_(heuristic) {}
+
+    // Return no path, and mark the context exhausted, if the query
+    // reaches more cells than the context holds.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+
+private:
+    int weight_;
+    Heuristic heuristic_;
+};
+
+template <class Heuristic, class Diagonal>
+typename BasicFringeFinder<Heuristic, Diagonal>::pnode_vector_t
+BasicFringeFinder<Heuristic, Diagonal>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    typedef context_t::slot_t slot_t;
+    typedef context_t::Entry entry_t;
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y);
+
+    context.Prepare();
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+    slot_t head = context.Head();
+    slot_t start_slot = context.Insert(start);
+    if (start_slot == context_t::kNoSlot) {
+        context.set_exhausted();
+        return pnode_vector_t();
+    }
+    entry_t &start_entry = context.At(start_slot);
+    start_entry.g = 0;
+    start_entry.h = weight_ * heuristic_(
+        10 * (int(start_x) - int(end_x)), 10 * (int(start_y) - int(end_y)));
+    context.LinkAfter(head, start_slot);
+
+    NeighborBuffer neighbors;
+    size_type x = 0, y = 0;
+    int threshold = start_entry.h;
+    while (context.First() != head) {
+        int next = INT_MAX;
+        slot_t slot = context.First();
+        while (slot != head) {
+            entry_t &entry = context.At(slot);
+            int f = entry.g + entry.h;
+            // leave it for a later iteration
+            if (f > threshold) {
+                next = std::min(next, f);
+                slot = entry.next;
+                continue;
+            }
+            if (entry.index == end) {
+                return Backtrace(grid, context, end);
+            }
+
+            // the successors go right after the cell, to be expanded
+            // in this iteration if they are within the threshold
+            grid.CoordsOf(entry.index, x, y);
+            grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+            for (unsigned i = neighbors.size; i-- > 0;) {
+                unsigned dir = neighbors.dir[i];
+                int ng = entry.g + (dir < 4 ? 10 : 14);
+                slot_t neighbor_slot = context.Find(neighbors.index[i]);
+                if (neighbor_slot == context_t::kNoSlot) {
+                    neighbor_slot = context.Insert(neighbors.index[i]);
+                    if (neighbor_slot == context_t::kNoSlot) {
+                        context.set_exhausted();
+                        return pnode_vector_t();
+                    }
+                    const DirectionOffset &o = OffsetOf(dir);
+                    context.At(neighbor_slot).h = weight_ * heuristic_(
+                        10 * (int(x) + o.dx - int(end_x)),
+                        10 * (int(y) + o.dy - int(end_y)));
+                }
+                entry_t &neighbor = context.At(neighbor_slot);
+                if (ng >= neighbor.g) {
+                    continue;
+                }
+                neighbor.g = ng;
+                neighbor.parent = entry.index;
+                if (neighbor.listed) {
+                    context.Unlink(neighbor_slot);
+                }
+                context.LinkAfter(slot, neighbor_slot);
+            }
+            slot_t expanded = slot;
+            slot = entry.next;
+            context.Unlink(expanded);
+        }
+        threshold = next;
+    }
+
+    // fail to find the path
+    return pnode_vector_t();
+}
+
+/**
+ * Fringe Search configured at runtime by FinderOption, dispatched as
+ * AStarFinder does.
+ */
+class FringeFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef grid_t::pnode_t pnode_t;
+    typedef grid_t::node_vector_t node_vector_t;
+    typedef grid_t::pnode_vector_t pnode_vector_t;
+    typedef FringeContext context_t;
+    typedef boost::shared_ptr<FinderOption> poption_t;
+
+    // The finder's own context holds `capacity` cells.
+    FringeFinder(poption_t op = poption_t(),
+                 size_type capacity = context_t::kDefaultCapacity)
+        : op_(op ? op : DefaultOption()), context_(capacity) {}
+    inline FinderOption &Option() {
+        return *op_;
+    }
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+    // Search with the finder's own context.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid) const {
+        return FindPath(start_x, start_y, end_x, end_y, grid, context_);
+    }
+    // The finder's own context, e.g. to tell whether it was exhausted.
+    const context_t &Context() const { return context_; }
+
+private:
+    // A query, searched with the heuristic DispatchHeuristic() picks.
+    struct FindVisitor {
+        typedef pnode_vector_t result_type;
+        FindVisitor(const FringeFinder &finder,
+                    size_type start_x, size_type start_y,
+                    size_type end_x, size_type end_y,
+                    const grid_t &grid, context_t &context)
+            : finder(&finder), start_x(start_x), start_y(start_y),
+              end_x(end_x), end_y(end_y), grid(&grid), context(&context) {}
+        template <class Heuristic>
+        result_type operator()(const Heuristic &heuristic) const {
+            return finder->FindPathWith(heuristic, start_x, start_y,
+                                        end_x, end_y, *grid, *context);
+        }
+        const FringeFinder *finder;
+        size_type start_x, start_y, end_x, end_y;
+        const grid_t *grid;
+        context_t *context;
+    };
+
+    template <class Heuristic>
+    pnode_vector_t
+    FindPathWith(const Heuristic &heuristic,
+                 size_type start_x, size_type start_y,
+                 size_type end_x, size_type end_y,
+                 const grid_t &grid, context_t &context) const;
+
+    poption_t op_;
+    mutable context_t context_;
+};
+
+inline FringeFinder::pnode_vector_t
+FringeFinder::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    return DispatchHeuristic(op_->heuristic, end_x, end_y,
+        grid.width(), grid.height(),
+        ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners),
+        FindVisitor(*this, start_x, start_y, end_x, end_y, grid, context));
+}
+
+template <class Heuristic>
+FringeFinder::pnode_vector_t
+FringeFinder::FindPathWith(const Heuristic &heuristic,
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    switch (ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners)) {
+    case kDiagonalIfAtMostOneObstacle:
+        return BasicFringeFinder<Heuristic,
+                DiagonalPolicy<kDiagonalIfAtMostOneObstacle> >(
+            op_->weight, heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    case kDiagonalOnlyWhenNoObstacles:
+        return BasicFringeFinder<Heuristic,
+                DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> >(
+            op_->weight, heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    default:
+        return BasicFringeFinder<Heuristic,
+                DiagonalPolicy<kDiagonalNever> >(
+            op_->weight, heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    }
+}
+
+#endif // FINDERS_FRINGEFINDER_HPP_
@@ -0,0 +1,366 @@
+#ifndef FINDERS_HPASTARFINDER_HPP_
+#define FINDERS_HPASTARFINDER_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "clustergraph.hpp"
+#include "searchcontext.hpp"
+
+/**
+ * The scratch state of an HPA* query: the context of the search on the
+ * abstract graph, by cell index, and the one of the searches within a
+ * cluster, with the edges that connect the start and the goal to the
+ * entrances of their clusters.
+ */
+template <class OpenList = DefaultOpenList>
+struct HPAStarContext {
+    typedef BasicSearchContext<OpenList> abstract_context_t;
+    typedef SearchContext local_context_t;
+    typedef ClusterEdge edge_t;
+
+    abstract_context_t abstract;
+    local_context_t local;
+    // the entrances reached from the start, and from the goal
+    std::vector<edge_t> start_edges;
+    std::vector<edge_t> goal_edges;
+};
+
+/**
+ * HPA*: A* on the entrances of a ClusterGraph, from the start to the goal
+ * connected to the entrances of their clusters, then refined into the
+ * cells of the grid one cluster at a time.
+ *
+ * The paths are near shortest: they pass the clusters through their
+ * entrances only, as the transitions of a border are a few of its cells.
+ * A goal in the cluster of the start or a neighbor of it is searched for
+ * within the two clusters too, for a path cheaper than the one through
+ * the entrances, as the detour to an entrance is the most of a short
+ * path.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>, the one of the graph
+ * @tparam OpenList       open list policy of the abstract search
+ */
+template <class Heuristic = heuristic::Octile,
+          class Diagonal = DiagonalPolicy<kDiagonalNever>,
+          class OpenList = DefaultOpenList>
+class BasicHPAStarFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef HPAStarContext<OpenList> context_t;
+    typedef ClusterGraph<Diagonal> graph_t;
+
+    explicit BasicHPAStarFinder(const graph_t &graph,
+                                const Heuristic &heuristic = Heuristic())
+        : graph_(&graph), heuristic_(heuristic) {}
+
+    // Find the path and refine it into every cell it passes.
+    // `grid` must be the grid of the graph.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+    // Find the path through the entrances only, from the start to the
+    // goal, to be refined a segment at a time by RefineSegment().
+    pnode_vector_t
+    FindAbstractPath(size_type start_x, size_type start_y,
+                     size_type end_x, size_type end_y,
+                     const grid_t &grid, context_t &context) const;
+    // Append the cells from the one after `from` up to `to`, consecutive
+    // nodes of an abstract path, to `path`. Return false if there is no
+    // path between them, e.g. for a graph out of date.
+    bool RefineSegment(pnode_t from, pnode_t to, context_t &context,
+                       node_vector_t &path) const;
+
+private:
+    typedef typename graph_t::Edge edge_t;
+
+    // Search the clusters of `start` and `end`, the same or neighbors,
+    // for a path cheaper than `bound`, and append it to `path`. Return
+    // its cost, or kNoPath.
+    int FindDirectPath(size_type start, size_type end, int bound,
+                       context_t &context, node_vector_t &path) const;
+
+    // Relax the edge from the cell `index` of the abstract search.
+    void Relax(size_type index, const edge_t &edge, size_type end,
+               context_t &context) const;
+
+    const graph_t *graph_;
+    Heuristic heuristic_;
+};
+
+template <class Heuristic, class Diagonal, class OpenList>
+typename BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::pnode_vector_t
+BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    pnode_vector_t abstract = FindAbstractPath(
+        start_x, start_y, end_x, end_y, grid, context);
+    if (!abstract || abstract->size() == 1) {
+        return abstract;
+    }
+    pnode_vector_t path(new node_vector_t);
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y),
+              size = graph_->cluster_size();
+    if (std::max(start_x / size, end_x / size) -
+            std::min(start_x / size, end_x / size) <= 1 &&
+            std::max(start_y / size, end_y / size) -
+            std::min(start_y / size, end_y / size) <= 1 &&
+            FindDirectPath(start, end, context.abstract.Touch(end).g,
+                           context, *path) != graph_t::kNoPath) {
+        return path;
+    }
+    path->push_back(abstract->front());
+    for (std::size_t i = 1; i < abstract->size(); ++i) {
+        if (!RefineSegment((*abstract)[i - 1], (*abstract)[i], context,
+                           *path)) {
+            return pnode_vector_t();
+        }
+    }
+    return path;
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+int BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::FindDirectPath(
+        size_type start, size_type end, int bound, context_t &context,
+        node_vector_t &path) const {
+    typedef typename context_t::local_context_t local_context_t;
+    typedef typename local_context_t::State state_t;
+    const grid_t &grid = graph_->grid();
+    size_type size = graph_->cluster_size(),
+              sx = 0, sy = 0, ex = 0, ey = 0;
+    grid.CoordsOf(start, sx, sy);
+    grid.CoordsOf(end, ex, ey);
+    // the rectangle of the two clusters, by local index
+    size_type x0 = std::min(sx, ex) / size * size,
+              y0 = std::min(sy, ey) / size * size,
+              x1 = std::min((std::max(sx, ex) / size + 1) * size,
+                            grid.width()),
+              y1 = std::min((std::max(sy, ey) / size + 1) * size,
+                            grid.height()),
+              w = x1 - x0;
+
+    local_context_t &local = context.local;
+    local.Prepare(w * (y1 - y0));
+    DefaultOpenList &open_list = local.open_list();
+    size_type start_local = (sy - y0) * w + (sx - x0);
+    state_t &start_state = local.Touch(start_local);
+    start_state.opened = true;
+    open_list.Push(start_local, 0, start_state.handle);
+
+    NeighborBuffer neighbors;
+    while (!open_list.Empty()) {
+        size_type index = open_list.Pop();
+        state_t &state = local.Touch(index);
+        state.closed = true;
+        // no path left cheaper than the bound
+        if (state.f >= bound) {
+            break;
+        }
+        size_type x = x0 + index % w, y = y0 + index / w;
+        if (x == ex && y == ey) {
+            std::size_t first = path.size();
+            for (size_type i = index; i != local_context_t::kNoParent;
+                    i = local.Parent(i)) {
+                path.push_back(grid.GetNodeAt(x0 + i % w, y0 + i / w));
+            }
+            std::reverse(path.begin() + first, path.end());
+            return state.g;
+        }
+
+        grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+        for (unsigned i = 0; i < neighbors.size; ++i) {
+            const DirectionOffset &o = OffsetOf(neighbors.dir[i]);
+            size_type nx = x + o.dx, ny = y + o.dy;
+            if (nx < x0 || nx >= x1 || ny < y0 || ny >= y1) {
+                continue;
+            }
+            size_type neighbor_index = (ny - y0) * w + (nx - x0);
+            state_t &neighbor_state = local.Touch(neighbor_index);
+            if (neighbor_state.closed) {
+                continue;
+            }
+            int ng = state.g + (neighbors.dir[i] < 4 ? 10 : 14);
+            if (!neighbor_state.opened || ng < neighbor_state.g) {
+                neighbor_state.g = ng;
+                if (!neighbor_state.opened) {
+                    neighbor_state.h = heuristic_(10 * (int(nx) - int(ex)),
+                                                  10 * (int(ny) - int(ey)));
+                }
+                neighbor_state.f = neighbor_state.g + neighbor_state.h;
+                neighbor_state.parent = index;
+                if (!neighbor_state.opened) {
+                    neighbor_state.opened = true;
+                    open_list.Push(neighbor_index, neighbor_state.f,
+                                   neighbor_state.handle);
+                } else {
+                    open_list.Update(neighbor_state.handle, neighbor_index,
+                                     neighbor_state.f);
+                }
+            }
+        }
+    }
+    return graph_t::kNoPath;
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+typename BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::pnode_vector_t
+BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::FindAbstractPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    BOOST_ASSERT_MSG(&grid == &graph_->grid(),
+                     "Oops, FindAbstractPath() with the grid of another graph.");
+    typedef typename context_t::abstract_context_t::State state_t;
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y);
+    size_type start_cluster = graph_->ClusterOf(start),
+              end_cluster = graph_->ClusterOf(end);
+
+    context.abstract.Prepare(grid.size());
+    if (start == end) {
+        pnode_vector_t path(new node_vector_t);
+        path->push_back(grid.GetNodeAt(start));
+        return path;
+    }
+    if (!grid.IsWalkableAt(end_x, end_y)) {
+        return pnode_vector_t();
+    }
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+
+    // connect the start and the goal to the entrances of their clusters,
+    // and the start to the goal within their cluster
+    const std::vector<typename graph_t::Node> &start_nodes =
+        graph_->Nodes(start_cluster);
+    const std::vector<typename graph_t::Node> &end_nodes =
+        graph_->Nodes(end_cluster);
+    context.start_edges.clear();
+    context.goal_edges.clear();
+    graph_->SearchCluster(start, graph_t::kNoCell, context.local);
+    for (std::size_t i = 0; i < start_nodes.size(); ++i) {
+        int cost = graph_->ClusterCost(start_nodes[i].cell, context.local);
+        if (cost != graph_t::kNoPath && start_nodes[i].cell != start) {
+            edge_t edge = {start_nodes[i].cell, cost};
+            context.start_edges.push_back(edge);
+        }
+    }
+    if (start_cluster == end_cluster) {
+        int cost = graph_->ClusterCost(end, context.local);
+        if (cost != graph_t::kNoPath) {
+            edge_t edge = {end, cost};
+            context.start_edges.push_back(edge);
+        }
+    }
+    graph_->SearchCluster(end, graph_t::kNoCell, context.local);
+    for (std::size_t i = 0; i < end_nodes.size(); ++i) {
+        int cost = graph_->ClusterCost(end_nodes[i].cell, context.local);
+        if (cost != graph_t::kNoPath && end_nodes[i].cell != end) {
+            edge_t edge = {end_nodes[i].cell, cost};
+            context.goal_edges.push_back(edge);
+        }
+    }
+
+    OpenList &open_list = context.abstract.open_list();
+    state_t &start_state = context.abstract.Touch(start);
+    start_state.opened = true;
+    open_list.Push(start, 0, start_state.handle);
+    while (!open_list.Empty()) {
+        size_type index = open_list.Pop();
+        context.abstract.Touch(index).closed = true;
+        if (index == end) {
+            return Backtrace(grid, context.abstract, end);
+        }
+
+        if (index == start) {
+            for (std::size_t i = 0; i < context.start_edges.size(); ++i) {
+                Relax(index, context.start_edges[i], end, context);
+            }
+        }
+        if (const typename graph_t::Node *node = graph_->FindNode(index)) {
+            for (std::size_t i = 0; i < node->edges.size(); ++i) {
+                Relax(index, node->edges[i], end, context);
+            }
+        }
+        if (graph_->ClusterOf(index) == end_cluster) {
+            for (std::size_t i = 0; i < context.goal_edges.size(); ++i) {
+                if (context.goal_edges[i].to == index) {
+                    edge_t edge = {end, context.goal_edges[i].cost};
+                    Relax(index, edge, end, context);
+                }
+            }
+        }
+    }
+
+    // fail to find the path
+    return pnode_vector_t();
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+void BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::Relax(
+        size_type index, const edge_t &edge, size_type end,
+        context_t &context) const {
+    typedef typename context_t::abstract_context_t::State state_t;
+    state_t &neighbor_state = context.abstract.Touch(edge.to);
+    if (neighbor_state.closed) {
+        return;
+    }
+    int ng = context.abstract.Touch(index).g + edge.cost;
+    if (!neighbor_state.opened || ng < neighbor_state.g) {
+        neighbor_state.g = ng;
+        if (!neighbor_state.opened) {
+            const grid_t &grid = graph_->grid();
+            size_type x = 0, y = 0, end_x = 0, end_y = 0;
+            grid.CoordsOf(edge.to, x, y);
+            grid.CoordsOf(end, end_x, end_y);
+            neighbor_state.h = heuristic_(10 * (int(x) - int(end_x)),
+                                          10 * (int(y) - int(end_y)));
+        }
+        neighbor_state.f = neighbor_state.g + neighbor_state.h;
+        neighbor_state.parent = index;
+        if (!neighbor_state.opened) {
+            neighbor_state.opened = true;
+            context.abstract.open_list().Push(edge.to, neighbor_state.f,
+                                              neighbor_state.handle);
+        } else {
+            context.abstract.open_list().Update(neighbor_state.handle,
+                                                edge.to, neighbor_state.f);
+        }
+    }
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+bool BasicHPAStarFinder<Heuristic, Diagonal, OpenList>::RefineSegment(
+        pnode_t from, pnode_t to, context_t &context,
+        node_vector_t &path) const {
+    const grid_t &grid = graph_->grid();
+    size_type from_index = grid.IndexOf(from), to_index = grid.IndexOf(to);
+    if (graph_->ClusterOf(from_index) != graph_->ClusterOf(to_index)) {
+        // a transition, one move
+        path.push_back(to);
+        return true;
+    }
+    if (graph_->SearchCluster(from_index, to_index, context.local) ==
+            graph_t::kNoPath) {
+        return false;
+    }
+    graph_->AppendClusterPath(to_index, context.local, path);
+    return true;
+}
+
+#endif // FINDERS_HPASTARFINDER_HPP_
@@ -0,0 +1,420 @@
+#ifndef FINDERS_IDASTARFINDER_HPP_
+#define FINDERS_IDASTARFINDER_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <vector>
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "option.hpp"
+
+/**
+ * The transposition table of IDA*: the cost each cell was reached at in
+ * the current iteration, so that a cell reached again at no less cost is
+ * not searched twice.
+ *
+ * It has a fixed number of entries, one per hash of the cell index. A
+ * cell whose entry was taken by another one is merely searched again.
+ */
+class TranspositionTable {
+public:
+    typedef std::size_t size_type;
+    typedef boost::uint32_t generation_t;
+
+    // `capacity` is rounded up to a power of two; 0 disables the table.
+    explicit TranspositionTable(size_type capacity = 0)
+        : bits_(0), generation_(0) {
+        Resize(capacity);
+    }
+
+    void Resize(size_type capacity);
+    // Forget all entries, in O(1).
+    void Clear();
+    // Record that the cell is reached at cost `g`, or return false if it
+    // was reached at no more cost since the last Clear().
+    bool Visit(size_type index, int g) {
+        if (entries_.empty()) {
+            return true;
+        }
+        Entry &entry = entries_[HashIndex(index, bits_)];
+        if (entry.generation == generation_ && entry.index == index &&
+                entry.g <= g) {
+            return false;
+        }
+        entry.index = index;
+        entry.g = g;
+        entry.generation = generation_;
+        return true;
+    }
+    size_type capacity() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        size_type index;
+        int g;
+        generation_t generation;
+    };
+
+    std::vector<Entry> entries_;
+    unsigned bits_;
+    generation_t generation_;
+};
+
+inline void TranspositionTable::Resize(size_type capacity) {
+    bits_ = 0;
+    while (capacity > (size_type(1) << bits_)) {
+        ++bits_;
+    }
+    Entry empty = {0, 0, 0};
+    entries_.assign(capacity ? size_type(1) << bits_ : 0, empty);
+    generation_ = 0;
+}
+
+inline void TranspositionTable::Clear() {
+    if (++generation_ == 0) {
+        for (std::vector<Entry>::iterator it = entries_.begin(),
+                end = entries_.end(); it != end; ++it) {
+            it->generation = 0;
+        }
+        generation_ = 1;
+    }
+}
+
+/**
+ * The scratch memory of IDA*: the transposition table, of a fixed size,
+ * and the stack of the depth-first search, which is as deep as the path.
+ * Unlike SearchContext nothing is kept per cell of the grid.
+ */
+class IDAStarContext : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+
+    // A cell on the path being searched, and its successors by `f` value.
+    struct Frame {
+        size_type index;
+        int g;
+        unsigned size;
+        unsigned next;
+        size_type child[NeighborBuffer::kCapacity];
+        int child_g[NeighborBuffer::kCapacity];
+        int child_f[NeighborBuffer::kCapacity];
+    };
+
+    // 16 bytes per entry of the table
+    enum { kDefaultTableCapacity = 1 << 16 };
+
+    // `table_capacity` entries of the transposition table, 0 for none.
+    explicit IDAStarContext(size_type table_capacity = kDefaultTableCapacity)
+        : table_(table_capacity), iterations_(0) {}
+
+    // Start a new query.
+    void Prepare() {
+        stack_.clear();
+        iterations_ = 0;
+    }
+
+    TranspositionTable &table() { return table_; }
+    std::vector<Frame> &stack() { return stack_; }
+    // The number of iterations of the last query.
+    size_type iterations() const { return iterations_; }
+    void CountIteration() { ++iterations_; }
+
+private:
+    TranspositionTable table_;
+    std::vector<Frame> stack_;
+    size_type iterations_;
+};
+
+/**
+ * Iterative deepening A*: depth-first searches bounded by an `f` value,
+ * raised each iteration to the least `f` value that exceeded it, so the
+ * memory needed does not grow with the grid, see IDAStarContext.
+ *
+ * Successors are searched in the order of their `f` values, and without
+ * a transposition table only cells on the current path are pruned, so
+ * the table should be disabled only for very open maps.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ */
+template <class Heuristic,
+          class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class BasicIDAStarFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef IDAStarContext context_t;
+
+    explicit BasicIDAStarFinder(int weight = 1,
+                                const Heuristic &heuristic = Heuristic())
+        : weight_(weight), heuristic_(heuristic) {}
+
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+
+private:
+    typedef context_t::Frame frame_t;
+
+    // Push the frame of the cell at cost `g`, its successors sorted.
+    void Push(size_type index, int g, size_type end_x, size_type end_y,
+              const grid_t &grid, context_t &context) const;
+    // Search within `threshold`; on failure, lower `next` to the least
+    // `f` value beyond it.
+    bool Search(size_type start, size_type end, int threshold, int &next,
+                const grid_t &grid, context_t &context) const;
+
+    int weight_;
+    Heuristic heuristic_;
+};
+
+template <class Heuristic, class Diagonal>
+typename BasicIDAStarFinder<Heuristic, Diagonal>::pnode_vector_t
+BasicIDAStarFinder<Heuristic, Diagonal>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y);
+
+    context.Prepare();
+    pnode_vector_t path(new node_vector_t);
+    if (start == end) {
+        path->push_back(grid.GetNodeAt(start));
+        return path;
+    }
+    // a goal out of the component of the start fails without a search,
+    // where IDA* would deepen until it ran out of thresholds
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+
+    int threshold = weight_ * heuristic_(
+        10 * (int(start_x) - int(end_x)), 10 * (int(start_y) - int(end_y)));
+    for (;;) {
+        context.CountIteration();
+        int next = INT_MAX;
+        if (Search(start, end, threshold, next, grid, context)) {
+            break;
+        }
+        // no cell beyond the threshold: the goal is not reachable
+        if (next == INT_MAX) {
+            return pnode_vector_t();
+        }
+        threshold = next;
+    }
+
+    // the stack holds the path but the goal
+    const std::vector<frame_t> &stack = context.stack();
+    path->reserve(stack.size() + 1);
+    for (std::size_t i = 0; i < stack.size(); ++i) {
+        path->push_back(grid.GetNodeAt(stack[i].index));
+    }
+    path->push_back(grid.GetNodeAt(end));
+    return path;
+}
+
+template <class Heuristic, class Diagonal>
+void BasicIDAStarFinder<Heuristic, Diagonal>::Push(
+        size_type index, int g, size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    NeighborBuffer neighbors;
+    size_type x = 0, y = 0;
+    grid.CoordsOf(index, x, y);
+    grid.GetNeighbors(x, y, Diagonal::movement, neighbors);
+
+    context.stack().push_back(frame_t());
+    frame_t &frame = context.stack().back();
+    frame.index = index;
+    frame.g = g;
+    frame.size = 0;
+    frame.next = 0;
+    for (unsigned i = 0; i < neighbors.size; ++i) {
+        unsigned dir = neighbors.dir[i];
+        const DirectionOffset &o = OffsetOf(dir);
+        int ng = g + (dir < 4 ? 10 : 14);
+        int f = ng + weight_ * heuristic_(
+            10 * (int(x) + o.dx - int(end_x)),
+            10 * (int(y) + o.dy - int(end_y)));
+        // insertion sort, there are at most eight
+        unsigned j = frame.size++;
+        for (; j > 0 && frame.child_f[j - 1] > f; --j) {
+            frame.child[j] = frame.child[j - 1];
+            frame.child_g[j] = frame.child_g[j - 1];
+            frame.child_f[j] = frame.child_f[j - 1];
+        }
+        frame.child[j] = neighbors.index[i];
+        frame.child_g[j] = ng;
+        frame.child_f[j] = f;
+    }
+}
+
+template <class Heuristic, class Diagonal>
+bool BasicIDAStarFinder<Heuristic, Diagonal>::Search(
+        size_type start, size_type end, int threshold, int &next,
+        const grid_t &grid, context_t &context) const {
+    std::vector<frame_t> &stack = context.stack();
+    TranspositionTable &table = context.table();
+    bool use_table = table.capacity() != 0;
+    size_type end_x = 0, end_y = 0;
+    grid.CoordsOf(end, end_x, end_y);
+
+    stack.clear();
+    table.Clear();
+    table.Visit(start, 0);
+    Push(start, 0, end_x, end_y, grid, context);
+    while (!stack.empty()) {
+        frame_t &top = stack.back();
+        if (top.next == top.size) {
+            stack.pop_back();
+            continue;
+        }
+        unsigned i = top.next++;
+        if (top.child_f[i] > threshold) {
+            // so are the ones after it
+            next = std::min(next, top.child_f[i]);
+            top.next = top.size;
+            continue;
+        }
+        size_type child = top.child[i];
+        int g = top.child_g[i];
+        if (child == end) {
+            return true;
+        }
+        if (use_table) {
+            if (!table.Visit(child, g)) {
+                continue;
+            }
+        } else {
+            // do not walk in circles
+            bool on_path = false;
+            for (std::size_t k = 0; k < stack.size() && !on_path; ++k) {
+                on_path = stack[k].index == child;
+            }
+            if (on_path) {
+                continue;
+            }
+        }
+        Push(child, g, end_x, end_y, grid, context);
+    }
+    return false;
+}
+
+/**
+ * IDA* configured at runtime by FinderOption, dispatched as AStarFinder
+ * does.
+ */
+class IDAStarFinder : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef grid_t::pnode_t pnode_t;
+    typedef grid_t::node_vector_t node_vector_t;
+    typedef grid_t::pnode_vector_t pnode_vector_t;
+    typedef IDAStarContext context_t;
+    typedef boost::shared_ptr<FinderOption> poption_t;
+
+    // The finder's own context has a table of `table_capacity` entries.
+    IDAStarFinder(poption_t op = poption_t(),
+                  size_type table_capacity =
+                      context_t::kDefaultTableCapacity)
+        : op_(op ? op : DefaultOption()), context_(table_capacity) {}
+    inline FinderOption &Option() {
+        return *op_;
+    }
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+    // Search with the finder's own context.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid) const {
+        return FindPath(start_x, start_y, end_x, end_y, grid, context_);
+    }
+
+private:
+    // A query, searched with the heuristic DispatchHeuristic() picks.
+    struct FindVisitor {
+        typedef pnode_vector_t result_type;
+        FindVisitor(const IDAStarFinder &finder,
+                    size_type start_x, size_type start_y,
+                    size_type end_x, size_type end_y,
+                    const grid_t &grid, context_t &context)
+            : finder(&finder), start_x(start_x), start_y(start_y),
+              end_x(end_x), end_y(end_y), grid(&grid), context(&context) {}
+        template <class Heuristic>
+        result_type operator()(const Heuristic &heuristic) const {
+            return finder->FindPathWith(heuristic, start_x, start_y,
+                                        end_x, end_y, *grid, *context);
+        }
+        const IDAStarFinder *finder;
+        size_type start_x, start_y, end_x, end_y;
+        const grid_t *grid;
+        context_t *context;
+    };
+
+    template <class Heuristic>
+    pnode_vector_t
+    FindPathWith(const Heuristic &heuristic,
+                 size_type start_x, size_type start_y,
+                 size_type end_x, size_type end_y,
+                 const grid_t &grid, context_t &context) const;
+
+    poption_t op_;
+    mutable context_t context_;
+};
+
+inline IDAStarFinder::pnode_vector_t
+IDAStarFinder::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    return DispatchHeuristic(op_->heuristic, end_x, end_y,
+        grid.width(), grid.height(),
+        ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners),
+        FindVisitor(*this, start_x, start_y, end_x, end_y, grid, context));
+}
+
+template <class Heuristic>
+IDAStarFinder::pnode_vector_t
+IDAStarFinder::FindPathWith(const Heuristic &heuristic,
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    switch (ToDiagonalMovement(op_->allow_diagonal, op_->dont_cross_corners)) {
+    case kDiagonalIfAtMostOneObstacle:
+        return BasicIDAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalIfAtMostOneObstacle> >(
+            op_->weight, heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    case kDiagonalOnlyWhenNoObstacles:
+        return BasicIDAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> >(
+            op_->weight, heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    default:
+        return BasicIDAStarFinder<Heuristic,
+                DiagonalPolicy<kDiagonalNever> >(
+            op_->weight, heuristic).FindPath(
+                start_x, start_y, end_x, end_y, grid, context);
+    }
+}
+
+#endif // FINDERS_IDASTARFINDER_HPP_
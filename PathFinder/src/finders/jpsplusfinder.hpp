@@ -0,0 +1,197 @@
+#ifndef FINDERS_JPSPLUSFINDER_HPP_
+#define FINDERS_JPSPLUSFINDER_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include "boost/assert.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "jumppointfinder.hpp"
+#include "jumptable.hpp"
+#include "searchcontext.hpp"
+
+/**
+ * JPS+: Jump Point Search where every jump is one lookup in a JumpTable.
+ *
+ * The table knows no goal, so a jump also stops where it reaches the row
+ * or column of the goal before the jump point or the wall: on the line
+ * of the goal for a straight jump, and where a diagonal jump, or a
+ * vertical one without diagonal moves, would turn to it.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>, the one of the table
+ * @tparam OpenList       open list policy, see openlist.hpp
+ */
+template <class Heuristic = heuristic::Octile,
+          class Diagonal = DiagonalPolicy<kDiagonalNever>,
+          class OpenList = DefaultOpenList>
+class BasicJPSPlusFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef BasicSearchContext<OpenList> context_t;
+    typedef JumpTable<Diagonal> table_t;
+
+    explicit BasicJPSPlusFinder(const table_t &table,
+                                const Heuristic &heuristic = Heuristic())
+        : table_(&table), heuristic_(heuristic) {}
+
+    // `grid` must be the grid of the table.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+
+private:
+    typedef JumpPointRules<Diagonal> rules_t;
+    typedef typename rules_t::coord_t coord_t;
+
+    // Jump from the cell `index` at (x, y) in Direction `dir` and get the
+    // jump point in (jx, jy), or return false if there is none.
+    bool Jump(size_type index, coord_t x, coord_t y, unsigned dir,
+              coord_t end_x, coord_t end_y, coord_t &jx, coord_t &jy) const;
+
+    const table_t *table_;
+    Heuristic heuristic_;
+};
+
+template <class Heuristic, class Diagonal, class OpenList>
+typename BasicJPSPlusFinder<Heuristic, Diagonal, OpenList>::pnode_vector_t
+BasicJPSPlusFinder<Heuristic, Diagonal, OpenList>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    BOOST_ASSERT_MSG(&grid == &table_->grid(),
+                     "Oops, FindPath() with the grid of another table.");
+    typedef typename context_t::State state_t;
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y);
+
+    context.Prepare(grid.size());
+    // the jumps take the goal for a jump point even if it is blocked
+    if (!grid.IsWalkableAt(end_x, end_y)) {
+        return pnode_vector_t();
+    }
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+    OpenList &open_list = context.open_list();
+
+    // push the start node into the open list
+    state_t &start_state = context.Touch(start);
+    start_state.opened = true;
+    open_list.Push(start, 0, start_state.handle);
+
+    size_type x = 0, y = 0, px = 0, py = 0;
+    coord_t jx = 0, jy = 0;
+    // while the open list is not empty
+    while (!open_list.Empty()) {
+        // pop the position of node which has the minimum `f` value.
+        size_type index = open_list.Pop();
+        state_t &state = context.Touch(index);
+        state.closed = true;
+
+        // if reached the end position, construct the path and return it
+        if (index == end) {
+            return ExpandPath(grid, Backtrace(grid, context, end));
+        }
+
+        // prune the neighbors by the direction of travel
+        grid.CoordsOf(index, x, y);
+        int dx = 0, dy = 0;
+        if (state.parent != context_t::kNoParent) {
+            grid.CoordsOf(state.parent, px, py);
+            dx = rules_t::Sign(coord_t(x) - coord_t(px));
+            dy = rules_t::Sign(coord_t(y) - coord_t(py));
+        }
+        unsigned dirs = rules_t::Successors(grid, x, y, dx, dy);
+        while (dirs) {
+            unsigned dir = LowestBit(dirs);
+            dirs &= dirs - 1;
+            if (!Jump(index, x, y, dir, end_x, end_y, jx, jy)) {
+                continue;
+            }
+            size_type jump_index = grid.IndexAt(jx, jy);
+            state_t &jump_state = context.Touch(jump_index);
+            if (jump_state.closed) {
+                continue;
+            }
+
+            // the jump point is on a straight or diagonal line
+            coord_t ax = jx - coord_t(x), ay = jy - coord_t(y);
+            ax = ax < 0 ? -ax : ax;
+            ay = ay < 0 ? -ay : ay;
+            int ng = state.g + int(ax > ay ? 10 * ax + 4 * ay
+                                           : 10 * ay + 4 * ax);
+
+            if (!jump_state.opened || ng < jump_state.g) {
+                jump_state.g = ng;
+                if (!jump_state.opened) {
+                    jump_state.h = heuristic_(
+                        int(10 * (jx - coord_t(end_x))),
+                        int(10 * (jy - coord_t(end_y))));
+                }
+                jump_state.f = jump_state.g + jump_state.h;
+                jump_state.parent = index;
+
+                if (!jump_state.opened) {
+                    jump_state.opened = true;
+                    open_list.Push(jump_index, jump_state.f,
+                                   jump_state.handle);
+                } else {
+                    open_list.Update(jump_state.handle, jump_index,
+                                     jump_state.f);
+                }
+            }
+        }
+    }
+
+    // fail to find the path
+    return pnode_vector_t();
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+bool BasicJPSPlusFinder<Heuristic, Diagonal, OpenList>::Jump(
+        size_type index, coord_t x, coord_t y, unsigned dir,
+        coord_t end_x, coord_t end_y, coord_t &jx, coord_t &jy) const {
+    const DirectionOffset &o = OffsetOf(dir);
+    coord_t d = table_->Distance(index, dir);
+    // the number of steps that can be made at all
+    coord_t reach = d > 0 ? d : -d;
+    // the steps to the row and to the column of the goal along the move,
+    // not positive if the goal is not ahead
+    coord_t to_x = (end_x - x) * o.dx, to_y = (end_y - y) * o.dy;
+    coord_t steps = 0;
+    if (o.dx != 0 && o.dy != 0) {
+        if (to_x > 0 && to_y > 0) {
+            steps = std::min(to_x, to_y);
+        }
+    } else if (o.dx != 0) {
+        steps = end_y == y ? to_x : 0;
+    } else if (Diagonal::movement == kDiagonalNever) {
+        // turns to the row of the goal
+        steps = to_y;
+    } else {
+        steps = end_x == x ? to_y : 0;
+    }
+    if (steps > 0 && steps <= reach) {
+        jx = x + steps * o.dx;
+        jy = y + steps * o.dy;
+        return true;
+    }
+    if (d > 0) {
+        jx = x + d * o.dx;
+        jy = y + d * o.dy;
+        return true;
+    }
+    return false;
+}
+
+#endif // FINDERS_JPSPLUSFINDER_HPP_
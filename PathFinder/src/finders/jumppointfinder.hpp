@@ -0,0 +1,461 @@
+#ifndef FINDERS_JUMPPOINTFINDER_HPP_
+#define FINDERS_JUMPPOINTFINDER_HPP_
+
+#include <cstddef>
+#include "core/bitmap.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "searchcontext.hpp"
+
+/**
+ * The pruning and jump point rules of Jump Point Search for one movement
+ * mode, after the JumpPointFinder of PathFinding.js.
+ *
+ * The cells around one are read from its 3x3 neighborhood `n`, see
+ * WalkableBitmap::Neighborhood().
+ */
+template <class Diagonal>
+struct JumpPointRules {
+    typedef std::ptrdiff_t coord_t;
+
+    // Never and OnlyWhenNoObstacles have a forced neighbor where a side
+    // cell opens after a blocked one; Always and IfAtMostOneObstacle where
+    // the next side cell opens after a blocked one, and may cut the corner.
+    static const bool kCornerRule =
+        Diagonal::movement == kDiagonalAlways ||
+        Diagonal::movement == kDiagonalIfAtMostOneObstacle;
+
+    // Whether the cell at (dx, dy) of `n` is walkable.
+    static bool Walkable(unsigned n, int dx, int dy) {
+        return (n >> ((dy + 1) * 3 + dx + 1)) & 1;
+    }
+    // The directions the movement mode allows from the center of `n`.
+    static unsigned Moves(unsigned n) {
+        return NeighborTable::Instance().Lookup(Diagonal::movement,
+                                                NeighborTable::Compact(n));
+    }
+    static unsigned DirectionAt(int dx, int dy) {
+        static const unsigned char dirs[9] = {
+            kDirUpLeft, kDirUp, kDirUpRight,
+            kDirLeft, 0, kDirRight,
+            kDirDownLeft, kDirDown, kDirDownRight
+        };
+        return dirs[(dy + 1) * 3 + dx + 1];
+    }
+    static int Sign(coord_t v) { return v > 0 ? 1 : (v < 0 ? -1 : 0); }
+
+    // Whether the center of `n` has a forced neighbor when reached by the
+    // straight move (dx, dy).
+    static bool IsForcedStraight(unsigned n, int dx, int dy) {
+        // the side cells are the ones across the move
+        int sx = dy < 0 ? -dy : dy, sy = dx < 0 ? -dx : dx;
+        if (kCornerRule) {
+            return (Walkable(n, dx + sx, dy + sy) && !Walkable(n, sx, sy)) ||
+                   (Walkable(n, dx - sx, dy - sy) && !Walkable(n, -sx, -sy));
+        }
+        return (Walkable(n, sx, sy) && !Walkable(n, sx - dx, sy - dy)) ||
+               (Walkable(n, -sx, -sy) && !Walkable(n, -sx - dx, -sy - dy));
+    }
+    // Whether the center of `n` has a forced neighbor when reached by the
+    // diagonal move (dx, dy).
+    static bool IsForcedDiagonal(unsigned n, int dx, int dy) {
+        return kCornerRule &&
+            ((Walkable(n, -dx, dy) && !Walkable(n, -dx, 0)) ||
+             (Walkable(n, dx, -dy) && !Walkable(n, 0, -dy)));
+    }
+
+    // The directions to search from (x, y) when it was reached moving
+    // along (dx, dy), or all of them from the start node (dx = dy = 0).
+    template <class Grid>
+    static unsigned Successors(const Grid &grid, coord_t x, coord_t y,
+                               int dx, int dy);
+};
+
+template <class Diagonal>
+template <class Grid>
+unsigned JumpPointRules<Diagonal>::Successors(
+        const Grid &grid, coord_t x, coord_t y, int dx, int dy) {
+    unsigned n = grid.bitmap().Neighborhood(x, y);
+    if (dx == 0 && dy == 0) {
+        return Moves(n);
+    }
+    unsigned dirs = 0;
+    if (dx != 0 && dy != 0) {
+        dirs = 1u << DirectionAt(0, dy) | 1u << DirectionAt(dx, 0) |
+               1u << DirectionAt(dx, dy);
+        if (kCornerRule) {
+            if (!Walkable(n, -dx, 0)) {
+                dirs |= 1u << DirectionAt(-dx, dy);
+            }
+            if (!Walkable(n, 0, -dy)) {
+                dirs |= 1u << DirectionAt(dx, -dy);
+            }
+        }
+    } else if (kCornerRule) {
+        int sx = dy, sy = dx;
+        dirs = 1u << DirectionAt(dx, dy);
+        if (!Walkable(n, sx, sy)) {
+            dirs |= 1u << DirectionAt(dx + sx, dy + sy);
+        }
+        if (!Walkable(n, -sx, -sy)) {
+            dirs |= 1u << DirectionAt(dx - sx, dy - sy);
+        }
+    } else {
+        int sx = dy, sy = dx;
+        dirs = 1u << DirectionAt(dx, dy) |
+               1u << DirectionAt(dx + sx, dy + sy) |
+               1u << DirectionAt(dx - sx, dy - sy) |
+               1u << DirectionAt(sx, sy) |
+               1u << DirectionAt(-sx, -sy);
+    }
+    // keep the walkable ones the movement mode allows
+    return dirs & Moves(n);
+}
+
+/**
+ * Jump Point Search, after the JumpPointFinder of PathFinding.js, for all
+ * four DiagonalMovement modes.
+ *
+ * Only the jump points enter the open list. The straight jumps test 62
+ * cells per step with word operations on the rows of the walkability
+ * bitmap, or on the rows of the transposed one along a column. The path
+ * returned contains every cell, as the one of AStarFinder.
+ *
+ * @tparam Heuristic      functor int(int dx, int dy), e.g. heuristic::Octile
+ * @tparam Diagonal       DiagonalPolicy<...>
+ * @tparam OpenList       open list policy, see openlist.hpp
+ */
+template <class Heuristic = heuristic::Octile,
+          class Diagonal = DiagonalPolicy<kDiagonalNever>,
+          class OpenList = DefaultOpenList>
+class BasicJumpPointFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef typename grid_t::pnode_t pnode_t;
+    typedef typename grid_t::node_vector_t node_vector_t;
+    typedef typename grid_t::pnode_vector_t pnode_vector_t;
+    typedef BasicSearchContext<OpenList> context_t;
+
+    explicit BasicJumpPointFinder(const Heuristic &heuristic = Heuristic())
+        : heuristic_(heuristic) {}
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, context_t &context) const;
+
+private:
+    typedef JumpPointRules<Diagonal> rules_t;
+    typedef typename rules_t::coord_t coord_t;
+    typedef WalkableBitmap::word_t word_t;
+
+    static coord_t ScanRow(const WalkableBitmap &bitmap, coord_t x,
+                           coord_t y, int dir, coord_t goal);
+    // Jump from (x, y) along (dx, dy) and get the jump point in (jx, jy),
+    // or return false if there is none.
+    static bool Jump(const grid_t &grid, coord_t x, coord_t y,
+                     int dx, int dy, coord_t end_x, coord_t end_y,
+                     coord_t &jx, coord_t &jy);
+    static bool JumpStraight(const grid_t &grid, coord_t x, coord_t y,
+                             int dx, int dy, coord_t end_x, coord_t end_y,
+                             coord_t &jx, coord_t &jy);
+
+    Heuristic heuristic_;
+};
+
+template <class Heuristic, class Diagonal, class OpenList>
+typename BasicJumpPointFinder<Heuristic, Diagonal, OpenList>::pnode_vector_t
+BasicJumpPointFinder<Heuristic, Diagonal, OpenList>::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, context_t &context) const {
+    typedef typename context_t::State state_t;
+    size_type start = grid.IndexAt(start_x, start_y),
+              end = grid.IndexAt(end_x, end_y);
+
+    context.Prepare(grid.size());
+    // the scans take the goal for a jump point even if it is blocked
+    if (!grid.IsWalkableAt(end_x, end_y)) {
+        return pnode_vector_t();
+    }
+    // a goal out of the component of the start fails without a search
+    if (!grid.IsReachable(start_x, start_y, end_x, end_y, Diagonal::movement)) {
+        return pnode_vector_t();
+    }
+    OpenList &open_list = context.open_list();
+
+    // push the start node into the open list
+    state_t &start_state = context.Touch(start);
+    start_state.opened = true;
+    open_list.Push(start, 0, start_state.handle);
+
+    size_type x = 0, y = 0, px = 0, py = 0;
+    coord_t jx = 0, jy = 0;
+    // while the open list is not empty
+    while (!open_list.Empty()) {
+        // pop the position of node which has the minimum `f` value.
+        size_type index = open_list.Pop();
+        state_t &state = context.Touch(index);
+        state.closed = true;
+
+        // if reached the end position, construct the path and return it
+        if (index == end) {
+            return ExpandPath(grid, Backtrace(grid, context, end));
+        }
+
+        // prune the neighbors by the direction of travel
+        grid.CoordsOf(index, x, y);
+        int dx = 0, dy = 0;
+        if (state.parent != context_t::kNoParent) {
+            grid.CoordsOf(state.parent, px, py);
+            dx = rules_t::Sign(coord_t(x) - coord_t(px));
+            dy = rules_t::Sign(coord_t(y) - coord_t(py));
+        }
+        unsigned dirs = rules_t::Successors(grid, x, y, dx, dy);
+        while (dirs) {
+            unsigned dir = LowestBit(dirs);
+            dirs &= dirs - 1;
+            const DirectionOffset &o = OffsetOf(dir);
+            if (!Jump(grid, x, y, o.dx, o.dy, end_x, end_y, jx, jy)) {
+                continue;
+            }
+            size_type jump_index = grid.IndexAt(jx, jy);
+            state_t &jump_state = context.Touch(jump_index);
+            if (jump_state.closed) {
+                continue;
+            }
+
+            // the jump point is on a straight or diagonal line
+            coord_t ax = jx - coord_t(x), ay = jy - coord_t(y);
+            ax = ax < 0 ? -ax : ax;
+            ay = ay < 0 ? -ay : ay;
+            int ng = state.g + int(ax > ay ? 10 * ax + 4 * ay
+                                           : 10 * ay + 4 * ax);
+
+            if (!jump_state.opened || ng < jump_state.g) {
+                jump_state.g = ng;
+                if (!jump_state.opened) {
+                    jump_state.h = heuristic_(
+                        int(10 * (jx - coord_t(end_x))),
+                        int(10 * (jy - coord_t(end_y))));
+                }
+                jump_state.f = jump_state.g + jump_state.h;
+                jump_state.parent = index;
+
+                if (!jump_state.opened) {
+                    jump_state.opened = true;
+                    open_list.Push(jump_index, jump_state.f,
+                                   jump_state.handle);
+                } else {
+                    open_list.Update(jump_state.handle, jump_index,
+                                     jump_state.f);
+                }
+            }
+        }
+    }
+
+    // fail to find the path
+    return pnode_vector_t();
+}
+
+/**
+ * Scan the row y of `bitmap` from the column x + dir on, dir being 1 or
+ * -1, and return the first column that is a jump point of the straight
+ * move: the column `goal` (-1 if the goal is not in this row) or a cell
+ * with a forced neighbor. Return -1 if a blocked cell comes first.
+ *
+ * A word holds 62 columns and the one on each side of them, and the
+ * forced neighbors of all of them are found by a few shifts of the words
+ * of the rows above and below.
+ */
+template <class Heuristic, class Diagonal, class OpenList>
+typename BasicJumpPointFinder<Heuristic, Diagonal, OpenList>::coord_t
+BasicJumpPointFinder<Heuristic, Diagonal, OpenList>::ScanRow(
+        const WalkableBitmap &bitmap, coord_t x, coord_t y, int dir,
+        coord_t goal) {
+    const word_t kInside = (~word_t(0) >> 1) & ~word_t(1);  // bits 1..62
+    const word_t *row = bitmap.Row(y),
+                 *above = row - bitmap.stride(),
+                 *below = row + bitmap.stride();
+    if (dir > 0) {
+        // bit k holds the column c - 1 + k, the padded bit of a column
+        // is one past it
+        for (coord_t c = x + 1; ; c += 62) {
+            word_t cur = WalkableBitmap::Word(row, c),
+                   up = WalkableBitmap::Word(above, c),
+                   down = WalkableBitmap::Word(below, c);
+            word_t forced = rules_t::kCornerRule
+                ? ((up >> 1) & ~up) | ((down >> 1) & ~down)
+                : (up & ~(up << 1)) | (down & ~(down << 1));
+            word_t stop = (~cur | forced) & kInside;
+            coord_t last = stop ? c - 1 + coord_t(LowestBit64(stop))
+                                : c + 61;
+            if (goal >= c && goal <= last) {
+                return goal;
+            }
+            if (stop) {
+                return (cur >> (last - c + 1)) & 1 ? last : -1;
+            }
+        }
+    }
+    // bit k holds the column c - 62 + k
+    for (coord_t c = x - 1; ; c -= 62) {
+        word_t cur = WalkableBitmap::Word(row, c - 61),
+               up = WalkableBitmap::Word(above, c - 61),
+               down = WalkableBitmap::Word(below, c - 61);
+        word_t forced = rules_t::kCornerRule
+            ? ((up << 1) & ~up) | ((down << 1) & ~down)
+            : (up & ~(up >> 1)) | (down & ~(down >> 1));
+        word_t stop = (~cur | forced) & kInside;
+        coord_t first = stop ? c - 62 + coord_t(HighestBit64(stop))
+                             : c - 61;
+        if (goal >= first && goal <= c) {
+            return goal;
+        }
+        if (stop) {
+            return (cur >> (first - c + 62)) & 1 ? first : -1;
+        }
+    }
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+bool BasicJumpPointFinder<Heuristic, Diagonal, OpenList>::Jump(
+        const grid_t &grid, coord_t x, coord_t y, int dx, int dy,
+        coord_t end_x, coord_t end_y, coord_t &jx, coord_t &jy) {
+    const WalkableBitmap &bitmap = grid.bitmap();
+    unsigned n = bitmap.Neighborhood(x, y);
+    if (dx != 0 && dy != 0) {
+        unsigned dir = rules_t::DirectionAt(dx, dy);
+        for (;;) {
+            if (!((rules_t::Moves(n) >> dir) & 1)) {
+                return false;
+            }
+            x += dx;
+            y += dy;
+            n = bitmap.Neighborhood(x, y);
+            if ((x == end_x && y == end_y) ||
+                    rules_t::IsForcedDiagonal(n, dx, dy) ||
+                    // a jump point along either straight component
+                    JumpStraight(grid, x, y, dx, 0, end_x, end_y, jx, jy) ||
+                    JumpStraight(grid, x, y, 0, dy, end_x, end_y, jx, jy)) {
+                jx = x;
+                jy = y;
+                return true;
+            }
+        }
+    }
+    if (Diagonal::movement != kDiagonalNever || dy == 0) {
+        return JumpStraight(grid, x, y, dx, dy, end_x, end_y, jx, jy);
+    }
+    // Without diagonal moves, a vertical jump stops where a horizontal
+    // one finds a jump point, so it goes cell by cell.
+    for (;;) {
+        if (!rules_t::Walkable(n, 0, dy)) {
+            return false;
+        }
+        y += dy;
+        n = bitmap.Neighborhood(x, y);
+        if ((x == end_x && y == end_y) ||
+                rules_t::IsForcedStraight(n, 0, dy) ||
+                JumpStraight(grid, x, y, 1, 0, end_x, end_y, jx, jy) ||
+                JumpStraight(grid, x, y, -1, 0, end_x, end_y, jx, jy)) {
+            jx = x;
+            jy = y;
+            return true;
+        }
+    }
+}
+
+template <class Heuristic, class Diagonal, class OpenList>
+bool BasicJumpPointFinder<Heuristic, Diagonal, OpenList>::JumpStraight(
+        const grid_t &grid, coord_t x, coord_t y, int dx, int dy,
+        coord_t end_x, coord_t end_y, coord_t &jx, coord_t &jy) {
+    if (dy == 0) {
+        jy = y;
+        jx = ScanRow(grid.bitmap(), x, y, dx, end_y == y ? end_x : -1);
+        return jx >= 0;
+    }
+    jx = x;
+    jy = ScanRow(grid.transposed_bitmap(), y, x, dy,
+                 end_x == x ? end_y : -1);
+    return jy >= 0;
+}
+
+/**
+ * Jump Point Search configured at runtime by the movement mode.
+ *
+ * Each query is dispatched to the BasicJumpPointFinder specialized for
+ * the mode, with the Manhattan heuristic without diagonal moves and the
+ * Octile one otherwise.
+ */
+class JumpPointFinder {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef grid_t::pnode_t pnode_t;
+    typedef grid_t::node_vector_t node_vector_t;
+    typedef grid_t::pnode_vector_t pnode_vector_t;
+    typedef SearchContext context_t;
+
+    explicit JumpPointFinder(DiagonalMovement movement = kDiagonalNever)
+        : movement_(movement) {}
+
+    DiagonalMovement movement() const { return movement_; }
+
+    // The search state is kept in `context`, the grid is only read, so
+    // queries on one grid may run concurrently with their own contexts.
+    template <class OpenList>
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid, BasicSearchContext<OpenList> &context) const;
+    // Search with the finder's own context, which keeps the state of the
+    // last query until the next one (see Context()).
+    pnode_vector_t
+    FindPath(size_type start_x, size_type start_y,
+             size_type end_x, size_type end_y,
+             const grid_t &grid) const {
+        return FindPath(start_x, start_y, end_x, end_y, grid, context_);
+    }
+    // The finder's own context, e.g. to show the opened and closed nodes.
+    const context_t &Context() const { return context_; }
+
+private:
+    DiagonalMovement movement_;
+    mutable context_t context_;
+};
+
+template <class OpenList>
+JumpPointFinder::pnode_vector_t
+JumpPointFinder::FindPath(
+        size_type start_x, size_type start_y,
+        size_type end_x, size_type end_y,
+        const grid_t &grid, BasicSearchContext<OpenList> &context) const {
+    switch (movement_) {
+    case kDiagonalAlways:
+        return BasicJumpPointFinder<heuristic::Octile,
+                DiagonalPolicy<kDiagonalAlways>, OpenList>().FindPath(
+            start_x, start_y, end_x, end_y, grid, context);
+    case kDiagonalIfAtMostOneObstacle:
+        return BasicJumpPointFinder<heuristic::Octile,
+                DiagonalPolicy<kDiagonalIfAtMostOneObstacle>, OpenList>()
+            .FindPath(start_x, start_y, end_x, end_y, grid, context);
+    case kDiagonalOnlyWhenNoObstacles:
+        return BasicJumpPointFinder<heuristic::Octile,
+                DiagonalPolicy<kDiagonalOnlyWhenNoObstacles>, OpenList>()
+            .FindPath(start_x, start_y, end_x, end_y, grid, context);
+    default:
+        return BasicJumpPointFinder<heuristic::Manhattan,
+                DiagonalPolicy<kDiagonalNever>, OpenList>().FindPath(
+            start_x, start_y, end_x, end_y, grid, context);
+    }
+}
+
+#endif // FINDERS_JUMPPOINTFINDER_HPP_
@@ -0,0 +1,256 @@
+#ifndef FINDERS_JUMPTABLE_HPP_
+#define FINDERS_JUMPTABLE_HPP_
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "core/grid.hpp"
+#include "core/movement.hpp"
+#include "jumppointfinder.hpp"
+
+/**
+ * The jump distances of JPS+: for every cell and Direction, the number of
+ * steps to the next jump point, found by the rules of JumpPointRules
+ * without a goal, so that a jump is one lookup.
+ *
+ * An entry d > 0 is a jump point d steps away. Otherwise there is none,
+ * and -d steps can be made before a blocked cell or a move the mode does
+ * not allow. Blocked cells have their entries as well, so a search may
+ * start on one as with AStarFinder.
+ *
+ * The table observes its grid. When a cell flips, the rows and columns
+ * around it are computed again, and so are the diagonals through the
+ * cells around it and through the cells whose straight jumps changed.
+ */
+template <class Diagonal = DiagonalPolicy<kDiagonalNever> >
+class JumpTable : public GridObserver, private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef boost::int16_t distance_t;
+
+    // Build the table of `grid` and observe it until destroyed.
+    explicit JumpTable(grid_t &grid);
+    ~JumpTable() { grid_.RemoveObserver(this); }
+
+    distance_t Distance(size_type index, unsigned dir) const {
+        return distances_[index * 8 + dir];
+    }
+    const grid_t &grid() const { return grid_; }
+
+    // Compute the whole table again.
+    void Rebuild();
+    virtual void OnWalkableChanged(size_type x, size_type y, bool walkable);
+
+private:
+    typedef JumpPointRules<Diagonal> rules_t;
+    typedef typename rules_t::coord_t coord_t;
+
+    distance_t &At(coord_t x, coord_t y, unsigned dir) {
+        return distances_[(size_type(y) * grid_.width() + size_type(x)) * 8 +
+                          dir];
+    }
+    // Which of the two directions have a jump point from (x, y), as bits.
+    unsigned char Jumps(coord_t x, coord_t y, unsigned dir1, unsigned dir2) {
+        return (At(x, y, dir1) > 0 ? 1 : 0) | (At(x, y, dir2) > 0 ? 2 : 0);
+    }
+    // Whether (x, y) is a jump point when reached moving in Direction `dir`.
+    bool IsJumpPoint(coord_t x, coord_t y, unsigned dir);
+    // Compute the entries in Direction `dir` of the line through (x, y).
+    void ComputeLine(coord_t x, coord_t y, unsigned dir);
+    // Compute both straight directions of row y, or of column x, and
+    // mark the diagonals through the cells whose jumps changed.
+    void ComputeRow(coord_t y);
+    void ComputeColumn(coord_t x);
+    // Mark the two diagonals through (x, y) to be computed again.
+    void MarkDiagonals(coord_t x, coord_t y);
+    void ComputeDiagonals();
+
+    grid_t &grid_;
+    std::vector<distance_t> distances_;
+    // the diagonals to compute again, indexed by x - y + height - 1 for
+    // the ones going down-right, and by x + y for the ones going up-right
+    std::vector<bool> dirty_falling_;
+    std::vector<bool> dirty_rising_;
+    // the columns to compute again, see OnWalkableChanged()
+    std::vector<bool> dirty_columns_;
+};
+
+template <class Diagonal>
+JumpTable<Diagonal>::JumpTable(grid_t &grid) : grid_(grid) {
+    if (grid.width() > 0x7FFF || grid.height() > 0x7FFF) {
+        throw std::runtime_error("Grid is too large for the jump table");
+    }
+    Rebuild();
+    grid_.AddObserver(this);
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::Rebuild() {
+    coord_t width = coord_t(grid_.width()), height = coord_t(grid_.height());
+    distances_.assign(grid_.size() * 8, 0);
+    dirty_falling_.assign(width + height, true);
+    dirty_rising_.assign(width + height, true);
+    dirty_columns_.assign(width, false);
+    // the diagonal jumps read the straight ones, and without diagonal
+    // moves the vertical jumps read the horizontal ones
+    for (coord_t y = 0; y < height; ++y) {
+        ComputeLine(0, y, kDirRight);
+        ComputeLine(0, y, kDirLeft);
+    }
+    for (coord_t x = 0; x < width; ++x) {
+        ComputeLine(x, 0, kDirDown);
+        ComputeLine(x, 0, kDirUp);
+    }
+    if (Diagonal::movement != kDiagonalNever) {
+        ComputeDiagonals();
+    }
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::OnWalkableChanged(size_type x, size_type y,
+                                            bool /*walkable*/) {
+    // The straight jump points of a cell depend on its 3x3 neighborhood.
+    coord_t cx = coord_t(x), cy = coord_t(y);
+    for (coord_t r = cy - 1; r <= cy + 1; ++r) {
+        if (grid_.IsInside(0, r)) {
+            ComputeRow(r);
+        }
+    }
+    for (coord_t c = cx - 1; c <= cx + 1; ++c) {
+        if (grid_.IsInside(c, 0)) {
+            dirty_columns_[c] = true;
+        }
+    }
+    for (coord_t c = 0; c < coord_t(grid_.width()); ++c) {
+        if (dirty_columns_[c]) {
+            dirty_columns_[c] = false;
+            ComputeColumn(c);
+        }
+    }
+    if (Diagonal::movement == kDiagonalNever) {
+        return;
+    }
+    for (coord_t r = cy - 1; r <= cy + 1; ++r) {
+        for (coord_t c = cx - 1; c <= cx + 1; ++c) {
+            if (grid_.IsInside(c, r)) {
+                MarkDiagonals(c, r);
+            }
+        }
+    }
+    ComputeDiagonals();
+}
+
+template <class Diagonal>
+bool JumpTable<Diagonal>::IsJumpPoint(coord_t x, coord_t y, unsigned dir) {
+    unsigned n = grid_.bitmap().Neighborhood(x, y);
+    const DirectionOffset &o = OffsetOf(dir);
+    if (o.dx != 0 && o.dy != 0) {
+        // a jump point along either straight component
+        return rules_t::IsForcedDiagonal(n, o.dx, o.dy) ||
+               At(x, y, rules_t::DirectionAt(o.dx, 0)) > 0 ||
+               At(x, y, rules_t::DirectionAt(0, o.dy)) > 0;
+    }
+    if (rules_t::IsForcedStraight(n, o.dx, o.dy)) {
+        return true;
+    }
+    // Without diagonal moves, a vertical jump stops where a horizontal
+    // one finds a jump point.
+    return Diagonal::movement == kDiagonalNever && o.dx == 0 &&
+           (At(x, y, kDirLeft) > 0 || At(x, y, kDirRight) > 0);
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::ComputeLine(coord_t x, coord_t y, unsigned dir) {
+    const DirectionOffset &o = OffsetOf(dir);
+    // from the last cell of the line backwards, every entry reads the
+    // one of the next cell
+    while (grid_.IsInside(x + o.dx, y + o.dy)) {
+        x += o.dx;
+        y += o.dy;
+    }
+    const WalkableBitmap &bitmap = grid_.bitmap();
+    for (; grid_.IsInside(x, y); x -= o.dx, y -= o.dy) {
+        unsigned n = bitmap.Neighborhood(x, y);
+        distance_t d = 0;
+        if ((rules_t::Moves(n) >> dir) & 1) {
+            if (IsJumpPoint(x + o.dx, y + o.dy, dir)) {
+                d = 1;
+            } else {
+                distance_t next = At(x + o.dx, y + o.dy, dir);
+                d = distance_t(next > 0 ? next + 1 : next - 1);
+            }
+        }
+        At(x, y, dir) = d;
+    }
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::ComputeRow(coord_t y) {
+    coord_t width = coord_t(grid_.width());
+    std::vector<unsigned char> had(width);
+    for (coord_t x = 0; x < width; ++x) {
+        had[x] = Jumps(x, y, kDirLeft, kDirRight);
+    }
+    ComputeLine(0, y, kDirRight);
+    ComputeLine(0, y, kDirLeft);
+    for (coord_t x = 0; x < width; ++x) {
+        if (Jumps(x, y, kDirLeft, kDirRight) != had[x]) {
+            MarkDiagonals(x, y);
+            if (Diagonal::movement == kDiagonalNever) {
+                dirty_columns_[x] = true;
+            }
+        }
+    }
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::ComputeColumn(coord_t x) {
+    coord_t height = coord_t(grid_.height());
+    std::vector<unsigned char> had(height);
+    for (coord_t y = 0; y < height; ++y) {
+        had[y] = Jumps(x, y, kDirUp, kDirDown);
+    }
+    ComputeLine(x, 0, kDirDown);
+    ComputeLine(x, 0, kDirUp);
+    for (coord_t y = 0; y < height; ++y) {
+        if (Jumps(x, y, kDirUp, kDirDown) != had[y]) {
+            MarkDiagonals(x, y);
+        }
+    }
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::MarkDiagonals(coord_t x, coord_t y) {
+    if (Diagonal::movement == kDiagonalNever) {
+        return;
+    }
+    dirty_falling_[x - y + coord_t(grid_.height()) - 1] = true;
+    dirty_rising_[x + y] = true;
+}
+
+template <class Diagonal>
+void JumpTable<Diagonal>::ComputeDiagonals() {
+    coord_t last_y = coord_t(grid_.height()) - 1;
+    for (coord_t k = 0; k < coord_t(dirty_falling_.size()); ++k) {
+        if (dirty_falling_[k]) {
+            dirty_falling_[k] = false;
+            // a cell of the line x - y = k - last_y
+            coord_t y = k < last_y ? last_y - k : 0, x = k - last_y + y;
+            ComputeLine(x, y, kDirDownRight);
+            ComputeLine(x, y, kDirUpLeft);
+        }
+        if (dirty_rising_[k]) {
+            dirty_rising_[k] = false;
+            // a cell of the line x + y = k
+            coord_t x = k > last_y ? k - last_y : 0, y = k - x;
+            ComputeLine(x, y, kDirUpRight);
+            ComputeLine(x, y, kDirDownLeft);
+        }
+    }
+}
+
+#endif // FINDERS_JUMPTABLE_HPP_
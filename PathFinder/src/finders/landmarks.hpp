@@ -0,0 +1,421 @@
+#ifndef FINDERS_LANDMARKS_HPP_
+#define FINDERS_LANDMARKS_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/bind.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/shared_ptr.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/workpool.hpp"
+#include "flowfield.hpp"
+#include "option.hpp"
+
+/**
+ * The exact distances from a few landmark cells to every cell, for the
+ * ALT heuristic: by the triangle inequality, the distance between two
+ * cells is at least the difference of their distances to any landmark.
+ *
+ * The landmarks are spread along the border of the map, in its largest
+ * component, and their distances are computed by one FlowField each, on
+ * a WorkStealingPool. The distances of a cell to all the landmarks are
+ * next to each other, so that the heuristic reads one cache line.
+ *
+ * The table is saved to a binary file and loaded again at the next start,
+ * with a hash of the walkable cells to tell whether it still fits the
+ * grid. It is not kept up to date with the grid: once a cell opens the
+ * bounds may be too high, so Build() it again.
+ */
+class LandmarkTable : private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef boost::uint32_t distance_t;
+
+    static const distance_t kUnreachable = 0xFFFFFFFFu;
+    enum { kMaxLandmarks = 32 };
+
+    LandmarkTable()
+        : width_(0), height_(0), movement_(kDiagonalNever), hash_(0) {}
+
+    // Pick `count` landmarks and compute their distances with the moves of
+    // `movement`. `workers` 0 is one per hardware thread.
+    void Build(const grid_t &grid, DiagonalMovement movement,
+               unsigned count, unsigned workers = 0);
+    // The same with the given landmark cells.
+    void Build(const grid_t &grid, DiagonalMovement movement,
+               const std::vector<size_type> &landmarks, unsigned workers = 0);
+
+    // Write the table, or read one written by Save(), throwing
+    // std::runtime_error if it is not one.
+    void Save(std::ostream &out) const;
+    void Load(std::istream &in);
+    // Whether the table was built on a grid of the same walkable cells.
+    bool Fits(const grid_t &grid) const {
+        return grid.width() == width_ && grid.height() == height_ &&
+               Hash(grid) == hash_;
+    }
+
+    // The distances of the cell `index` to each landmark, or kUnreachable.
+    const distance_t *Distances(size_type index) const {
+        return distances_.empty() ? 0 : &distances_[index * landmarks_.size()];
+    }
+    const std::vector<size_type> &landmarks() const { return landmarks_; }
+    size_type width() const { return width_; }
+    size_type height() const { return height_; }
+    DiagonalMovement movement() const { return movement_; }
+
+private:
+    template <class Diagonal>
+    void ComputeDistances(const grid_t &grid, unsigned workers);
+    template <class Diagonal>
+    static void ComputeLandmark(
+        std::vector<boost::shared_ptr<FlowField<Diagonal> > > *fields,
+        const std::vector<size_type> *landmarks,
+        std::vector<std::vector<int> > *columns,
+        unsigned worker, size_type i);
+    // The cells of the largest component, evenly spaced along the border.
+    static std::vector<size_type> PickLandmarks(
+        const grid_t &grid, DiagonalMovement movement, unsigned count);
+    static boost::uint32_t Hash(const grid_t &grid);
+
+    size_type width_;
+    size_type height_;
+    DiagonalMovement movement_;
+    boost::uint32_t hash_;
+    std::vector<size_type> landmarks_;
+    std::vector<distance_t> distances_;
+};
+
+/**
+ * The ALT heuristic of a LandmarkTable, to be set as the heuristic of a
+ * FinderOption through a GoalHeuristic (see option.hpp).
+ *
+ * A heuristic only gets the differences to the goal, so the finder binds
+ * it to the goal of each query by To(), which finds the cell again from
+ * them. Unbound, as by a finder that does not know it, it is the octile
+ * distance, still a lower bound. Bound, it is the largest of the octile
+ * distance and the bounds of the landmarks, and stays consistent.
+ */
+class LandmarkHeuristic : public GoalBoundHeuristic {
+public:
+    typedef std::size_t size_type;
+
+    class Bound {
+    public:
+        int operator()(int dx, int dy) const;
+
+    private:
+        friend class LandmarkHeuristic;
+        const LandmarkTable *table_;
+        size_type goal_x_;
+        size_type goal_y_;
+        LandmarkTable::distance_t goal_[LandmarkTable::kMaxLandmarks];
+    };
+
+    explicit LandmarkHeuristic(boost::shared_ptr<const LandmarkTable> table)
+        : table_(table) {}
+
+    int operator()(int dx, int dy) const {
+        return heuristic::Octile()(dx, dy);
+    }
+    // The heuristic towards the goal (goal_x, goal_y).
+    Bound To(size_type goal_x, size_type goal_y) const;
+    // To(), if the table is the one of the grid size and the moves.
+    FinderOption::heuristic_t Bind(
+            size_type goal_x, size_type goal_y, size_type width,
+            size_type height, DiagonalMovement movement) const {
+        if (table_->movement() != movement || table_->width() != width ||
+                table_->height() != height) {
+            return FinderOption::heuristic_t();
+        }
+        return To(goal_x, goal_y);
+    }
+    const LandmarkTable &table() const { return *table_; }
+
+private:
+    boost::shared_ptr<const LandmarkTable> table_;
+};
+
+inline void LandmarkTable::Build(const grid_t &grid,
+        DiagonalMovement movement, unsigned count, unsigned workers) {
+    Build(grid, movement, PickLandmarks(grid, movement, count), workers);
+}
+
+inline void LandmarkTable::Build(const grid_t &grid,
+        DiagonalMovement movement, const std::vector<size_type> &landmarks,
+        unsigned workers) {
+    if (landmarks.size() > kMaxLandmarks) {
+        throw std::invalid_argument("Too many landmarks");
+    }
+    width_ = grid.width();
+    height_ = grid.height();
+    movement_ = movement;
+    hash_ = Hash(grid);
+    landmarks_ = landmarks;
+    switch (movement) {
+    case kDiagonalAlways:
+        ComputeDistances<DiagonalPolicy<kDiagonalAlways> >(grid, workers);
+        break;
+    case kDiagonalIfAtMostOneObstacle:
+        ComputeDistances<DiagonalPolicy<kDiagonalIfAtMostOneObstacle> >(
+            grid, workers);
+        break;
+    case kDiagonalOnlyWhenNoObstacles:
+        ComputeDistances<DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> >(
+            grid, workers);
+        break;
+    default:
+        ComputeDistances<DiagonalPolicy<kDiagonalNever> >(grid, workers);
+        break;
+    }
+}
+
+template <class Diagonal>
+void LandmarkTable::ComputeDistances(const grid_t &grid, unsigned workers) {
+    typedef FlowField<Diagonal> field_t;
+    WorkStealingPool pool(std::min<size_type>(
+        workers ? workers : boost::thread::hardware_concurrency(),
+        std::max<size_type>(landmarks_.size(), 1)));
+    std::vector<boost::shared_ptr<field_t> > fields;
+    for (unsigned i = 0; i < pool.workers(); ++i) {
+        fields.push_back(boost::shared_ptr<field_t>(new field_t(grid)));
+    }
+    // one column per landmark, so that the workers do not write to the
+    // same cache lines
+    std::vector<std::vector<int> > columns(landmarks_.size());
+    pool.Run(landmarks_.size(), boost::bind(&ComputeLandmark<Diagonal>,
+        &fields, &landmarks_, &columns, _1, _2));
+
+    size_type count = landmarks_.size();
+    distances_.resize(grid.size() * count);
+    for (size_type k = 0; k < count; ++k) {
+        const std::vector<int> &column = columns[k];
+        for (size_type i = 0; i < grid.size(); ++i) {
+            distances_[i * count + k] = column[i] == field_t::kUnreachable
+                ? distance_t(kUnreachable) : distance_t(column[i]);
+        }
+    }
+}
+
+template <class Diagonal>
+void LandmarkTable::ComputeLandmark(
+        std::vector<boost::shared_ptr<FlowField<Diagonal> > > *fields,
+        const std::vector<size_type> *landmarks,
+        std::vector<std::vector<int> > *columns,
+        unsigned worker, size_type i) {
+    FlowField<Diagonal> &field = *(*fields)[worker];
+    size_type x = 0, y = 0;
+    field.grid().CoordsOf((*landmarks)[i], x, y);
+    field.Build(x, y);
+    (*columns)[i] = field.distances();
+}
+
+inline std::vector<LandmarkTable::size_type>
+LandmarkTable::PickLandmarks(const grid_t &grid, DiagonalMovement movement,
+                             unsigned count) {
+    std::vector<size_type> landmarks;
+    const ComponentIndex &components = grid.components(movement);
+    std::vector<size_type> sizes;
+    ComponentIndex::label_t largest = ComponentIndex::kNoComponent;
+    for (size_type i = 0; i < grid.size(); ++i) {
+        ComponentIndex::label_t label = components.Component(i);
+        if (label == ComponentIndex::kNoComponent) {
+            continue;
+        }
+        if (sizes.size() <= label) {
+            sizes.resize(label + 1, 0);
+        }
+        if (++sizes[label] > sizes[largest]) {
+            largest = label;
+        }
+    }
+    if (largest == ComponentIndex::kNoComponent) {
+        return landmarks;
+    }
+
+    // walk the border, and take the cell of the component nearest to
+    // each point
+    size_type w = grid.width(), h = grid.height();
+    size_type perimeter = w + h > 2 ? 2 * (w + h) - 4 : w * h;
+    for (unsigned i = 0; i < count; ++i) {
+        size_type p = perimeter * i / count, bx = 0, by = 0;
+        if (p < w) {
+            bx = p;
+        } else if ((p -= w) < h - 1) {
+            bx = w - 1, by = p + 1;
+        } else if ((p -= h - 1) < w - 1) {
+            bx = w - 2 - p, by = h - 1;
+        } else {
+            by = h - 2 - (p - (w - 1));
+        }
+        size_type found = 0, nearest = size_type(-1);
+        for (size_type y = 0, index = 0; y < h; ++y) {
+            for (size_type x = 0; x < w; ++x, ++index) {
+                size_type d = std::max(x > bx ? x - bx : bx - x,
+                                       y > by ? y - by : by - y);
+                if (d < nearest && components.Component(index) == largest) {
+                    found = index;
+                    nearest = d;
+                }
+            }
+        }
+        if (std::find(landmarks.begin(), landmarks.end(), found) ==
+                landmarks.end()) {
+            landmarks.push_back(found);
+        }
+    }
+    return landmarks;
+}
+
+inline boost::uint32_t LandmarkTable::Hash(const grid_t &grid) {
+    // FNV-1a over the walkable cells, row by row
+    boost::uint32_t hash = 2166136261u;
+    for (size_type y = 0; y < grid.height(); ++y) {
+        for (size_type x = 0; x < grid.width(); ++x) {
+            hash = (hash ^ (grid.IsWalkableAt(x, y) ? 1u : 0u)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+namespace landmarks_detail {
+
+const boost::uint32_t kMagic = 0x4D4C4650;  // "PFLM"
+const boost::uint32_t kVersion = 1;
+
+// Words are written little-endian, whatever the machine.
+inline void Write(std::ostream &out, boost::uint32_t word, unsigned bytes) {
+    char buffer[4];
+    for (unsigned i = 0; i < bytes; ++i) {
+        buffer[i] = char((word >> (8 * i)) & 0xFF);
+    }
+    out.write(buffer, bytes);
+}
+
+inline boost::uint32_t Read(std::istream &in, unsigned bytes) {
+    unsigned char buffer[4];
+    if (!in.read(reinterpret_cast<char *>(buffer), bytes)) {
+        throw std::runtime_error("Landmark file is truncated");
+    }
+    boost::uint32_t word = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+        word |= boost::uint32_t(buffer[i]) << (8 * i);
+    }
+    return word;
+}
+
+}  // landmarks_detail
+
+/*
+ * The file is the header words: magic, version, width, height, movement,
+ * hash, landmark count and the bytes per distance (2 or 4), then the
+ * landmark cells, and the distances by cell then landmark. The distances
+ * are even, and stored halved; on 2 bytes when the largest one fits.
+ */
+inline void LandmarkTable::Save(std::ostream &out) const {
+    using namespace landmarks_detail;
+    distance_t largest = 0;
+    for (size_type i = 0; i < distances_.size(); ++i) {
+        if (distances_[i] != kUnreachable) {
+            largest = std::max(largest, distances_[i] / 2);
+        }
+    }
+    unsigned bytes = largest < 0xFFFFu ? 2 : 4;
+    distance_t unreachable =
+        bytes == 2 ? 0xFFFFu : distance_t(kUnreachable);
+    Write(out, kMagic, 4);
+    Write(out, kVersion, 4);
+    Write(out, boost::uint32_t(width_), 4);
+    Write(out, boost::uint32_t(height_), 4);
+    Write(out, boost::uint32_t(movement_), 4);
+    Write(out, hash_, 4);
+    Write(out, boost::uint32_t(landmarks_.size()), 4);
+    Write(out, bytes, 4);
+    for (size_type i = 0; i < landmarks_.size(); ++i) {
+        Write(out, boost::uint32_t(landmarks_[i]), 4);
+    }
+    for (size_type i = 0; i < distances_.size(); ++i) {
+        Write(out, distances_[i] == kUnreachable
+            ? unreachable : distances_[i] / 2, bytes);
+    }
+    if (!out) {
+        throw std::runtime_error("Fail to write the landmark file");
+    }
+}
+
+inline void LandmarkTable::Load(std::istream &in) {
+    using namespace landmarks_detail;
+    if (Read(in, 4) != kMagic || Read(in, 4) != kVersion) {
+        throw std::runtime_error("Not a landmark file");
+    }
+    size_type width = Read(in, 4), height = Read(in, 4);
+    boost::uint32_t movement = Read(in, 4), hash = Read(in, 4),
+                    count = Read(in, 4), bytes = Read(in, 4);
+    if (movement >= kDiagonalMovementCount || count > kMaxLandmarks ||
+            (bytes != 2 && bytes != 4)) {
+        throw std::runtime_error("Landmark file is corrupt");
+    }
+    std::vector<size_type> landmarks(count);
+    for (size_type i = 0; i < count; ++i) {
+        landmarks[i] = Read(in, 4);
+        if (landmarks[i] >= width * height) {
+            throw std::runtime_error("Landmark file is corrupt");
+        }
+    }
+    distance_t unreachable =
+        bytes == 2 ? 0xFFFFu : distance_t(kUnreachable);
+    std::vector<distance_t> distances(width * height * count);
+    for (size_type i = 0; i < distances.size(); ++i) {
+        distance_t d = Read(in, bytes);
+        distances[i] = d == unreachable ? distance_t(kUnreachable) : d * 2;
+    }
+    width_ = width;
+    height_ = height;
+    movement_ = DiagonalMovement(movement);
+    hash_ = hash;
+    landmarks_.swap(landmarks);
+    distances_.swap(distances);
+}
+
+inline LandmarkHeuristic::Bound
+LandmarkHeuristic::To(size_type goal_x, size_type goal_y) const {
+    Bound bound;
+    bound.table_ = table_.get();
+    bound.goal_x_ = goal_x;
+    bound.goal_y_ = goal_y;
+    const LandmarkTable::distance_t *goal =
+        table_->Distances(goal_y * table_->width() + goal_x);
+    std::copy(goal, goal + table_->landmarks().size(), bound.goal_);
+    return bound;
+}
+
+inline int LandmarkHeuristic::Bound::operator()(int dx, int dy) const {
+    BOOST_ASSERT_MSG(dx % 10 == 0 && dy % 10 == 0,
+                     "Oops, a landmark bound between fractions of cells.");
+    int bound = heuristic::Octile()(dx, dy);
+    size_type x = size_type(std::ptrdiff_t(goal_x_) + dx / 10),
+              y = size_type(std::ptrdiff_t(goal_y_) + dy / 10);
+    const LandmarkTable::distance_t *cell =
+        table_->Distances(y * table_->width() + x);
+    for (size_type k = 0, n = table_->landmarks().size(); k < n; ++k) {
+        if (cell[k] == LandmarkTable::kUnreachable ||
+                goal_[k] == LandmarkTable::kUnreachable) {
+            continue;
+        }
+        int d = int(cell[k]) - int(goal_[k]);
+        bound = std::max(bound, d < 0 ? -d : d);
+    }
+    return bound;
+}
+
+#endif // FINDERS_LANDMARKS_HPP_
@@ -0,0 +1,233 @@
+#ifndef FINDERS_OPENLIST_HPP_
+#define FINDERS_OPENLIST_HPP_
+
+#include <vector>
+#include <boost/heap/pairing_heap.hpp>
+#include "boost/assert.hpp"
+
+/**
+ * Open list policies of the A* family, picked at compile time by the
+ * search context type (see BasicSearchContext).
+ *
+ * Every policy has the same interface:
+ *
+ *     typedef ... handle_type;  // kept in the search record of the cell
+ *     void Clear();
+ *     bool Empty() const;
+ *     // Insert the cell `index` with key `f`, and set its handle.
+ *     void Push(size_type index, int f, handle_type &handle);
+ *     // Lower the key of the cell to `f`, which must not be larger.
+ *     void Update(handle_type &handle, size_type index, int f);
+ *     // Remove the cell with the minimum key and return it.
+ *     size_type Pop();
+ *
+ * A handle is only read while its cell is in the list, and it must stay
+ * at the same address until the list is cleared.
+ */
+
+// boost::heap::pairing_heap of (f, cell index).
+class PairingHeapOpenList {
+public:
+    typedef std::size_t size_type;
+    struct Entry {
+        Entry(int f, size_type index) : f(f), index(index) {}
+        int f;
+        size_type index;
+    };
+    struct FCmp {
+        bool operator()(const Entry &lhs, const Entry &rhs) const {
+            return lhs.f > rhs.f;
+        }
+    };
+    typedef boost::heap::pairing_heap<Entry,
+        boost::heap::compare<FCmp> > heap_t;
+    typedef heap_t::handle_type handle_type;
+
+    void Clear() { heap_.clear(); }
+    bool Empty() const { return heap_.empty(); }
+    void Push(size_type index, int f, handle_type &handle) {
+        handle = heap_.push(Entry(f, index));
+    }
+    void Update(handle_type &handle, size_type index, int f) {
+        heap_.increase(handle, Entry(f, index));
+    }
+    size_type Pop() {
+        size_type index = heap_.top().index;
+        heap_.pop();
+        return index;
+    }
+
+private:
+    heap_t heap_;
+};
+
+// Implicit D-ary min-heap in one array. Each entry points back to the
+// handle of its cell, which holds the entry's position for Update().
+template <unsigned D = 4>
+class DAryHeapOpenList {
+public:
+    typedef std::size_t size_type;
+    typedef size_type handle_type;
+
+    void Clear() { entries_.clear(); }
+    bool Empty() const { return entries_.empty(); }
+    void Push(size_type index, int f, handle_type &handle) {
+        Entry entry = {f, index, &handle};
+        entries_.push_back(entry);
+        SiftUp(entries_.size() - 1);
+    }
+    void Update(handle_type &handle, size_type index, int f) {
+        BOOST_ASSERT(entries_[handle].index == index);
+        BOOST_ASSERT(f <= entries_[handle].f);
+        entries_[handle].f = f;
+        SiftUp(handle);
+    }
+    size_type Pop() {
+        size_type index = entries_[0].index;
+        entries_[0] = entries_.back();
+        entries_.pop_back();
+        if (!entries_.empty()) {
+            SiftDown(0);
+        }
+        return index;
+    }
+
+private:
+    struct Entry {
+        int f;
+        size_type index;
+        handle_type *handle;
+    };
+
+    void SiftUp(size_type pos) {
+        Entry entry = entries_[pos];
+        while (pos > 0) {
+            size_type parent = (pos - 1) / D;
+            if (entries_[parent].f <= entry.f) {
+                break;
+            }
+            Place(pos, entries_[parent]);
+            pos = parent;
+        }
+        Place(pos, entry);
+    }
+    void SiftDown(size_type pos) {
+        Entry entry = entries_[pos];
+        size_type n = entries_.size();
+        for (;;) {
+            size_type first = pos * D + 1;
+            if (first >= n) {
+                break;
+            }
+            size_type last = first + D < n ? first + D : n;
+            size_type best = first;
+            for (size_type child = first + 1; child < last; ++child) {
+                if (entries_[child].f < entries_[best].f) {
+                    best = child;
+                }
+            }
+            if (entry.f <= entries_[best].f) {
+                break;
+            }
+            Place(pos, entries_[best]);
+            pos = best;
+        }
+        Place(pos, entry);
+    }
+    void Place(size_type pos, const Entry &entry) {
+        entries_[pos] = entry;
+        *entry.handle = pos;
+    }
+
+    std::vector<Entry> entries_;
+};
+
+/**
+ * Bucket queue on the integer key: one LIFO bucket per f value and a
+ * cursor at the lowest bucket that may be non-empty.
+ *
+ * With a consistent heuristic and weight 1 the popped keys never
+ * decrease, so the cursor only moves forward and every operation is O(1)
+ * amortized. A key below the cursor (e.g. a weighted heuristic) just moves
+ * the cursor back. Update() inserts the cell again and leaves the old
+ * entry behind, it is recognized as stale by its key on Pop().
+ */
+class BucketOpenList {
+public:
+    typedef std::size_t size_type;
+    // the current key of the cell
+    typedef int handle_type;
+
+    BucketOpenList() : size_(0), cursor_(0), top_(0) {}
+
+    void Clear() {
+        for (size_type f = cursor_; f < top_; ++f) {
+            buckets_[f].clear();
+        }
+        size_ = 0;
+        cursor_ = 0;
+        top_ = 0;
+    }
+    bool Empty() const { return size_ == 0; }
+    void Push(size_type index, int f, handle_type &handle) {
+        handle = f;
+        Insert(index, f, handle);
+        ++size_;
+    }
+    void Update(handle_type &handle, size_type index, int f) {
+        BOOST_ASSERT(f <= handle);
+        handle = f;
+        Insert(index, f, handle);
+    }
+    size_type Pop() {
+        for (;;) {
+            while (buckets_[cursor_].empty()) {
+                ++cursor_;
+            }
+            Entry entry = buckets_[cursor_].back();
+            buckets_[cursor_].pop_back();
+            if (*entry.handle == int(cursor_)) {
+                --size_;
+                // mark it popped, so that its stale entries are skipped
+                *entry.handle = -1;
+                return entry.index;
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        size_type index;
+        handle_type *handle;
+    };
+
+    void Insert(size_type index, int f, handle_type &handle) {
+        BOOST_ASSERT(f >= 0);
+        size_type key = size_type(f);
+        if (size_ == 0) {
+            // with no live entry left, the rest of the buckets are stale
+            for (size_type k = cursor_; k < top_; ++k) {
+                buckets_[k].clear();
+            }
+            cursor_ = top_ = key;
+        }
+        if (key >= buckets_.size()) {
+            buckets_.resize(key + key / 2 + 1);
+        }
+        Entry entry = {index, &handle};
+        buckets_[key].push_back(entry);
+        if (key < cursor_) {
+            cursor_ = key;
+        }
+        if (key >= top_) {
+            top_ = key + 1;
+        }
+    }
+
+    size_type size_;    // the number of live entries
+    size_type cursor_;  // no live entry is below it
+    size_type top_;     // no entry is at or above it
+    std::vector<std::vector<Entry> > buckets_;
+};
+
+#endif // FINDERS_OPENLIST_HPP_
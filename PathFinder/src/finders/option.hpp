@@ -1,7 +1,11 @@
 #ifndef FINDERS_OPTION_HPP_
 #define FINDERS_OPTION_HPP_
 
+#include <cstddef>
 #include "boost/function.hpp"
+#include "boost/shared_ptr.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
 
 struct FinderOption {
     typedef boost::function<int(int, int)> heuristic_t;
@@ -16,4 +20,90 @@ struct FinderOption {
     int weight;
 };
 
+/**
+ * A heuristic that needs the goal cell, and not only the differences to
+ * it, e.g. LandmarkHeuristic (see landmarks.hpp). It is the heuristic of
+ * a FinderOption through a GoalHeuristic:
+ *
+ *     option.heuristic = GoalHeuristic(new LandmarkHeuristic(table));
+ *
+ * The finders that dispatch on the option, see DispatchHeuristic(), bind
+ * it to the goal of each query by Bind(); the other ones call it
+ * unbound, which must be a lower bound too.
+ */
+class GoalBoundHeuristic {
+public:
+    typedef std::size_t size_type;
+    virtual ~GoalBoundHeuristic() {}
+
+    // The heuristic unbound.
+    virtual int operator()(int dx, int dy) const = 0;
+    // The heuristic towards (goal_x, goal_y), on a grid of `width` by
+    // `height` cells with the moves of `movement`, or an empty one if it
+    // does not fit them.
+    virtual FinderOption::heuristic_t Bind(
+        size_type goal_x, size_type goal_y, size_type width, size_type height,
+        DiagonalMovement movement) const = 0;
+};
+
+// A GoalBoundHeuristic, shared by the copies of the option.
+class GoalHeuristic {
+public:
+    // Take `heuristic`, to be deleted with the last copy.
+    explicit GoalHeuristic(const GoalBoundHeuristic *heuristic)
+        : heuristic_(heuristic) {}
+
+    int operator()(int dx, int dy) const { return (*heuristic_)(dx, dy); }
+    const GoalBoundHeuristic &heuristic() const { return *heuristic_; }
+
+private:
+    boost::shared_ptr<const GoalBoundHeuristic> heuristic_;
+};
+
+// The option of the finders given none: no diagonal moves, Manhattan.
+inline boost::shared_ptr<FinderOption> DefaultOption() {
+    FinderOption option = {false, false, heuristic::Manhattan(), 1};
+    return boost::shared_ptr<FinderOption>(new FinderOption(option));
+}
+
+// Call the heuristic of an option through its boost::function.
+struct FunctionHeuristic {
+    FunctionHeuristic(const FinderOption::heuristic_t *function = 0)
+        : function(function) {}
+    int operator()(int dx, int dy) const { return (*function)(dx, dy); }
+    const FinderOption::heuristic_t *function;
+};
+
+/**
+ * Call `visitor` with the heuristic `h` as the type a finder is
+ * specialized on: the functor of core/heuristic.hpp it holds, or the
+ * GoalHeuristic it holds bound to (end_x, end_y), as a
+ * FinderOption::heuristic_t, if it fits the grid of `width` by `height`
+ * cells and `movement`, or else FunctionHeuristic.
+ * FunctionHeuristic points to `h`, which must outlive its use.
+ */
+template <class Visitor>
+typename Visitor::result_type
+DispatchHeuristic(const FinderOption::heuristic_t &h,
+                  std::size_t end_x, std::size_t end_y,
+                  std::size_t width, std::size_t height,
+                  DiagonalMovement movement, const Visitor &visitor) {
+    if (h.target<heuristic::Manhattan>()) {
+        return visitor(heuristic::Manhattan());
+    } else if (h.target<heuristic::Octile>()) {
+        return visitor(heuristic::Octile());
+    } else if (h.target<heuristic::Chebyshev>()) {
+        return visitor(heuristic::Chebyshev());
+    } else if (h.target<heuristic::Euclidean>()) {
+        return visitor(heuristic::Euclidean());
+    } else if (const GoalHeuristic *goal = h.target<GoalHeuristic>()) {
+        FinderOption::heuristic_t bound = goal->heuristic().Bind(
+            end_x, end_y, width, height, movement);
+        if (bound) {
+            return visitor(bound);
+        }
+    }
+    return visitor(FunctionHeuristic(&h));
+}
+
 #endif // FINDERS_OPTION_HPP_
@@ -0,0 +1,397 @@
+#ifndef FINDERS_PATHCACHE_HPP_
+#define FINDERS_PATHCACHE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <list>
+#include <typeinfo>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/functional/hash.hpp"
+#include "boost/noncopyable.hpp"
+#include "boost/unordered_map.hpp"
+#include "core/grid.hpp"
+#include "core/heuristic.hpp"
+#include "core/movement.hpp"
+#include "core/utils.hpp"
+#include "astarfinder.hpp"
+#include "option.hpp"
+
+/**
+ * The last paths found on a grid, by their query, so that a query asked
+ * again costs a hash lookup instead of a search.
+ *
+ * The grid is cut into square regions, and the cache observes it to know
+ * when each region was last edited. A path is kept with the regions it
+ * crosses, those of its cells and of the corners of its diagonal moves:
+ * - a cell blocked in one of them may cut the path, which is dropped;
+ * - a cell opened anywhere may only shorten it, and is checked against
+ *   its cost: the path is also kept with the regions where any way from
+ *   one of its ends to the region, or its border, and on to the other end
+ *   is shorter, and is dropped once a cell of one of them is opened.
+ * The other edits leave the paths as the finder would find them again, up
+ * to ties. Each region keeps the last edit that blocked, and the last one
+ * that opened, one of its cells, so a hit reads the regions of its path
+ * only.
+ *
+ * The least recently used path goes once the cache is full. The queries
+ * without a path are not kept, Grid::IsReachable() tells most of them,
+ * nor the ones of a heuristic that cannot be told apart from another of
+ * its type (see Options). The cache is not thread safe.
+ */
+class PathCache : public GridObserver, private boost::noncopyable {
+public:
+    typedef std::size_t size_type;
+    typedef BaseNode<size_type> node_t;
+    typedef Grid<node_t> grid_t;
+    typedef grid_t::pnode_t pnode_t;
+    typedef grid_t::node_vector_t node_vector_t;
+    typedef grid_t::pnode_vector_t pnode_vector_t;
+
+    typedef int (*function_t)(int, int);
+
+    // What a path depends on besides the ends of its query.
+    struct Options {
+        DiagonalMovement movement;
+        int weight;
+        // the type of the heuristic, which tells apart the ones of
+        // core/heuristic.hpp
+        const std::type_info *heuristic;
+        // the function of a function pointer, and the heuristic shared by
+        // a GoalHeuristic, which tell apart the others
+        function_t function;
+        const void *object;
+        // false for the heuristics of any other type, whose paths are
+        // not kept
+        bool cached;
+
+        static Options Of(const FinderOption &option);
+    };
+
+    // Cache up to `capacity` paths of `grid`, observing it until destroyed.
+    explicit PathCache(grid_t &grid, size_type capacity = 1024,
+                       size_type region_size = 16);
+    ~PathCache() { grid_.RemoveObserver(this); }
+
+    // A copy of the path kept for the query, or an empty pointer.
+    pnode_vector_t Find(size_type start_x, size_type start_y,
+                        size_type end_x, size_type end_y,
+                        const Options &options);
+    // Keep the path `path` found for the query.
+    void Insert(size_type start_x, size_type start_y,
+                size_type end_x, size_type end_y,
+                const Options &options, const pnode_vector_t &path);
+
+    // The path kept for the query, or else the one `finder` finds with
+    // `context`, which is kept.
+    template <class Finder, class Context>
+    pnode_vector_t FindPath(const Finder &finder, const Options &options,
+                            size_type start_x, size_type start_y,
+                            size_type end_x, size_type end_y,
+                            Context &context);
+    // The same with the options of the finder.
+    template <class Context>
+    pnode_vector_t FindPath(const AStarFinder &finder,
+                            size_type start_x, size_type start_y,
+                            size_type end_x, size_type end_y,
+                            Context &context) {
+        return FindPath(finder, Options::Of(finder.Option()),
+                        start_x, start_y, end_x, end_y, context);
+    }
+
+    // Forget every path.
+    void Clear();
+
+    size_type size() const { return entries_.size(); }
+    size_type capacity() const { return capacity_; }
+    // The queries answered from the cache, and the other ones.
+    size_type hits() const { return hits_; }
+    size_type misses() const { return misses_; }
+
+    virtual void OnWalkableChanged(size_type x, size_type y, bool walkable);
+
+private:
+    typedef boost::uint32_t region_t;
+    // the count of edits, from 1
+    typedef unsigned long tick_t;
+
+    struct Key {
+        size_type start;
+        size_type end;
+        Options options;
+
+        bool operator==(const Key &other) const {
+            return start == other.start && end == other.end &&
+                options.movement == other.options.movement &&
+                options.weight == other.options.weight &&
+                *options.heuristic == *other.options.heuristic &&
+                options.function == other.options.function &&
+                options.object == other.options.object;
+        }
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const {
+            std::size_t seed = 0;
+            boost::hash_combine(seed, key.start);
+            boost::hash_combine(seed, key.end);
+            boost::hash_combine(seed, int(key.options.movement));
+            boost::hash_combine(seed, key.options.weight);
+            // by the address of the type, one per type in practice
+            boost::hash_combine(seed, key.options.heuristic);
+            boost::hash_combine(seed, key.options.object);
+            return seed;
+        }
+    };
+    struct Entry {
+        Key key;
+        node_vector_t path;
+        int cost;
+        // the last edit the path was found after
+        tick_t found;
+        // the regions it crosses, sorted
+        std::vector<region_t> regions;
+        // the regions where an opened cell may shorten it
+        std::vector<region_t> shortcuts;
+    };
+    typedef std::list<Entry> entry_list_t;
+    typedef boost::unordered_map<Key, entry_list_t::iterator, KeyHash>
+        index_t;
+    region_t RegionOf(size_type x, size_type y) const {
+        return region_t((y / region_size_) * regions_x_ + x / region_size_);
+    }
+    Key MakeKey(size_type start_x, size_type start_y,
+                size_type end_x, size_type end_y,
+                const Options &options) const {
+        Key key = {grid_.IndexAt(start_x, start_y),
+                   grid_.IndexAt(end_x, end_y), options};
+        return key;
+    }
+    // Whether the path of `entry` is still the one a search would find.
+    bool IsValid(const Entry &entry) const;
+    // Whether a cell opened in `region` may shorten the path of `entry`.
+    bool MayShorten(const Entry &entry, region_t region) const;
+    // List the regions where an opened cell may shorten the path.
+    void FindShortcuts(Entry &entry) const;
+    void Erase(index_t::iterator it);
+
+    grid_t &grid_;
+    size_type capacity_;
+    size_type region_size_;
+    size_type regions_x_;
+    entry_list_t entries_;  // the most recently used first
+    index_t index_;
+    tick_t tick_;
+    // the last edit blocking, and opening, a cell of each region
+    std::vector<tick_t> blocked_;
+    std::vector<tick_t> opened_;
+    // the last edit opening a cell anywhere
+    tick_t last_opened_;
+    size_type hits_;
+    size_type misses_;
+};
+
+inline PathCache::PathCache(grid_t &grid, size_type capacity,
+                            size_type region_size)
+        : grid_(grid), capacity_(capacity), region_size_(region_size),
+          regions_x_((grid.width() + region_size - 1) / region_size),
+          tick_(0), last_opened_(0), hits_(0), misses_(0) {
+    BOOST_ASSERT_MSG(region_size > 0, "Oops, PathCache with empty regions.");
+    size_type regions_y = (grid.height() + region_size - 1) / region_size;
+    blocked_.assign(regions_x_ * regions_y, 0);
+    opened_.assign(regions_x_ * regions_y, 0);
+    grid_.AddObserver(this);
+}
+
+inline PathCache::Options PathCache::Options::Of(const FinderOption &option) {
+    const FinderOption::heuristic_t &h = option.heuristic;
+    Options options = {
+        ToDiagonalMovement(option.allow_diagonal, option.dont_cross_corners),
+        option.weight, &h.target_type(), 0, 0, true};
+    if (const function_t *function = h.target<function_t>()) {
+        options.function = *function;
+    } else if (const GoalHeuristic *goal = h.target<GoalHeuristic>()) {
+        options.object = &goal->heuristic();
+    } else {
+        options.cached = h.target<heuristic::Manhattan>() ||
+                         h.target<heuristic::Octile>() ||
+                         h.target<heuristic::Chebyshev>() ||
+                         h.target<heuristic::Euclidean>();
+    }
+    return options;
+}
+
+inline PathCache::pnode_vector_t
+PathCache::Find(size_type start_x, size_type start_y,
+                size_type end_x, size_type end_y, const Options &options) {
+    if (!options.cached) {
+        ++misses_;
+        return pnode_vector_t();
+    }
+    index_t::iterator it =
+        index_.find(MakeKey(start_x, start_y, end_x, end_y, options));
+    if (it == index_.end()) {
+        ++misses_;
+        return pnode_vector_t();
+    }
+    if (!IsValid(*it->second)) {
+        Erase(it);
+        ++misses_;
+        return pnode_vector_t();
+    }
+    // the most recently used now
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++hits_;
+    return pnode_vector_t(new node_vector_t(it->second->path));
+}
+
+inline void PathCache::Insert(size_type start_x, size_type start_y,
+                              size_type end_x, size_type end_y,
+                              const Options &options,
+                              const pnode_vector_t &path) {
+    if (!path || path->empty() || capacity_ == 0 || !options.cached) {
+        return;
+    }
+    Key key = MakeKey(start_x, start_y, end_x, end_y, options);
+    index_t::iterator it = index_.find(key);
+    if (it != index_.end()) {
+        Erase(it);
+    }
+    if (entries_.size() == capacity_) {
+        Erase(index_.find(entries_.back().key));
+    }
+
+    entries_.push_front(Entry());
+    Entry &entry = entries_.front();
+    entry.key = key;
+    entry.path = *path;
+    entry.cost = PathCost(path);
+    entry.found = tick_;
+    const node_vector_t &nodes = entry.path;
+    entry.regions.push_back(RegionOf(nodes[0]->x, nodes[0]->y));
+    for (std::size_t i = 1; i < nodes.size(); ++i) {
+        const node_t &a = *nodes[i - 1], &b = *nodes[i];
+        entry.regions.push_back(RegionOf(b.x, b.y));
+        if (a.x != b.x && a.y != b.y) {
+            // a diagonal move depends on the two cells by its corner
+            entry.regions.push_back(RegionOf(b.x, a.y));
+            entry.regions.push_back(RegionOf(a.x, b.y));
+        }
+    }
+    std::sort(entry.regions.begin(), entry.regions.end());
+    entry.regions.erase(
+        std::unique(entry.regions.begin(), entry.regions.end()),
+        entry.regions.end());
+    FindShortcuts(entry);
+    index_[key] = entries_.begin();
+}
+
+template <class Finder, class Context>
+PathCache::pnode_vector_t
+PathCache::FindPath(const Finder &finder, const Options &options,
+                    size_type start_x, size_type start_y,
+                    size_type end_x, size_type end_y, Context &context) {
+    pnode_vector_t path = Find(start_x, start_y, end_x, end_y, options);
+    if (path) {
+        return path;
+    }
+    path = finder.FindPath(start_x, start_y, end_x, end_y, grid_, context);
+    Insert(start_x, start_y, end_x, end_y, options, path);
+    return path;
+}
+
+inline void PathCache::Clear() {
+    entries_.clear();
+    index_.clear();
+}
+
+inline void PathCache::OnWalkableChanged(size_type x, size_type y,
+                                         bool walkable) {
+    region_t region = RegionOf(x, y);
+    ++tick_;
+    if (walkable) {
+        opened_[region] = tick_;
+        last_opened_ = tick_;
+    } else {
+        blocked_[region] = tick_;
+    }
+}
+
+inline bool PathCache::IsValid(const Entry &entry) const {
+    for (std::size_t i = 0; i < entry.regions.size(); ++i) {
+        if (blocked_[entry.regions[i]] > entry.found) {
+            return false;
+        }
+    }
+    if (last_opened_ <= entry.found) {
+        return true;
+    }
+    for (std::size_t i = 0; i < entry.shortcuts.size(); ++i) {
+        if (opened_[entry.shortcuts[i]] > entry.found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool PathCache::MayShorten(const Entry &entry, region_t region) const {
+    // the bounds of the region and of its border, where an opened cell
+    // may also let a diagonal move by, and the distances to them from
+    // both ends along each axis
+    size_type x0 = region % regions_x_ * region_size_,
+              y0 = region / regions_x_ * region_size_;
+    size_type x1 = std::min(x0 + region_size_ + 1, grid_.width()) - 1,
+              y1 = std::min(y0 + region_size_ + 1, grid_.height()) - 1;
+    x0 = x0 > 0 ? x0 - 1 : 0;
+    y0 = y0 > 0 ? y0 - 1 : 0;
+    int d[2][2];
+    const size_type ends[2] = {entry.key.start, entry.key.end};
+    for (int i = 0; i < 2; ++i) {
+        size_type x = 0, y = 0;
+        grid_.CoordsOf(ends[i], x, y);
+        d[i][0] = x < x0 ? int(x0 - x) : x > x1 ? int(x - x1) : 0;
+        d[i][1] = y < y0 ? int(y0 - y) : y > y1 ? int(y - y1) : 0;
+    }
+    // no path through the region is shorter than the two lower bounds
+    int bound = 0;
+    if (entry.key.options.movement == kDiagonalNever) {
+        heuristic::Manhattan h;
+        bound = h(10 * d[0][0], 10 * d[0][1]) + h(10 * d[1][0], 10 * d[1][1]);
+    } else {
+        heuristic::Octile h;
+        bound = h(10 * d[0][0], 10 * d[0][1]) + h(10 * d[1][0], 10 * d[1][1]);
+    }
+    return bound < entry.cost;
+}
+
+inline void PathCache::FindShortcuts(Entry &entry) const {
+    // The bounds of MayShorten() are at least 10 a cell along either
+    // axis from each end, so the regions within `reach` cells of both
+    // ends, and their borders, are the only ones to check.
+    size_type sx = 0, sy = 0, ex = 0, ey = 0;
+    grid_.CoordsOf(entry.key.start, sx, sy);
+    grid_.CoordsOf(entry.key.end, ex, ey);
+    size_type reach = size_type(entry.cost > 0 ? (entry.cost - 1) / 10 : 0) + 1;
+    size_type far_x = std::max(sx, ex), far_y = std::max(sy, ey),
+              x0 = far_x > reach ? far_x - reach : 0,
+              y0 = far_y > reach ? far_y - reach : 0,
+              x1 = std::min(std::min(sx, ex) + reach, grid_.width() - 1),
+              y1 = std::min(std::min(sy, ey) + reach, grid_.height() - 1);
+    entry.shortcuts.clear();
+    for (size_type ry = y0 / region_size_; ry <= y1 / region_size_; ++ry) {
+        for (size_type rx = x0 / region_size_; rx <= x1 / region_size_;
+                ++rx) {
+            region_t region = region_t(ry * regions_x_ + rx);
+            if (MayShorten(entry, region)) {
+                entry.shortcuts.push_back(region);
+            }
+        }
+    }
+}
+
+inline void PathCache::Erase(index_t::iterator it) {
+    entries_.erase(it->second);
+    index_.erase(it);
+}
+
+#endif // FINDERS_PATHCACHE_HPP_
@@ -0,0 +1,152 @@
+#ifndef FINDERS_RESERVATIONTABLE_HPP_
+#define FINDERS_RESERVATIONTABLE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+
+/**
+ * The cells held by the agents over time, for cooperative planning: an
+ * open-addressing hash table of (time, cell) to agent, in one array of
+ * 16 bytes an entry, that is wiped rather than freed between planning
+ * passes. A plan dropped within a pass releases its cells one by one.
+ *
+ * The times are steps from the start of the window being planned.
+ */
+class ReservationTable {
+public:
+    typedef std::size_t size_type;
+    static const unsigned kNoAgent = unsigned(-1);
+
+    explicit ReservationTable(size_type cells = 0)
+        : cells_(cells), size_(0), entries_(kInitialCapacity) {
+        Clear();
+    }
+
+    // Forget every reservation, the table being for grids of `cells`
+    // cells from now on.
+    void Reset(size_type cells) {
+        cells_ = cells;
+        Clear();
+    }
+    void Clear() {
+        Entry empty = {kEmptyKey, kNoAgent};
+        std::fill(entries_.begin(), entries_.end(), empty);
+        size_ = 0;
+    }
+
+    // The agent holding `cell` at time `t`, or kNoAgent.
+    unsigned At(size_type cell, unsigned t) const {
+        const Entry &entry = entries_[Find(KeyOf(cell, t))];
+        return entry.agent;
+    }
+    // Hold `cell` at time `t` for `agent`, unless another one does:
+    // return whether `agent` holds it.
+    bool Reserve(size_type cell, unsigned t, unsigned agent);
+    // Let go of `cell` at time `t`, if `agent` holds it.
+    void Release(size_type cell, unsigned t, unsigned agent);
+    // Whether `agent` may move from `from` at time `t` to `to` at `t` + 1:
+    // no other agent holds `to` then, nor comes the other way.
+    bool CanMove(size_type from, size_type to, unsigned t,
+                 unsigned agent) const {
+        unsigned holder = At(to, t + 1);
+        if (holder != kNoAgent && holder != agent) {
+            return false;
+        }
+        if (from == to) {
+            return true;
+        }
+        unsigned other = At(to, t);
+        return other == kNoAgent || other == agent ||
+               At(from, t + 1) != other;
+    }
+
+    // The reservations held.
+    size_type size() const { return size_; }
+
+private:
+    struct Entry {
+        boost::uint64_t key;
+        unsigned agent;
+    };
+    static const boost::uint64_t kEmptyKey = ~boost::uint64_t(0);
+    enum { kInitialCapacity = 1024 };
+
+    boost::uint64_t KeyOf(size_type cell, unsigned t) const {
+        BOOST_ASSERT(cell < cells_);
+        return boost::uint64_t(t) * cells_ + cell;
+    }
+    // The entry `key` is probed from first.
+    size_type HomeOf(boost::uint64_t key) const {
+        // Fibonacci hashing spreads the keys of neighboring cells
+        return size_type((key * 0x9E3779B97F4A7C15ULL) >> 32) &
+               (entries_.size() - 1);
+    }
+    // The entry of `key`, or the empty one where it would go.
+    size_type Find(boost::uint64_t key) const {
+        size_type mask = entries_.size() - 1;
+        size_type i = HomeOf(key);
+        while (entries_[i].key != key && entries_[i].key != kEmptyKey) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+    void Grow();
+
+    size_type cells_;
+    size_type size_;
+    // a power of two, at most half full
+    std::vector<Entry> entries_;
+};
+
+inline bool ReservationTable::Reserve(size_type cell, unsigned t,
+                                      unsigned agent) {
+    boost::uint64_t key = KeyOf(cell, t);
+    Entry &entry = entries_[Find(key)];
+    if (entry.key == key) {
+        return entry.agent == agent;
+    }
+    entry.key = key;
+    entry.agent = agent;
+    if (++size_ * 2 > entries_.size()) {
+        Grow();
+    }
+    return true;
+}
+
+inline void ReservationTable::Release(size_type cell, unsigned t,
+                                      unsigned agent) {
+    size_type i = Find(KeyOf(cell, t));
+    if (entries_[i].key == kEmptyKey || entries_[i].agent != agent) {
+        return;
+    }
+    // shift back into the hole the entries after it that were probed
+    // past it, so that no probe stops short of its key
+    size_type mask = entries_.size() - 1;
+    for (size_type j = (i + 1) & mask; entries_[j].key != kEmptyKey;
+            j = (j + 1) & mask) {
+        if (((j - HomeOf(entries_[j].key)) & mask) >= ((j - i) & mask)) {
+            entries_[i] = entries_[j];
+            i = j;
+        }
+    }
+    Entry empty = {kEmptyKey, kNoAgent};
+    entries_[i] = empty;
+    --size_;
+}
+
+inline void ReservationTable::Grow() {
+    std::vector<Entry> old(entries_.size() * 2);
+    old.swap(entries_);
+    Entry empty = {kEmptyKey, kNoAgent};
+    std::fill(entries_.begin(), entries_.end(), empty);
+    for (size_type i = 0; i < old.size(); ++i) {
+        if (old[i].key != kEmptyKey) {
+            entries_[Find(old[i].key)] = old[i];
+        }
+    }
+}
+
+#endif // FINDERS_RESERVATIONTABLE_HPP_
@@ -0,0 +1,214 @@
+#ifndef FINDERS_SEARCHCONTEXT_HPP_
+#define FINDERS_SEARCHCONTEXT_HPP_
+
+#include <deque>
+#include <utility>
+#include <vector>
+#include "boost/assert.hpp"
+#include "boost/cstdint.hpp"
+#include "boost/unordered_map.hpp"
+#include "openlist.hpp"
+#include "searchstats.hpp"
+
+/**
+ * The per-query scratch state of a search: g/h/f, parent, open/closed
+ * flags and the open list, one record per grid cell, addressed by the
+ * cell index. The open list policy (see openlist.hpp) and the statistics
+ * policy (see searchstats.hpp) are template parameters.
+ *
+ * Records are stamped with the generation of the query that touched them
+ * last, so starting a new query is O(1): a record from an older query is
+ * treated as fresh and reset the first time it is touched. The grid is
+ * never written, so any number of contexts may search one grid at the
+ * same time, one context per thread.
+ */
+template <class OpenList, class Stats = NoSearchStats>
+class BasicSearchContext {
+public:
+    typedef std::size_t size_type;
+    typedef boost::uint32_t generation_t;
+    typedef OpenList open_list_t;
+    typedef Stats stats_t;
+
+    struct State {
+        void Reset(generation_t gen) {
+            f = 0; g = 0; h = 0;
+            parent = kNoParent;
+            generation = gen;
+            opened = false; closed = false;
+        }
+        int f;
+        int g;
+        int h;
+        size_type parent;
+        generation_t generation;
+        bool opened;
+        bool closed;
+        typename open_list_t::handle_type handle;
+    };
+
+    static const size_type kNoParent = size_type(-1);
+
+    BasicSearchContext() : generation_(0), size_(0) {}
+
+    // Start a new query over a grid of `size` cells, and reset the stats.
+    // It costs O(1) unless the grid grew or the generation wrapped around.
+    void Prepare(size_type size);
+
+    // Get the record of the cell, reset if this query has not touched it.
+    State &Touch(size_type index) {
+        BOOST_ASSERT(index < states_.size());
+        State &state = states_[index];
+        if (state.generation != generation_) {
+            state.Reset(generation_);
+        }
+        return state;
+    }
+    // Get the record of the cell, or 0 if this query has not touched it.
+    const State *Find(size_type index) const {
+        if (index >= states_.size() ||
+                states_[index].generation != generation_) {
+            return 0;
+        }
+        return &states_[index];
+    }
+    bool IsOpened(size_type index) const {
+        const State *state = Find(index);
+        return state && state->opened;
+    }
+    bool IsClosed(size_type index) const {
+        const State *state = Find(index);
+        return state && state->closed;
+    }
+    size_type Parent(size_type index) const {
+        const State *state = Find(index);
+        return state ? state->parent : kNoParent;
+    }
+
+    open_list_t &open_list() { return open_list_; }
+    // The stats of the last query, see Stats::Get().
+    stats_t &stats() { return stats_; }
+    const stats_t &stats() const { return stats_; }
+    // The number of cells of the grid last prepared for.
+    size_type size() const { return size_; }
+
+private:
+    generation_t generation_;
+    size_type size_;
+    std::vector<State> states_;
+    open_list_t open_list_;
+    stats_t stats_;
+};
+
+// The open list of the context used when none is specified.
+typedef DAryHeapOpenList<4> DefaultOpenList;
+typedef BasicSearchContext<DefaultOpenList> SearchContext;
+
+template <class OpenList, class Stats>
+void BasicSearchContext<OpenList, Stats>::Prepare(size_type size) {
+    open_list_.Clear();
+    stats_.Reset();
+    size_ = size;
+    if (++generation_ == 0) {
+        // wrapped around: stamps of the old queries may look current again
+        for (typename std::vector<State>::iterator it = states_.begin(),
+                end = states_.end(); it != end; ++it) {
+            it->generation = 0;
+        }
+        generation_ = 1;
+    }
+    if (states_.size() < size) {
+        State fresh;
+        fresh.Reset(0);
+        states_.resize(size, fresh);
+    }
+}
+
+/**
+ * A context with a record per cell touched rather than per grid cell,
+ * kept in a hash table, for the grids too large to hold a record for
+ * each of their cells, e.g. a ChunkedGrid (see core/chunkedgrid.hpp):
+ * its memory goes with the cells a query touches.
+ *
+ * It is used as BasicSearchContext is, at the cost of a hash lookup a
+ * touch. The records are kept between the queries, at fixed addresses
+ * for the handles of the open list, and reused.
+ */
+template <class OpenList, class Stats = NoSearchStats>
+class SparseSearchContext {
+public:
+    typedef std::size_t size_type;
+    typedef typename BasicSearchContext<OpenList, Stats>::generation_t
+        generation_t;
+    typedef typename BasicSearchContext<OpenList, Stats>::State State;
+    typedef OpenList open_list_t;
+    typedef Stats stats_t;
+
+    static const size_type kNoParent = size_type(-1);
+
+    SparseSearchContext() : size_(0), used_(0) {}
+
+    // Start a new query over a grid of `size` cells, and reset the stats.
+    void Prepare(size_type size) {
+        open_list_.Clear();
+        stats_.Reset();
+        size_ = size;
+        state_of_.clear();
+        used_ = 0;
+    }
+
+    // Get the record of the cell, reset if this query has not touched it.
+    State &Touch(size_type index) {
+        BOOST_ASSERT(index < size_);
+        std::pair<typename map_t::iterator, bool> slot =
+            state_of_.insert(std::make_pair(index, used_));
+        if (!slot.second) {
+            return states_[slot.first->second];
+        }
+        if (used_ == states_.size()) {
+            states_.push_back(State());
+        }
+        State &state = states_[used_++];
+        state.Reset(1);
+        return state;
+    }
+    // Get the record of the cell, or 0 if this query has not touched it.
+    const State *Find(size_type index) const {
+        typename map_t::const_iterator it = state_of_.find(index);
+        return it == state_of_.end() ? 0 : &states_[it->second];
+    }
+    bool IsOpened(size_type index) const {
+        const State *state = Find(index);
+        return state && state->opened;
+    }
+    bool IsClosed(size_type index) const {
+        const State *state = Find(index);
+        return state && state->closed;
+    }
+    size_type Parent(size_type index) const {
+        const State *state = Find(index);
+        return state ? state->parent : kNoParent;
+    }
+
+    open_list_t &open_list() { return open_list_; }
+    // The stats of the last query, see Stats::Get().
+    stats_t &stats() { return stats_; }
+    const stats_t &stats() const { return stats_; }
+    // The number of cells of the grid last prepared for.
+    size_type size() const { return size_; }
+    // The number of cells the last query touched.
+    size_type touched() const { return used_; }
+
+private:
+    typedef boost::unordered_map<size_type, size_type> map_t;
+
+    size_type size_;
+    size_type used_;
+    // the record of each cell touched, by its position in states_
+    map_t state_of_;
+    std::deque<State> states_;
+    open_list_t open_list_;
+    stats_t stats_;
+};
+
+#endif // FINDERS_SEARCHCONTEXT_HPP_
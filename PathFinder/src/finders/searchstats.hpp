@@ -0,0 +1,142 @@
+#ifndef FINDERS_SEARCHSTATS_HPP_
+#define FINDERS_SEARCHSTATS_HPP_
+
+#include "boost/chrono.hpp"
+#include "boost/cstdint.hpp"
+
+/**
+ * Statistics policies of the A* family, picked at compile time by the
+ * search context type (see BasicSearchContext) as the open list is.
+ *
+ * Every policy has the same interface:
+ *
+ *     void Reset();               // at the start of each query
+ *     void Expand();              // a cell popped and closed
+ *     void Push();                // a cell opened
+ *     void Update();              // the key of an open cell lowered
+ *     void Generate(unsigned n);  // the moves out of a cell
+ *     void RejectClosed();        // a move into a closed cell
+ *     SearchStats Get() const;
+ *     // times the scope it lives in, as a SearchPhase
+ *     class Scope { Scope(policy &, SearchPhase); };
+ *
+ * NoSearchStats does nothing in each of them, so the finder compiles to
+ * the same code as without it.
+ */
+
+enum SearchPhase {
+    kNeighborPhase,   // generating the moves out of a cell
+    kHeapPhase,       // pushing, updating and popping the open list
+    kBacktracePhase   // building the path
+};
+
+// The counts and times of one query, or the sum of several, e.g. to be
+// exported per interval.
+struct SearchStats {
+    boost::uint64_t expanded;
+    boost::uint64_t pushed;
+    boost::uint64_t updated;
+    boost::uint64_t generated;
+    boost::uint64_t rejected_closed;
+    // nanoseconds by SearchPhase, 0 unless timed
+    boost::uint64_t phase_ns[3];
+
+    SearchStats &operator+=(const SearchStats &other) {
+        expanded += other.expanded;
+        pushed += other.pushed;
+        updated += other.updated;
+        generated += other.generated;
+        rejected_closed += other.rejected_closed;
+        for (int i = 0; i < 3; ++i) {
+            phase_ns[i] += other.phase_ns[i];
+        }
+        return *this;
+    }
+};
+
+inline SearchStats ZeroSearchStats() {
+    SearchStats stats = {0, 0, 0, 0, 0, {0, 0, 0}};
+    return stats;
+}
+
+// Keep no statistics.
+class NoSearchStats {
+public:
+    enum { kEnabled = false, kTimed = false };
+
+    class Scope {
+    public:
+        Scope(NoSearchStats &, SearchPhase) {}
+    };
+
+    void Reset() {}
+    void Expand() {}
+    void Push() {}
+    void Update() {}
+    void Generate(unsigned) {}
+    void RejectClosed() {}
+    SearchStats Get() const { return ZeroSearchStats(); }
+};
+
+namespace searchstats_detail {
+
+// Add the time it lives to `ns`, or nothing if not `kTimed`, in which
+// case the clock is not even linked.
+template <bool kTimed>
+class PhaseTimer {
+public:
+    explicit PhaseTimer(boost::uint64_t &) {}
+};
+
+template <>
+class PhaseTimer<true> {
+public:
+    explicit PhaseTimer(boost::uint64_t &ns)
+        : ns_(ns), begin_(clock_t::now()) {}
+    ~PhaseTimer() {
+        ns_ += boost::uint64_t(
+            boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                clock_t::now() - begin_).count());
+    }
+
+private:
+    typedef boost::chrono::steady_clock clock_t;
+    boost::uint64_t &ns_;
+    clock_t::time_point begin_;
+};
+
+}  // searchstats_detail
+
+// Count the operations of each query, and time its phases if
+// `kTimedPhases`;
+// a timed phase reads the clock twice each time it is entered.
+template <bool kTimedPhases = false>
+class BasicSearchStats {
+public:
+    enum { kEnabled = true, kTimed = kTimedPhases };
+
+    class Scope : private searchstats_detail::PhaseTimer<kTimedPhases> {
+    public:
+        Scope(BasicSearchStats &stats, SearchPhase phase)
+            : searchstats_detail::PhaseTimer<kTimedPhases>(
+                  stats.stats_.phase_ns[phase]) {}
+    };
+
+    BasicSearchStats() : stats_(ZeroSearchStats()) {}
+
+    void Reset() { stats_ = ZeroSearchStats(); }
+    void Expand() { ++stats_.expanded; }
+    void Push() { ++stats_.pushed; }
+    void Update() { ++stats_.updated; }
+    void Generate(unsigned count) { stats_.generated += count; }
+    void RejectClosed() { ++stats_.rejected_closed; }
+    const SearchStats &Get() const { return stats_; }
+
+private:
+    SearchStats stats_;
+};
+
+typedef BasicSearchStats<false> CountingSearchStats;
+typedef BasicSearchStats<true> TimedSearchStats;
+
+#endif // FINDERS_SEARCHSTATS_HPP_
@@ -0,0 +1,12 @@
+#ifndef TEST_RANDOM_HPP_
+#define TEST_RANDOM_HPP_
+
+// The generator of the random maps and queries of the tests and the
+// benchmarks: steps the seed, and returns it. Its low bits repeat soon,
+// the high ones are to be read.
+inline unsigned NextRandom(unsigned &seed) {
+    seed = seed * 1103515245u + 12345u;
+    return seed;
+}
+
+#endif // TEST_RANDOM_HPP_
@@ -1,13 +1,20 @@
 #define BOOST_TEST_MODULE GridTest
 #include <boost/test/unit_test.hpp>
 
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 #include "boost/array.hpp"
 #include "boost/bind.hpp"
 #include "boost/foreach.hpp"
 #include "boost/function.hpp"
 #include "boost/scoped_ptr.hpp"
 #include "boost/range/algorithm/stable_sort.hpp"
+#include "core/chunkedgrid.hpp"
 #include "core/grid.hpp"
+#include "core/mapfile.hpp"
+#include "random.hpp"
 
 /* generate without matrix */
 
@@ -29,10 +36,8 @@ BOOST_AUTO_TEST_CASE(should_have_correct_size) {
 
     Grid<>::pnode_grid_t nodes = grid->nodes();
 
-    BOOST_REQUIRE_EQUAL(height, nodes->size());
-    for (size_type i = 0; i < height; ++i) {
-        BOOST_REQUIRE_EQUAL(width, (*nodes)[i].size());
-    }
+    BOOST_REQUIRE_EQUAL(width * height, grid->size());
+    BOOST_REQUIRE_EQUAL(width * height, nodes->size());
 }
 
 BOOST_AUTO_TEST_CASE(should_set_all_nodes_walkable_attribute) {
@@ -43,6 +48,20 @@ BOOST_AUTO_TEST_CASE(should_set_all_nodes_walkable_attribute) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(should_store_nodes_in_row_major_order) {
+    for (size_type i = 0; i < height; ++i) {
+        for (size_type j = 0; j < width; ++j) {
+            Grid<>::pnode_t node = grid->GetNodeAt(j, i);
+            size_type index = grid->IndexAt(j, i);
+            BOOST_REQUIRE_EQUAL(i * width + j, index);
+            BOOST_REQUIRE_EQUAL(index, grid->IndexOf(node));
+            BOOST_REQUIRE_EQUAL(node, grid->GetNodeAt(index));
+            BOOST_REQUIRE_EQUAL(j, node->x);
+            BOOST_REQUIRE_EQUAL(i, node->y);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 /* generate with matrix */
@@ -91,10 +110,8 @@ BOOST_AUTO_TEST_CASE(should_have_correct_size) {
 
     Grid<>::pnode_grid_t nodes = grid->nodes();
 
-    BOOST_REQUIRE_EQUAL(height, nodes->size());
-    for (size_type i = 0; i < height; ++i) {
-        BOOST_REQUIRE_EQUAL(width, (*nodes)[i].size());
-    }
+    BOOST_REQUIRE_EQUAL(width * height, grid->size());
+    BOOST_REQUIRE_EQUAL(width * height, nodes->size());
 }
 
 void initiate_all_nodes(std::size_t x,
@@ -157,19 +174,18 @@ bool Cmp(const GridWithMatrix<>::grid_t::pnode_t &a,
 };
 
 BOOST_AUTO_TEST_CASE(should_return_correct_neighbors) {
-    grid_t::pnode_vector_t &neighbors =
+    grid_t::pnode_vector_t neighbors =
         grid->GetNeighbors(grid->GetNodeAt(1, 0), false, false);
     BOOST_REQUIRE_EQUAL(1, neighbors->size());
     BOOST_REQUIRE_EQUAL(grid->GetNodeAt(2, 0), (*neighbors)[0]);
 
-    grid_t::node_grid_t &nodes = *(grid->nodes());
-    neighbors = grid->GetNeighbors(nodes[0][2], true, false);
+    neighbors = grid->GetNeighbors(grid->GetNodeAt(2, 0), true, false);
     boost::range::stable_sort(*neighbors, Cmp);
 
     grid_t::node_vector_t expected;
-    expected.push_back(nodes[0][1]);
-    expected.push_back(nodes[1][2]);
-    expected.push_back(nodes[1][3]);
+    expected.push_back(grid->GetNodeAt(1, 0));
+    expected.push_back(grid->GetNodeAt(2, 1));
+    expected.push_back(grid->GetNodeAt(3, 1));
     boost::range::stable_sort(expected, Cmp);
 
     BOOST_REQUIRE_EQUAL(expected.size(), neighbors->size());
@@ -178,5 +194,452 @@ BOOST_AUTO_TEST_CASE(should_return_correct_neighbors) {
     }
 }
 
+// The neighbors by probing IsWalkableAt() one by one, as GetNeighbors()
+// did before the bitmap.
+void ProbeNeighbors(const GridWithMatrix<>::grid_t &grid,
+        std::size_t x, std::size_t y, DiagonalMovement movement,
+        GridWithMatrix<>::grid_t::node_vector_t &neighbors) {
+    bool s[4], d[4];
+    for (unsigned dir = 0; dir < 4; ++dir) {
+        const DirectionOffset &o = OffsetOf(dir);
+        s[dir] = grid.IsWalkableAt(x + o.dx, y + o.dy);
+        if (s[dir]) {
+            neighbors.push_back(grid.GetNodeAt(x + o.dx, y + o.dy));
+        }
+    }
+    for (unsigned i = 0; i < 4; ++i) {
+        bool a = s[(i + 3) % 4], b = s[i];
+        switch (movement) {
+        case kDiagonalAlways: d[i] = true; break;
+        case kDiagonalNever: d[i] = false; break;
+        case kDiagonalIfAtMostOneObstacle: d[i] = a || b; break;
+        case kDiagonalOnlyWhenNoObstacles: d[i] = a && b; break;
+        }
+        const DirectionOffset &o = OffsetOf(4 + i);
+        if (d[i] && grid.IsWalkableAt(x + o.dx, y + o.dy)) {
+            neighbors.push_back(grid.GetNodeAt(x + o.dx, y + o.dy));
+        }
+    }
+}
+
+struct NeighborCollector {
+    void operator()(std::size_t index, unsigned /*dir*/) {
+        indexes.push_back(index);
+    }
+    std::vector<std::size_t> indexes;
+};
+
+void check_neighbors_in_all_movements(std::size_t x, std::size_t y,
+        GridWithMatrix<>::grid_t *grid) {
+    for (int m = 0; m < kDiagonalMovementCount; ++m) {
+        DiagonalMovement movement = DiagonalMovement(m);
+        GridWithMatrix<>::grid_t::node_vector_t expected;
+        ProbeNeighbors(*grid, x, y, movement, expected);
+        GridWithMatrix<>::grid_t::pnode_vector_t neighbors =
+            grid->GetNeighbors(grid->GetNodeAt(x, y), movement);
+        BOOST_REQUIRE_EQUAL(expected.size(), neighbors->size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(expected[i], (*neighbors)[i]);
+        }
+        // the allocation-free form yields the same neighbors
+        NeighborBuffer buffer;
+        BOOST_REQUIRE_EQUAL(expected.size(),
+                            grid->GetNeighbors(x, y, movement, buffer));
+        for (unsigned i = 0; i < buffer.size; ++i) {
+            BOOST_REQUIRE_EQUAL(grid->IndexOf(expected[i]), buffer.index[i]);
+            const DirectionOffset &o = OffsetOf(buffer.dir[i]);
+            BOOST_REQUIRE_EQUAL(x + o.dx, expected[i]->x);
+            BOOST_REQUIRE_EQUAL(y + o.dy, expected[i]->y);
+        }
+        NeighborCollector collector;
+        grid->ForEachNeighbor(x, y, movement, collector);
+        BOOST_REQUIRE_EQUAL(expected.size(), collector.indexes.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(grid->IndexOf(expected[i]),
+                                collector.indexes[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_generate_neighbors_from_bitmap) {
+    EnumPos(boost::bind(&check_neighbors_in_all_movements, _1, _2, _3));
+    // flip every cell, so that each one is seen blocked and free
+    EnumPos(boost::bind(&set_nodes_walkable, _1, _2, _3, false));
+    EnumPos(boost::bind(&check_neighbors_in_all_movements, _1, _2, _3));
+    grid->SetWalkableAt(1, 1, true);
+    grid->SetWalkableAt(2, 2, true);
+    grid->SetWalkableAt(0, 4, true);
+    EnumPos(boost::bind(&check_neighbors_in_all_movements, _1, _2, _3));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
+/* walkable bitmap */
+
+BOOST_AUTO_TEST_CASE(bitmap_should_handle_word_boundaries) {
+    typedef WalkableBitmap::size_type size_type;
+    const size_type w = 130, h = 3;
+    WalkableBitmap bitmap(w, h, false);
+    for (size_type x = 0; x < w; x += 3) {
+        bitmap.Set(x, 1, true);
+    }
+    for (size_type x = 0; x < w; ++x) {
+        BOOST_REQUIRE_EQUAL(x % 3 == 0, bitmap.Get(x, 1));
+        BOOST_REQUIRE(!bitmap.Get(x, 0));
+        unsigned expected = (x % 3 == 0 ? 0x10 : 0) |
+            (x > 0 && (x - 1) % 3 == 0 ? 0x08 : 0) |
+            (x + 1 < w && (x + 1) % 3 == 0 ? 0x20 : 0);
+        BOOST_REQUIRE_EQUAL(expected, bitmap.Neighborhood(x, 1));
+    }
+    WalkableBitmap open(w, h);
+    for (size_type x = 0; x < w; ++x) {
+        // the padding around the map is blocked
+        unsigned expected = 0x1FF;
+        if (x == 0) expected &= ~0x49u;
+        if (x == w - 1) expected &= ~0x124u;
+        BOOST_REQUIRE_EQUAL(expected & ~0x7u, open.Neighborhood(x, 0));
+        BOOST_REQUIRE_EQUAL(expected, open.Neighborhood(x, 1));
+    }
+}
+
+/* connected components */
+
+// The cells reached from (x, y) by the moves of `movement`.
+std::vector<bool> Flood(const Grid<> &grid, std::size_t x, std::size_t y,
+                        DiagonalMovement movement) {
+    std::vector<bool> reached(grid.size(), false);
+    std::vector<std::size_t> queue(1, grid.IndexAt(x, y));
+    reached[queue[0]] = true;
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        std::size_t cx = 0, cy = 0;
+        grid.CoordsOf(queue[head], cx, cy);
+        NeighborBuffer buffer;
+        grid.GetNeighbors(cx, cy, movement, buffer);
+        for (unsigned i = 0; i < buffer.size; ++i) {
+            if (!reached[buffer.index[i]]) {
+                reached[buffer.index[i]] = true;
+                queue.push_back(buffer.index[i]);
+            }
+        }
+    }
+    return reached;
+}
+
+void CheckReachability(const Grid<> &grid, unsigned rand) {
+    for (int m = 0; m < kDiagonalMovementCount; ++m) {
+        DiagonalMovement movement = DiagonalMovement(m);
+        for (unsigned i = 0; i < 8; ++i) {
+            NextRandom(rand);
+            std::size_t sx = (rand >> 4) % grid.width(),
+                        sy = (rand >> 16) % grid.height();
+            std::vector<bool> reached = Flood(grid, sx, sy, movement);
+            for (std::size_t end = 0; end < grid.size(); ++end) {
+                std::size_t ex = 0, ey = 0;
+                grid.CoordsOf(end, ex, ey);
+                BOOST_REQUIRE_EQUAL(bool(reached[end]),
+                    grid.IsReachable(sx, sy, ex, ey, movement));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_tell_reachability_as_cells_flip) {
+    const std::size_t width = 37, height = 23;
+    Grid<> grid(width, height);
+    unsigned rand = 31337;
+    for (std::size_t i = 0; i < width * height * 35 / 100; ++i) {
+        NextRandom(rand);
+        grid.SetWalkableAt((rand >> 4) % width, (rand >> 16) % height, false);
+    }
+    CheckReachability(grid, rand);
+    // flip cells both ways, so that components are split and joined
+    for (unsigned round = 0; round < 40; ++round) {
+        for (unsigned i = 0; i < 25; ++i) {
+            NextRandom(rand);
+            std::size_t x = (rand >> 4) % width, y = (rand >> 16) % height;
+            grid.SetWalkableAt(x, y, !grid.IsWalkableAt(x, y));
+        }
+        CheckReachability(grid, rand);
+    }
+    // the labels of the components gone are renumbered, as a fresh grid
+    // would label them
+    Grid<> copy(width, height);
+    for (std::size_t y = 0; y < height; ++y) {
+        for (std::size_t x = 0; x < width; ++x) {
+            copy.SetWalkableAt(x, y, grid.IsWalkableAt(x, y));
+        }
+    }
+    CheckReachability(copy, rand);
+}
+
+BOOST_AUTO_TEST_CASE(should_split_components_by_a_wall) {
+    Grid<> grid(10, 10);
+    for (std::size_t y = 0; y < 10; ++y) {
+        grid.SetWalkableAt(5, y, false);
+    }
+    BOOST_REQUIRE(!grid.IsReachable(0, 0, 9, 9, kDiagonalAlways));
+    // a door in the wall joins both sides
+    grid.SetWalkableAt(5, 5, true);
+    BOOST_REQUIRE(grid.IsReachable(0, 0, 9, 9, kDiagonalNever));
+    grid.SetWalkableAt(5, 5, false);
+    BOOST_REQUIRE(!grid.IsReachable(0, 0, 9, 9, kDiagonalNever));
+
+    // a diagonal wall is crossed by corners only
+    Grid<> diagonal(10, 10);
+    for (std::size_t x = 0; x < 10; ++x) {
+        diagonal.SetWalkableAt(x, 9 - x, false);
+    }
+    BOOST_REQUIRE(diagonal.IsReachable(0, 0, 9, 9, kDiagonalAlways));
+    BOOST_REQUIRE(
+        !diagonal.IsReachable(0, 0, 9, 9, kDiagonalIfAtMostOneObstacle));
+    BOOST_REQUIRE(!diagonal.IsReachable(0, 0, 9, 9, kDiagonalNever));
+    // a blocked start leaves to its free neighbors
+    BOOST_REQUIRE(diagonal.IsReachable(0, 9, 0, 0, kDiagonalNever));
+    BOOST_REQUIRE(diagonal.IsReachable(0, 9, 9, 9, kDiagonalNever));
+    BOOST_REQUIRE(!diagonal.IsReachable(0, 0, 1, 8, kDiagonalNever));
+}
+
+// Every cell of both grids is the same, and so are their neighbors.
+void CheckSameGrid(const Grid<> &grid, const Grid<> &expected) {
+    BOOST_REQUIRE_EQUAL(expected.width(), grid.width());
+    BOOST_REQUIRE_EQUAL(expected.height(), grid.height());
+    for (std::size_t y = 0; y < grid.height(); ++y) {
+        for (std::size_t x = 0; x < grid.width(); ++x) {
+            BOOST_REQUIRE_EQUAL(expected.IsWalkableAt(x, y),
+                                grid.IsWalkableAt(x, y));
+            BOOST_REQUIRE_EQUAL(expected.GetNodeAt(x, y)->walkable,
+                                grid.GetNodeAt(x, y)->walkable);
+            BOOST_REQUIRE_EQUAL(expected.transposed_bitmap().Get(y, x),
+                                grid.transposed_bitmap().Get(y, x));
+            for (int m = 0; m < 4; ++m) {
+                DiagonalMovement movement = DiagonalMovement(m);
+                BOOST_REQUIRE_EQUAL(expected.NeighborMask(x, y, movement),
+                                    grid.NeighborMask(x, y, movement));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_read_moving_ai_map_and_scenario) {
+    std::istringstream map(
+        "type octile\nheight 3\nwidth 5\nmap\n"
+        ".G@T.\r\n"
+        "S.WO.\r\n"
+        "....@\r\n");
+    WalkableBitmap bitmap;
+    ReadMovingAIMap(map, bitmap);
+    Grid<> grid(bitmap);
+    const char *expected[] = {"11001", "11001", "11110"};
+    for (std::size_t y = 0; y < 3; ++y) {
+        for (std::size_t x = 0; x < 5; ++x) {
+            BOOST_REQUIRE_EQUAL(expected[y][x] == '1', grid.IsWalkableAt(x, y));
+        }
+    }
+    BOOST_REQUIRE(!grid.IsReachable(0, 0, 4, 0, kDiagonalNever));
+    BOOST_REQUIRE(grid.IsReachable(0, 0, 4, 1, kDiagonalAlways));
+
+    std::istringstream truncated("type octile\nheight 3\nwidth 5\nmap\n.....\n");
+    BOOST_REQUIRE_THROW(ReadMovingAIMap(truncated, bitmap), std::runtime_error);
+
+    std::istringstream scenario(
+        "version 1\n"
+        "1\tmaps/rooms/64room_000.map\t512\t512\t210\t389\t214\t389\t4\n"
+        "3\tmaps/rooms/64room_000.map\t512\t512\t137\t295\t134\t292"
+        "\t4.24264\n");
+    std::vector<ScenarioQuery> queries;
+    ReadMovingAIScenario(scenario, queries);
+    BOOST_REQUIRE_EQUAL(2u, queries.size());
+    BOOST_REQUIRE_EQUAL(3u, queries[1].bucket);
+    BOOST_REQUIRE_EQUAL("maps/rooms/64room_000.map", queries[1].map);
+    BOOST_REQUIRE_EQUAL(512u, queries[1].map_width);
+    BOOST_REQUIRE_EQUAL(137u, queries[1].start_x);
+    BOOST_REQUIRE_EQUAL(292u, queries[1].goal_y);
+    BOOST_REQUIRE_CLOSE(4.24264, queries[1].optimal_length, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(should_map_packed_grid_in_place) {
+    // wider than a word, with blocked cells on the borders
+    const std::size_t width = 130, height = 40;
+    Grid<> expected(width, height);
+    unsigned rand = 5;
+    for (std::size_t i = 0; i < width * height / 4; ++i) {
+        NextRandom(rand);
+        expected.SetWalkableAt((rand >> 4) % width, (rand >> 16) % height,
+                               false);
+    }
+    std::stringstream packed;
+    WritePackedGrid(packed, expected.bitmap());
+    WalkableBitmap read;
+    ReadPackedGrid(packed, read);
+    CheckSameGrid(Grid<>(read), expected);
+
+    const std::string path = "test_grid_packed.bin";
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        WritePackedGrid(file, expected.bitmap());
+    }
+    WalkableBitmap mapped;
+    MapPackedGrid(path, mapped);
+    BOOST_REQUIRE(mapped.borrowed());
+    Grid<> grid(mapped);
+    BOOST_REQUIRE(grid.bitmap().borrowed());
+    CheckSameGrid(grid, expected);
+    // the runs of the components are found across words
+    CheckReachability(grid, rand);
+
+    // a cell set copies the words, the file is left as it was
+    grid.SetWalkableAt(3, 3, !grid.IsWalkableAt(3, 3));
+    BOOST_REQUIRE(!grid.bitmap().borrowed());
+    BOOST_REQUIRE(mapped.borrowed());
+    BOOST_REQUIRE_NE(grid.IsWalkableAt(3, 3), mapped.Get(3, 3));
+    expected.SetWalkableAt(3, 3, grid.IsWalkableAt(3, 3));
+    CheckSameGrid(grid, expected);
+
+    // the padding read as a walkable cell
+    std::string bytes = packed.str();
+    bytes[64 + 8 * WalkableBitmap::Stride(width) * 2] |= 1;
+    std::istringstream corrupt(bytes);
+    BOOST_REQUIRE_THROW(ReadPackedGrid(corrupt, read), std::runtime_error);
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 8));
+    BOOST_REQUIRE_THROW(ReadPackedGrid(truncated, read), std::runtime_error);
+    mapped = WalkableBitmap();
+    std::remove(path.c_str());
+}
+
+/* chunked grid */
+
+// Every cell of the chunked grid reads as the one of `expected`.
+void CheckSameChunkedGrid(const ChunkedGrid &grid, const Grid<> &expected) {
+    BOOST_REQUIRE_EQUAL(expected.width(), grid.width());
+    BOOST_REQUIRE_EQUAL(expected.height(), grid.height());
+    for (std::size_t y = 0; y < grid.height(); ++y) {
+        for (std::size_t x = 0; x < grid.width(); ++x) {
+            BOOST_REQUIRE_EQUAL(expected.IsWalkableAt(x, y),
+                                grid.IsWalkableAt(x, y));
+            for (int m = 0; m < 4; ++m) {
+                DiagonalMovement movement = DiagonalMovement(m);
+                BOOST_REQUIRE_EQUAL(expected.NeighborMask(x, y, movement),
+                                    grid.NeighborMask(x, y, movement));
+            }
+            NeighborBuffer a, b;
+            expected.GetNeighbors(x, y, kDiagonalAlways, a);
+            grid.GetNeighbors(x, y, kDiagonalAlways, b);
+            BOOST_REQUIRE_EQUAL(a.size, b.size);
+            for (unsigned i = 0; i < a.size; ++i) {
+                BOOST_REQUIRE_EQUAL(a.index[i], b.index[i]);
+            }
+        }
+    }
+    BOOST_REQUIRE(!grid.IsWalkableAt(grid.width(), 0));
+}
+
+// A grid wider than two tiles, its cells open but a blocked tile and a
+// few blocked cells in two others.
+Grid<> MostlyOpenGrid(unsigned rand) {
+    const std::size_t width = 150, height = 100;
+    Grid<> grid(width, height);
+    for (std::size_t y = 64; y < height; ++y) {
+        for (std::size_t x = 64; x < 128; ++x) {
+            grid.SetWalkableAt(x, y, false);
+        }
+    }
+    for (std::size_t i = 0; i < 200; ++i) {
+        NextRandom(rand);
+        grid.SetWalkableAt((rand >> 4) % 70, (rand >> 16) % 64, false);
+    }
+    return grid;
+}
+
+BOOST_AUTO_TEST_CASE(chunked_grid_should_read_as_grid) {
+    Grid<> expected = MostlyOpenGrid(7);
+    ChunkedGrid grid(expected.bitmap());
+    CheckSameChunkedGrid(grid, expected);
+    BOOST_REQUIRE_EQUAL(3u, grid.tile_x());
+    BOOST_REQUIRE_EQUAL(2u, grid.tile_y());
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kDetailedTile, grid.tile_kind(0, 0));
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kBlockedTile, grid.tile_kind(1, 1));
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kOpenTile, grid.tile_kind(2, 1));
+    BOOST_REQUIRE_EQUAL(2u, grid.detailed_tiles());
+
+    // the cells set one by one, a uniform tile copied on its first change
+    ChunkedGrid set(expected.width(), expected.height());
+    for (std::size_t y = 0; y < expected.height(); ++y) {
+        for (std::size_t x = 0; x < expected.width(); ++x) {
+            set.SetWalkableAt(x, y, expected.IsWalkableAt(x, y));
+        }
+    }
+    CheckSameChunkedGrid(set, expected);
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kOpenTile, set.tile_kind(2, 1));
+    set.SetTile(1, 1, false);
+    BOOST_REQUIRE_EQUAL(2u, set.detailed_tiles());
+
+    // the nodes are made on demand, and follow the cells
+    ChunkedGrid::pnode_t node = grid.GetNodeAt(140, 90);
+    BOOST_REQUIRE_EQUAL(140u, node->x);
+    BOOST_REQUIRE_EQUAL(90u, node->y);
+    BOOST_REQUIRE_EQUAL(node, grid.GetNodeAt(grid.IndexAt(140, 90)));
+    grid.SetWalkableAt(140, 90, false);
+    BOOST_REQUIRE(!node->walkable);
+    BOOST_REQUIRE_EQUAL(3u, grid.detailed_tiles());
+    expected.SetWalkableAt(140, 90, false);
+
+    // a copy has tiles of its own
+    ChunkedGrid copy(grid);
+    grid.SetWalkableAt(140, 90, true);
+    CheckSameChunkedGrid(copy, expected);
+
+    // a tile uniform again shares the uniform words, and its words are
+    // given to the next tile
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kOpenTile, grid.tile_kind(2, 1));
+    BOOST_REQUIRE_EQUAL(2u, grid.detailed_tiles());
+    grid.SetWalkableAt(140, 10, false);
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kDetailedTile, grid.tile_kind(2, 0));
+    BOOST_REQUIRE(!grid.IsWalkableAt(140, 10));
+    BOOST_REQUIRE(grid.IsWalkableAt(140, 90));
+    grid.SetWalkableAt(140, 10, true);
+    BOOST_REQUIRE_EQUAL(2u, grid.detailed_tiles());
+}
+
+BOOST_AUTO_TEST_CASE(should_map_chunked_grid_in_place) {
+    Grid<> expected = MostlyOpenGrid(11);
+    ChunkedGrid grid(expected.bitmap());
+    std::stringstream chunked;
+    WriteChunkedGrid(chunked, grid);
+    // the header, the directory and the two detailed tiles
+    BOOST_REQUIRE_EQUAL(64u + 64u + 2 * 64 * 8u, chunked.str().size());
+    ChunkedGrid read;
+    ReadChunkedGrid(chunked, read);
+    CheckSameChunkedGrid(read, expected);
+    BOOST_REQUIRE_EQUAL(2u, read.detailed_tiles());
+
+    const std::string path = "test_grid_chunked.bin";
+    {
+        std::ofstream file(path.c_str(), std::ios::binary);
+        WriteChunkedGrid(file, grid);
+    }
+    ChunkedGrid mapped;
+    MapChunkedGrid(path, mapped);
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kBorrowedTile, mapped.tile_kind(0, 0));
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kBlockedTile, mapped.tile_kind(1, 1));
+    CheckSameChunkedGrid(mapped, expected);
+
+    // a cell set copies the tile, the file is left as it was
+    mapped.SetWalkableAt(3, 3, !mapped.IsWalkableAt(3, 3));
+    BOOST_REQUIRE_EQUAL(ChunkedGrid::kDetailedTile, mapped.tile_kind(0, 0));
+    expected.SetWalkableAt(3, 3, mapped.IsWalkableAt(3, 3));
+    CheckSameChunkedGrid(mapped, expected);
+    ChunkedGrid again;
+    MapChunkedGrid(path, again);
+    BOOST_REQUIRE_NE(again.IsWalkableAt(3, 3), mapped.IsWalkableAt(3, 3));
+
+    // a directory entry past the detailed tiles
+    std::string bytes = chunked.str();
+    bytes[64] = 9;
+    std::istringstream corrupt(bytes);
+    BOOST_REQUIRE_THROW(ReadChunkedGrid(corrupt, read), std::runtime_error);
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 8));
+    BOOST_REQUIRE_THROW(ReadChunkedGrid(truncated, read), std::runtime_error);
+    again = ChunkedGrid();
+    mapped = ChunkedGrid();
+    std::remove(path.c_str());
+}
@@ -1,15 +1,38 @@
 #define BOOST_TEST_MODULE PathTest
 #include <boost/test/unit_test.hpp>
 
+#include <climits>
+#include <sstream>
+
+#include "boost/bind.hpp"
+#include "boost/foreach.hpp"
 #include "boost/function.hpp"
+#include "boost/scoped_array.hpp"
+#include "core/chunkedgrid.hpp"
+#include "finders/arastarfinder.hpp"
 #include "finders/astarfinder.hpp"
+#include "finders/asyncfinder.hpp"
+#include "finders/batchfinder.hpp"
+#include "finders/cooperativefinder.hpp"
+#include "finders/biastarfinder.hpp"
+#include "finders/dstarlitefinder.hpp"
+#include "finders/flowfield.hpp"
+#include "finders/fringefinder.hpp"
+#include "finders/hpastarfinder.hpp"
+#include "finders/idastarfinder.hpp"
+#include "finders/jpsplusfinder.hpp"
+#include "finders/jumppointfinder.hpp"
+#include "finders/jumptable.hpp"
+#include "finders/landmarks.hpp"
+#include "finders/pathcache.hpp"
+#include "random.hpp"
 #include "test_path.hpp"
 
 template <typename Finder, typename Maze>
 void Handler(Finder &finder, Maze &maze) {
-    RandomAccessMatrix<Maze::matrix_t> matrix(&maze.matrix);
-    Finder::grid_t grid(matrix.Width(), matrix.Height(), &matrix);
-    Finder::pnode_vector_t nodes =
+    RandomAccessMatrix<typename Maze::matrix_t> matrix(&maze.matrix);
+    typename Finder::grid_t grid(matrix.Width(), matrix.Height(), &matrix);
+    typename Finder::pnode_vector_t nodes =
     finder.FindPath(maze.start_x, maze.start_y,
                     maze.end_x, maze.end_y, grid);
     BOOST_REQUIRE_EQUAL(maze.expected_length, nodes->size());
@@ -80,3 +103,1546 @@ void TestAStarFinder() {
 BOOST_AUTO_TEST_CASE(should_solve_maze) {
     TestAStarFinder();
 }
+
+// Adapt a finder that searches with a given context to EachMaze().
+template <class Finder, class Context = typename Finder::context_t>
+struct ContextFinder : public Finder {
+    typedef typename Finder::size_type size_type;
+    typedef typename Finder::grid_t grid_t;
+    typedef typename Finder::pnode_vector_t pnode_vector_t;
+    ContextFinder(const Finder &finder = Finder()) : Finder(finder) {}
+    pnode_vector_t FindPath(size_type start_x, size_type start_y,
+                            size_type end_x, size_type end_y,
+                            const grid_t &grid) {
+        return Finder::FindPath(start_x, start_y, end_x, end_y,
+                                grid, context);
+    }
+    Context context;
+};
+
+BOOST_AUTO_TEST_CASE(should_solve_maze_with_each_open_list) {
+    ContextFinder<AStarFinder,
+        BasicSearchContext<PairingHeapOpenList> > pairing;
+    EachMaze(pairing);
+    ContextFinder<AStarFinder,
+        BasicSearchContext<DAryHeapOpenList<2> > > binary;
+    EachMaze(binary);
+    ContextFinder<AStarFinder,
+        BasicSearchContext<DAryHeapOpenList<4> > > quaternary;
+    EachMaze(quaternary);
+    ContextFinder<AStarFinder, BasicSearchContext<BucketOpenList> > bucket;
+    EachMaze(bucket);
+}
+
+BOOST_AUTO_TEST_CASE(should_solve_maze_with_specialized_finder) {
+    ContextFinder<BasicAStarFinder<heuristic::Manhattan> > manhattan;
+    EachMaze(manhattan);
+    ContextFinder<BasicAStarFinder<heuristic::Octile,
+        DiagonalPolicy<kDiagonalNever>, BucketOpenList> > octile;
+    EachMaze(octile);
+}
+
+template <class OpenList>
+int RandomQueryCost(const AStarFinder &finder, const AStarFinder::grid_t &grid,
+                    std::size_t seed) {
+    BasicSearchContext<OpenList> context;
+    std::size_t w = grid.width(), h = grid.height();
+    std::size_t sx = seed * 7 % w, sy = seed * 13 % h,
+                ex = seed * 31 % w, ey = seed * 17 % h;
+    AStarFinder::pnode_vector_t path =
+        finder.FindPath(sx, sy, ex, ey, grid, context);
+    return path ? PathCost(path) : -1;
+}
+
+BOOST_AUTO_TEST_CASE(open_lists_should_agree_on_path_cost) {
+    const std::size_t size = 48;
+    AStarFinder::grid_t grid(size, size);
+    unsigned rand = 12345;
+    for (std::size_t i = 0; i < size * size / 4; ++i) {
+        NextRandom(rand);
+        grid.SetWalkableAt((rand >> 8) % size, (rand >> 20) % size, false);
+    }
+    for (int m = 0; m < 3; ++m) {
+        AStarFinder finder;
+        finder.Option().allow_diagonal = m > 0;
+        finder.Option().dont_cross_corners = m > 1;
+        // Manhattan overestimates diagonal moves, and then the path found
+        // depends on the tie-breaking of the open list.
+        if (m > 0) {
+            finder.Option().heuristic = heuristic::Chebyshev();
+        }
+        for (std::size_t seed = 1; seed < 40; ++seed) {
+            int expected = RandomQueryCost<PairingHeapOpenList>(finder, grid, seed);
+            BOOST_REQUIRE_EQUAL(expected,
+                RandomQueryCost<DAryHeapOpenList<4> >(finder, grid, seed));
+            BOOST_REQUIRE_EQUAL(expected,
+                RandomQueryCost<BucketOpenList>(finder, grid, seed));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(euclidean_should_not_need_floating_point) {
+    heuristic::Euclidean euclidean;
+    for (int dx = -300; dx <= 300; dx += 7) {
+        for (int dy = -300; dy <= 300; dy += 3) {
+            BOOST_REQUIRE_EQUAL(int(sqrt(double(dx * dx + dy * dy))),
+                                euclidean(dx, dy));
+        }
+    }
+    BOOST_REQUIRE_EQUAL(655360, euclidean(655360, 0));
+    BOOST_REQUIRE_EQUAL(926819, euclidean(655360, 655360));
+}
+
+BOOST_AUTO_TEST_CASE(octile_should_be_exact_on_empty_map) {
+    BasicAStarFinder<heuristic::Octile,
+        DiagonalPolicy<kDiagonalIfAtMostOneObstacle> > finder;
+    AStarFinder::grid_t grid(20, 20);
+    AStarFinder::context_t context;
+    heuristic::Octile octile;
+    for (std::size_t x = 0; x < 20; x += 3) {
+        for (std::size_t y = 0; y < 20; y += 5) {
+            AStarFinder::pnode_vector_t path =
+                finder.FindPath(2, 3, x, y, grid, context);
+            BOOST_REQUIRE(path);
+            BOOST_REQUIRE_EQUAL(octile(10 * (int(x) - 2), 10 * (int(y) - 3)),
+                                PathCost(path));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_dispatch_to_specialized_finder) {
+    const std::size_t size = 48;
+    AStarFinder::grid_t grid(size, size);
+    unsigned rand = 4321;
+    for (std::size_t i = 0; i < size * size / 4; ++i) {
+        NextRandom(rand);
+        grid.SetWalkableAt((rand >> 8) % size, (rand >> 20) % size, false);
+    }
+    AStarFinder chebyshev, octile, function;
+    chebyshev.Option().heuristic = heuristic::Chebyshev();
+    octile.Option().heuristic = heuristic::Octile();
+    // not one of core/heuristic.hpp, so called through boost::function
+    function.Option().heuristic = boost::function<int(int, int)>(
+        boost::bind<int>(heuristic::Octile(), _1, _2));
+    AStarFinder *finders[] = {&chebyshev, &octile, &function};
+    BOOST_FOREACH(AStarFinder *finder, finders) {
+        finder->Option().allow_diagonal = true;
+        finder->Option().dont_cross_corners = true;
+    }
+    // all of them are admissible, so they agree on the cost
+    for (std::size_t seed = 1; seed < 40; ++seed) {
+        int expected = RandomQueryCost<DefaultOpenList>(chebyshev, grid, seed);
+        BOOST_REQUIRE_EQUAL(expected,
+            RandomQueryCost<DefaultOpenList>(octile, grid, seed));
+        BOOST_REQUIRE_EQUAL(expected,
+            RandomQueryCost<DefaultOpenList>(function, grid, seed));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_solve_maze_again_without_reset) {
+    AStarFinder finder;
+    EachMaze(finder);
+    EachMaze(finder);
+}
+
+BOOST_AUTO_TEST_CASE(should_share_one_grid_between_contexts) {
+    AStarFinder finder;
+    finder.Option().allow_diagonal = true;
+    const std::size_t size = 32;
+    AStarFinder::grid_t grid(size, size);
+    for (std::size_t i = 0; i + 4 < size; ++i) {
+        grid.SetWalkableAt(size / 2, i, false);
+    }
+    const AStarFinder::grid_t &shared = grid;
+    AStarFinder::context_t a, b;
+    AStarFinder::pnode_vector_t pa =
+        finder.FindPath(0, 0, size - 1, 0, shared, a);
+    // another query in between must not disturb the records of `a`
+    AStarFinder::pnode_vector_t pb =
+        finder.FindPath(size - 1, size - 1, 0, size - 1, shared, b);
+    BOOST_REQUIRE(pa && pb);
+    BOOST_REQUIRE(a.IsClosed(shared.IndexAt(0, 0)));
+    BOOST_REQUIRE(b.IsClosed(shared.IndexAt(size - 1, size - 1)));
+    BOOST_REQUIRE(!a.IsOpened(shared.IndexAt(size - 1, size - 1)));
+    AStarFinder::pnode_vector_t again =
+        finder.FindPath(0, 0, size - 1, 0, shared, b);
+    BOOST_REQUIRE(again);
+    BOOST_REQUIRE_EQUAL(pa->size(), again->size());
+    for (std::size_t i = 0; i < pa->size(); ++i) {
+        BOOST_REQUIRE_EQUAL((*pa)[i], (*again)[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_solve_maze_with_jump_point_finder) {
+    JumpPointFinder finder;
+    EachMaze(finder);
+    ContextFinder<BasicJumpPointFinder<heuristic::Manhattan,
+        DiagonalPolicy<kDiagonalNever>, BucketOpenList> > bucket;
+    EachMaze(bucket);
+}
+
+// Every step of the path goes to a neighbor the movement mode allows.
+bool IsValidPath(const AStarFinder::grid_t &grid,
+                 const AStarFinder::pnode_vector_t &path,
+                 DiagonalMovement movement) {
+    for (std::size_t i = 1; i < path->size(); ++i) {
+        AStarFinder::pnode_t from = (*path)[i - 1], to = (*path)[i];
+        unsigned dirs = grid.NeighborMask(from->x, from->y, movement);
+        bool found = false;
+        for (unsigned dir = 0; dir < 8; ++dir) {
+            if (((dirs >> dir) & 1) &&
+                    grid.GetNodeAt(from->x, from->y) + grid.IndexOffset(dir) == to) {
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The finder finds paths as short as the ones of A*.
+template <DiagonalMovement kMovement, class Finder>
+void CompareWithAStar(const Finder &finder, const AStarFinder::grid_t &grid) {
+    BasicAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> > astar;
+    AStarFinder::context_t astar_context;
+    typename Finder::context_t context;
+    std::size_t w = grid.width(), h = grid.height();
+    for (std::size_t seed = 1; seed < 60; ++seed) {
+        std::size_t sx = seed * 7 % w, sy = seed * 13 % h,
+                    ex = seed * 31 % w, ey = seed * 17 % h;
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(sx, sy, ex, ey, grid, astar_context);
+        AStarFinder::pnode_vector_t path =
+            finder.FindPath(sx, sy, ex, ey, grid, context);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+        BOOST_REQUIRE(path->front() == grid.GetNodeAt(sx, sy));
+        BOOST_REQUIRE(path->back() == grid.GetNodeAt(ex, ey));
+        BOOST_REQUIRE(IsValidPath(grid, path, kMovement));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(jump_point_finder_should_agree_with_astar) {
+    // larger than a word both ways, so the scans of rows and columns
+    // cross word boundaries
+    const std::size_t width = 150, height = 90;
+    for (unsigned density = 0; density <= 40; density += 10) {
+        AStarFinder::grid_t grid(width, height);
+        unsigned rand = 777 + density;
+        for (std::size_t i = 0; i < width * height * density / 100; ++i) {
+            NextRandom(rand);
+            grid.SetWalkableAt((rand >> 4) % width, (rand >> 16) % height,
+                               false);
+        }
+        CompareWithAStar<kDiagonalAlways>(
+            JumpPointFinder(kDiagonalAlways), grid);
+        CompareWithAStar<kDiagonalNever>(
+            JumpPointFinder(kDiagonalNever), grid);
+        CompareWithAStar<kDiagonalIfAtMostOneObstacle>(
+            JumpPointFinder(kDiagonalIfAtMostOneObstacle), grid);
+        CompareWithAStar<kDiagonalOnlyWhenNoObstacles>(
+            JumpPointFinder(kDiagonalOnlyWhenNoObstacles), grid);
+    }
+}
+
+void MakeRandomGrid(AStarFinder::grid_t &grid, unsigned seed,
+                    unsigned density) {
+    std::size_t w = grid.width(), h = grid.height();
+    for (std::size_t i = 0; i < w * h * density / 100; ++i) {
+        NextRandom(seed);
+        grid.SetWalkableAt((seed >> 4) % w, (seed >> 16) % h, false);
+    }
+}
+
+// Flip random cells, and check after each flip that the table repaired
+// itself into the one built from scratch, and that JPS+ still finds the
+// shortest paths.
+template <DiagonalMovement kMovement>
+void CheckJumpTable(unsigned seed) {
+    AStarFinder::grid_t grid(100, 70);
+    MakeRandomGrid(grid, seed, 20);
+    JumpTable<DiagonalPolicy<kMovement> > table(grid);
+    BasicJPSPlusFinder<heuristic::Octile, DiagonalPolicy<kMovement> >
+        finder(table);
+    CompareWithAStar<kMovement>(finder, grid);
+    for (int flip = 0; flip < 120; ++flip) {
+        NextRandom(seed);
+        std::size_t x = (seed >> 4) % grid.width(),
+                    y = (seed >> 16) % grid.height();
+        grid.SetWalkableAt(x, y, !grid.IsWalkableAt(x, y));
+        JumpTable<DiagonalPolicy<kMovement> > expected(grid);
+        for (std::size_t i = 0; i < grid.size(); ++i) {
+            for (unsigned dir = 0; dir < 8; ++dir) {
+                BOOST_REQUIRE_EQUAL(expected.Distance(i, dir),
+                                    table.Distance(i, dir));
+            }
+        }
+    }
+    CompareWithAStar<kMovement>(finder, grid);
+}
+
+BOOST_AUTO_TEST_CASE(jump_table_should_repair_itself) {
+    CheckJumpTable<kDiagonalAlways>(11);
+    CheckJumpTable<kDiagonalNever>(12);
+    CheckJumpTable<kDiagonalIfAtMostOneObstacle>(13);
+    CheckJumpTable<kDiagonalOnlyWhenNoObstacles>(14);
+}
+
+BOOST_AUTO_TEST_CASE(should_solve_maze_with_bi_astar_finder) {
+    BiAStarFinder finder;
+    EachMaze(finder);
+    finder.set_parallel(true);
+    EachMaze(finder);
+}
+
+template <DiagonalMovement kMovement>
+void CheckBiAStarFinder(const AStarFinder::grid_t &grid) {
+    BiAStarFinder finder;
+    finder.Option().allow_diagonal = kMovement != kDiagonalNever;
+    finder.Option().dont_cross_corners =
+        kMovement == kDiagonalOnlyWhenNoObstacles;
+    finder.Option().heuristic = heuristic::Octile();
+    CompareWithAStar<kMovement>(finder, grid);
+    finder.set_parallel(true);
+    CompareWithAStar<kMovement>(finder, grid);
+}
+
+BOOST_AUTO_TEST_CASE(bi_astar_finder_should_leave_blocked_start) {
+    // the backward side runs out of cells at once, as it cannot enter
+    // the start
+    AStarFinder::grid_t grid(8, 8);
+    grid.SetWalkableAt(0, 0, false);
+    grid.SetWalkableAt(2, 0, false);
+    grid.SetWalkableAt(2, 1, false);
+    grid.SetWalkableAt(2, 2, false);
+    grid.SetWalkableAt(1, 2, false);
+    grid.SetWalkableAt(0, 2, false);
+    BiAStarFinder finder(BiAStarFinder::poption_t(), true);
+    for (int i = 0; i < 200; ++i) {
+        AStarFinder::pnode_vector_t path = finder.FindPath(0, 0, 1, 1, grid);
+        BOOST_REQUIRE(path);
+        BOOST_REQUIRE_EQUAL(3u, path->size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bi_astar_finder_should_find_shortest_paths) {
+    for (unsigned density = 0; density <= 40; density += 20) {
+        AStarFinder::grid_t grid(80, 60);
+        MakeRandomGrid(grid, 4242 + density, density);
+        CheckBiAStarFinder<kDiagonalNever>(grid);
+        CheckBiAStarFinder<kDiagonalIfAtMostOneObstacle>(grid);
+        CheckBiAStarFinder<kDiagonalOnlyWhenNoObstacles>(grid);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_solve_maze_with_memory_bounded_finders) {
+    IDAStarFinder idastar;
+    EachMaze(idastar);
+    IDAStarFinder without_table(IDAStarFinder::poption_t(), 0);
+    EachMaze(without_table);
+    FringeFinder fringe;
+    EachMaze(fringe);
+}
+
+template <DiagonalMovement kMovement, class Heuristic>
+void CheckMemoryBoundedFinders(const AStarFinder::grid_t &grid) {
+    CompareWithAStar<kMovement>(
+        BasicIDAStarFinder<Heuristic, DiagonalPolicy<kMovement> >(), grid);
+    CompareWithAStar<kMovement>(
+        BasicFringeFinder<Heuristic, DiagonalPolicy<kMovement> >(), grid);
+}
+
+BOOST_AUTO_TEST_CASE(memory_bounded_finders_should_find_shortest_paths) {
+    for (unsigned density = 0; density <= 30; density += 15) {
+        AStarFinder::grid_t grid(40, 30);
+        MakeRandomGrid(grid, 99 + density, density);
+        CheckMemoryBoundedFinders<kDiagonalNever, heuristic::Manhattan>(grid);
+        CheckMemoryBoundedFinders<kDiagonalAlways, heuristic::Octile>(grid);
+        CheckMemoryBoundedFinders<kDiagonalOnlyWhenNoObstacles,
+                                  heuristic::Octile>(grid);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(memory_bounded_finders_should_tell_unreachable_goal) {
+    AStarFinder::grid_t grid(10, 10);
+    grid.SetWalkableAt(4, 5, false);
+    grid.SetWalkableAt(6, 5, false);
+    grid.SetWalkableAt(5, 4, false);
+    grid.SetWalkableAt(5, 6, false);
+    IDAStarFinder idastar;
+    BOOST_REQUIRE(!idastar.FindPath(0, 0, 5, 5, grid));
+    FringeFinder fringe;
+    BOOST_REQUIRE(!fringe.FindPath(0, 0, 5, 5, grid));
+    BOOST_REQUIRE(!fringe.Context().exhausted());
+}
+
+// Octile, bound to every goal, counting the queries.
+class CountingGoalHeuristic : public GoalBoundHeuristic {
+public:
+    explicit CountingGoalHeuristic(int *binds) : binds_(binds) {}
+    int operator()(int dx, int dy) const {
+        return heuristic::Octile()(dx, dy);
+    }
+    FinderOption::heuristic_t Bind(size_type, size_type, size_type,
+                                   size_type, DiagonalMovement) const {
+        ++*binds_;
+        return heuristic::Octile();
+    }
+
+private:
+    int *binds_;
+};
+
+BOOST_AUTO_TEST_CASE(memory_bounded_finders_should_bind_goal_heuristic) {
+    AStarFinder::grid_t grid(40, 30);
+    MakeRandomGrid(grid, 61, 20);
+    int binds = 0;
+    FinderOption option = {
+        true, false, GoalHeuristic(new CountingGoalHeuristic(&binds)), 1};
+    IDAStarFinder idastar(IDAStarFinder::poption_t(new FinderOption(option)));
+    FringeFinder fringe(FringeFinder::poption_t(new FinderOption(option)));
+    CompareWithAStar<kDiagonalIfAtMostOneObstacle>(idastar, grid);
+    BOOST_REQUIRE_GT(binds, 0);
+    int idastar_binds = binds;
+    CompareWithAStar<kDiagonalIfAtMostOneObstacle>(fringe, grid);
+    BOOST_REQUIRE_EQUAL(2 * idastar_binds, binds);
+}
+
+BOOST_AUTO_TEST_CASE(fringe_finder_should_stay_within_capacity) {
+    AStarFinder::grid_t grid(64, 64);
+    for (std::size_t y = 0; y + 1 < 64; ++y) {
+        grid.SetWalkableAt(32, y, false);
+    }
+    BasicFringeFinder<heuristic::Manhattan> finder;
+    FringeContext small(100), large(64 * 64);
+    BOOST_REQUIRE(!finder.FindPath(0, 0, 63, 0, grid, small));
+    BOOST_REQUIRE(small.exhausted());
+    BOOST_REQUIRE_EQUAL(100u, small.size());
+    AStarFinder::pnode_vector_t path =
+        finder.FindPath(0, 0, 63, 0, grid, large);
+    BOOST_REQUIRE(path);
+    BOOST_REQUIRE(!large.exhausted());
+    BOOST_REQUIRE_EQUAL(10 * (63 + 2 * 63), PathCost(path));
+}
+
+// HPA* finds a path whenever A* does, at most twice as long as the one of
+// A* on these small grids.
+template <DiagonalMovement kMovement>
+void CheckHPAStarFinder(const AStarFinder::grid_t &grid,
+                        const ClusterGraph<DiagonalPolicy<kMovement> > &graph) {
+    BasicAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> > astar;
+    AStarFinder::context_t astar_context;
+    BasicHPAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> >
+        finder(graph);
+    HPAStarContext<> context;
+    std::size_t w = grid.width(), h = grid.height();
+    for (std::size_t seed = 1; seed < 60; ++seed) {
+        std::size_t sx = seed * 7 % w, sy = seed * 13 % h,
+                    ex = seed * 31 % w, ey = seed * 17 % h;
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(sx, sy, ex, ey, grid, astar_context);
+        AStarFinder::pnode_vector_t path =
+            finder.FindPath(sx, sy, ex, ey, grid, context);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            continue;
+        }
+        BOOST_REQUIRE(path->front() == grid.GetNodeAt(sx, sy));
+        BOOST_REQUIRE(path->back() == grid.GetNodeAt(ex, ey));
+        BOOST_REQUIRE(IsValidPath(grid, path, kMovement));
+        BOOST_REQUIRE_LE(PathCost(expected), PathCost(path));
+        BOOST_REQUIRE_LE(PathCost(path), PathCost(expected) * 2);
+    }
+}
+
+// Flip random cells, and check after each flip that only the clusters
+// around the cell were built again, into the graph built from scratch.
+template <DiagonalMovement kMovement>
+void CheckClusterGraph(unsigned seed) {
+    typedef ClusterGraph<DiagonalPolicy<kMovement> > graph_t;
+    AStarFinder::grid_t grid(70, 45);
+    MakeRandomGrid(grid, seed, 25);
+    graph_t graph(grid, 8);
+    CheckHPAStarFinder<kMovement>(grid, graph);
+    for (int flip = 0; flip < 80; ++flip) {
+        NextRandom(seed);
+        std::size_t x = (seed >> 4) % grid.width(),
+                    y = (seed >> 16) % grid.height();
+        std::size_t builds = graph.builds();
+        grid.SetWalkableAt(x, y, !grid.IsWalkableAt(x, y));
+        BOOST_REQUIRE_LE(graph.builds() - builds, 4u);
+        graph_t expected(grid, 8);
+        for (std::size_t c = 0; c < graph.clusters(); ++c) {
+            const std::vector<typename graph_t::Node> &nodes = graph.Nodes(c),
+                &expected_nodes = expected.Nodes(c);
+            BOOST_REQUIRE_EQUAL(expected_nodes.size(), nodes.size());
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                BOOST_REQUIRE_EQUAL(expected_nodes[i].cell, nodes[i].cell);
+                BOOST_REQUIRE_EQUAL(expected_nodes[i].edges.size(),
+                                    nodes[i].edges.size());
+                for (std::size_t e = 0; e < nodes[i].edges.size(); ++e) {
+                    BOOST_REQUIRE_EQUAL(expected_nodes[i].edges[e].to,
+                                        nodes[i].edges[e].to);
+                    BOOST_REQUIRE_EQUAL(expected_nodes[i].edges[e].cost,
+                                        nodes[i].edges[e].cost);
+                }
+            }
+        }
+    }
+    CheckHPAStarFinder<kMovement>(grid, graph);
+}
+
+BOOST_AUTO_TEST_CASE(hpa_star_finder_should_find_near_shortest_paths) {
+    for (unsigned density = 0; density <= 40; density += 20) {
+        AStarFinder::grid_t grid(80, 60);
+        MakeRandomGrid(grid, 31 + density, density);
+        CheckHPAStarFinder<kDiagonalAlways>(grid,
+            ClusterGraph<DiagonalPolicy<kDiagonalAlways> >(grid, 8));
+        CheckHPAStarFinder<kDiagonalNever>(grid,
+            ClusterGraph<DiagonalPolicy<kDiagonalNever> >(grid, 8));
+        CheckHPAStarFinder<kDiagonalIfAtMostOneObstacle>(grid,
+            ClusterGraph<DiagonalPolicy<kDiagonalIfAtMostOneObstacle> >(
+                grid, 8));
+        CheckHPAStarFinder<kDiagonalOnlyWhenNoObstacles>(grid,
+            ClusterGraph<DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> >(
+                grid, 16));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hpa_star_finder_should_keep_short_paths_shortest) {
+    // the goals in the cluster of the start or the next ones, where the
+    // detours to the entrances were the most of the path
+    typedef DiagonalPolicy<kDiagonalIfAtMostOneObstacle> diagonal_t;
+    for (unsigned density = 0; density <= 20; density += 20) {
+        AStarFinder::grid_t grid(80, 60);
+        MakeRandomGrid(grid, 37 + density, density);
+        ClusterGraph<diagonal_t> graph(grid, 8);
+        BasicAStarFinder<heuristic::Octile, diagonal_t> astar;
+        AStarFinder::context_t astar_context;
+        BasicHPAStarFinder<heuristic::Octile, diagonal_t> finder(graph);
+        HPAStarContext<> context;
+        int astar_cost = 0, cost = 0;
+        unsigned seed = 41;
+        for (int i = 0; i < 300; ++i) {
+            std::size_t sx = (NextRandom(seed) >> 8) % 80,
+                        sy = (NextRandom(seed) >> 8) % 60,
+                        ex = std::min<std::size_t>(
+                            79, sx / 8 * 8 + (NextRandom(seed) >> 8) % 16),
+                        ey = std::min<std::size_t>(
+                            59, sy / 8 * 8 + (NextRandom(seed) >> 8) % 16);
+            if (!grid.IsWalkableAt(sx, sy)) {
+                continue;
+            }
+            AStarFinder::pnode_vector_t expected =
+                astar.FindPath(sx, sy, ex, ey, grid, astar_context);
+            AStarFinder::pnode_vector_t path =
+                finder.FindPath(sx, sy, ex, ey, grid, context);
+            BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+            if (!path) {
+                continue;
+            }
+            BOOST_REQUIRE(IsValidPath(grid, path, diagonal_t::movement));
+            if (density == 0) {
+                BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+            }
+            astar_cost += PathCost(expected);
+            cost += PathCost(path);
+        }
+        // within 2% over all the queries
+        BOOST_REQUIRE_LE(cost * 100, astar_cost * 102);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hpa_star_finder_should_squeeze_between_clusters) {
+    // the two clusters meet only where a diagonal move passes between
+    // two blocks
+    AStarFinder::grid_t grid(16, 8);
+    for (std::size_t y = 0; y < 8; ++y) {
+        grid.SetWalkableAt(7, y, y == 3);
+        grid.SetWalkableAt(8, y, y == 4);
+    }
+    CheckHPAStarFinder<kDiagonalAlways>(grid,
+        ClusterGraph<DiagonalPolicy<kDiagonalAlways> >(grid, 8));
+    CheckHPAStarFinder<kDiagonalIfAtMostOneObstacle>(grid,
+        ClusterGraph<DiagonalPolicy<kDiagonalIfAtMostOneObstacle> >(grid, 8));
+}
+
+BOOST_AUTO_TEST_CASE(cluster_graph_should_rebuild_touched_clusters) {
+    CheckClusterGraph<kDiagonalAlways>(21);
+    CheckClusterGraph<kDiagonalNever>(22);
+    CheckClusterGraph<kDiagonalIfAtMostOneObstacle>(23);
+    CheckClusterGraph<kDiagonalOnlyWhenNoObstacles>(24);
+}
+
+void CountRun(boost::atomic<int> *runs, unsigned /*worker*/,
+              std::size_t item) {
+    // the first items take longer, so that their range is stolen from
+    for (volatile int spin = item < 50 ? 20000 : 0; spin > 0; --spin) {
+    }
+    ++runs[item];
+}
+
+BOOST_AUTO_TEST_CASE(work_stealing_pool_should_run_every_item_once) {
+    WorkStealingPool pool(4);
+    BOOST_REQUIRE_EQUAL(4u, pool.workers());
+    const std::size_t count = 1000;
+    boost::scoped_array<boost::atomic<int> > runs(
+        new boost::atomic<int>[count]);
+    for (int round = 0; round < 3; ++round) {
+        for (std::size_t i = 0; i < count; ++i) {
+            runs[i].store(0);
+        }
+        pool.Run(count, boost::bind(&CountRun, runs.get(), _1, _2));
+        for (std::size_t i = 0; i < count; ++i) {
+            BOOST_REQUIRE_EQUAL(1, runs[i].load());
+        }
+    }
+    pool.Run(0, boost::bind(&CountRun, runs.get(), _1, _2));
+}
+
+// The paths of a batch are the ones of the queries one by one, even from
+// an arena too small for them at first.
+template <class Finder>
+void CheckBatchFinder(const Finder &finder, const AStarFinder::grid_t &grid) {
+    std::vector<PathQuery> batch;
+    unsigned rand = 2024;
+    for (int i = 0; i < 300; ++i) {
+        PathQuery query;
+        NextRandom(rand);
+        query.start_x = (rand >> 4) % grid.width();
+        query.start_y = (rand >> 16) % grid.height();
+        NextRandom(rand);
+        query.end_x = (rand >> 4) % grid.width();
+        query.end_y = (rand >> 16) % grid.height();
+        batch.push_back(query);
+    }
+    BatchFinder<Finder> batch_finder(finder, 4);
+    typename BatchFinder<Finder>::arena_t paths(16);
+    typename Finder::context_t context;
+    for (int round = 0; round < 2; ++round) {
+        batch_finder.FindPaths(batch, grid, paths);
+        BOOST_REQUIRE_EQUAL(batch.size(), paths.size());
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            const PathQuery &query = batch[i];
+            AStarFinder::pnode_vector_t expected = finder.FindPath(
+                query.start_x, query.start_y, query.end_x, query.end_y,
+                grid, context);
+            BOOST_REQUIRE_EQUAL(bool(expected), paths.Found(i));
+            if (expected) {
+                BOOST_REQUIRE_EQUAL(expected->size(), paths.PathSize(i));
+                BOOST_REQUIRE(std::equal(paths.begin(i), paths.end(i),
+                                         expected->begin()));
+            }
+        }
+    }
+    // the arena grew once, to fit the whole batch
+    BOOST_REQUIRE_LE(paths.used(), paths.capacity());
+    std::size_t capacity = paths.capacity();
+    BOOST_REQUIRE_EQUAL(batch.size(),
+                        batch_finder.FindPaths(batch, grid).size());
+    batch_finder.FindPaths(batch, grid, paths);
+    BOOST_REQUIRE_EQUAL(capacity, paths.capacity());
+}
+
+BOOST_AUTO_TEST_CASE(batch_finder_should_find_paths_of_single_queries) {
+    AStarFinder::grid_t grid(80, 60);
+    MakeRandomGrid(grid, 555, 30);
+    FinderOption option = {true, true, heuristic::Octile(), 1};
+    CheckBatchFinder(AStarFinder(AStarFinder::poption_t(
+        new FinderOption(option))), grid);
+    CheckBatchFinder(BasicJumpPointFinder<heuristic::Octile,
+        DiagonalPolicy<kDiagonalAlways> >(), grid);
+}
+
+// The field has the costs of the paths of A* to the goal, and its steps
+// follow one of them.
+template <DiagonalMovement kMovement>
+void CheckFlowField(const AStarFinder::grid_t &grid, std::size_t goal_x,
+                    std::size_t goal_y) {
+    BasicAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> > astar;
+    AStarFinder::context_t context;
+    FlowField<DiagonalPolicy<kMovement> > field(grid);
+    field.Build(goal_x, goal_y);
+    for (std::size_t index = 0; index < grid.size(); index += 7) {
+        std::size_t x = 0, y = 0;
+        grid.CoordsOf(index, x, y);
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(x, y, goal_x, goal_y, grid, context);
+        AStarFinder::pnode_vector_t path = field.PathFrom(x, y);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            BOOST_REQUIRE_EQUAL(+FlowField<>::kUnreachable,
+                                field.Distance(x, y));
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), field.Distance(x, y));
+        BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+        BOOST_REQUIRE(path->front() == grid.GetNodeAt(x, y));
+        BOOST_REQUIRE(path->back() == grid.GetNodeAt(goal_x, goal_y));
+        BOOST_REQUIRE(IsValidPath(grid, path, kMovement));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(flow_field_should_follow_shortest_paths) {
+    for (unsigned density = 0; density <= 40; density += 20) {
+        AStarFinder::grid_t grid(61, 43);
+        MakeRandomGrid(grid, 808 + density, density);
+        // the last goal is blocked, unless the density is 0
+        std::size_t goals[3][2] = {{30, 20}, {0, 42}, {0, 0}};
+        grid.SetWalkableAt(0, 0, density == 0);
+        for (int g = 0; g < 3; ++g) {
+            CheckFlowField<kDiagonalAlways>(grid, goals[g][0], goals[g][1]);
+            CheckFlowField<kDiagonalNever>(grid, goals[g][0], goals[g][1]);
+            CheckFlowField<kDiagonalIfAtMostOneObstacle>(
+                grid, goals[g][0], goals[g][1]);
+            CheckFlowField<kDiagonalOnlyWhenNoObstacles>(
+                grid, goals[g][0], goals[g][1]);
+        }
+    }
+}
+
+// Rooms of 8x8 cells, each wall between two rooms with one door, where
+// the straight line to the goal is rarely the way.
+void MakeRoomGrid(AStarFinder::grid_t &grid, unsigned seed) {
+    std::size_t w = grid.width(), h = grid.height();
+    for (std::size_t y = 0; y < h; ++y) {
+        for (std::size_t x = 0; x < w; ++x) {
+            grid.SetWalkableAt(x, y, x % 8 != 7 && y % 8 != 7);
+        }
+    }
+    for (std::size_t ry = 0; ry < h; ry += 8) {
+        for (std::size_t rx = 0; rx < w; rx += 8) {
+            NextRandom(seed);
+            if (rx + 7 < w) {
+                grid.SetWalkableAt(rx + 7, ry + (seed >> 8) % 7, true);
+            }
+            if (ry + 7 < h) {
+                grid.SetWalkableAt(rx + (seed >> 20) % 7, ry + 7, true);
+            }
+        }
+    }
+}
+
+template <class Context>
+std::size_t CountClosed(const Context &context, std::size_t size) {
+    std::size_t closed = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        closed += context.IsClosed(i) ? 1 : 0;
+    }
+    return closed;
+}
+
+BOOST_AUTO_TEST_CASE(landmark_heuristic_should_keep_paths_shortest) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRoomGrid(grid, 64);
+    boost::shared_ptr<LandmarkTable> table(new LandmarkTable);
+    table->Build(grid, kDiagonalIfAtMostOneObstacle, 8, 4);
+    BOOST_REQUIRE_EQUAL(8u, table->landmarks().size());
+
+    FinderOption octile_option = {true, false, heuristic::Octile(), 1};
+    FinderOption alt_option = {
+        true, false, GoalHeuristic(new LandmarkHeuristic(table)), 1};
+    AStarFinder octile(AStarFinder::poption_t(new FinderOption(octile_option)));
+    AStarFinder alt(AStarFinder::poption_t(new FinderOption(alt_option)));
+    AStarFinder::context_t octile_context, alt_context;
+    FlowField<DiagonalPolicy<kDiagonalIfAtMostOneObstacle> > field(grid);
+    std::size_t octile_closed = 0, alt_closed = 0;
+    unsigned rand = 99;
+    for (int i = 0; i < 60; ++i) {
+        NextRandom(rand);
+        std::size_t sx = (rand >> 4) % 64, sy = (rand >> 12) % 64,
+                    ex = (rand >> 18) % 64, ey = (rand >> 24) % 64;
+        AStarFinder::pnode_vector_t expected =
+            octile.FindPath(sx, sy, ex, ey, grid, octile_context);
+        AStarFinder::pnode_vector_t path =
+            alt.FindPath(sx, sy, ex, ey, grid, alt_context);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+        octile_closed += CountClosed(octile_context, grid.size());
+        alt_closed += CountClosed(alt_context, grid.size());
+
+        // a lower bound of the distance from every cell to the goal
+        LandmarkHeuristic::Bound bound =
+            LandmarkHeuristic(table).To(ex, ey);
+        field.Build(ex, ey);
+        for (std::size_t c = 0; c < grid.size(); c += 5) {
+            std::size_t x = 0, y = 0;
+            grid.CoordsOf(c, x, y);
+            int distance = field.Distance(x, y);
+            if (distance != field.kUnreachable) {
+                BOOST_REQUIRE_LE(bound(10 * (int(x) - int(ex)),
+                                       10 * (int(y) - int(ey))), distance);
+            }
+        }
+    }
+    // about half of the cells are closed
+    BOOST_REQUIRE_LT(3 * alt_closed, 2 * octile_closed);
+}
+
+BOOST_AUTO_TEST_CASE(bi_astar_finder_should_bind_landmark_heuristic) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRoomGrid(grid, 65);
+    boost::shared_ptr<LandmarkTable> table(new LandmarkTable);
+    table->Build(grid, kDiagonalIfAtMostOneObstacle, 8, 4);
+
+    FinderOption octile_option = {true, false, heuristic::Octile(), 1};
+    FinderOption alt_option = {
+        true, false, GoalHeuristic(new LandmarkHeuristic(table)), 1};
+    AStarFinder astar(AStarFinder::poption_t(new FinderOption(octile_option)));
+    BiAStarFinder octile(
+        BiAStarFinder::poption_t(new FinderOption(octile_option)));
+    BiAStarFinder alt(BiAStarFinder::poption_t(new FinderOption(alt_option)));
+    BiAStarFinder::context_t octile_context, alt_context;
+    std::size_t octile_closed = 0, alt_closed = 0;
+    unsigned rand = 101;
+    for (int i = 0; i < 60; ++i) {
+        NextRandom(rand);
+        std::size_t sx = (rand >> 4) % 64, sy = (rand >> 12) % 64,
+                    ex = (rand >> 18) % 64, ey = (rand >> 24) % 64;
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(sx, sy, ex, ey, grid);
+        octile.FindPath(sx, sy, ex, ey, grid, octile_context);
+        alt.set_parallel(i % 2 == 1);
+        AStarFinder::pnode_vector_t path =
+            alt.FindPath(sx, sy, ex, ey, grid, alt_context);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+        for (int side = 0; side < 2; ++side) {
+            octile_closed += CountClosed(octile_context.side(side),
+                                         grid.size());
+            alt_closed += CountClosed(alt_context.side(side), grid.size());
+        }
+    }
+    // the landmarks, bound to the end and to the start, and not octile
+    BOOST_REQUIRE_LT(3 * alt_closed, 2 * octile_closed);
+}
+
+BOOST_AUTO_TEST_CASE(landmark_table_should_save_and_load) {
+    AStarFinder::grid_t grid(40, 24);
+    MakeRoomGrid(grid, 40);
+    LandmarkTable table;
+    table.Build(grid, kDiagonalNever, 5);
+    std::stringstream file;
+    table.Save(file);
+    LandmarkTable loaded;
+    loaded.Load(file);
+    BOOST_REQUIRE(loaded.Fits(grid));
+    BOOST_REQUIRE_EQUAL(kDiagonalNever, loaded.movement());
+    BOOST_REQUIRE(table.landmarks() == loaded.landmarks());
+    for (std::size_t i = 0; i < grid.size(); ++i) {
+        BOOST_REQUIRE(std::equal(table.Distances(i), table.Distances(i) + 5,
+                                 loaded.Distances(i)));
+    }
+    // the bytes per distance halve the size
+    BOOST_REQUIRE_EQUAL(8 * 4 + 5 * 4 + grid.size() * 5 * 2,
+                        file.str().size());
+
+    std::string bytes = file.str();
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+    BOOST_REQUIRE_THROW(loaded.Load(truncated), std::runtime_error);
+    bytes[0] = 'X';
+    std::stringstream corrupt(bytes);
+    BOOST_REQUIRE_THROW(loaded.Load(corrupt), std::runtime_error);
+    // a table of another map is told apart
+    grid.SetWalkableAt(0, 0, !grid.IsWalkableAt(0, 0));
+    BOOST_REQUIRE(!table.Fits(grid));
+}
+
+// Two heuristics of the same type, told apart by the cache by address.
+int ZeroHeuristic(int, int) { return 0; }
+int HalfManhattan(int dx, int dy) { return (dx + dy) * 5; }
+
+// Flip random cells between queries from a few ends, and check that the
+// cached paths stay as short as the ones of a search on the grid as it is.
+template <DiagonalMovement kMovement>
+void CheckPathCache(unsigned seed) {
+    AStarFinder::grid_t grid(48, 40);
+    MakeRandomGrid(grid, seed, 25);
+    FinderOption option = {kMovement != kDiagonalNever,
+                           kMovement == kDiagonalOnlyWhenNoObstacles,
+                           heuristic::Octile(), 1};
+    AStarFinder finder(AStarFinder::poption_t(new FinderOption(option)));
+    AStarFinder::context_t context;
+    PathCache cache(grid, 8, 8);
+    for (int i = 0; i < 600; ++i) {
+        NextRandom(seed);
+        std::size_t x = (seed >> 4) % 48, y = (seed >> 12) % 40;
+        if (i % 3 == 0) {
+            grid.SetWalkableAt(x, y, !grid.IsWalkableAt(x, y));
+        }
+        // one of 12 queries, so that most of them are asked again
+        std::size_t q = (seed >> 20) % 12;
+        std::size_t sx = q * 7 % 48, sy = q * 13 % 40,
+                    ex = (q * 31 + 20) % 48, ey = (q * 17 + 9) % 40;
+        AStarFinder::pnode_vector_t expected =
+            finder.FindPath(sx, sy, ex, ey, grid, context);
+        AStarFinder::pnode_vector_t path =
+            cache.FindPath(finder, sx, sy, ex, ey, context);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+        BOOST_REQUIRE(path->front() == grid.GetNodeAt(sx, sy));
+        BOOST_REQUIRE(path->back() == grid.GetNodeAt(ex, ey));
+        BOOST_REQUIRE(IsValidPath(grid, path, kMovement));
+    }
+    BOOST_REQUIRE_LE(cache.size(), 8u);
+    BOOST_REQUIRE_GT(cache.hits(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(path_cache_should_drop_paths_of_edited_regions) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRoomGrid(grid, 7);
+    FinderOption option = {true, true, heuristic::Octile(), 1};
+    AStarFinder finder(AStarFinder::poption_t(new FinderOption(option)));
+    AStarFinder::context_t context;
+    PathCache cache(grid);
+    AStarFinder::pnode_vector_t path =
+        cache.FindPath(finder, 1, 1, 20, 3, context);
+    BOOST_REQUIRE(path);
+    BOOST_REQUIRE_EQUAL(0u, cache.hits());
+    BOOST_REQUIRE(cache.FindPath(finder, 1, 1, 20, 3, context));
+    BOOST_REQUIRE_EQUAL(1u, cache.hits());
+
+    // another heuristic is another query
+    option.heuristic = heuristic::Manhattan();
+    AStarFinder manhattan(AStarFinder::poption_t(new FinderOption(option)));
+    cache.FindPath(manhattan, 1, 1, 20, 3, context);
+    BOOST_REQUIRE_EQUAL(1u, cache.hits());
+    BOOST_REQUIRE_EQUAL(2u, cache.size());
+    // so is another function, while a functor of any other type is not
+    // kept at all
+    option.heuristic = &ZeroHeuristic;
+    AStarFinder zero(AStarFinder::poption_t(new FinderOption(option)));
+    cache.FindPath(zero, 1, 1, 20, 3, context);
+    option.heuristic = &HalfManhattan;
+    AStarFinder half(AStarFinder::poption_t(new FinderOption(option)));
+    cache.FindPath(half, 1, 1, 20, 3, context);
+    BOOST_REQUIRE_EQUAL(1u, cache.hits());
+    BOOST_REQUIRE_EQUAL(4u, cache.size());
+    option.heuristic = boost::bind(&HalfManhattan, _1, _2);
+    AStarFinder bound(AStarFinder::poption_t(new FinderOption(option)));
+    BOOST_REQUIRE(cache.FindPath(bound, 1, 1, 20, 3, context));
+    BOOST_REQUIRE(cache.FindPath(bound, 1, 1, 20, 3, context));
+    BOOST_REQUIRE_EQUAL(1u, cache.hits());
+    BOOST_REQUIRE_EQUAL(4u, cache.size());
+
+    // a cell blocked far from the path, or opened too far to shorten it
+    grid.SetWalkableAt(60, 60, false);
+    grid.SetWalkableAt(63, 55, true);
+    BOOST_REQUIRE(cache.FindPath(finder, 1, 1, 20, 3, context));
+    BOOST_REQUIRE_EQUAL(2u, cache.hits());
+
+    // a cell blocked on the path
+    AStarFinder::pnode_t middle = (*path)[path->size() / 2];
+    grid.SetWalkableAt(middle->x, middle->y, false);
+    AStarFinder::pnode_vector_t detour =
+        cache.FindPath(finder, 1, 1, 20, 3, context);
+    BOOST_REQUIRE_EQUAL(2u, cache.hits());
+    BOOST_REQUIRE(std::find(detour->begin(), detour->end(), middle) ==
+                  detour->end());
+
+    // a wall opened on the way
+    grid.SetWalkableAt(middle->x, middle->y, true);
+    for (std::size_t y = 0; y < 7; ++y) {
+        grid.SetWalkableAt(7, y, true);
+        grid.SetWalkableAt(15, y, true);
+    }
+    AStarFinder::pnode_vector_t shortcut =
+        cache.FindPath(finder, 1, 1, 20, 3, context);
+    BOOST_REQUIRE_EQUAL(2u, cache.hits());
+    BOOST_REQUIRE_LT(PathCost(shortcut), PathCost(path));
+
+    CheckPathCache<kDiagonalNever>(3);
+    CheckPathCache<kDiagonalAlways>(5);
+    CheckPathCache<kDiagonalIfAtMostOneObstacle>(7);
+    CheckPathCache<kDiagonalOnlyWhenNoObstacles>(9);
+}
+
+// Walk towards goals along the paths found, flipping random cells at
+// each step, and check that the paths stay as short as the ones of A*.
+template <DiagonalMovement kMovement>
+void CheckDStarLiteFinder(unsigned seed) {
+    AStarFinder::grid_t grid(60, 50);
+    MakeRandomGrid(grid, seed, 25);
+    BasicAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> > astar;
+    AStarFinder::context_t context;
+    BasicDStarLiteFinder<heuristic::Octile, DiagonalPolicy<kMovement> >
+        finder(grid);
+    std::size_t sx = 0, sy = 0, ex = 0, ey = 0;
+    for (int i = 0; i < 400; ++i) {
+        NextRandom(seed);
+        if (i % 40 == 0) {
+            sx = (seed >> 4) % 60;
+            sy = (seed >> 10) % 50;
+            ex = (seed >> 16) % 60;
+            ey = (seed >> 22) % 50;
+        }
+        for (unsigned flips = seed >> 30; flips > 0; --flips) {
+            NextRandom(seed);
+            std::size_t x = (seed >> 4) % 60, y = (seed >> 12) % 50;
+            grid.SetWalkableAt(x, y, !grid.IsWalkableAt(x, y));
+        }
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(sx, sy, ex, ey, grid, context);
+        AStarFinder::pnode_vector_t path = finder.FindPath(sx, sy, ex, ey);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (!path) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+        BOOST_REQUIRE(path->front() == grid.GetNodeAt(sx, sy));
+        BOOST_REQUIRE(path->back() == grid.GetNodeAt(ex, ey));
+        BOOST_REQUIRE(IsValidPath(grid, path, kMovement));
+        // one step ahead
+        if (path->size() > 1) {
+            sx = (*path)[1]->x;
+            sy = (*path)[1]->y;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(d_star_lite_finder_should_repair_its_search) {
+    CheckDStarLiteFinder<kDiagonalNever>(11);
+    CheckDStarLiteFinder<kDiagonalAlways>(13);
+    CheckDStarLiteFinder<kDiagonalIfAtMostOneObstacle>(17);
+    CheckDStarLiteFinder<kDiagonalOnlyWhenNoObstacles>(19);
+
+    // the search being from the goal, cells blocked on the way just ahead
+    // of the start settle few cells again
+    AStarFinder::grid_t grid(200, 200);
+    MakeRandomGrid(grid, 23, 10);
+    BasicDStarLiteFinder<heuristic::Octile,
+        DiagonalPolicy<kDiagonalIfAtMostOneObstacle> > finder(grid);
+    AStarFinder::pnode_vector_t path = finder.FindPath(0, 0, 199, 199);
+    BOOST_REQUIRE(path);
+    BOOST_REQUIRE(finder.restarted());
+    std::size_t scratch = finder.expanded();
+    BOOST_REQUIRE(finder.FindPath(0, 0, 199, 199));
+    BOOST_REQUIRE(!finder.restarted());
+    BOOST_REQUIRE_EQUAL(0u, finder.expanded());
+    for (std::size_t i = 0; i < 3; ++i) {
+        std::size_t step = 2 + i * 4;
+        grid.SetWalkableAt((*path)[step]->x, (*path)[step]->y, false);
+    }
+    BOOST_REQUIRE(finder.FindPath((*path)[1]->x, (*path)[1]->y, 199, 199));
+    BOOST_REQUIRE(!finder.restarted());
+    BOOST_REQUIRE_LT(10 * finder.expanded(), scratch);
+}
+
+template <class Stats>
+SearchStats StatsOfQuery(const AStarFinder::grid_t &grid,
+                         std::size_t sx, std::size_t sy,
+                         std::size_t ex, std::size_t ey, int &cost) {
+    typedef BasicAStarFinder<heuristic::Octile,
+        DiagonalPolicy<kDiagonalIfAtMostOneObstacle>, DefaultOpenList,
+        Stats> finder_t;
+    typename finder_t::context_t context;
+    AStarFinder::pnode_vector_t path =
+        finder_t().FindPath(sx, sy, ex, ey, grid, context);
+    cost = path ? PathCost(path) : -1;
+
+    SearchStats stats = context.stats().Get();
+    if (!Stats::kEnabled) {
+        return stats;
+    }
+    std::size_t opened = 0;
+    for (std::size_t i = 0; i < grid.size(); ++i) {
+        opened += context.IsOpened(i) ? 1 : 0;
+    }
+    BOOST_REQUIRE_EQUAL(CountClosed(context, grid.size()), stats.expanded);
+    BOOST_REQUIRE_EQUAL(opened, stats.pushed);
+    // every move is rejected, opens or lowers a cell, or is no better; the
+    // start is pushed without one
+    BOOST_REQUIRE_GE(stats.generated + 1,
+        stats.rejected_closed + stats.pushed + stats.updated);
+    return stats;
+}
+
+BOOST_AUTO_TEST_CASE(search_stats_should_count_each_query) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRandomGrid(grid, 77, 30);
+    std::size_t updated = 0, found = 20;
+    for (std::size_t q = 0; q < 20; ++q) {
+        std::size_t sx = q * 7 % 64, sy = q * 13 % 64,
+                    ex = 63 - q * 5 % 64, ey = 63 - q * 11 % 64;
+        int cost = 0, counted_cost = 0, timed_cost = 0;
+        SearchStats none = StatsOfQuery<NoSearchStats>(
+            grid, sx, sy, ex, ey, cost);
+        BOOST_REQUIRE_EQUAL(0u, none.expanded + none.pushed + none.generated);
+        SearchStats counted = StatsOfQuery<CountingSearchStats>(
+            grid, sx, sy, ex, ey, counted_cost);
+        SearchStats timed = StatsOfQuery<TimedSearchStats>(
+            grid, sx, sy, ex, ey, timed_cost);
+        BOOST_REQUIRE_EQUAL(cost, counted_cost);
+        BOOST_REQUIRE_EQUAL(cost, timed_cost);
+        for (int i = 0; i < 3; ++i) {
+            BOOST_REQUIRE_EQUAL(0u, counted.phase_ns[i]);
+        }
+        BOOST_REQUIRE_EQUAL(counted.expanded, timed.expanded);
+        BOOST_REQUIRE_EQUAL(counted.generated, timed.generated);
+        BOOST_REQUIRE_EQUAL(counted.updated, timed.updated);
+        if (timed.expanded > 100) {
+            BOOST_REQUIRE_GT(timed.phase_ns[kHeapPhase] +
+                             timed.phase_ns[kNeighborPhase], 0u);
+        }
+        updated += counted.updated;
+        if (cost >= 0 && found == 20) {
+            found = q;
+        }
+    }
+    // with diagonal moves some cells are reached again by a shorter way
+    BOOST_REQUIRE_GT(updated, 0u);
+
+    // the stats of a context are the ones of its last query, also when it
+    // is searched through AStarFinder
+    BOOST_REQUIRE_LT(found, 20u);
+    AStarFinder finder;
+    finder.Option().allow_diagonal = true;
+    finder.Option().heuristic = heuristic::Octile();
+    BasicSearchContext<DefaultOpenList, CountingSearchStats> context;
+    std::size_t sx = found * 7 % 64, sy = found * 13 % 64,
+                ex = 63 - found * 5 % 64, ey = 63 - found * 11 % 64;
+    BOOST_REQUIRE(finder.FindPath(sx, sy, ex, ey, grid, context));
+    SearchStats first = context.stats().Get();
+    BOOST_REQUIRE_GT(first.expanded, 0u);
+    BOOST_REQUIRE(finder.FindPath(sx, sy, ex, ey, grid, context));
+    BOOST_REQUIRE_EQUAL(first.expanded, context.stats().Get().expanded);
+    BOOST_REQUIRE_EQUAL(CountClosed(context, grid.size()), first.expanded);
+}
+
+// Improve the paths of ARA* a few expansions at a time, and check that
+// they get better within their bounds down to the shortest one.
+template <DiagonalMovement kMovement>
+void CheckARAStarFinder(unsigned seed, std::size_t &first_expanded,
+                        std::size_t &astar_expanded) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRandomGrid(grid, seed, 20);
+    BasicAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> > astar;
+    AStarFinder::context_t context;
+    typedef BasicARAStarFinder<heuristic::Octile, DiagonalPolicy<kMovement> >
+        finder_t;
+    finder_t finder(3, 0.5);
+    for (int i = 0; i < 30; ++i) {
+        NextRandom(seed);
+        std::size_t sx = (seed >> 4) % 64, sy = (seed >> 10) % 64,
+                    ex = (seed >> 16) % 64, ey = (seed >> 22) % 64;
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(sx, sy, ex, ey, grid, context);
+        astar_expanded += CountClosed(context, grid.size());
+
+        finder.Start(sx, sy, ex, ey, grid);
+        int cost = INT_MAX;
+        double bound = 3;
+        std::size_t paths = 0;
+        while (!finder.Improve(20).done) {
+            const typename finder_t::Result &result = finder.result();
+            if (!result.path) {
+                continue;
+            }
+            if (paths++ == 0) {
+                first_expanded += finder.expanded();
+            }
+            BOOST_REQUIRE(expected);
+            BOOST_REQUIRE(IsValidPath(grid, result.path, kMovement));
+            BOOST_REQUIRE_EQUAL(PathCost(result.path), result.cost);
+            BOOST_REQUIRE_LE(result.cost, cost);
+            BOOST_REQUIRE_LE(result.bound, bound);
+            BOOST_REQUIRE_LE(result.cost,
+                             result.bound * PathCost(expected) + 1e-9);
+            cost = result.cost;
+            bound = result.bound;
+        }
+        const typename finder_t::Result &result = finder.result();
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(result.path));
+        if (!expected) {
+            continue;
+        }
+        BOOST_REQUIRE_EQUAL(PathCost(expected), result.cost);
+        BOOST_REQUIRE_EQUAL(1.0, result.bound);
+        BOOST_REQUIRE(IsValidPath(grid, result.path, kMovement));
+        if (paths == 0) {
+            first_expanded += finder.expanded();
+        }
+        BOOST_REQUIRE_EQUAL(result.cost,
+            finder.FindPath(sx, sy, ex, ey, grid).cost);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ara_star_finder_should_improve_its_paths) {
+    std::size_t first_expanded = 0, astar_expanded = 0;
+    CheckARAStarFinder<kDiagonalNever>(31, first_expanded, astar_expanded);
+    CheckARAStarFinder<kDiagonalAlways>(37, first_expanded, astar_expanded);
+    CheckARAStarFinder<kDiagonalIfAtMostOneObstacle>(41, first_expanded,
+                                                     astar_expanded);
+    CheckARAStarFinder<kDiagonalOnlyWhenNoObstacles>(43, first_expanded,
+                                                     astar_expanded);
+    // the first path, by the largest weight, comes after fewer expansions
+    BOOST_REQUIRE_LT(2 * first_expanded, astar_expanded);
+
+    // no expansion past the deadline, and the search goes on after it
+    AStarFinder::grid_t grid(64, 64);
+    ARAStarFinder finder;
+    finder.Start(0, 0, 63, 63, grid);
+    BOOST_REQUIRE(!finder.Improve(std::size_t(-1),
+                                  ARAStarFinder::clock_t::now()).done);
+    BOOST_REQUIRE_EQUAL(0u, finder.expanded());
+    BOOST_REQUIRE(!finder.Improve(1).path);
+    BOOST_REQUIRE_EQUAL(1u, finder.expanded());
+    const ARAStarFinder::Result &result = finder.Improve();
+    BOOST_REQUIRE(result.done);
+    BOOST_REQUIRE_EQUAL(1260, result.cost);
+}
+
+// Search each query a few expansions at a time, the way a frame-based
+// caller does, and check that it ends as the search run at once.
+BOOST_AUTO_TEST_CASE(a_star_search_should_resume_between_steps) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRoomGrid(grid, 53);
+    AStarFinder finder;
+    finder.Option().allow_diagonal = true;
+    finder.Option().heuristic = heuristic::Octile();
+    AStarFinder::context_t whole, sliced;
+    unsigned seed = 59;
+    for (int i = 0; i < 30; ++i) {
+        NextRandom(seed);
+        std::size_t sx = (seed >> 4) % 64, sy = (seed >> 10) % 64,
+                    ex = (seed >> 16) % 64, ey = (seed >> 22) % 64;
+        AStarFinder::pnode_vector_t expected =
+            finder.FindPath(sx, sy, ex, ey, grid, whole);
+        AStarFinder::psearch_t search =
+            finder.StartSearch(sx, sy, ex, ey, grid, sliced);
+        std::size_t steps = 0;
+        while (search->status() == kSearchInProgress) {
+            BOOST_REQUIRE_LE(CountClosed(sliced, grid.size()), 7 * steps);
+            search->Step(7);
+            ++steps;
+        }
+        BOOST_REQUIRE_EQUAL(search->status(),
+                            expected ? kSearchFound : kSearchFailed);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(search->path()));
+        BOOST_REQUIRE_EQUAL(CountClosed(whole, grid.size()),
+                            CountClosed(sliced, grid.size()));
+        if (expected) {
+            BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(search->path()));
+        }
+        // a search over stays so
+        BOOST_REQUIRE_EQUAL(search->status(), search->Step(7));
+    }
+
+    // no expansion past the deadline, and the search goes on after it
+    AStarFinder::grid_t open(64, 64);
+    AStarFinder::psearch_t search = finder.StartSearch(0, 0, 63, 63, open);
+    BOOST_REQUIRE_EQUAL(kSearchInProgress,
+                        search->StepFor(boost::chrono::microseconds(0)));
+    BOOST_REQUIRE_EQUAL(0u, CountClosed(finder.Context(), open.size()));
+    BOOST_REQUIRE_EQUAL(kSearchInProgress, search->Step(1));
+    BOOST_REQUIRE_EQUAL(1u, CountClosed(finder.Context(), open.size()));
+    BOOST_REQUIRE_EQUAL(kSearchFound, search->Step(std::size_t(-1)));
+    BOOST_REQUIRE_EQUAL(63 * 14, PathCost(search->path()));
+
+    // a walled-in goal fails before any step
+    for (unsigned dir = 0; dir < 8; ++dir) {
+        const DirectionOffset &o = OffsetOf(dir);
+        open.SetWalkableAt(32 + o.dx, 32 + o.dy, false);
+    }
+    search = finder.StartSearch(0, 0, 32, 32, open);
+    BOOST_REQUIRE_EQUAL(kSearchFailed, search->status());
+    BOOST_REQUIRE(!search->path());
+}
+
+typedef AsyncFinder<AStarFinder> AsyncAStarFinder;
+
+// Keep the worker until the gate opens, then record the status.
+void WaitAtGate(boost::mutex *gate, boost::atomic<int> *status,
+                const AsyncAStarFinder::Result &result) {
+    boost::lock_guard<boost::mutex> lock(*gate);
+    status->store(result.status);
+}
+
+BOOST_AUTO_TEST_CASE(async_finder_should_answer_and_drop_cancelled_queries) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRoomGrid(grid, 61);
+    FinderOption option = {true, true, heuristic::Octile(), 1};
+    AStarFinder finder(AStarFinder::poption_t(new FinderOption(option)));
+    AStarFinder::context_t context;
+
+    // the paths of the futures are the ones of the queries one by one
+    std::vector<PathQuery> queries;
+    std::vector<AsyncAStarFinder::future_t> futures;
+    {
+        AsyncAStarFinder async(finder, 4, 8);
+        unsigned seed = 67;
+        for (int i = 0; i < 100; ++i) {
+            NextRandom(seed);
+            PathQuery query = {(seed >> 4) % 64, (seed >> 10) % 64,
+                               (seed >> 16) % 64, (seed >> 22) % 64};
+            queries.push_back(query);
+            futures.push_back(async.Submit(query, grid));
+        }
+        BOOST_REQUIRE_LE(async.queued(), 8u);
+    }
+    for (std::size_t i = 0; i < queries.size(); ++i) {
+        const PathQuery &query = queries[i];
+        AStarFinder::pnode_vector_t expected = finder.FindPath(
+            query.start_x, query.start_y, query.end_x, query.end_y,
+            grid, context);
+        BOOST_REQUIRE(futures[i].is_ready());
+        AsyncAStarFinder::Result result = futures[i].get();
+        BOOST_REQUIRE_EQUAL(expected ? kPathFound : kPathNotFound,
+                            result.status);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(result.path));
+        if (expected) {
+            BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(result.path));
+        }
+    }
+
+    // with the one worker held, the queue of one fills up, and the query
+    // cancelled while queued is dropped unsearched
+    boost::mutex gate;
+    boost::atomic<int> first(-1), second(-1);
+    PathQuery query = {0, 0, 62, 62};
+    CancellationToken token;
+    {
+        AsyncAStarFinder async(finder, 1, 1);
+        boost::unique_lock<boost::mutex> closed(gate);
+        async.Submit(query, grid, CancellationToken(),
+                     boost::bind(&WaitAtGate, &gate, &first, _1));
+        async.Submit(query, grid, token,
+                     boost::bind(&WaitAtGate, &gate, &second, _1));
+        AsyncAStarFinder::future_t turned_down;
+        BOOST_REQUIRE(!async.TrySubmit(query, grid, CancellationToken(),
+                                       turned_down));
+        BOOST_REQUIRE_EQUAL(1u, async.queued());
+        token.Cancel();
+        closed.unlock();
+    }
+    BOOST_REQUIRE_EQUAL(int(kPathFound), first.load());
+    BOOST_REQUIRE_EQUAL(int(kPathCancelled), second.load());
+
+    // a query cancelled before it is searched is not
+    AStarFinder::pnode_vector_t path;
+    BOOST_REQUIRE_EQUAL(kPathCancelled, FindPathUnlessCancelled(
+        finder, query, grid, context, token, path));
+    BOOST_REQUIRE(!path);
+    BOOST_REQUIRE_EQUAL(kPathFound, FindPathUnlessCancelled(
+        finder, query, grid, context, CancellationToken(), path));
+    BOOST_REQUIRE(path);
+}
+
+BOOST_AUTO_TEST_CASE(reverse_resumable_distance_should_be_the_shortest) {
+    AStarFinder::grid_t grid(64, 64);
+    MakeRoomGrid(grid, 73);
+    typedef DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> diagonal_t;
+    BasicAStarFinder<heuristic::Octile, diagonal_t> astar;
+    AStarFinder::context_t context;
+    ReverseResumableDistance<diagonal_t> distance(grid, 60, 60, 1, 2);
+    unsigned seed = 79;
+    for (int i = 0; i < 100; ++i) {
+        NextRandom(seed);
+        std::size_t x = (seed >> 4) % 64, y = (seed >> 16) % 64;
+        // A* leaves a blocked start, the agents are never on one
+        if (!grid.IsWalkableAt(x, y)) {
+            continue;
+        }
+        AStarFinder::pnode_vector_t expected =
+            astar.FindPath(x, y, 60, 60, grid, context);
+        BOOST_REQUIRE_EQUAL(expected ? PathCost(expected) :
+                            ReverseResumableDistance<diagonal_t>::kUnreachable,
+                            distance.Distance(x, y));
+    }
+}
+
+// Plan agents to their goals window after window, moving them half a
+// window each time, and check that no two of them ever meet or swap.
+BOOST_AUTO_TEST_CASE(cooperative_finder_should_keep_agents_apart) {
+    const DiagonalMovement kMovement = kDiagonalOnlyWhenNoObstacles;
+    AStarFinder::grid_t grid(48, 48);
+    MakeRandomGrid(grid, 71, 15);
+    std::vector<PathQuery> agents;
+    std::vector<bool> started(grid.size()), aimed(grid.size());
+    unsigned seed = 83;
+    while (agents.size() < 60) {
+        NextRandom(seed);
+        PathQuery agent = {(seed >> 4) % 48, (seed >> 10) % 48,
+                           (seed >> 16) % 48, (seed >> 22) % 48};
+        std::size_t start = grid.IndexAt(agent.start_x, agent.start_y),
+                    goal = grid.IndexAt(agent.end_x, agent.end_y);
+        if (!started[start] && !aimed[goal] &&
+                grid.IsWalkableAt(agent.start_x, agent.start_y) &&
+                grid.IsReachable(agent.start_x, agent.start_y,
+                                 agent.end_x, agent.end_y, kMovement)) {
+            started[start] = aimed[goal] = true;
+            agents.push_back(agent);
+        }
+    }
+
+    CooperativeFinder finder(8);
+    const unsigned window = finder.window();
+    std::size_t arrived = 0;
+    for (int pass = 0; pass < 40 && arrived < agents.size(); ++pass) {
+        const CooperativeFinder::arena_t &paths =
+            finder.PlanWindow(agents, grid);
+        BOOST_REQUIRE_EQUAL(agents.size(), paths.size());
+        std::vector<unsigned> holder(grid.size() * (window + 1), ~0u);
+        for (std::size_t i = 0; i < agents.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(window + 1, paths.PathSize(i));
+            CooperativeFinder::arena_t::const_iterator cell = paths.begin(i);
+            BOOST_REQUIRE_EQUAL(agents[i].start_x, cell[0]->x);
+            BOOST_REQUIRE_EQUAL(agents[i].start_y, cell[0]->y);
+            for (unsigned t = 0; t <= window; ++t) {
+                std::size_t index = grid.IndexAt(cell[t]->x, cell[t]->y);
+                BOOST_REQUIRE_EQUAL(~0u, holder[t * grid.size() + index]);
+                holder[t * grid.size() + index] = unsigned(i);
+                if (t > 0 && cell[t] != cell[t - 1]) {
+                    AStarFinder::pnode_vector_t step(
+                        new AStarFinder::node_vector_t);
+                    step->push_back(cell[t - 1]);
+                    step->push_back(cell[t]);
+                    BOOST_REQUIRE(IsValidPath(grid, step, kMovement));
+                }
+            }
+        }
+        // no two agents trade their cells
+        for (std::size_t i = 0; i < agents.size(); ++i) {
+            CooperativeFinder::arena_t::const_iterator cell = paths.begin(i);
+            for (unsigned t = 1; t <= window; ++t) {
+                unsigned other = holder[(t - 1) * grid.size() +
+                    grid.IndexAt(cell[t]->x, cell[t]->y)];
+                BOOST_REQUIRE(other == i || other == ~0u ||
+                    holder[t * grid.size() +
+                        grid.IndexAt(cell[t - 1]->x, cell[t - 1]->y)] !=
+                    other);
+            }
+        }
+
+        arrived = 0;
+        for (std::size_t i = 0; i < agents.size(); ++i) {
+            AStarFinder::pnode_t next = paths.begin(i)[window / 2];
+            agents[i].start_x = next->x;
+            agents[i].start_y = next->y;
+            if (next->x == agents[i].end_x && next->y == agents[i].end_y) {
+                ++arrived;
+            }
+        }
+    }
+    BOOST_REQUIRE_EQUAL(agents.size(), arrived);
+}
+
+// An agent with no way to its goal waits on the only way of another one,
+// which is planned first and must stop before it.
+BOOST_AUTO_TEST_CASE(cooperative_finder_should_not_run_into_a_stuck_agent) {
+    AStarFinder::grid_t grid(10, 5);
+    for (std::size_t y = 0; y < 5; ++y) {
+        for (std::size_t x = 0; x < 10; ++x) {
+            grid.SetWalkableAt(x, y, y == 1 || (x == 5 && y == 3));
+        }
+    }
+    std::vector<PathQuery> agents;
+    PathQuery through = {0, 1, 9, 1}, walled = {5, 1, 5, 3};
+    agents.push_back(through);
+    agents.push_back(walled);
+    CooperativeFinder finder(12);
+    const CooperativeFinder::arena_t &paths = finder.PlanWindow(agents, grid);
+    BOOST_REQUIRE(!finder.stuck(0));
+    BOOST_REQUIRE(finder.stuck(1));
+    CooperativeFinder::arena_t::const_iterator first = paths.begin(0),
+                                               second = paths.begin(1);
+    for (unsigned t = 0; t <= finder.window(); ++t) {
+        BOOST_REQUIRE_EQUAL(5u, second[t]->x);
+        BOOST_REQUIRE_EQUAL(1u, second[t]->y);
+        BOOST_REQUIRE_LT(first[t]->x, 5u);
+    }
+    // as far as it goes
+    BOOST_REQUIRE_EQUAL(4u, first[finder.window()]->x);
+}
+
+// Corridors of one agent through and one walled in each: every walled
+// agent is run into by the agent just before it, which alone is planned
+// again, so the pass searches a bounded number of agents per agent.
+BOOST_AUTO_TEST_CASE(cooperative_finder_should_replan_only_the_agents_after) {
+    const std::size_t kCorridors = 20;
+    AStarFinder::grid_t grid(10, 4 * kCorridors);
+    std::vector<PathQuery> agents;
+    for (std::size_t c = 0; c < kCorridors; ++c) {
+        std::size_t y = 4 * c + 1;
+        for (std::size_t x = 0; x < 10; ++x) {
+            for (std::size_t dy = 0; dy < 4; ++dy) {
+                grid.SetWalkableAt(x, 4 * c + dy,
+                                   dy == 1 || (x == 5 && dy == 3));
+            }
+        }
+        PathQuery through = {0, y, 9, y}, walled = {5, y, 5, y + 2};
+        agents.push_back(through);
+        agents.push_back(walled);
+    }
+    CooperativeFinder finder(12);
+    const CooperativeFinder::arena_t &paths = finder.PlanWindow(agents, grid);
+    for (std::size_t i = 0; i < agents.size(); i += 2) {
+        BOOST_REQUIRE(!finder.stuck(i));
+        BOOST_REQUIRE(finder.stuck(i + 1));
+        BOOST_REQUIRE_EQUAL(4u, paths.begin(i)[finder.window()]->x);
+        BOOST_REQUIRE_EQUAL(5u, paths.begin(i + 1)[finder.window()]->x);
+    }
+    // each agent through twice, each walled one once
+    BOOST_REQUIRE_LE(finder.searched(), 3 * kCorridors);
+}
+
+BOOST_AUTO_TEST_CASE(a_star_finder_should_search_a_chunked_grid) {
+    typedef BasicAStarFinder<heuristic::Octile,
+        DiagonalPolicy<kDiagonalOnlyWhenNoObstacles> > finder_t;
+    typedef SparseSearchContext<DefaultOpenList> sparse_t;
+    // 2^32 cells, open but rooms walled in away from the tile borders
+    ChunkedGrid huge(65536, 65536);
+    const std::size_t ox = 40001, oy = 30003;
+    AStarFinder::grid_t rooms(64, 64);
+    MakeRoomGrid(rooms, 61);
+    for (std::size_t y = 0; y < 66; ++y) {
+        for (std::size_t x = 0; x < 66; ++x) {
+            bool inside = x > 0 && y > 0 && x < 65 && y < 65;
+            huge.SetWalkableAt(ox - 1 + x, oy - 1 + y,
+                               inside && rooms.IsWalkableAt(x - 1, y - 1));
+        }
+    }
+    BOOST_REQUIRE_EQUAL(4u, huge.detailed_tiles());
+
+    finder_t finder;
+    finder_t::context_t context;
+    sparse_t sparse;
+    unsigned seed = 67;
+    for (int i = 0; i < 30; ++i) {
+        NextRandom(seed);
+        std::size_t sx = (seed >> 4) % 64, sy = (seed >> 10) % 64,
+                    ex = (seed >> 16) % 64, ey = (seed >> 22) % 64;
+        finder_t::pnode_vector_t expected =
+            finder.FindPath(sx, sy, ex, ey, rooms, context);
+        finder_t::pnode_vector_t path = finder.FindPath(
+            ox + sx, oy + sy, ox + ex, oy + ey, huge, sparse);
+        BOOST_REQUIRE_EQUAL(bool(expected), bool(path));
+        if (expected) {
+            BOOST_REQUIRE_EQUAL(PathCost(expected), PathCost(path));
+            BOOST_REQUIRE_EQUAL(ox + ex, path->back()->x);
+            BOOST_REQUIRE_EQUAL(oy + ey, path->back()->y);
+        }
+    }
+
+    // the far corner, the context holding the cells touched only
+    finder_t::pnode_vector_t path =
+        finder.FindPath(65535, 65535, 65035, 65335, huge, sparse);
+    BOOST_REQUIRE(path);
+    BOOST_REQUIRE_EQUAL(200 * 14 + 300 * 10, PathCost(path));
+    BOOST_REQUIRE_LT(sparse.touched(), 500u * 200u);
+    huge.ReleaseNodes();
+}
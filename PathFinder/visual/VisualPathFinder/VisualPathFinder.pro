@@ -15,6 +15,9 @@ TEMPLATE = app
 LIBRARYPATH = /users/moonraito/Desktop/A*/PathFinder/src
 INCLUDEPATH += ../../src \
     $$LIBRARYPATH/boost/1.57.0/include
+# the searches are stepped by the steady clock; msvc links boost by itself
+!msvc:LIBS += -L$$LIBRARYPATH/boost/1.57.0/lib \
+    -lboost_chrono -lboost_system
 
 HEADERS += mainwindow.h
 SOURCES += \
@@ -1,6 +1,8 @@
 #ifndef GRIDDATADELEGATE_HPP
 #define GRIDDATADELEGATE_HPP
 
+#include <QCoreApplication>
+#include <QEventLoop>
 #include <QScopedPointer>
 #include "boost/foreach.hpp"
 #include "gridscene.h"
@@ -14,6 +16,8 @@ class GridDataDelegate : public GridScene::GridSceneDelegate
 public:
     typedef typename Finder::grid_t grid_t;
     typedef typename Finder::pnode_vector_t pnode_vector_t;
+    typedef typename Finder::context_t context_t;
+    typedef typename Finder::psearch_t psearch_t;
 
     GridDataDelegate(GridScene *scene, Finder *finder);
     virtual void onPrepared(int row, int column);
@@ -27,12 +31,17 @@ protected:
     void notifyNodesChanged();
     void notifyShortestPath(const pnode_vector_t &pnodes);
     void setCellData(CellItem * const cellItem,
-                     const typename grid_t::pnode_t &node);
+                     const typename context_t::State &state);
 #ifndef NDEBUG
     void debugPrint();
 #endif
+    // the time a search runs before the events are processed again
+    enum { kSliceMicroseconds = 10000 };
+
     Finder *m_finder;
     QScopedPointer<grid_t> m_grid;
+    // the search in progress, dropped by a new one or a change of the grid
+    psearch_t m_search;
 };
 
 template <class Finder>
@@ -45,6 +54,7 @@ GridDataDelegate<Finder>::GridDataDelegate(GridScene *scene, Finder *finder) :
 template <class Finder>
 void GridDataDelegate<Finder>::onPrepared(int row, int column)
 {
+    m_search.reset();
     m_grid.reset(new grid_t(column, row));
 }
 
@@ -69,14 +79,25 @@ void GridDataDelegate<Finder>::onSearchStarted(CellItem * const startCellItem,
                 startCellItem->data(GridScene::kCellAxis).toPoint();
         const QPoint &endPoint =
                 endCellItem->data(GridScene::kCellAxis).toPoint();
-        pnode_vector_t nodes = m_finder->FindPath(
+        // search a slice at a time, repainting in between; the clicks and
+        // keys wait for the search, so none of them re-enters here, edits
+        // the grid or closes the scene while the search reads them
+        psearch_t search = m_finder->StartSearch(
                 startPoint.x(), startPoint.y(),
                 endPoint.x(), endPoint.y(), *m_grid);
+        m_search = search;
+        while (search->StepFor(boost::chrono::microseconds(
+                kSliceMicroseconds)) == kSearchInProgress) {
+            QCoreApplication::processEvents(
+                    QEventLoop::ExcludeUserInputEvents);
+            if (m_search != search)
+                return;
+        }
+        m_search.reset();
         if (m_scene) {
             notifyNodesChanged();
-            notifyShortestPath(nodes);
+            notifyShortestPath(search->path());
         }
-        m_finder->ResetGrid(*m_grid);
     }
 }
 
@@ -84,6 +105,7 @@ template <class Finder>
 void GridDataDelegate<Finder>::syncWalkable(CellItem * const cellItem)
 {
     if (m_grid) {
+        m_search.reset();
         const QPoint &p = cellItem->data(GridScene::kCellAxis).toPoint();
         bool unwalkable = cellItem->cellType() == CellItem::kCellUnwalkable;
         m_grid->SetWalkableAt(p.x(), p.y(), !unwalkable);
@@ -95,19 +117,17 @@ void GridDataDelegate<Finder>::notifyNodesChanged()
 {
     typedef typename grid_t::size_type size_t;
     typedef typename grid_t::pnode_t pnode_t;
-    typedef typename grid_t::pnode_grid_t pnode_grid_t;
-    pnode_grid_t nodes = m_grid->nodes();
-    size_t w = m_grid->width(),
-           h = m_grid->height();
-    for (size_t i = 0; i < h; ++i) {
-        for (size_t j = 0; j < w; ++j) {
-            pnode_t &node = (*nodes)[i][j];
-            // node must be opened while it's closed
-            if (node->opened/* || node->closed*/) {
-                CellItem *cellItem = m_scene->cellItemAt(node->x, node->y);
-                setCellData(cellItem, node);
-                m_scene->callbackCellItemChanged(cellItem);
-            }
+    typedef typename context_t::State state_t;
+    const context_t &context = m_finder->Context();
+    size_t n = m_grid->size();
+    for (size_t i = 0; i < n; ++i) {
+        const state_t *state = context.Find(i);
+        // node must be opened while it's closed
+        if (state && state->opened/* || state->closed*/) {
+            pnode_t node = m_grid->GetNodeAt(i);
+            CellItem *cellItem = m_scene->cellItemAt(node->x, node->y);
+            setCellData(cellItem, *state);
+            m_scene->callbackCellItemChanged(cellItem);
         }
     }
 }
@@ -118,7 +138,7 @@ void GridDataDelegate<Finder>::notifyShortestPath(const pnode_vector_t &pnodes)
     GridScene::CellItemVector cells;
     if (pnodes) {
         typedef typename grid_t::pnode_t pnode_t;
-        BOOST_FOREACH(pnode_t &node, *pnodes) {
+        BOOST_FOREACH(const pnode_t &node, *pnodes) {
             cells.push_back(m_scene->cellItemAt(node->x, node->y));
         }
     }
@@ -127,13 +147,13 @@ void GridDataDelegate<Finder>::notifyShortestPath(const pnode_vector_t &pnodes)
 
 template <class Finder>
 void GridDataDelegate<Finder>::setCellData(CellItem * const cellItem,
-                                           const typename grid_t::pnode_t &node)
+                                           const typename context_t::State &state)
 {
-    cellItem->setData(GridScene::kCellF, node->f);
-    cellItem->setData(GridScene::kCellG, node->g);
-    cellItem->setData(GridScene::kCellH, node->h);
-    //cellItem->setData(GridScene::kCellOpened, node->opened);
-    cellItem->setData(GridScene::kCellClosed, node->closed);
+    cellItem->setData(GridScene::kCellF, state.f);
+    cellItem->setData(GridScene::kCellG, state.g);
+    cellItem->setData(GridScene::kCellH, state.h);
+    //cellItem->setData(GridScene::kCellOpened, state.opened);
+    cellItem->setData(GridScene::kCellClosed, state.closed);
 }
 
 #ifndef NDEBUG
@@ -142,14 +162,12 @@ void GridDataDelegate<Finder>::debugPrint()
 {
     typedef typename grid_t::size_type size_t;
     typedef typename grid_t::pnode_t pnode_t;
-    typedef typename grid_t::pnode_grid_t pnode_grid_t;
-    pnode_grid_t nodes = m_grid->nodes();
     size_t w = m_grid->width(),
            h = m_grid->height();
     QDebug dbg = qDebug();
     for (size_t i = 0; i < h; ++i) {
         for (size_t j = 0; j < w; ++j) {
-            pnode_t &node = (*nodes)[i][j];
+            pnode_t node = m_grid->GetNodeAt(j, i);
             dbg.nospace() << "(" << node->x
                           << " " << node->y
                           << " " << node->walkable